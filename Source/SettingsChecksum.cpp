@@ -0,0 +1,314 @@
+#include "SettingsChecksum.h"
+#include <array>
+
+#if defined(__x86_64__) && defined(__linux__)
+    #define SETTINGS_CHECKSUM_X86_64_ACCELERATION 1
+    #include <immintrin.h>
+#else
+    #define SETTINGS_CHECKSUM_X86_64_ACCELERATION 0
+#endif
+
+namespace
+{
+    // Reflected polynomials.
+    constexpr uint32_t CRC32_POLYNOMIAL  = 0xEDB88320;
+    constexpr uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+    using SlicingTables_t = std::array<std::array<uint32_t, 256>, 8>;
+    using PowerTable_t    = std::array<uint32_t, 32>;
+
+    // Table k maps a byte to its CRC after being followed by k zero bytes.
+    constexpr SlicingTables_t makeSlicingTables(const uint32_t polynomial)
+    {
+        SlicingTables_t tables{};
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc & 1) ? (crc >> 1) ^ polynomial : crc >> 1;
+            }
+            tables[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            for (size_t k = 1; k < tables.size(); k++)
+            {
+                tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+            }
+        }
+        return tables;
+    }
+
+    // Multiply two polynomials modulo the CRC polynomial (bit 31 holds the x^0 term).
+    constexpr uint32_t multiplyModulo(uint32_t a, uint32_t b, const uint32_t polynomial)
+    {
+        uint32_t mask    = 1U << 31;
+        uint32_t product = 0;
+        while (mask != 0)
+        {
+            if (a & mask)
+            {
+                product ^= b;
+                a ^= mask;
+                if (a == 0)
+                {
+                    break;
+                }
+            }
+            mask >>= 1;
+            b = (b & 1) ? (b >> 1) ^ polynomial : b >> 1;
+        }
+        return product;
+    }
+
+    // Entry k holds x^(2^k) modulo the CRC polynomial.
+    constexpr PowerTable_t makePowerTable(const uint32_t polynomial)
+    {
+        PowerTable_t table{};
+        table[0] = 1U << 30; // x^1
+        for (size_t k = 1; k < table.size(); k++)
+        {
+            table[k] = multiplyModulo(table[k - 1], table[k - 1], polynomial);
+        }
+        return table;
+    }
+
+    constexpr SlicingTables_t CRC32_TABLES  = makeSlicingTables(CRC32_POLYNOMIAL);
+    constexpr SlicingTables_t CRC32C_TABLES = makeSlicingTables(CRC32C_POLYNOMIAL);
+    constexpr PowerTable_t    CRC32_POWERS  = makePowerTable(CRC32_POLYNOMIAL);
+    constexpr PowerTable_t    CRC32C_POWERS = makePowerTable(CRC32C_POLYNOMIAL);
+
+    static_assert(CRC32_TABLES[0][1] == 0x77073096, "Invalid CRC32 table");
+    static_assert(CRC32C_TABLES[0][1] == 0xF26B8303, "Invalid CRC32C table");
+
+    // All the update functions work over the raw CRC register (the finished CRC with its bits inverted).
+    uint32_t updateSoftware(const SlicingTables_t& tables, uint32_t crc, const uint8_t* data, size_t size)
+    {
+        while (size >= 8)
+        {
+            const uint32_t low = crc ^ (static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+                                        static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24);
+            crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^
+                  tables[4][low >> 24] ^ tables[3][data[4]] ^ tables[2][data[5]] ^ tables[1][data[6]] ^
+                  tables[0][data[7]];
+            data += 8;
+            size -= 8;
+        }
+        while (size-- > 0)
+        {
+            crc = (crc >> 8) ^ tables[0][(crc ^ *data++) & 0xFF];
+        }
+        return crc;
+    }
+
+#if SETTINGS_CHECKSUM_X86_64_ACCELERATION
+    bool cpuSupportsSse42()
+    {
+        static const bool supported = __builtin_cpu_supports("sse4.2");
+        return supported;
+    }
+
+    bool cpuSupportsPclmul()
+    {
+        static const bool supported = __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+        return supported;
+    }
+
+    __attribute__((target("sse4.2"))) uint32_t updateCrc32cSse42(uint32_t crc, const uint8_t* data, size_t size)
+    {
+        uint64_t crc64 = crc;
+        while (size >= 8)
+        {
+            uint64_t word;
+            __builtin_memcpy(&word, data, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+            data += 8;
+            size -= 8;
+        }
+        crc = static_cast<uint32_t>(crc64);
+        while (size-- > 0)
+        {
+            crc = _mm_crc32_u8(crc, *data++);
+        }
+        return crc;
+    }
+
+    // Folds 64-byte blocks with carry-less multiplications, then reduces with Barrett reduction.
+    // size must be a multiple of 16 and at least 64.
+    __attribute__((target("sse4.2,pclmul"))) uint32_t updateCrc32Pclmul(const uint32_t crc, const uint8_t* data,
+                                                                         size_t size)
+    {
+        alignas(16) static constexpr uint64_t k1k2[]       = {0x0154442bd4, 0x01c6e41596};
+        alignas(16) static constexpr uint64_t k3k4[]       = {0x01751997d0, 0x00ccaa009e};
+        alignas(16) static constexpr uint64_t k5k0[]       = {0x0163cd6124, 0x0000000000};
+        alignas(16) static constexpr uint64_t polynomial[] = {0x01db710641, 0x01f7011641};
+
+        __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+        __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+        __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+        __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+        x1         = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+        __m128i x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+        data += 64;
+        size -= 64;
+
+        while (size >= 64)
+        {
+            const __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            const __m128i x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+            const __m128i x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+            const __m128i x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+            x1               = _mm_clmulepi64_si128(x1, x0, 0x11);
+            x2               = _mm_clmulepi64_si128(x2, x0, 0x11);
+            x3               = _mm_clmulepi64_si128(x3, x0, 0x11);
+            x4               = _mm_clmulepi64_si128(x4, x0, 0x11);
+            x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00)));
+            x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10)));
+            x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20)));
+            x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30)));
+            data += 64;
+            size -= 64;
+        }
+
+        // Fold the four lanes into one.
+        x0         = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+        __m128i x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1         = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x2), x5);
+        x5         = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1         = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x3), x5);
+        x5         = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1         = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x4), x5);
+
+        while (size >= 16)
+        {
+            x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+            x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x11), x2), x5);
+            data += 16;
+            size -= 16;
+        }
+
+        // Fold 128 bits into 64 bits.
+        x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+        x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+        x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+        x2 = _mm_srli_si128(x1, 4);
+        x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, x3), x0, 0x00), x2);
+
+        // Barrett reduction to 32 bits.
+        x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(polynomial));
+        x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, x3), x0, 0x10);
+        x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, x3), x0, 0x00);
+        x1 = _mm_xor_si128(x1, x2);
+
+        return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+    }
+#endif
+
+    uint32_t updateRegister(const SettingsChecksumAlgorithm_t algorithm, uint32_t crc, const uint8_t* data,
+                            size_t size, [[maybe_unused]] const bool allowHardwareAcceleration)
+    {
+        if (algorithm == SettingsChecksumAlgorithm_t::CRC32C)
+        {
+#if SETTINGS_CHECKSUM_X86_64_ACCELERATION
+            if (allowHardwareAcceleration && cpuSupportsSse42())
+            {
+                return updateCrc32cSse42(crc, data, size);
+            }
+#endif
+            return updateSoftware(CRC32C_TABLES, crc, data, size);
+        }
+
+#if SETTINGS_CHECKSUM_X86_64_ACCELERATION
+        if (allowHardwareAcceleration && size >= 64 && cpuSupportsPclmul())
+        {
+            const size_t foldedSize = size & ~static_cast<size_t>(15);
+            crc                     = updateCrc32Pclmul(crc, data, foldedSize);
+            data += foldedSize;
+            size -= foldedSize;
+        }
+#endif
+        return updateSoftware(CRC32_TABLES, crc, data, size);
+    }
+} // namespace
+
+SettingsChecksum::SettingsChecksum(const SettingsChecksumAlgorithm_t algorithm)
+{
+    this->algorithm = algorithm;
+    this->crc       = 0;
+    this->size      = 0;
+}
+
+void SettingsChecksum::reset()
+{
+    this->crc  = 0;
+    this->size = 0;
+}
+
+void SettingsChecksum::update(const void* data, const size_t size)
+{
+    this->crc = calculate(algorithm, data, size, this->crc);
+    this->size += size;
+}
+
+uint32_t SettingsChecksum::getValue() const
+{
+    return crc;
+}
+
+uint64_t SettingsChecksum::getSize() const
+{
+    return size;
+}
+
+SettingsChecksumAlgorithm_t SettingsChecksum::getAlgorithm() const
+{
+    return algorithm;
+}
+
+uint32_t SettingsChecksum::calculate(const SettingsChecksumAlgorithm_t algorithm, const void* data, const size_t size,
+                                     const uint32_t crc, const bool allowHardwareAcceleration)
+{
+    return ~updateRegister(algorithm, ~crc, static_cast<const uint8_t*>(data), size, allowHardwareAcceleration);
+}
+
+uint32_t SettingsChecksum::combine(const SettingsChecksumAlgorithm_t algorithm, const uint32_t crc1,
+                                   const uint32_t crc2, uint64_t size2)
+{
+    const bool      isCrc32c   = algorithm == SettingsChecksumAlgorithm_t::CRC32C;
+    const uint32_t  polynomial = isCrc32c ? CRC32C_POLYNOMIAL : CRC32_POLYNOMIAL;
+    const uint32_t* powers     = isCrc32c ? CRC32C_POWERS.data() : CRC32_POWERS.data();
+
+    // Multiply crc1 by x^(8 * size2), adding the powers of two that compose the shift.
+    uint32_t shift = 1U << 31; // x^0
+    for (uint32_t k = 3; size2 != 0; size2 >>= 1, k++)
+    {
+        if (size2 & 1)
+        {
+            shift = multiplyModulo(powers[k & 31], shift, polynomial);
+        }
+    }
+    return multiplyModulo(shift, crc1, polynomial) ^ crc2;
+}
+
+bool SettingsChecksum::isHardwareAccelerated([[maybe_unused]] const SettingsChecksumAlgorithm_t algorithm)
+{
+#if SETTINGS_CHECKSUM_X86_64_ACCELERATION
+    if (algorithm == SettingsChecksumAlgorithm_t::CRC32C)
+    {
+        return cpuSupportsSse42();
+    }
+    if (algorithm == SettingsChecksumAlgorithm_t::CRC32)
+    {
+        return cpuSupportsPclmul();
+    }
+#endif
+    return false;
+}
+
+bool SettingsChecksum::isValidAlgorithm(const SettingsChecksumAlgorithm_t algorithm)
+{
+    return algorithm < SettingsChecksumAlgorithm_t::MAX_SETTINGS_CHECKSUM_ALGORITHM;
+}
@@ -0,0 +1,388 @@
+#include "SettingsCompressor.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace
+{
+    // LZ77 sequences: a token with the literals length (high nibble) and the match length minus
+    // MIN_MATCH_SIZE (low nibble), the extra length bytes of the literals, the literals, and for every sequence but
+    // the last one, the 16 bits little endian match offset and the extra length bytes of the match. A nibble of 15
+    // is followed by bytes that are added to the length until one of them is not 255.
+    constexpr size_t   MIN_MATCH_SIZE   = 4;
+    constexpr uint32_t HASH_BITS        = 12;
+    constexpr uint8_t  NIBBLE_MAX       = 15;
+    constexpr char     ESCAPE_CHARACTER = '\x10';
+    constexpr char     ESCAPE_MASK      = 0x20;
+
+    uint32_t read32(const char* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    uint32_t hash(const uint32_t value)
+    {
+        return (value * 2654435761U) >> (32 - HASH_BITS);
+    }
+
+    void appendLength(std::string& output, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            output.push_back(static_cast<char>(255));
+        }
+        output.push_back(static_cast<char>(length));
+    }
+
+    bool readLength(std::string_view& data, size_t& length)
+    {
+        uint8_t byte = 255;
+        while (byte == 255)
+        {
+            if (data.empty())
+            {
+                return false;
+            }
+            byte = static_cast<uint8_t>(data.front());
+            data.remove_prefix(1);
+            length += byte;
+        }
+        return true;
+    }
+
+    void appendSequence(std::string& output, const std::string_view literals, const size_t matchSize,
+                        const size_t offset)
+    {
+        const size_t matchLength = matchSize > 0 ? matchSize - MIN_MATCH_SIZE : 0;
+        output.push_back(static_cast<char>(std::min<size_t>(literals.size(), NIBBLE_MAX) << 4 |
+                                           std::min<size_t>(matchLength, NIBBLE_MAX)));
+        if (literals.size() >= NIBBLE_MAX)
+        {
+            appendLength(output, literals.size() - NIBBLE_MAX);
+        }
+        output.append(literals);
+        if (matchSize > 0)
+        {
+            output.push_back(static_cast<char>(offset & 0xFF));
+            output.push_back(static_cast<char>(offset >> 8));
+            if (matchLength >= NIBBLE_MAX)
+            {
+                appendLength(output, matchLength - NIBBLE_MAX);
+            }
+        }
+    }
+
+    bool isEscaped(const char character)
+    {
+        return character == '\0' || character == '\n' || character == '\r' || character == ESCAPE_CHARACTER;
+    }
+} // namespace
+
+SettingsCompressor::SettingsCompressor(const size_t blockSize)
+{
+    assert(blockSize > 0 && blockSize <= SETTINGS_COMPRESSION_MAX_BLOCK_SIZE && "Invalid compression block size");
+
+    this->blockSize = blockSize;
+    this->inKey     = true;
+}
+
+void SettingsCompressor::begin()
+{
+    block.clear();
+    key.clear();
+    previousKey.clear();
+    inKey = true;
+}
+
+void SettingsCompressor::compress(std::string_view records, std::string& output)
+{
+    // Record format: <shared prefix length><rest of the key>\t<type>\t<value>\n
+    while (!records.empty())
+    {
+        if (inKey)
+        {
+            const size_t keyEnd = records.find('\t');
+            key.append(records.substr(0, keyEnd));
+            if (keyEnd == std::string_view::npos)
+            {
+                return;
+            }
+            const size_t sharedSize = std::min<size_t>(
+                std::mismatch(key.begin(), key.end(), previousKey.begin(), previousKey.end()).first - key.begin(), 255);
+            block.push_back(static_cast<char>(sharedSize));
+            block.append(key, sharedSize);
+            block.push_back('\t');
+            previousKey.swap(key);
+            key.clear();
+            inKey = false;
+            records.remove_prefix(keyEnd + 1);
+        }
+        else
+        {
+            const size_t recordEnd = records.find('\n');
+            block.append(records.substr(0, recordEnd == std::string_view::npos ? recordEnd : recordEnd + 1));
+            if (recordEnd == std::string_view::npos)
+            {
+                records = {};
+            }
+            else
+            {
+                inKey = true;
+                records.remove_prefix(recordEnd + 1);
+            }
+        }
+
+        if (block.size() >= blockSize)
+        {
+            size_t blockStart = 0;
+            for (; block.size() - blockStart >= blockSize; blockStart += blockSize)
+            {
+                compressBlock(std::string_view(block).substr(blockStart, blockSize), output);
+            }
+            block.erase(0, blockStart);
+        }
+    }
+}
+
+void SettingsCompressor::end(std::string& output)
+{
+    // A stream that ends in the middle of a key keeps it whole, it is the last data of the stream.
+    if (inKey && !key.empty())
+    {
+        block.push_back('\0');
+        block.append(key);
+    }
+    if (!block.empty())
+    {
+        compressBlock(block, output);
+    }
+    begin();
+}
+
+void SettingsCompressor::compressBlock(const std::string_view data, std::string& output)
+{
+    // Line format: <escaped(<size of the block as 7 bits groups><LZ77 sequences>)>\n
+    std::string sequences;
+    sequences.reserve(data.size() + data.size() / 255 + 16);
+    size_t size = data.size();
+    for (; size > 0x7F; size >>= 7)
+    {
+        sequences.push_back(static_cast<char>((size & 0x7F) | 0x80));
+    }
+    sequences.push_back(static_cast<char>(size));
+
+    hashTable.assign(static_cast<size_t>(1) << HASH_BITS, -1);
+    size_t literalsStart = 0;
+    size_t position      = 0;
+    while (position + MIN_MATCH_SIZE <= data.size())
+    {
+        const uint32_t value     = read32(data.data() + position);
+        int32_t&       candidate = hashTable[hash(value)];
+        if (candidate >= 0 && read32(data.data() + candidate) == value)
+        {
+            size_t matchSize = MIN_MATCH_SIZE;
+            while (position + matchSize < data.size() && data[candidate + matchSize] == data[position + matchSize])
+            {
+                matchSize++;
+            }
+            appendSequence(sequences, data.substr(literalsStart, position - literalsStart), matchSize,
+                           position - candidate);
+            candidate = static_cast<int32_t>(position);
+            position += matchSize;
+            literalsStart = position;
+        }
+        else
+        {
+            candidate = static_cast<int32_t>(position);
+            position++;
+        }
+    }
+    appendSequence(sequences, data.substr(literalsStart), 0, 0);
+
+    for (const char character : sequences)
+    {
+        if (isEscaped(character))
+        {
+            output.push_back(ESCAPE_CHARACTER);
+            output.push_back(static_cast<char>(character ^ ESCAPE_MASK));
+        }
+        else
+        {
+            output.push_back(character);
+        }
+    }
+    output.push_back('\n');
+}
+
+SettingsDecompressor::SettingsDecompressor()
+{
+    this->state = RecordStart;
+}
+
+void SettingsDecompressor::begin()
+{
+    key.clear();
+    previousKey.clear();
+    state = RecordStart;
+}
+
+bool SettingsDecompressor::decompress(std::string_view data, std::string& records)
+{
+    if (!data.empty() && data.back() == '\n')
+    {
+        data.remove_suffix(1);
+    }
+
+    line.clear();
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        if (data[i] == ESCAPE_CHARACTER)
+        {
+            if (++i == data.size() || !isEscaped(static_cast<char>(data[i] ^ ESCAPE_MASK)))
+            {
+                return false;
+            }
+            line.push_back(static_cast<char>(data[i] ^ ESCAPE_MASK));
+        }
+        else if (isEscaped(data[i]))
+        {
+            return false;
+        }
+        else
+        {
+            line.push_back(data[i]);
+        }
+    }
+
+    return decompressBlock(line) && decodeRecords(block, records);
+}
+
+bool SettingsDecompressor::decompressBlock(std::string_view data)
+{
+    size_t blockSize = 0;
+    for (uint32_t shift = 0;; shift += 7)
+    {
+        if (data.empty() || shift > 14)
+        {
+            return false;
+        }
+        const auto byte = static_cast<uint8_t>(data.front());
+        data.remove_prefix(1);
+        blockSize |= static_cast<size_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            break;
+        }
+    }
+    if (blockSize == 0 || blockSize > SETTINGS_COMPRESSION_MAX_BLOCK_SIZE)
+    {
+        return false;
+    }
+
+    block.clear();
+    block.reserve(blockSize);
+    while (true)
+    {
+        if (data.empty())
+        {
+            return false;
+        }
+        const auto token = static_cast<uint8_t>(data.front());
+        data.remove_prefix(1);
+
+        size_t literalsSize = token >> 4;
+        if (literalsSize == NIBBLE_MAX && !readLength(data, literalsSize))
+        {
+            return false;
+        }
+        if (literalsSize > data.size() || literalsSize > blockSize - block.size())
+        {
+            return false;
+        }
+        block.append(data.substr(0, literalsSize));
+        data.remove_prefix(literalsSize);
+        if (data.empty())
+        {
+            return block.size() == blockSize;
+        }
+
+        if (data.size() < 2)
+        {
+            return false;
+        }
+        const size_t offset = static_cast<uint8_t>(data[0]) | static_cast<size_t>(static_cast<uint8_t>(data[1])) << 8;
+        data.remove_prefix(2);
+        size_t matchSize = token & NIBBLE_MAX;
+        if (matchSize == NIBBLE_MAX && !readLength(data, matchSize))
+        {
+            return false;
+        }
+        matchSize += MIN_MATCH_SIZE;
+        if (offset == 0 || offset > block.size() || matchSize > blockSize - block.size())
+        {
+            return false;
+        }
+        // The match may overlap the data it produces, so it is copied in pieces of at most offset bytes.
+        const size_t matchStart = block.size() - offset;
+        for (size_t copied = 0; copied < matchSize;)
+        {
+            const size_t pieceSize = std::min(matchSize - copied, offset);
+            block.append(block, matchStart + copied, pieceSize);
+            copied += pieceSize;
+        }
+    }
+}
+
+bool SettingsDecompressor::decodeRecords(std::string_view data, std::string& records)
+{
+    while (!data.empty())
+    {
+        switch (state)
+        {
+            case RecordStart:
+            {
+                const auto sharedSize = static_cast<uint8_t>(data.front());
+                if (sharedSize > previousKey.size())
+                {
+                    return false;
+                }
+                key.assign(previousKey, 0, sharedSize);
+                records.append(key);
+                data.remove_prefix(1);
+                state = Key;
+                break;
+            }
+            case Key:
+            {
+                const size_t keyEnd = data.find('\t');
+                key.append(data.substr(0, keyEnd));
+                records.append(data.substr(0, keyEnd));
+                if (keyEnd == std::string_view::npos)
+                {
+                    return key.size() <= SETTINGS_COMPRESSION_MAX_BLOCK_SIZE;
+                }
+                records.push_back('\t');
+                previousKey.swap(key);
+                state = Value;
+                data.remove_prefix(keyEnd + 1);
+                break;
+            }
+            case Value:
+            {
+                const size_t recordEnd = data.find('\n');
+                if (recordEnd == std::string_view::npos)
+                {
+                    records.append(data);
+                    return true;
+                }
+                records.append(data.substr(0, recordEnd + 1));
+                state = RecordStart;
+                data.remove_prefix(recordEnd + 1);
+                break;
+            }
+        }
+    }
+    return true;
+}
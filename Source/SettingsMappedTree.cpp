@@ -0,0 +1,513 @@
+#include "SettingsMappedTree.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "SettingsChecksum.h"
+
+namespace
+{
+    // The region starts with \rv4\n and a magic number in the byte order of the CPU, so the trees stored by CPUs with
+    // another byte order are rejected. The superblocks are in different sectors, so a torn write only damages one.
+    constexpr std::string_view SIGNATURE_LINE      = "\rv4\n";
+    constexpr uint32_t         SIGNATURE_MAGIC     = 0x544D5353; // "SSMT" in little endian.
+    constexpr size_t           SIGNATURE_SIZE      = 8;
+    constexpr size_t           SUPERBLOCK_OFFSET[] = {512, 1024};
+    constexpr uint32_t         NODE_ALIGNMENT      = 8;
+    constexpr uint32_t         MAX_DEPTH           = 128; // Only corrupted trees are this deep.
+    constexpr auto             CHECKSUM_ALGORITHM  = SettingsChecksumAlgorithm_t::CRC32C;
+
+    uint32_t getPriority(const std::string_view key)
+    {
+        // The checksum is mixed (MurmurHash3 finalizer), so similar keys do not get similar priorities.
+        uint32_t priority = SettingsChecksum::calculate(CHECKSUM_ALGORITHM, key.data(), key.size());
+        priority ^= priority >> 16;
+        priority *= 0x85EBCA6B;
+        priority ^= priority >> 13;
+        priority *= 0xC2B2AE35;
+        priority ^= priority >> 16;
+        return priority;
+    }
+} // namespace
+
+SettingsMappedTree::SettingsMappedTree()
+{
+    static_assert(sizeof(SettingsMappedNode_t) % NODE_ALIGNMENT == 0);
+    static_assert(sizeof(SettingsMappedSuperblock_t) == 32);
+    static_assert(HEADER_SIZE % NODE_ALIGNMENT == 0);
+    this->region        = nullptr;
+    this->regionSize    = 0;
+    this->writable      = false;
+    this->committedSlot = 0;
+    this->committed     = {};
+    this->current       = {};
+    this->changesStart  = 0;
+    this->changed       = false;
+}
+
+bool SettingsMappedTree::isMappedTree(const std::string_view data)
+{
+    uint32_t magic = 0;
+    if (data.size() < SIGNATURE_SIZE || !data.starts_with(SIGNATURE_LINE))
+    {
+        return false;
+    }
+    memcpy(&magic, data.data() + SIGNATURE_LINE.size(), sizeof(magic));
+    return magic == SIGNATURE_MAGIC;
+}
+
+bool SettingsMappedTree::attach(const std::string_view data)
+{
+    return attachRegion(const_cast<char*>(data.data()), data.size(), false);
+}
+
+bool SettingsMappedTree::attach(char* data, const size_t size)
+{
+    return attachRegion(data, size, true);
+}
+
+bool SettingsMappedTree::attachRegion(char* data, const size_t size, const bool canWrite)
+{
+    detach();
+    if (size < HEADER_SIZE || size > UINT32_MAX || !isMappedTree(std::string_view(data, size)))
+    {
+        return false;
+    }
+
+    // The committed tree is the valid superblock with the highest generation.
+    bool found = false;
+    for (uint32_t slot = 0; slot < 2; slot++)
+    {
+        SettingsMappedSuperblock_t superblock;
+        memcpy(&superblock, data + SUPERBLOCK_OFFSET[slot], sizeof(superblock));
+        if (superblock.generation == 0 || superblock.checksum != getSuperblockChecksum(superblock) ||
+            superblock.nodesStart < HEADER_SIZE || superblock.nodesStart > superblock.nodesEnd ||
+            superblock.nodesEnd > size || superblock.nodesStart % NODE_ALIGNMENT != 0 ||
+            superblock.nodesEnd % NODE_ALIGNMENT != 0 ||
+            superblock.liveSize > superblock.nodesEnd - superblock.nodesStart ||
+            (superblock.root == 0) != (superblock.count == 0) ||
+            (found && superblock.generation <= committed.generation))
+        {
+            continue;
+        }
+        committed     = superblock;
+        committedSlot = slot;
+        found         = true;
+    }
+    if (!found)
+    {
+        return false;
+    }
+
+    region       = data;
+    regionSize   = size;
+    writable     = canWrite;
+    current      = committed;
+    changesStart = current.nodesEnd;
+    changed      = false;
+    return true;
+}
+
+void SettingsMappedTree::create(char* data, const size_t size)
+{
+    detach();
+    memcpy(data, SIGNATURE_LINE.data(), SIGNATURE_LINE.size());
+    memcpy(data + SIGNATURE_LINE.size(), &SIGNATURE_MAGIC, sizeof(SIGNATURE_MAGIC));
+    for (const size_t offset : SUPERBLOCK_OFFSET)
+    {
+        memset(data + offset, 0, sizeof(SettingsMappedSuperblock_t));
+    }
+
+    region        = data;
+    regionSize    = size;
+    writable      = true;
+    committedSlot = 1;
+    committed     = {0, 0, 0, HEADER_SIZE, HEADER_SIZE, 0, 0};
+    current       = committed;
+    changesStart  = HEADER_SIZE;
+    changed       = true;
+}
+
+void SettingsMappedTree::remap(char* data, const size_t size)
+{
+    region     = data;
+    regionSize = size;
+}
+
+void SettingsMappedTree::detach()
+{
+    region     = nullptr;
+    regionSize = 0;
+    writable   = false;
+    committed  = {};
+    current    = {};
+    changed    = false;
+}
+
+bool SettingsMappedTree::isAttached() const
+{
+    return region != nullptr;
+}
+
+size_t SettingsMappedTree::getRegionSize() const
+{
+    return regionSize;
+}
+
+uint32_t SettingsMappedTree::getCount() const
+{
+    return current.count;
+}
+
+bool SettingsMappedTree::needsCompaction() const
+{
+    const size_t unusedSize = current.nodesEnd - current.nodesStart - current.liveSize;
+    return unusedSize > std::max<size_t>(current.liveSize, HEADER_SIZE);
+}
+
+bool SettingsMappedTree::search(const std::string_view key, std::string_view& record, uint32_t& id) const
+{
+    uint32_t offset = current.root;
+    for (uint32_t depth = 0; offset != 0 && depth < MAX_DEPTH; depth++)
+    {
+        const SettingsMappedNode_t* node = getNode(offset);
+        if (node == nullptr)
+        {
+            return false;
+        }
+        const int comparison = key.compare(getKey(node));
+        if (comparison == 0)
+        {
+            record = getRecord(node);
+            id     = node->id;
+            return true;
+        }
+        offset = comparison < 0 ? node->left : node->right;
+    }
+    return false;
+}
+
+int SettingsMappedTree::iterate(const std::string_view firstKey, const std::string_view prefix,
+                                const SettingsMappedRecordCallback_t cb, void* data) const
+{
+    // The stack holds the nodes whose key is not lower than the first key, and whose left subtree was already
+    // visited or skipped. Every node is pushed at most once, so a corrupted tree with cycles is detected by the count.
+    const std::string_view      startKey = std::max(firstKey, prefix);
+    const SettingsMappedNode_t* stack[MAX_DEPTH];
+    uint32_t                    depth   = 0;
+    uint32_t                    visited = 0;
+    uint32_t                    offset  = current.root;
+    for (uint32_t steps = 0; offset != 0; steps++)
+    {
+        const SettingsMappedNode_t* node = getNode(offset);
+        if (node == nullptr || steps == MAX_DEPTH)
+        {
+            return -1;
+        }
+        if (getKey(node) < startKey)
+        {
+            offset = node->right;
+        }
+        else
+        {
+            stack[depth++] = node;
+            visited++;
+            offset = node->left;
+        }
+    }
+
+    while (depth > 0)
+    {
+        const SettingsMappedNode_t* node = stack[--depth];
+        if (!getKey(node).starts_with(prefix))
+        {
+            return 0;
+        }
+        if (const int result = cb(data, getRecord(node), node->id); result != 0)
+        {
+            return result;
+        }
+        for (offset = node->right; offset != 0; offset = stack[depth - 1]->left)
+        {
+            const SettingsMappedNode_t* child = getNode(offset);
+            if (child == nullptr || depth == MAX_DEPTH || ++visited > current.count)
+            {
+                return -1;
+            }
+            stack[depth++] = child;
+        }
+    }
+    return 0;
+}
+
+bool SettingsMappedTree::put(const std::string_view record, size_t& requiredSize)
+{
+    requiredSize           = 0;
+    const size_t keyLength = getKeyLength(record);
+    const auto   key       = record.substr(0, keyLength);
+    if (!writable || keyLength == 0 || record.size() > UINT32_MAX)
+    {
+        return false;
+    }
+
+    // Every node of the path to the key is copied, but the node of the key, which is replaced.
+    size_t   size   = getNodeSize(record.size());
+    uint32_t offset = current.root;
+    for (uint32_t depth = 0; offset != 0; depth++)
+    {
+        const SettingsMappedNode_t* node = getNode(offset);
+        if (node == nullptr || depth == MAX_DEPTH)
+        {
+            return false;
+        }
+        const int comparison = key.compare(getKey(node));
+        if (comparison == 0)
+        {
+            break;
+        }
+        size += getNodeSize(node->recordLength);
+        offset = comparison < 0 ? node->left : node->right;
+    }
+    if (current.nodesEnd + size > UINT32_MAX)
+    {
+        return false;
+    }
+    if (current.nodesEnd + size > regionSize)
+    {
+        requiredSize = current.nodesEnd + size;
+        return false;
+    }
+
+    const uint32_t start        = current.nodesEnd;
+    bool           inserted     = false;
+    uint32_t       replacedSize = 0;
+    current.root = putNode(current.root, record, static_cast<uint16_t>(keyLength), inserted, replacedSize);
+    current.count += inserted ? 1 : 0;
+    current.liveSize += getNodeSize(record.size()) - replacedSize;
+    sealNodes(start, current.nodesEnd);
+    changed = true;
+    return true;
+}
+
+uint32_t SettingsMappedTree::putNode(const uint32_t offset, const std::string_view record, const uint16_t keyLength,
+                                     bool& inserted, uint32_t& replacedSize)
+{
+    if (offset == 0)
+    {
+        inserted = true;
+        return allocateNode(record, keyLength, current.count);
+    }
+
+    // The path was validated by put(), and the region is not remapped until it returns.
+    const auto* node       = reinterpret_cast<const SettingsMappedNode_t*>(region + offset);
+    const int   comparison = record.substr(0, keyLength).compare(getKey(node));
+    if (comparison == 0)
+    {
+        replacedSize               = getNodeSize(node->recordLength);
+        const uint32_t replacement = allocateNode(record, keyLength, node->id);
+        getFreshNode(replacement)->left  = node->left;
+        getFreshNode(replacement)->right = node->right;
+        return replacement;
+    }
+
+    // The inserted node is rotated up while its priority is higher than the priority of its parent.
+    const uint32_t child =
+        putNode(comparison < 0 ? node->left : node->right, record, keyLength, inserted, replacedSize);
+    const uint32_t        copy       = copyNode(offset);
+    SettingsMappedNode_t* parentNode = getFreshNode(copy);
+    SettingsMappedNode_t* childNode  = getFreshNode(child);
+    const bool            rotate     = childNode->priority > parentNode->priority;
+    if (comparison < 0)
+    {
+        parentNode->left = rotate ? childNode->right : child;
+        if (rotate)
+        {
+            childNode->right = copy;
+        }
+    }
+    else
+    {
+        parentNode->right = rotate ? childNode->left : child;
+        if (rotate)
+        {
+            childNode->left = copy;
+        }
+    }
+    return rotate ? child : copy;
+}
+
+bool SettingsMappedTree::rebuild(const std::span<const std::string_view> records, size_t& requiredSize)
+{
+    requiredSize = 0;
+    if (!writable || records.size() > UINT32_MAX)
+    {
+        return false;
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const size_t keyLength = getKeyLength(records[i]);
+        if (keyLength == 0 || records[i].size() > UINT32_MAX ||
+            (i > 0 && records[i - 1].substr(0, getKeyLength(records[i - 1])) >= records[i].substr(0, keyLength)))
+        {
+            return false;
+        }
+        size += getNodeSize(records[i].size());
+    }
+
+    // The nodes of the committed tree must stay intact until the new tree is committed.
+    const size_t start = HEADER_SIZE + size <= committed.nodesStart ? HEADER_SIZE : committed.nodesEnd;
+    if (start + size > UINT32_MAX)
+    {
+        return false;
+    }
+    if (start + size > regionSize)
+    {
+        requiredSize = start + size;
+        return false;
+    }
+
+    // The treap is built in key order: each node takes the nodes of the right spine with a lower priority as its
+    // left subtree, and becomes the right child of the last node of the spine.
+    current            = committed;
+    current.nodesStart = static_cast<uint32_t>(start);
+    current.nodesEnd   = static_cast<uint32_t>(start);
+    std::vector<uint32_t> spine;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const uint32_t        offset = allocateNode(records[i], static_cast<uint16_t>(getKeyLength(records[i])),
+                                                    static_cast<uint32_t>(i));
+        SettingsMappedNode_t* node   = getFreshNode(offset);
+        uint32_t              left   = 0;
+        while (!spine.empty() && getFreshNode(spine.back())->priority < node->priority)
+        {
+            left = spine.back();
+            spine.pop_back();
+        }
+        node->left = left;
+        if (!spine.empty())
+        {
+            getFreshNode(spine.back())->right = offset;
+        }
+        spine.push_back(offset);
+    }
+    current.root     = spine.empty() ? 0 : spine.front();
+    current.count    = static_cast<uint32_t>(records.size());
+    current.liveSize = static_cast<uint32_t>(size);
+    sealNodes(current.nodesStart, current.nodesEnd);
+    changesStart = current.nodesStart;
+    changed      = true;
+    return true;
+}
+
+bool SettingsMappedTree::hasChanges() const
+{
+    return changed;
+}
+
+void SettingsMappedTree::getChanges(size_t& offset, size_t& length) const
+{
+    offset = changesStart;
+    length = current.nodesEnd - changesStart;
+}
+
+void SettingsMappedTree::commit()
+{
+    current.generation = committed.generation + 1;
+    current.checksum   = getSuperblockChecksum(current);
+    committedSlot      = 1 - committedSlot;
+    memcpy(region + SUPERBLOCK_OFFSET[committedSlot], &current, sizeof(current));
+    committed    = current;
+    changesStart = current.nodesEnd;
+    changed      = false;
+}
+
+const SettingsMappedTree::SettingsMappedNode_t* SettingsMappedTree::getNode(const uint32_t offset) const
+{
+    // The nodes that are read are validated, so a corrupted region is never read out of its bounds.
+    if (offset < current.nodesStart || offset % NODE_ALIGNMENT != 0 ||
+        current.nodesEnd - offset < sizeof(SettingsMappedNode_t))
+    {
+        return nullptr;
+    }
+    const auto* node = reinterpret_cast<const SettingsMappedNode_t*>(region + offset);
+    if (node->keyLength == 0 || node->keyLength > node->recordLength || node->id >= current.count ||
+        node->recordLength > current.nodesEnd - offset - sizeof(SettingsMappedNode_t) ||
+        node->checksum != getNodeChecksum(node))
+    {
+        return nullptr;
+    }
+    return node;
+}
+
+SettingsMappedTree::SettingsMappedNode_t* SettingsMappedTree::getFreshNode(const uint32_t offset) const
+{
+    return reinterpret_cast<SettingsMappedNode_t*>(region + offset);
+}
+
+uint32_t SettingsMappedTree::allocateNode(const std::string_view record, const uint16_t keyLength, const uint32_t id)
+{
+    const uint32_t offset = current.nodesEnd;
+    const uint32_t size   = getNodeSize(record.size());
+    auto*          node   = getFreshNode(offset);
+    *node                 = {0, 0, getPriority(record.substr(0, keyLength)), id, static_cast<uint32_t>(record.size()),
+                             keyLength, 0, 0, 0};
+    memcpy(node + 1, record.data(), record.size());
+    memset(reinterpret_cast<char*>(node + 1) + record.size(), 0, size - sizeof(SettingsMappedNode_t) - record.size());
+    current.nodesEnd += size;
+    return offset;
+}
+
+uint32_t SettingsMappedTree::copyNode(const uint32_t offset)
+{
+    const uint32_t copy = current.nodesEnd;
+    const uint32_t size = getNodeSize(getFreshNode(offset)->recordLength);
+    memcpy(region + copy, region + offset, size);
+    current.nodesEnd += size;
+    return copy;
+}
+
+void SettingsMappedTree::sealNodes(uint32_t start, const uint32_t end) const
+{
+    // The new nodes are contiguous, and their children are only final once the whole change is done.
+    while (start < end)
+    {
+        SettingsMappedNode_t* node = getFreshNode(start);
+        node->checksum             = getNodeChecksum(node);
+        start += getNodeSize(node->recordLength);
+    }
+}
+
+std::string_view SettingsMappedTree::getRecord(const SettingsMappedNode_t* node)
+{
+    return {reinterpret_cast<const char*>(node + 1), node->recordLength};
+}
+
+std::string_view SettingsMappedTree::getKey(const SettingsMappedNode_t* node)
+{
+    return {reinterpret_cast<const char*>(node + 1), node->keyLength};
+}
+
+uint32_t SettingsMappedTree::getNodeSize(const size_t recordLength)
+{
+    return static_cast<uint32_t>((sizeof(SettingsMappedNode_t) + recordLength + NODE_ALIGNMENT - 1) /
+                                 NODE_ALIGNMENT * NODE_ALIGNMENT);
+}
+
+uint32_t SettingsMappedTree::getNodeChecksum(const SettingsMappedNode_t* node)
+{
+    SettingsMappedNode_t members = *node;
+    members.checksum             = 0;
+    const uint32_t checksum      = SettingsChecksum::calculate(CHECKSUM_ALGORITHM, &members, sizeof(members));
+    return SettingsChecksum::calculate(CHECKSUM_ALGORITHM, node + 1, node->recordLength, checksum);
+}
+
+uint32_t SettingsMappedTree::getSuperblockChecksum(const SettingsMappedSuperblock_t& superblock)
+{
+    return SettingsChecksum::calculate(CHECKSUM_ALGORITHM, &superblock, offsetof(SettingsMappedSuperblock_t, checksum));
+}
+
+size_t SettingsMappedTree::getKeyLength(const std::string_view record)
+{
+    const size_t keyEnd = record.find('\t');
+    return keyEnd == std::string_view::npos || keyEnd > UINT16_MAX ? 0 : keyEnd;
+}
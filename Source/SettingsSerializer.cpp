@@ -0,0 +1,157 @@
+#include "SettingsSerializer.h"
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+
+// Longest output of std::to_chars for the supported types (shortest round-trip double is 24 characters at most).
+constexpr size_t SETTINGS_SERIALIZER_MAX_NUMBER_SIZE = 32;
+
+SettingsSerializer::SettingsSerializer(const size_t bufferSize) : checksum(SettingsChecksumAlgorithm_t::CRC32)
+{
+    assert(bufferSize >= SETTINGS_SERIALIZER_MAX_NUMBER_SIZE && "Serializer buffer too small");
+
+    this->settingsFile = nullptr;
+    this->output       = nullptr;
+    this->compressor   = nullptr;
+    this->bufferSize   = bufferSize;
+    this->buffer.reserve(bufferSize); // The only allocation of the serializer, every block reuses this capacity.
+}
+
+void SettingsSerializer::begin(SettingsFile* settingsFile, const SettingsChecksumAlgorithm_t checksumAlgorithm,
+                               SettingsCompressor* compressor)
+{
+    this->settingsFile = settingsFile;
+    this->output       = nullptr;
+    this->compressor   = compressor;
+    this->checksum     = SettingsChecksum(checksumAlgorithm);
+    this->buffer.clear();
+    if (compressor != nullptr)
+    {
+        compressor->begin();
+    }
+}
+
+void SettingsSerializer::beginInMemory(std::string* output, const SettingsChecksumAlgorithm_t checksumAlgorithm)
+{
+    this->settingsFile = nullptr;
+    this->output       = output;
+    this->compressor   = nullptr;
+    this->checksum     = SettingsChecksum(checksumAlgorithm);
+    this->buffer.clear();
+}
+
+SettingsFile::SettingsFileResult SettingsSerializer::append(std::string_view data)
+{
+    while (!data.empty())
+    {
+        if (buffer.size() == bufferSize)
+        {
+            if (const SettingsFile::SettingsFileResult res = flush(); res != SettingsFile::Success)
+            {
+                return res;
+            }
+        }
+
+        const size_t chunkSize = std::min(data.size(), bufferSize - buffer.size());
+        buffer.append(data.data(), chunkSize);
+        data.remove_prefix(chunkSize);
+    }
+    return SettingsFile::Success;
+}
+
+SettingsFile::SettingsFileResult SettingsSerializer::append(const char character)
+{
+    if (const SettingsFile::SettingsFileResult res = reserve(1); res != SettingsFile::Success)
+    {
+        return res;
+    }
+    buffer.push_back(character);
+    return SettingsFile::Success;
+}
+
+SettingsFile::SettingsFileResult SettingsSerializer::append(const int64_t value)
+{
+    char numberBuffer[SETTINGS_SERIALIZER_MAX_NUMBER_SIZE];
+    const auto [end, ec] = std::to_chars(numberBuffer, numberBuffer + sizeof(numberBuffer), value);
+    if (ec != std::errc())
+    {
+        return SettingsFile::InvalidState;
+    }
+    return append(std::string_view(numberBuffer, end - numberBuffer));
+}
+
+SettingsFile::SettingsFileResult SettingsSerializer::append(const uint32_t value)
+{
+    return append(static_cast<int64_t>(value));
+}
+
+SettingsFile::SettingsFileResult SettingsSerializer::append(const double value)
+{
+    char numberBuffer[SETTINGS_SERIALIZER_MAX_NUMBER_SIZE];
+    const auto [end, ec] = std::to_chars(numberBuffer, numberBuffer + sizeof(numberBuffer), value);
+    if (ec != std::errc())
+    {
+        return SettingsFile::InvalidState;
+    }
+    return append(std::string_view(numberBuffer, end - numberBuffer));
+}
+
+SettingsFile::SettingsFileResult SettingsSerializer::flush(const bool updateChecksum)
+{
+    if (buffer.empty())
+    {
+        return SettingsFile::Success;
+    }
+    if (settingsFile == nullptr && output == nullptr)
+    {
+        return SettingsFile::InvalidState;
+    }
+
+    if (updateChecksum)
+    {
+        checksum.update(buffer.data(), buffer.size());
+    }
+    if (compressor == nullptr)
+    {
+        const SettingsFile::SettingsFileResult res = write(buffer);
+        buffer.clear(); // Keeps the capacity, so the next block does not allocate.
+        return res;
+    }
+
+    compressedBuffer.clear();
+    if (updateChecksum)
+    {
+        compressor->compress(buffer, compressedBuffer);
+    }
+    else
+    {
+        compressor->end(compressedBuffer);
+        compressedBuffer.append(buffer);
+    }
+    buffer.clear();
+    return compressedBuffer.empty() ? SettingsFile::Success : write(compressedBuffer);
+}
+
+uint32_t SettingsSerializer::getChecksum() const
+{
+    return checksum.getValue();
+}
+
+SettingsFile::SettingsFileResult SettingsSerializer::write(const std::string& data)
+{
+    if (output != nullptr)
+    {
+        output->append(data);
+        return SettingsFile::Success;
+    }
+    return settingsFile->write(data);
+}
+
+SettingsFile::SettingsFileResult SettingsSerializer::reserve(const size_t size)
+{
+    if (bufferSize - buffer.size() < size)
+    {
+        return flush();
+    }
+    return SettingsFile::Success;
+}
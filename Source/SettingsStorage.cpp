@@ -1,9 +1,22 @@
 #include "SettingsStorage.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
 #include <cstring>
-#include <format>
-#include <sstream>
+#include <thread>
+#include <utility>
 
 constexpr uint32_t SETTINGS_STORAGE_MUTEX_TIMEOUT_MS = 100;
+constexpr char     SETTING_TOMBSTONE_MARKER          = '~'; // Prefix of the type of the tombstone records.
+constexpr size_t   SETTING_SLOT_NUMBER_SIZE          = 24;  // Longest number, e.g. -2.2250738585072014e-308.
+constexpr size_t   SETTING_SLOT_STRING_ALIGNMENT     = 8;   // The room for a string value is a multiple of this size.
+constexpr size_t   SETTING_SLOT_CHECKSUM_SIZE        = 10;  // \t<checksum as 8 hex digits>\n, at the end of each slot.
+
+namespace
+{
+// The storage whose store completion callbacks are called by this thread, see waitForStore().
+thread_local const SettingsStorage* storeCallbacksStorage = nullptr;
+} // namespace
 
 // This operator overload allows the enum SettingPermissions_t to have a bitwise OR operator.
 SettingPermissions_t operator|(SettingPermissions_t lhs, SettingPermissions_t rhs)
@@ -64,16 +77,71 @@ const char* settingPermissionToString(const SettingPermissions_t permission, cha
 SettingsStorage::SettingsStorage(OSInterface& osInterface, SettingsFile* settingsFile)
 {
     this->osInterface       = &osInterface;
+    this->taskFactory       = nullptr;
     this->moduleConfigMutex = osInterface.osCreateMutex();
     assert(this->moduleConfigMutex != nullptr && "Mutex creation failed");
 
     this->persistentStorageEnabled = false;
     this->settings                 = new Settings_t(osInterface);
 
-    this->settingsFile = settingsFile;
+    this->settingsFile         = settingsFile;
+    this->extendedSettingsFile = nullptr;
+    this->settingsSerializer   = nullptr;
+    this->settingsCompressor   = nullptr;
+    this->settingsShards       = new std::list<SettingsShard_t>();
+    this->settingsSlotIndex    = nullptr;
+    this->settingsRecordCache  = nullptr;
+    this->settingsFileHash     = nullptr;
+    this->settingsHashes       = new SettingsHashIndex_t();
+    for (SettingsHashStripe_t& stripe : settingsHashes->stripes)
+    {
+        stripe.mutex = osInterface.osCreateMutex();
+        assert(stripe.mutex != nullptr && "Mutex creation failed");
+    }
+    this->settingsValuePool      = nullptr;
+    this->settingsValuePoolMutex = nullptr;
+    this->settingsStringsMemory  = 0;
+    this->settingsFileDirty      = true;
+    this->lazyImageMutex         = nullptr;
+    this->lazyImage              = nullptr;
+    this->asyncStoreMutex        = nullptr;
+    this->asyncStoreIdle         = nullptr;
+    this->asyncStore             = nullptr;
+    this->persistenceIdle        = nullptr;
+    this->persistence            = nullptr;
+    if (CONFIG_SETTINGS_STORAGE_VALUE_POOL_SLAB_SIZE > 0)
+    {
+        this->settingsValuePool =
+            new SettingsValuePool(sizeof(SettingValue_t), CONFIG_SETTINGS_STORAGE_VALUE_POOL_SLAB_SIZE);
+        this->settingsValuePoolMutex = osInterface.osCreateMutex();
+        assert(this->settingsValuePoolMutex != nullptr && "Mutex creation failed");
+    }
+
+    this->settingsFileDirtyDurability = static_cast<uint8_t>(SettingsDurability_t::NONE);
     if (settingsFile != nullptr)
     {
         this->persistentStorageEnabled = !CONFIG_SETTINGS_STORAGE_FORCE_DISABLE_PERSISTENT_STORAGE;
+        this->settingsSerializer       = new SettingsSerializer();
+        this->settingsCompressor       = new SettingsCompressor();
+        this->settingsSlotIndex        = new SettingsSlotIndex_t{SettingsChecksumAlgorithm_t::CRC32, {}};
+        this->settingsRecordCache      = new SettingsRecordCache_t();
+        this->settingsFileHash         = new SettingsFileHash_t();
+        this->lazyImageMutex           = osInterface.osCreateMutex();
+        assert(this->lazyImageMutex != nullptr && "Mutex creation failed");
+        this->lazyImage       = new SettingsLazyImage_t();
+        this->asyncStoreMutex = osInterface.osCreateMutex();
+        assert(this->asyncStoreMutex != nullptr && "Mutex creation failed");
+        this->asyncStoreIdle = osInterface.osCreateBinarySemaphore();
+        assert(this->asyncStoreIdle != nullptr && "Semaphore creation failed");
+        this->asyncStoreIdle->signal();
+        this->asyncStore = new SettingsAsyncStore_t{
+            nullptr, false, false, SettingsCompressionAlgorithm_t::NONE, StoreAllSettings, SettingsDurability_t::NONE,
+            {}};
+        this->persistenceIdle = osInterface.osCreateBinarySemaphore();
+        assert(this->persistenceIdle != nullptr && "Semaphore creation failed");
+        this->persistenceIdle->signal();
+        this->persistence = new SettingsPersistenceState_t{
+            0, 0, NO_ERROR, SettingsCompressionAlgorithm_t::NONE, StoreAllSettings, SettingsDurability_t::NONE, {}, 0};
     }
 }
 
@@ -81,12 +149,51 @@ SettingsStorage::~SettingsStorage()
 {
     if (this->settingsFile != nullptr)
     {
+        // The background store writes the files, so it must finish before they are closed.
+        if (asyncStore->worker != nullptr)
+        {
+            asyncStore->worker->join();
+            delete asyncStore->worker;
+        }
+        stopLazySettingsLoader();
         settingsFile->forceClose();
+        for (const SettingsShard_t& shard : *settingsShards)
+        {
+            shard.settingsFile->forceClose();
+        }
     }
 
-    settings->iterateOverAll(freeSettingValuesCallback, nullptr);
+    // The pool releases the values and their strings with its slabs, without visiting them.
+    if (settingsValuePool == nullptr)
+    {
+        settings->iterateOverAll(freeSettingValuesCallback, this);
+    }
 
     delete settings;
+    delete settingsValuePool;
+    delete settingsValuePoolMutex;
+    delete settingsSerializer;
+    delete settingsCompressor;
+    delete settingsShards;
+    delete settingsSlotIndex;
+    delete settingsRecordCache;
+    delete settingsFileHash;
+    for (SettingsHashStripe_t& stripe : settingsHashes->stripes)
+    {
+        for (SettingsHashChange_t* change = stripe.pending; change != nullptr;)
+        {
+            delete std::exchange(change, change->next);
+        }
+        delete stripe.mutex;
+    }
+    delete settingsHashes;
+    delete lazyImage;
+    delete lazyImageMutex;
+    delete asyncStore;
+    delete asyncStoreIdle;
+    delete asyncStoreMutex;
+    delete persistence;
+    delete persistenceIdle;
     delete moduleConfigMutex;
 }
 
@@ -113,327 +220,3318 @@ bool SettingsStorage::disablePersistentStorage()
     return res;
 }
 
-SettingsStorage::SettingError_t SettingsStorage::restoreDefaultSettings(const char*                    keyPrefix,
-                                                                        SettingPermissions_t           permissions,
-                                                                        SettingPermissionsFilterMode_t filterMode) const
+SettingsStorage::SettingError_t SettingsStorage::addSettingsShard(const char* keyPrefix, SettingsFile* shardFile)
 {
-    if (keyPrefix == nullptr)
+    if (keyPrefix == nullptr || keyPrefix[0] == '\0' || shardFile == nullptr || settingsFile == nullptr)
     {
         return INVALID_INPUT_ERROR;
     }
-
-    SettingsKeysList_t outputKeys;
-
-    SettingError_t result = listSettingsKeys(keyPrefix, permissions, filterMode, outputKeys);
-    if (result != NO_ERROR)
+    const size_t prefixLength = strnlen(keyPrefix, MAX_SETTING_KEY_SIZE);
+    if (prefixLength == MAX_SETTING_KEY_SIZE)
     {
-        return result;
+        return INVALID_INPUT_ERROR;
     }
 
-    for (const auto& key : outputKeys)
+    if (std::any_of(settingsShards->begin(), settingsShards->end(),
+                    [keyPrefix](const SettingsShard_t& shard) { return shard.keyPrefix == keyPrefix; }))
     {
-        SettingValue_t* outputValue;
-        result = getSettingValue(key.c_str(), outputValue);
-        if (result != NO_ERROR)
-        {
-            return result;
-        }
-
-        if (outputValue->settingValueType == STRING)
-        {
-            free(outputValue->settingValueData.string);
-            outputValue->settingValueData.string = strdup(outputValue->settingDefaultValueData.string);
-        }
-        else
-        {
-            outputValue->settingValueData = outputValue->settingDefaultValueData;
-        }
+        return KEY_EXISTS_ERROR;
     }
 
+    // A new shard is dirty, so its file is written by the next store even if its settings do not change.
+    SettingsShard_t& shard     = settingsShards->emplace_back();
+    shard.keyPrefix            = std::string(keyPrefix, prefixLength);
+    shard.settingsFile         = shardFile;
+    shard.extendedSettingsFile = nullptr;
+    shard.dirty                = true;
+    shard.dirtyDurability      = static_cast<uint8_t>(SettingsDurability_t::NONE);
+
+    // The settings of the shard may already be registered, so the hashes of the files are summed again.
+    settingsFileHash->current = 0;
+    for (SettingsShard_t& otherShard : *settingsShards)
+    {
+        otherShard.hash.current = 0;
+    }
+    settings->iterateOverAll(sumFileHashesCallback, this);
     return NO_ERROR;
 }
 
-SettingsStorage::SettingError_t SettingsStorage::storeSettingsInPersistentStorage() const
+SettingsStorage::SettingError_t SettingsStorage::setExtendedSettingsFile(ExtendedSettingsFile* settingsFile)
 {
-    SettingsFile::SettingsFileResult res = settingsFile->openForWrite();
-    if (res != SettingsFile::Success)
+    if (settingsFile == nullptr)
     {
-        return SETTINGS_FILESYSTEM_ERROR;
+        return INVALID_INPUT_ERROR;
     }
 
-    uint32_t                    crc32;
-    bool                        firstSetting = true;
-    CRC::Table<unsigned, 32>    crcTable     = CRC::CRC_32().MakeTable();
-    SettingsStoreCallbackData_t callbackData = std::make_tuple(settingsFile, &crc32, &firstSetting, &crcTable);
-    res                                      = static_cast<SettingsFile::SettingsFileResult>(
-        settings->iterateOverAll(storeSettingsInPersistentStorageCallback, &callbackData));
-    if (res != SettingsFile::Success)
+    if (static_cast<SettingsFile*>(settingsFile) == this->settingsFile)
     {
-        return SETTINGS_FILESYSTEM_ERROR;
+        this->extendedSettingsFile = settingsFile;
+        return NO_ERROR;
     }
 
-    std::string formattedString = std::format("\r{}\n", crc32);
-    res                         = settingsFile->write(formattedString);
-    if (res != SettingsFile::Success)
+    for (SettingsShard_t& shard : *settingsShards)
     {
-        return SETTINGS_FILESYSTEM_ERROR;
+        if (static_cast<SettingsFile*>(settingsFile) == shard.settingsFile)
+        {
+            shard.extendedSettingsFile = settingsFile;
+            return NO_ERROR;
+        }
     }
+    return INVALID_INPUT_ERROR;
+}
 
-    res = settingsFile->close();
-    if (res != SettingsFile::Success)
-    {
-        return SETTINGS_FILESYSTEM_ERROR;
-    }
-    return NO_ERROR;
+void SettingsStorage::setTaskFactory(SettingsTaskFactory* taskFactory)
+{
+    this->taskFactory = taskFactory;
 }
 
-SettingsStorage::SettingError_t SettingsStorage::validateChecksum() const
+SettingsTask* SettingsStorage::createTask(void (*function)(void* arg), void* arg, const char* name) const
 {
-    uint32_t   expectedCrc32 = 0;
-    uint32_t   computedCrc32 = 0;
-    const auto crcTable      = CRC::CRC_32().MakeTable();
+    const SettingsTaskConfig_t config = {name, CONFIG_SETTINGS_STORAGE_TASK_STACK_SIZE,
+                                         CONFIG_SETTINGS_STORAGE_TASK_PRIORITY, CONFIG_SETTINGS_STORAGE_TASK_CORE};
+    return taskFactory != nullptr ? taskFactory->createTask(function, arg, config)
+                                  : SettingsTaskFactory::createDefaultTask(function, arg, config);
+}
 
-    SettingsFile::SettingsFileResult res = settingsFile->openForRead();
-    if (res != SettingsFile::Success)
+template <typename Function>
+void SettingsStorage::runInParallel(const size_t count, const char* name, const Function& function) const
+{
+    // The calling task runs the last index, so a single index does not create any task. An index whose task can not be
+    // created runs in the calling task too, after the others were started.
+    std::vector<SettingsParallelTask_t> tasks(count > 0 ? count - 1 : 0);
+    for (size_t i = 0; i < tasks.size(); i++)
     {
-        return SETTINGS_FILESYSTEM_ERROR;
+        tasks[i].run = [](const void* runFunction, const size_t index)
+        { (*static_cast<const Function*>(runFunction))(index); };
+        tasks[i].function = &function;
+        tasks[i].index    = i;
+        tasks[i].task     = createTask(runParallelTask, &tasks[i], name);
     }
-
-    bool firstSetting = true;
-    while (res == SettingsFile::Success)
+    if (count > 0)
     {
-        std::string settingStr;
-        res = settingsFile->readLine(settingStr);
-
-        if (res == SettingsFile::EndOfFile)
-        {
-            break;
-        }
-
-        if (settingStr[0] == '\r')
-        {
-            char* end;
-            expectedCrc32 = static_cast<uint32_t>(std::strtol(&settingStr[1], &end, 10));
-            if (*end != '\n')
-            {
-                settingsFile->close();
-                return SETTINGS_FILESYSTEM_ERROR;
-            }
-        }
-        else
+        function(count - 1);
+    }
+    for (SettingsParallelTask_t& task : tasks)
+    {
+        if (task.task == nullptr)
         {
-            if (firstSetting)
-            {
-                computedCrc32 = CRC::Calculate(settingStr.c_str(), settingStr.size(), crcTable);
-                firstSetting  = false;
-            }
-            else
-            {
-                computedCrc32 = CRC::Calculate(settingStr.c_str(), settingStr.size(), crcTable, computedCrc32);
-            }
+            function(task.index);
+            continue;
         }
+        task.task->join();
+        delete task.task;
     }
+}
 
-    if (res != SettingsFile::EndOfFile)
+void SettingsStorage::runParallelTask(void* arg)
+{
+    const auto* task = static_cast<SettingsParallelTask_t*>(arg);
+    task->run(task->function, task->index);
+}
+
+SettingsStorage::SettingsShard_t* SettingsStorage::findSettingsShard(const unsigned char* key,
+                                                                     const uint32_t       key_len) const
+{
+    // There are few shards, so the longest matching prefix is searched linearly.
+    const std::string_view keyView(reinterpret_cast<const char*>(key), key_len);
+    SettingsShard_t*       result = nullptr;
+    for (SettingsShard_t& shard : *settingsShards)
     {
-        settingsFile->close();
-        return SETTINGS_FILESYSTEM_ERROR;
+        if (keyView.starts_with(shard.keyPrefix) &&
+            (result == nullptr || shard.keyPrefix.size() > result->keyPrefix.size()))
+        {
+            result = &shard;
+        }
     }
+    return result;
+}
 
-    res = settingsFile->close();
-    if (res != SettingsFile::Success)
+void SettingsStorage::markSettingsFileDirty(const char* key, const SettingsDurability_t durability) const
+{
+    // The durability is raised first, so a store that clears the dirty flag also takes the durability it requires.
+    if (SettingsShard_t* shard = findSettingsShard(reinterpret_cast<const unsigned char*>(key),
+                                                   static_cast<uint32_t>(strnlen(key, MAX_SETTING_KEY_SIZE)));
+        shard != nullptr)
     {
-        return SETTINGS_FILESYSTEM_ERROR;
+        raiseDurability(shard->dirtyDurability, durability);
+        shard->dirty = true;
     }
-
-    if (expectedCrc32 != computedCrc32)
+    else
     {
-        return SETTINGS_FILESYSTEM_ERROR;
+        raiseDurability(settingsFileDirtyDurability, durability);
+        settingsFileDirty = true;
     }
-    return NO_ERROR;
 }
 
-SettingsStorage::SettingError_t SettingsStorage::loadSettingsFromPersistentStorage() const
+void SettingsStorage::raiseDurability(std::atomic<uint8_t>& dirtyDurability, const SettingsDurability_t durability)
 {
-    if (const SettingError_t result = validateChecksum(); result != NO_ERROR)
+    uint8_t current = dirtyDurability.load();
+    while (current < static_cast<uint8_t>(durability) &&
+           !dirtyDurability.compare_exchange_weak(current, static_cast<uint8_t>(durability)))
     {
-        return SETTINGS_FILESYSTEM_ERROR;
     }
+}
 
-    SettingsFile::SettingsFileResult res = settingsFile->openForRead();
-    if (res != SettingsFile::Success)
-    {
-        return SETTINGS_FILESYSTEM_ERROR;
-    }
-    while (res == SettingsFile::Success)
+void SettingsStorage::updateSettingHash(const unsigned char* key, const uint32_t key_len,
+                                        SettingValue_t* settingValue) const
+{
+    // The hashes are sums, so a change only adds the difference between the new and the old hash of the setting to
+    // the sums that include it, in any order. The setting is hashed again once the sums include its hash, so
+    // concurrent changes of the same setting leave the hash of its last value.
+    const std::string_view keyView(reinterpret_cast<const char*>(key), key_len);
+    while (true)
     {
-        std::string settingStr;
-        res = settingsFile->readLine(settingStr);
-        std::istringstream iss(settingStr);
-
-        if (res == SettingsFile::EndOfFile)
+        const uint64_t hash       = hashSetting(key, key_len, settingValue);
+        const uint64_t difference = hash - std::atomic_ref<uint64_t>(settingValue->settingHash).exchange(hash);
+        if (difference == 0)
         {
-            break;
+            return;
         }
-        if (settingStr[0] == '\r')
+        settingsHashes->root += difference;
+        if (settingsFileHash != nullptr)
         {
-            continue;
+            getFileHash(findSettingsShard(key, key_len)).current += difference;
         }
 
-        std::string key;
-        std::getline(iss, key, '\t');
-        if (key.empty())
+        // A thread that can not lock the stripe leaves its change to the next one that does.
+        SettingsHashStripe_t* stripe = findSettingsHashStripe(keyView);
+        if (stripe == nullptr)
         {
-            settingsFile->close();
-            return SETTINGS_FILESYSTEM_ERROR;
+            continue;
         }
-
-        std::string valueTypeStr;
-        std::getline(iss, valueTypeStr, '\t');
-        if (valueTypeStr.empty())
+        if (stripe->mutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
         {
-            settingsFile->close();
-            return SETTINGS_FILESYSTEM_ERROR;
+            addPendingSubtreeHashes(*stripe);
+            addSubtreeHashes(*stripe, keyView, difference);
+            stripe->mutex->signal();
         }
-
-        std::string valueStr;
-        std::getline(iss, valueStr, '\n');
-        if (valueStr.empty())
+        else
         {
-            settingsFile->close();
-            return SETTINGS_FILESYSTEM_ERROR;
+            auto* change = new SettingsHashChange_t{std::string(keyView), difference, stripe->pending};
+            while (!stripe->pending.compare_exchange_weak(change->next, change))
+            {
+            }
         }
+    }
+}
 
-        char* end;
-        long  data = std::strtol(valueTypeStr.c_str(), &end, 10);
-        if (*end != '\0' || data < 0 || data >= static_cast<uint8_t>(MAX_SETTING_VALUE_TYPE_ENUM))
+SettingsStorage::SettingsHashStripe_t* SettingsStorage::findSettingsHashStripe(const std::string_view key) const
+{
+    // The keys without '/' are not in any subtree.
+    const size_t end = key.find('/');
+    if (end == std::string_view::npos)
+    {
+        return nullptr;
+    }
+    return &settingsHashes->stripes[std::hash<std::string_view>{}(key.substr(0, end)) % SETTINGS_HASH_STRIPES];
+}
+
+void SettingsStorage::addSubtreeHashes(SettingsHashStripe_t& stripe, const std::string_view key,
+                                       const uint64_t difference)
+{
+    for (size_t end = key.find('/'); end != std::string_view::npos; end = key.find('/', end + 1))
+    {
+        const std::string_view prefix = key.substr(0, end + 1);
+        if (auto subtree = stripe.subtrees.find(prefix); subtree != stripe.subtrees.end())
         {
-            settingsFile->close();
-            return SETTINGS_FILESYSTEM_ERROR;
+            subtree->second += difference;
         }
-        const auto     valueType = static_cast<SettingValueType_t>(data);
-        SettingError_t settingError;
-
-        switch (static_cast<uint8_t>(valueType))
+        else
         {
-            case REAL:
-            {
-                const double realValue = std::strtod(valueStr.c_str(), &end);
-                if (*end != '\0')
-                {
-                    settingsFile->close();
-                    return SETTINGS_FILESYSTEM_ERROR;
-                }
+            stripe.subtrees.emplace(prefix, difference);
+        }
+    }
+}
 
-                settingError = putSettingValueAsReal(key.c_str(), realValue);
+void SettingsStorage::addPendingSubtreeHashes(SettingsHashStripe_t& stripe)
+{
+    for (SettingsHashChange_t* change = stripe.pending.exchange(nullptr); change != nullptr;)
+    {
+        addSubtreeHashes(stripe, change->key, change->difference);
+        delete std::exchange(change, change->next);
+    }
+}
 
-                if (settingError == KEY_NOT_FOUND_ERROR)
-                {
-                    settingError = registerSettingAsReal(key.c_str(), SettingPermissions_t::VOLATILE, realValue);
-                    if (settingError != NO_ERROR)
-                    {
-                        settingsFile->close();
-                        return SETTINGS_FILESYSTEM_ERROR;
-                    }
-                }
-                else if (settingError != NO_ERROR)
-                {
-                    settingsFile->close();
-                    return SETTINGS_FILESYSTEM_ERROR;
-                }
-            }
-            break;
-            case INTEGER:
-            {
-                const int64_t integerValue = std::strtoll(valueStr.c_str(), &end, 10);
-                if (*end != '\0')
-                {
-                    settingsFile->close();
-                    return SETTINGS_FILESYSTEM_ERROR;
-                }
+uint64_t SettingsStorage::hashSetting(const unsigned char* key, const uint32_t key_len,
+                                      const SettingValue_t* settingValue)
+{
+    // Volatile settings are not stored, so they do not change the hashes.
+    if (static_cast<bool>(settingValue->settingPermissions & SettingPermissions_t::VOLATILE))
+    {
+        return 0;
+    }
 
-                settingError = putSettingValueAsInt(key.c_str(), integerValue);
+    // FNV-1a over the key, the type and the value. The keys can not contain a NUL character, so the type separates
+    // them from the values.
+    uint64_t   hash     = 0xcbf29ce484222325ULL;
+    const auto hashData = [&hash](const void* data, const size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ static_cast<const unsigned char*>(data)[i]) * 0x100000001b3ULL;
+        }
+    };
+    const auto type = static_cast<uint8_t>(settingValue->settingValueType);
+    hashData(key, key_len);
+    hashData(&type, sizeof(type));
+    if (settingValue->settingValueType == STRING)
+    {
+        hashData(settingValue->settingValueData.string, settingValue->settingString.length);
+    }
+    else
+    {
+        hashData(&settingValue->settingValueData, sizeof(settingValue->settingValueData));
+    }
 
-                if (settingError == KEY_NOT_FOUND_ERROR)
-                {
-                    settingError = registerSettingAsInt(key.c_str(), SettingPermissions_t::VOLATILE, integerValue);
-                    if (settingError != NO_ERROR)
-                    {
-                        settingsFile->close();
-                        return SETTINGS_FILESYSTEM_ERROR;
-                    }
-                }
-                else if (settingError != NO_ERROR)
-                {
-                    settingsFile->close();
-                    return SETTINGS_FILESYSTEM_ERROR;
-                }
-            }
-            break;
-            case STRING:
-            {
-                settingError = putSettingValueAsString(key.c_str(), valueStr.c_str());
+    // The bits are mixed, so the sums of similar settings do not cancel out.
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
 
-                if (settingError == KEY_NOT_FOUND_ERROR)
-                {
-                    settingError =
-                        registerSettingAsString(key.c_str(), SettingPermissions_t::VOLATILE, valueStr.c_str());
-                    if (settingError != NO_ERROR)
-                    {
-                        settingsFile->close();
-                        return SETTINGS_FILESYSTEM_ERROR;
-                    }
-                }
-                else if (settingError != NO_ERROR)
-                {
-                    settingsFile->close();
-                    return SETTINGS_FILESYSTEM_ERROR;
-                }
-            }
-            break;
-            default:
-                settingsFile->close();
-                return SETTINGS_FILESYSTEM_ERROR;
-        }
+SettingsStorage::SettingsFileHash_t& SettingsStorage::getFileHash(const SettingsShard_t* shard) const
+{
+    return shard == nullptr ? *settingsFileHash : shard->hash;
+}
+
+bool SettingsStorage::isSettingsFileStored(const SettingsShard_t* shard, const uint64_t hash,
+                                           const SettingsCompressionAlgorithm_t compression,
+                                           const SettingsStoreMode_t mode, const SettingsDurability_t durability) const
+{
+    // The file already holds these settings if the last store wrote them the same way, and synced them as far. Only
+    // the sums of the hashes are compared, see addSettingsShard().
+    if (CONFIG_SETTINGS_STORAGE_STORE_UNCHANGED_FILES)
+    {
+        return false;
     }
+    const SettingsFileHash_t& fileHash = getFileHash(shard);
+    return fileHash.storedValid && fileHash.stored == hash && fileHash.storedCompression == compression &&
+           fileHash.storedMode == mode && fileHash.storedDurability >= durability;
+}
 
-    if (res != SettingsFile::EndOfFile)
+void SettingsStorage::recordStoredSettingsFile(const SettingsShard_t* shard, const bool dirty, const uint64_t hash,
+                                               const SettingsCompressionAlgorithm_t compression,
+                                               const SettingsStoreMode_t mode,
+                                               const SettingsDurability_t durability) const
+{
+    // A setting that changed while the file was written may or may not be in it, so the file is not trusted.
+    SettingsFileHash_t& fileHash = getFileHash(shard);
+    fileHash.storedValid         = !dirty;
+    fileHash.stored              = hash;
+    fileHash.storedCompression   = compression;
+    fileHash.storedMode          = mode;
+    fileHash.storedDurability    = durability;
+}
+
+void SettingsStorage::forgetStoredSettingsFiles() const
+{
+    // The loaded files may not be the files written by the last stores.
+    settingsFileHash->storedValid = false;
+    for (SettingsShard_t& shard : *settingsShards)
     {
-        settingsFile->close();
-        return SETTINGS_FILESYSTEM_ERROR;
+        shard.hash.storedValid = false;
     }
+}
 
-    res = settingsFile->close();
-    if (res != SettingsFile::Success)
+int SettingsStorage::sumFileHashesCallback(void* data, const unsigned char* key, const uint32_t key_len, void* value)
+{
+    const auto* settingsStorage = static_cast<const SettingsStorage*>(data);
+    settingsStorage->getFileHash(settingsStorage->findSettingsShard(key, key_len)).current +=
+        std::atomic_ref<uint64_t>(static_cast<SettingValue_t*>(value)->settingHash).load();
+    return 0;
+}
+
+SettingsFile::SettingsFileResult SettingsStorage::syncSettingsFile(ExtendedSettingsFile*      file,
+                                                                   const SettingsDurability_t durability)
+{
+    // A plain settings file does not tell how far its data gets, so it can only be used without a durability.
+    if (durability == SettingsDurability_t::NONE)
     {
-        return SETTINGS_FILESYSTEM_ERROR;
+        return SettingsFile::Success;
     }
-    return NO_ERROR;
+    return file == nullptr ? SettingsFile::InvalidState : file->sync(durability);
 }
 
-int SettingsStorage::listSettingsKeysCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+SettingsStorage::SettingError_t SettingsStorage::restoreDefaultSettings(const char*                    keyPrefix,
+                                                                        SettingPermissions_t           permissions,
+                                                                        SettingPermissionsFilterMode_t filterMode) const
 {
-    auto*                          callbackData = static_cast<SettingsListCallbackData_t*>(data);
-    SettingPermissions_t           permissions  = std::get<0>(*callbackData);
-    SettingPermissionsFilterMode_t filterMode   = std::get<1>(*callbackData);
-    SettingsKeysList_t*            outputKeys   = std::get<2>(*callbackData);
-    auto*                          settingValue = static_cast<SettingValue_t*>(value);
+    if (keyPrefix == nullptr)
+    {
+        return INVALID_INPUT_ERROR;
+    }
 
-    switch (filterMode)
+    SettingsKeysList_t outputKeys;
+
+    SettingError_t result = listSettingsKeys(keyPrefix, permissions, filterMode, outputKeys);
+    if (result != NO_ERROR)
     {
-        case MatchSettingsWithAnyPermissionsListed:
+        return result;
+    }
+
+    for (const auto& key : outputKeys)
+    {
+        SettingValue_t* outputValue;
+        result = getSettingValue(key.c_str(), outputValue, true);
+        if (result != NO_ERROR)
         {
-            if (static_cast<uint32_t>(settingValue->settingPermissions & permissions) >
-                0) // If a bit is set in both, the result is greater than 0.
-            {
-                outputKeys->emplace_back(reinterpret_cast<const char*>(key), key_len);
-            }
-            return NO_ERROR;
+            return result;
         }
 
-        case MatchSettingsWithAllPermissionsListed:
+        if (outputValue->settingValueType == STRING)
         {
-            if (settingValue->settingPermissions == permissions)
+            shareDefaultSettingString(outputValue);
+        }
+        else
+        {
+            outputValue->settingValueData = outputValue->settingDefaultValueData;
+        }
+        updateSettingHash(reinterpret_cast<const unsigned char*>(key.data()), static_cast<uint32_t>(key.size()),
+                          outputValue);
+        markSettingsFileDirty(key.c_str(), outputValue->settingDurability);
+    }
+
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t
+SettingsStorage::storeSettingsInPersistentStorage(const uint32_t                       threads,
+                                                  const SettingsCompressionAlgorithm_t compression,
+                                                  const SettingsStoreMode_t            mode,
+                                                  const SettingsDurability_t           durability) const
+{
+    if (compression >= SettingsCompressionAlgorithm_t::MAX_SETTINGS_COMPRESSION_ALGORITHM ||
+        durability >= SettingsDurability_t::MAX_SETTINGS_DURABILITY ||
+        (mode != StoreAllSettings && mode != StoreModifiedSettings && mode != StoreSettingsInSlots &&
+         mode != StoreSettingsInMappedTree && mode != StoreSettingsInBlocks) ||
+        ((mode == StoreSettingsInSlots || mode == StoreSettingsInMappedTree || mode == StoreSettingsInBlocks) &&
+         compression != SettingsCompressionAlgorithm_t::NONE))
+    {
+        return INVALID_INPUT_ERROR;
+    }
+    if (persistence == nullptr)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // A store that starts after this point reads the settings as they are now, so its result is also the result of
+    // this store if it writes the files the same way, and syncs them at least as far.
+    const uint64_t firstJoinableStore = persistence->storesStarted + 1;
+    if (!persistenceIdle->wait(CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS))
+    {
+        return TIMEOUT_ERROR;
+    }
+    SettingError_t result;
+    if (persistence->storesFinished >= firstJoinableStore && persistence->lastStoreCompression == compression &&
+        persistence->lastStoreMode == mode && persistence->lastStoreDurability >= durability)
+    {
+        result = persistence->lastStoreResult;
+    }
+    else
+    {
+        persistence->storesStarted++;
+        result = storeSettingsFiles(threads, compression, mode, durability);
+        finishStore(result, compression, mode, durability);
+    }
+    persistenceIdle->signal();
+    return result;
+}
+
+SettingsStorage::SettingError_t
+SettingsStorage::storeSettingsFiles(const uint32_t threads, const SettingsCompressionAlgorithm_t compression,
+                                    const SettingsStoreMode_t mode, const SettingsDurability_t durability) const
+{
+    // The pending records are part of the settings, and the image may keep the settings file open.
+    if (loadLazySettings({}, false, SETTINGS_STORAGE_MUTEX_TIMEOUT_MS) != NO_ERROR)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // A file is clean once it is stored, unless one of its settings changes while it is being stored. Its durability is
+    // taken before the dirty flag, so a setting that changes in between is synced by this store or by the next one.
+    // The hash of a file is read after its dirty flag, and the hash of a setting changes before the flag is set, so a
+    // file whose settings hash the same as the last file written is skipped.
+    for (SettingsShard_t& shard : *settingsShards)
+    {
+        const auto dirtyDurability = static_cast<SettingsDurability_t>(shard.dirtyDurability.exchange(0));
+        if (shard.dirty.exchange(false) || dirtyDurability != SettingsDurability_t::NONE)
+        {
+            const SettingsDurability_t fileDurability = std::max(durability, dirtyDurability);
+            const uint64_t             hash           = shard.hash.current;
+            if (isSettingsFileStored(&shard, hash, compression, mode, fileDurability))
+            {
+                continue;
+            }
+            const SettingError_t result = storeSettingsFile(&shard, threads, compression, mode, fileDurability);
+            commitSettingRecords(&shard, result == NO_ERROR, persistence->persistedChanges);
+            recordStoredSettingsFile(&shard, result != NO_ERROR || shard.dirty, hash, compression, mode,
+                                     fileDurability);
+            if (result != NO_ERROR)
+            {
+                raiseDurability(shard.dirtyDurability, dirtyDurability);
+                shard.dirty = true;
+                return result;
+            }
+        }
+    }
+    const auto dirtyDurability = static_cast<SettingsDurability_t>(settingsFileDirtyDurability.exchange(0));
+    if (settingsFileDirty.exchange(false) || dirtyDurability != SettingsDurability_t::NONE || settingsShards->empty())
+    {
+        const SettingsDurability_t fileDurability = std::max(durability, dirtyDurability);
+        const uint64_t             hash           = settingsFileHash->current;
+        if (isSettingsFileStored(nullptr, hash, compression, mode, fileDurability))
+        {
+            return NO_ERROR;
+        }
+        const SettingError_t result = storeSettingsFile(nullptr, threads, compression, mode, fileDurability);
+        commitSettingRecords(nullptr, result == NO_ERROR, persistence->persistedChanges);
+        recordStoredSettingsFile(nullptr, result != NO_ERROR || settingsFileDirty, hash, compression, mode,
+                                 fileDurability);
+        if (result != NO_ERROR)
+        {
+            raiseDurability(settingsFileDirtyDurability, dirtyDurability);
+            settingsFileDirty = true;
+            return result;
+        }
+    }
+    return NO_ERROR;
+}
+
+void SettingsStorage::finishStore(const SettingError_t result, const SettingsCompressionAlgorithm_t compression,
+                                  const SettingsStoreMode_t mode, const SettingsDurability_t durability) const
+{
+    persistence->storesFinished       = persistence->storesStarted;
+    persistence->lastStoreResult      = result;
+    persistence->lastStoreCompression = compression;
+    persistence->lastStoreMode        = mode;
+    persistence->lastStoreDurability  = durability;
+}
+
+SettingsStorage::SettingError_t
+SettingsStorage::storeSettingsAsync(const SettingsStoreCompletionCallback_t callback, void* callbackData,
+                                    const SettingsCompressionAlgorithm_t compression,
+                                    const SettingsStoreMode_t            mode,
+                                    const SettingsDurability_t           durability) const
+{
+    if (compression >= SettingsCompressionAlgorithm_t::MAX_SETTINGS_COMPRESSION_ALGORITHM ||
+        durability >= SettingsDurability_t::MAX_SETTINGS_DURABILITY ||
+        (mode != StoreAllSettings && mode != StoreModifiedSettings))
+    {
+        return INVALID_INPUT_ERROR;
+    }
+    if (settingsFile == nullptr)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    if (!asyncStoreMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        return TIMEOUT_ERROR;
+    }
+    // A store requested while another one is in flight is written by the worker when it finishes, with a new snapshot.
+    if (asyncStore->inFlight)
+    {
+        asyncStore->followUpRequested = true;
+        asyncStore->compression       = compression;
+        asyncStore->mode              = mode;
+        asyncStore->durability        = std::max(asyncStore->durability, durability);
+        if (callback != nullptr)
+        {
+            asyncStore->callbacks.emplace_back(callback, callbackData);
+        }
+        asyncStoreMutex->signal();
+        return NO_ERROR;
+    }
+    if (!asyncStoreIdle->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        asyncStoreMutex->signal();
+        return TIMEOUT_ERROR;
+    }
+    // A follow-up left by a worker that could not lock the state is written by this store.
+    asyncStore->inFlight = true;
+
+    SettingsDurability_t          storeDurability = durability;
+    SettingsStoreCompletionList_t callbacks;
+    if (asyncStore->followUpRequested)
+    {
+        asyncStore->followUpRequested = false;
+        storeDurability               = std::max(asyncStore->durability, durability);
+        callbacks.swap(asyncStore->callbacks);
+    }
+    asyncStoreMutex->signal();
+
+    // The previous worker already finished its last store, and only this thread can start a new one until it is done.
+    if (asyncStore->worker != nullptr)
+    {
+        asyncStore->worker->join();
+        delete asyncStore->worker;
+        asyncStore->worker = nullptr;
+    }
+
+    // The settings are copied now if no store or load uses the files. Otherwise, the worker copies them when it can.
+    std::vector<SettingsFileSnapshot_t> snapshots;
+    SettingError_t                      result        = NO_ERROR;
+    const bool                          snapshotTaken = persistenceIdle->wait(0);
+    if (snapshotTaken)
+    {
+        persistence->storesStarted++;
+        result = takeSettingsSnapshot(compression, mode, storeDurability, snapshots);
+    }
+    if (callback != nullptr)
+    {
+        callbacks.emplace_back(callback, callbackData);
+    }
+
+    // The worker takes the mutex before it finishes, so it can not end before it is assigned. Without the mutex or a
+    // task, the store is written before returning, as if the worker had finished it.
+    auto* backgroundStore = new SettingsBackgroundStoreData_t(this, std::move(snapshots), result, snapshotTaken,
+                                                              compression, mode, storeDurability, std::move(callbacks));
+    if (asyncStoreMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        asyncStore->worker = createTask(storeSettingsInBackgroundTask, backgroundStore, "SettingsStore");
+        asyncStoreMutex->signal();
+    }
+    if (asyncStore->worker == nullptr)
+    {
+        storeSettingsInBackgroundTask(backgroundStore);
+    }
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::waitForStore(const uint32_t timeoutMs) const
+{
+    if (asyncStoreIdle == nullptr)
+    {
+        return NO_ERROR;
+    }
+
+    // The worker calls the callbacks before it is idle, so it can not wait for itself. The store they report is
+    // written, so a callback only has to wait for a store requested since, which the worker writes once it returns.
+    if (storeCallbacksStorage == this)
+    {
+        if (!asyncStoreMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+        {
+            return TIMEOUT_ERROR;
+        }
+        const bool followUpRequested = asyncStore->followUpRequested;
+        asyncStoreMutex->signal();
+        return followUpRequested ? TIMEOUT_ERROR : NO_ERROR;
+    }
+    if (!asyncStoreIdle->wait(timeoutMs))
+    {
+        return TIMEOUT_ERROR;
+    }
+    asyncStoreIdle->signal();
+    return NO_ERROR;
+}
+
+void SettingsStorage::storeSettingsInBackground(std::vector<SettingsFileSnapshot_t> snapshots, SettingError_t result,
+                                                bool snapshotTaken, SettingsCompressionAlgorithm_t compression,
+                                                SettingsStoreMode_t mode, SettingsDurability_t durability,
+                                                SettingsStoreCompletionList_t callbacks) const
+{
+    // The worker has its own serializer and compressor, so the stores of the calling threads do not share them.
+    SettingsSerializer serializer;
+    SettingsCompressor compressor;
+    while (true)
+    {
+        // The files are used by this store from the copy of the settings until they are written. If another store or
+        // load keeps them, the files stay dirty for the next store.
+        if (!snapshotTaken && !persistenceIdle->wait(CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS))
+        {
+            result = TIMEOUT_ERROR;
+        }
+        else if (!snapshotTaken)
+        {
+            snapshotTaken = true;
+            persistence->storesStarted++;
+            result = takeSettingsSnapshot(compression, mode, durability, snapshots);
+        }
+        for (SettingsFileSnapshot_t& snapshot : snapshots)
+        {
+            if (result == NO_ERROR)
+            {
+                result = writeSettingsSnapshot(snapshot, compression, serializer, compressor);
+                commitSettingRecords(snapshot.shard, result == NO_ERROR, snapshot.persistedChanges);
+                recordStoredSettingsFile(snapshot.shard,
+                                         result != NO_ERROR ||
+                                             (snapshot.shard == nullptr ? settingsFileDirty : snapshot.shard->dirty),
+                                         snapshot.hash, compression, mode, snapshot.durability);
+            }
+            // A file that is not written is stored again by the next store, and synced as far.
+            if (result != NO_ERROR)
+            {
+                raiseDurability(snapshot.shard == nullptr ? settingsFileDirtyDurability
+                                                          : snapshot.shard->dirtyDurability,
+                                snapshot.durability);
+                (snapshot.shard == nullptr ? settingsFileDirty : snapshot.shard->dirty) = true;
+            }
+        }
+        if (snapshotTaken)
+        {
+            finishStore(result, compression, mode, durability);
+            persistenceIdle->signal();
+        }
+
+        const SettingsStorage* previousCallbacksStorage = storeCallbacksStorage;
+        storeCallbacksStorage                           = this;
+        for (const auto& [callback, callbackData] : callbacks)
+        {
+            callback(callbackData, result);
+        }
+        storeCallbacksStorage = previousCallbacksStorage;
+
+        // If the state can not be locked, the worker stops anyway, and the next store requested writes the follow-up
+        // and calls its callbacks.
+        if (!asyncStoreMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+        {
+            asyncStore->inFlight = false;
+            asyncStoreIdle->signal();
+            return;
+        }
+        if (!asyncStore->followUpRequested)
+        {
+            asyncStore->inFlight = false;
+            asyncStoreIdle->signal();
+            asyncStoreMutex->signal();
+            return;
+        }
+        mode                   = asyncStore->mode;
+        compression            = asyncStore->compression;
+        durability             = asyncStore->durability;
+        asyncStore->durability = SettingsDurability_t::NONE;
+        callbacks.swap(asyncStore->callbacks);
+        asyncStore->callbacks.clear();
+        asyncStore->followUpRequested = false;
+        asyncStoreMutex->signal();
+
+        snapshots.clear();
+        snapshotTaken = false;
+    }
+}
+
+void SettingsStorage::storeSettingsInBackgroundTask(void* data)
+{
+    auto* backgroundStore = static_cast<SettingsBackgroundStoreData_t*>(data);
+    std::get<0>(*backgroundStore)
+        ->storeSettingsInBackground(std::move(std::get<1>(*backgroundStore)), std::get<2>(*backgroundStore),
+                                    std::get<3>(*backgroundStore), std::get<4>(*backgroundStore),
+                                    std::get<5>(*backgroundStore), std::get<6>(*backgroundStore),
+                                    std::move(std::get<7>(*backgroundStore)));
+    delete backgroundStore;
+}
+
+SettingsStorage::SettingError_t
+SettingsStorage::takeSettingsSnapshot(const SettingsCompressionAlgorithm_t compression, const SettingsStoreMode_t mode,
+                                      const SettingsDurability_t           durability,
+                                      std::vector<SettingsFileSnapshot_t>& snapshots) const
+{
+    // The pending records are part of the settings, and the image may keep the settings file open.
+    if (loadLazySettings({}, false, SETTINGS_STORAGE_MUTEX_TIMEOUT_MS) != NO_ERROR)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // Like storeSettingsInPersistentStorage(), only the files whose settings changed are copied and written.
+    for (SettingsShard_t& shard : *settingsShards)
+    {
+        const auto dirtyDurability = static_cast<SettingsDurability_t>(shard.dirtyDurability.exchange(0));
+        if (shard.dirty.exchange(false) || dirtyDurability != SettingsDurability_t::NONE)
+        {
+            const SettingsDurability_t fileDurability = std::max(durability, dirtyDurability);
+            const uint64_t             hash           = shard.hash.current;
+            if (isSettingsFileStored(&shard, hash, compression, mode, fileDurability))
+            {
+                continue;
+            }
+            SettingsFileSnapshot_t&        snapshot     = snapshots.emplace_back();
+            SettingsSnapshotCallbackData_t callbackData = std::make_tuple(this, &snapshot, mode);
+            snapshot.shard                              = &shard;
+            snapshot.durability                         = fileDurability;
+            snapshot.hash                               = hash;
+            const int iterateResult =
+                settings->iterateOverPrefix(shard.keyPrefix.c_str(), static_cast<int>(shard.keyPrefix.size()),
+                                            snapshotSettingCallback, &callbackData);
+            snapshot.persistedChanges = std::exchange(persistence->persistedChanges, 0);
+            if (iterateResult != 0)
+            {
+                return SETTINGS_FILESYSTEM_ERROR;
+            }
+        }
+    }
+    const auto dirtyDurability = static_cast<SettingsDurability_t>(settingsFileDirtyDurability.exchange(0));
+    if (settingsFileDirty.exchange(false) || dirtyDurability != SettingsDurability_t::NONE || settingsShards->empty())
+    {
+        const SettingsDurability_t fileDurability = std::max(durability, dirtyDurability);
+        const uint64_t             hash           = settingsFileHash->current;
+        if (isSettingsFileStored(nullptr, hash, compression, mode, fileDurability))
+        {
+            return NO_ERROR;
+        }
+        SettingsFileSnapshot_t&        snapshot     = snapshots.emplace_back();
+        SettingsSnapshotCallbackData_t callbackData = std::make_tuple(this, &snapshot, mode);
+        snapshot.shard                              = nullptr;
+        snapshot.durability                         = fileDurability;
+        snapshot.hash                               = hash;
+        const int iterateResult   = settings->iterateOverAll(snapshotSettingCallback, &callbackData);
+        snapshot.persistedChanges = std::exchange(persistence->persistedChanges, 0);
+        if (iterateResult != 0)
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+    }
+    return NO_ERROR;
+}
+
+int SettingsStorage::snapshotSettingCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    auto* callbackData = static_cast<SettingsSnapshotCallbackData_t*>(data);
+    auto* settingValue = static_cast<SettingValue_t*>(value);
+    auto* snapshot     = std::get<1>(*callbackData);
+
+    bool tombstone = false;
+    if (std::get<0>(*callbackData)->findSettingsShard(key, key_len) != snapshot->shard ||
+        !std::get<0>(*callbackData)->selectSettingRecord(settingValue, std::get<2>(*callbackData), tombstone))
+    {
+        return 0;
+    }
+
+    // The strings are appended to a single buffer, so the copy only allocates a few times.
+    SettingSnapshotRecord_t& record = snapshot->records.emplace_back();
+    record.keyOffset                = static_cast<uint32_t>(snapshot->strings.size());
+    record.keyLength                = key_len;
+    record.value                    = *settingValue;
+    record.tombstone                = tombstone;
+    snapshot->strings.append(reinterpret_cast<const char*>(key), key_len);
+    record.valueOffset = static_cast<uint32_t>(snapshot->strings.size());
+    if (!tombstone && settingValue->settingValueType == STRING)
+    {
+        snapshot->strings.append(settingValue->settingValueData.string, settingValue->settingString.length);
+        snapshot->strings.push_back('\0');
+    }
+    return 0;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::writeSettingsSnapshot(const SettingsFileSnapshot_t&        snapshot,
+                                                                       const SettingsCompressionAlgorithm_t compression,
+                                                                       SettingsSerializer&                  serializer,
+                                                                       SettingsCompressor& compressor) const
+{
+    SettingsFile*         file = snapshot.shard == nullptr ? settingsFile : snapshot.shard->settingsFile;
+    ExtendedSettingsFile* extendedFile =
+        snapshot.shard == nullptr ? extendedSettingsFile : snapshot.shard->extendedSettingsFile;
+    SettingsCompressor* fileCompressor =
+        compression == SettingsCompressionAlgorithm_t::NONE ? nullptr : &compressor;
+    getSlotIndex(snapshot.shard).slots.clear();
+    SettingsRecordCacheUpdate_t      recordCache{&getRecordCache(snapshot.shard), 0};
+    SettingsFile::SettingsFileResult res = beginSettingsFile(&serializer, file, fileCompressor, compression);
+    for (const SettingSnapshotRecord_t& record : snapshot.records)
+    {
+        if (res != SettingsFile::Success)
+        {
+            break;
+        }
+        SettingValue_t value = record.value;
+        if (value.settingValueType == STRING)
+        {
+            value.settingValueData.string = const_cast<char*>(snapshot.strings.data() + record.valueOffset);
+        }
+        res = serializeSettingRecord(&serializer,
+                                     reinterpret_cast<const unsigned char*>(snapshot.strings.data() + record.keyOffset),
+                                     record.keyLength, &value, record.tombstone,
+                                     nextSettingRecordText(&recordCache, &value, record.tombstone));
+    }
+    recordCache.records->resize(recordCache.count);
+    if (res == SettingsFile::Success)
+    {
+        res = serializer.flush();
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = endSettingsFile(&serializer, file, serializer.getChecksum(), extendedFile, snapshot.durability);
+    }
+    return res == SettingsFile::Success ? NO_ERROR : SETTINGS_FILESYSTEM_ERROR;
+}
+
+SettingsStorage::SettingError_t
+SettingsStorage::storeSettingsFile(const SettingsShard_t* shard, const uint32_t threads,
+                                   const SettingsCompressionAlgorithm_t compression, const SettingsStoreMode_t mode,
+                                   const SettingsDurability_t durability) const
+{
+    if (mode == StoreSettingsInSlots)
+    {
+        return storeSettingSlots(shard, durability);
+    }
+    if (mode == StoreSettingsInMappedTree)
+    {
+        return storeMappedTree(shard, durability);
+    }
+    if (mode == StoreSettingsInBlocks)
+    {
+        return storeSettingBlocks(shard, durability);
+    }
+
+    SettingsFile*         file         = shard == nullptr ? settingsFile : shard->settingsFile;
+    ExtendedSettingsFile* extendedFile = shard == nullptr ? extendedSettingsFile : shard->extendedSettingsFile;
+    SettingsCompressor* compressor =
+        compression == SettingsCompressionAlgorithm_t::NONE ? nullptr : settingsCompressor;
+    const auto checksumAlgorithm = static_cast<SettingsChecksumAlgorithm_t>(CONFIG_SETTINGS_STORAGE_CHECKSUM_ALGORITHM);
+    getSlotIndex(shard).slots.clear();
+
+    SettingsFile::SettingsFileResult res = beginSettingsFile(settingsSerializer, file, compressor, compression);
+    if (res != SettingsFile::Success)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // The records of the numbers are kept from the previous store while their values are the same.
+    SettingsRecordCacheUpdate_t recordCache{&getRecordCache(shard), 0};
+    uint32_t                    checksum = 0;
+    if (threads <= 1)
+    {
+        SettingsStoreCallbackData_t callbackData = std::make_tuple(settingsSerializer, mode, this, shard, &recordCache);
+
+        res = static_cast<SettingsFile::SettingsFileResult>(
+            shard == nullptr
+                ? settings->iterateOverAll(storeSettingsInPersistentStorageCallback, &callbackData)
+                : settings->iterateOverPrefix(shard->keyPrefix.c_str(), static_cast<int>(shard->keyPrefix.size()),
+                                              storeSettingsInPersistentStorageCallback, &callbackData));
+        if (res == SettingsFile::Success)
+        {
+            res = settingsSerializer->flush();
+        }
+        checksum = settingsSerializer->getChecksum();
+    }
+    else
+    {
+        // The records are formatted while the tree is locked, and written once it is unlocked, so the settings can
+        // be updated while the file is written.
+        std::vector<SettingRecord_t>        records;
+        std::vector<std::string>            outputs;
+        SettingsParallelStoreCallbackData_t callbackData = std::make_tuple(
+            this, threads, checksumAlgorithm, &records, &checksum, compressor, mode, shard, &outputs, &recordCache);
+        records.reserve(settings->size());
+        res = static_cast<SettingsFile::SettingsFileResult>(
+            shard == nullptr
+                ? settings->iterateOverAll(collectSettingRecordsCallback, &callbackData,
+                                           formatSettingRecordsInParallelCallback)
+                : settings->iterateOverPrefix(shard->keyPrefix.c_str(), static_cast<int>(shard->keyPrefix.size()),
+                                              collectSettingRecordsCallback, &callbackData,
+                                              formatSettingRecordsInParallelCallback));
+        if (res == SettingsFile::Success)
+        {
+            res = writeSettingOutputs(file, extendedFile, outputs);
+        }
+    }
+    recordCache.records->resize(recordCache.count);
+    if (res == SettingsFile::Success)
+    {
+        res = endSettingsFile(settingsSerializer, file, checksum, extendedFile, durability);
+    }
+    return res == SettingsFile::Success ? NO_ERROR : SETTINGS_FILESYSTEM_ERROR;
+}
+
+SettingsFile::SettingsFileResult SettingsStorage::beginSettingsFile(SettingsSerializer* serializer, SettingsFile* file,
+                                                                    SettingsCompressor*                  compressor,
+                                                                    const SettingsCompressionAlgorithm_t compression)
+{
+    SettingsFile::SettingsFileResult res = file->openForWrite();
+    if (res != SettingsFile::Success)
+    {
+        return res;
+    }
+
+    // Header line: \rv<format version>\t<checksum algorithm>[\t<compression algorithm>]\n. Like the checksum line,
+    // it is not checksummed. Uncompressed files keep the format version 1, so older versions can still load them.
+    const auto checksumAlgorithm = static_cast<SettingsChecksumAlgorithm_t>(CONFIG_SETTINGS_STORAGE_CHECKSUM_ALGORITHM);
+    serializer->begin(file, checksumAlgorithm, compressor);
+    serializer->append(std::string_view("\rv"));
+    serializer->append(compressor == nullptr ? SETTINGS_FILE_FORMAT_VERSION : SETTINGS_FILE_COMPRESSED_FORMAT_VERSION);
+    serializer->append('\t');
+    serializer->append(static_cast<int64_t>(checksumAlgorithm));
+    if (compressor != nullptr)
+    {
+        serializer->append('\t');
+        serializer->append(static_cast<int64_t>(compression));
+    }
+    serializer->append('\n');
+    return serializer->flush(false);
+}
+
+SettingsFile::SettingsFileResult SettingsStorage::endSettingsFile(SettingsSerializer* serializer, SettingsFile* file,
+                                                                  const uint32_t             checksum,
+                                                                  ExtendedSettingsFile*      extendedFile,
+                                                                  const SettingsDurability_t durability)
+{
+    // The checksum line is not part of the checksummed data.
+    serializer->append('\r');
+    serializer->append(checksum);
+    serializer->append('\n');
+    SettingsFile::SettingsFileResult res = serializer->flush(false);
+    if (res != SettingsFile::Success)
+    {
+        return res;
+    }
+
+    // The file is closed even if it can not be synced, its data is written but it may not survive a crash.
+    res = syncSettingsFile(extendedFile, durability);
+    if (res != SettingsFile::Success)
+    {
+        file->forceClose();
+        return res;
+    }
+    return file->close();
+}
+
+SettingsStorage::SettingsSlotIndex_t& SettingsStorage::getSlotIndex(const SettingsShard_t* shard) const
+{
+    return shard == nullptr ? *settingsSlotIndex : shard->slotIndex;
+}
+
+SettingsStorage::SettingsRecordCache_t& SettingsStorage::getRecordCache(const SettingsShard_t* shard) const
+{
+    return shard == nullptr ? *settingsRecordCache : shard->recordCache;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::storeSettingSlots(const SettingsShard_t*     shard,
+                                                                   const SettingsDurability_t durability) const
+{
+    SettingsSlotIndex_t&  slotIndex    = getSlotIndex(shard);
+    ExtendedSettingsFile* extendedFile = shard == nullptr ? extendedSettingsFile : shard->extendedSettingsFile;
+    if (extendedFile == nullptr || slotIndex.slots.empty())
+    {
+        return writeSettingSlots(shard, durability);
+    }
+
+    // The settings are compared with the slots in key order. The file is rewritten if any setting does not have the
+    // same slot, and otherwise only the records that changed are written.
+    SettingsSerializer                          recordSerializer;
+    std::string                                 record;
+    std::vector<std::pair<size_t, std::string>> updates;
+    SettingsSlotUpdateCallbackData_t            callbackData =
+        std::make_tuple(this, shard, &slotIndex, static_cast<size_t>(0), &recordSerializer, &record, &updates);
+    const int result = shard == nullptr
+                           ? settings->iterateOverAll(updateSettingSlotCallback, &callbackData)
+                           : settings->iterateOverPrefix(shard->keyPrefix.c_str(),
+                                                         static_cast<int>(shard->keyPrefix.size()),
+                                                         updateSettingSlotCallback, &callbackData);
+    if (result != 0 || std::get<3>(callbackData) != slotIndex.slots.size())
+    {
+        return writeSettingSlots(shard, durability);
+    }
+    // Without updates, the file is still opened to sync the records written by a previous store that did not.
+    if (updates.empty() && durability == SettingsDurability_t::NONE)
+    {
+        return NO_ERROR;
+    }
+
+    // If the file can not be updated in place, it is rewritten.
+    if (extendedFile->openForUpdate() != SettingsFile::Success)
+    {
+        return writeSettingSlots(shard, durability);
+    }
+    for (const auto& [slot, slotRecord] : updates)
+    {
+        if (extendedFile->writeAt(slotIndex.slots[slot].offset, slotRecord) != SettingsFile::Success)
+        {
+            // The slots written so far are not known, so the next store rewrites the file.
+            extendedFile->close();
+            slotIndex.slots.clear();
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+        slotIndex.slots[slot].recordHash = std::hash<std::string_view>{}(slotRecord);
+    }
+    const bool synced = syncSettingsFile(extendedFile, durability) == SettingsFile::Success;
+    if (extendedFile->close() != SettingsFile::Success || !synced)
+    {
+        slotIndex.slots.clear();
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return NO_ERROR;
+}
+
+int SettingsStorage::updateSettingSlotCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    auto* callbackData = static_cast<SettingsSlotUpdateCallbackData_t*>(data);
+    auto* settingValue = static_cast<SettingValue_t*>(value);
+    auto* slotIndex    = std::get<2>(*callbackData);
+    auto& slot         = std::get<3>(*callbackData);
+
+    bool tombstone = false;
+    if (std::get<0>(*callbackData)->findSettingsShard(key, key_len) != std::get<1>(*callbackData) ||
+        !std::get<0>(*callbackData)->selectSettingRecord(settingValue, StoreSettingsInSlots, tombstone))
+    {
+        return 0;
+    }
+
+    if (slot >= slotIndex->slots.size() ||
+        slotIndex->slots[slot].key != std::string_view(reinterpret_cast<const char*>(key), key_len))
+    {
+        return 1;
+    }
+    uint32_t     payloadSize = slotIndex->slots[slot].payloadSize;
+    std::string& record      = *std::get<5>(*callbackData);
+    if (!formatSettingSlot(*std::get<4>(*callbackData), record, key, key_len, settingValue,
+                           slotIndex->checksumAlgorithm, payloadSize))
+    {
+        return 1;
+    }
+    if (std::hash<std::string_view>{}(record) != slotIndex->slots[slot].recordHash)
+    {
+        std::get<6>(*callbackData)->emplace_back(slot, record);
+    }
+    slot++;
+    return 0;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::writeSettingSlots(const SettingsShard_t*     shard,
+                                                                   const SettingsDurability_t durability) const
+{
+    SettingsFile*         file         = shard == nullptr ? settingsFile : shard->settingsFile;
+    ExtendedSettingsFile* extendedFile = shard == nullptr ? extendedSettingsFile : shard->extendedSettingsFile;
+    SettingsSlotIndex_t& slotIndex         = getSlotIndex(shard);
+    const auto           checksumAlgorithm =
+        static_cast<SettingsChecksumAlgorithm_t>(CONFIG_SETTINGS_STORAGE_CHECKSUM_ALGORITHM);
+    slotIndex.slots.clear();
+    slotIndex.checksumAlgorithm = checksumAlgorithm;
+
+    SettingsFile::SettingsFileResult res = file->openForWrite();
+    if (res != SettingsFile::Success)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // Header line: \rv3\t<checksum algorithm>\n. The offset of each record is kept, so it can be overwritten later.
+    const std::string header = "\rv" + std::to_string(SETTINGS_FILE_SLOTTED_FORMAT_VERSION) + '\t' +
+                               std::to_string(static_cast<int>(checksumAlgorithm)) + '\n';
+    settingsSerializer->begin(file, checksumAlgorithm);
+    res = settingsSerializer->append(header);
+
+    SettingsSerializer              recordSerializer;
+    std::string                     record;
+    auto                            offset       = static_cast<uint32_t>(header.size());
+    SettingsSlotStoreCallbackData_t callbackData = std::make_tuple(this, shard, &slotIndex, &recordSerializer,
+                                                                   &record, settingsSerializer, &offset);
+    if (res == SettingsFile::Success)
+    {
+        res = static_cast<SettingsFile::SettingsFileResult>(
+            shard == nullptr
+                ? settings->iterateOverAll(storeSettingSlotCallback, &callbackData)
+                : settings->iterateOverPrefix(shard->keyPrefix.c_str(), static_cast<int>(shard->keyPrefix.size()),
+                                              storeSettingSlotCallback, &callbackData));
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = settingsSerializer->flush(false);
+    }
+    // Each record has its own checksum, so the last line holds the number of records, to detect truncated files.
+    if (res == SettingsFile::Success)
+    {
+        res = endSettingsFile(settingsSerializer, file, static_cast<uint32_t>(slotIndex.slots.size()), extendedFile,
+                              durability);
+    }
+    if (res != SettingsFile::Success)
+    {
+        file->forceClose();
+        slotIndex.slots.clear();
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return NO_ERROR;
+}
+
+int SettingsStorage::storeSettingSlotCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    auto* callbackData = static_cast<SettingsSlotStoreCallbackData_t*>(data);
+    auto* settingValue = static_cast<SettingValue_t*>(value);
+    auto* slotIndex    = std::get<2>(*callbackData);
+
+    bool tombstone = false;
+    if (std::get<0>(*callbackData)->findSettingsShard(key, key_len) != std::get<1>(*callbackData) ||
+        !std::get<0>(*callbackData)->selectSettingRecord(settingValue, StoreSettingsInSlots, tombstone))
+    {
+        return SettingsFile::Success;
+    }
+
+    std::string& record      = *std::get<4>(*callbackData);
+    uint32_t     payloadSize = 0;
+    if (!formatSettingSlot(*std::get<3>(*callbackData), record, key, key_len, settingValue,
+                           slotIndex->checksumAlgorithm, payloadSize))
+    {
+        return SettingsFile::InvalidState;
+    }
+    uint32_t& offset = *std::get<6>(*callbackData);
+    slotIndex->slots.push_back({std::string(reinterpret_cast<const char*>(key), key_len), offset, payloadSize,
+                                std::hash<std::string_view>{}(record)});
+    offset += static_cast<uint32_t>(record.size());
+    return std::get<5>(*callbackData)->append(record);
+}
+
+SettingsStorage::SettingError_t SettingsStorage::storeMappedTree(const SettingsShard_t*     shard,
+                                                                 const SettingsDurability_t durability) const
+{
+    ExtendedSettingsFile* extendedFile = shard == nullptr ? extendedSettingsFile : shard->extendedSettingsFile;
+    getSlotIndex(shard).slots.clear();
+    if (extendedFile == nullptr)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    char*  data = nullptr;
+    size_t size = 0;
+    if (extendedFile->mapForUpdate(0, data, size) != SettingsFile::Success)
+    {
+        extendedFile->forceClose();
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // A file that does not hold a committed tree, e.g. a new file or one stored in another mode, gets an empty tree.
+    SettingsMappedTree tree;
+    bool               stored = true;
+    if (!tree.attach(data, size))
+    {
+        if (size < SettingsMappedTree::HEADER_SIZE)
+        {
+            stored = extendedFile->mapForUpdate(SettingsMappedTree::HEADER_SIZE, data, size) == SettingsFile::Success;
+        }
+        if (stored)
+        {
+            tree.create(data, size);
+        }
+    }
+
+    // The records of the settings that changed are put in the tree, which copies the nodes of their path.
+    SettingsSerializer                     recordSerializer;
+    std::string                            record;
+    std::string                            records;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    size_t                                 selected     = 0;
+    size_t                                 requiredSize = 0;
+    SettingsMappedStoreCallbackData_t      callbackData =
+        std::make_tuple(this, shard, &tree, &recordSerializer, &record, &records, &ranges, &selected);
+    const auto collectRecords = [&]
+    {
+        return (shard == nullptr ? settings->iterateOverAll(collectMappedRecordCallback, &callbackData)
+                                 : settings->iterateOverPrefix(shard->keyPrefix.c_str(),
+                                                               static_cast<int>(shard->keyPrefix.size()),
+                                                               collectMappedRecordCallback, &callbackData)) == 0;
+    };
+    stored = stored && collectRecords();
+
+    // Each put copies about log2(count) nodes, so when many records changed, e.g. in a new file, it is cheaper to
+    // build the whole tree again.
+    const uint32_t count  = tree.getCount();
+    bool           putAll = ranges.size() * (std::bit_width(count) + 1) <= count;
+    for (auto range = ranges.begin(); stored && putAll && range != ranges.end(); ++range)
+    {
+        const std::string_view treeRecord = std::string_view(records).substr(range->first, range->second);
+        while (stored && putAll && !tree.put(treeRecord, requiredSize))
+        {
+            // A record that does not fit extends the file, and a corrupted node makes the tree be built again.
+            putAll = requiredSize != 0;
+            stored = !putAll || growMappedTree(extendedFile, tree, requiredSize);
+        }
+    }
+
+    // The tree is also built again if a setting was removed, or if most of the file is not used.
+    if (stored && (!putAll || tree.getCount() != selected || tree.needsCompaction()))
+    {
+        records.clear();
+        ranges.clear();
+        selected                  = 0;
+        std::get<2>(callbackData) = nullptr;
+        stored                    = collectRecords();
+        std::vector<std::string_view> treeRecords;
+        treeRecords.reserve(ranges.size());
+        for (const auto& [offset, length] : ranges)
+        {
+            treeRecords.emplace_back(std::string_view(records).substr(offset, length));
+        }
+        while (stored && !tree.rebuild(treeRecords, requiredSize))
+        {
+            stored = requiredSize != 0 && growMappedTree(extendedFile, tree, requiredSize);
+        }
+    }
+
+    // The new nodes must reach the storage before the header that publishes them.
+    if (stored && tree.hasChanges())
+    {
+        size_t offset = 0;
+        size_t length = 0;
+        tree.getChanges(offset, length);
+        stored = extendedFile->syncMapped(offset, length) == SettingsFile::Success;
+        if (stored)
+        {
+            tree.commit();
+            stored = extendedFile->syncMapped(0, SettingsMappedTree::HEADER_SIZE) == SettingsFile::Success;
+        }
+    }
+    // The commit already waits for the data of the tree, only the metadata of the file is left.
+    if (stored && durability == SettingsDurability_t::FSYNCED)
+    {
+        stored = extendedFile->sync(durability) == SettingsFile::Success;
+    }
+    tree.detach();
+    if (!stored)
+    {
+        extendedFile->forceClose();
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return extendedFile->close() == SettingsFile::Success ? NO_ERROR : SETTINGS_FILESYSTEM_ERROR;
+}
+
+bool SettingsStorage::growMappedTree(ExtendedSettingsFile* file, SettingsMappedTree& tree, const size_t requiredSize)
+{
+    // The file grows by half its size at least, so the records of a store do not extend it one by one.
+    char*  data = nullptr;
+    size_t size = std::max(requiredSize, tree.getRegionSize() + tree.getRegionSize() / 2);
+    if (file->mapForUpdate(size, data, size) != SettingsFile::Success || size < requiredSize)
+    {
+        return false;
+    }
+    tree.remap(data, size);
+    return true;
+}
+
+int SettingsStorage::collectMappedRecordCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    auto* callbackData = static_cast<SettingsMappedStoreCallbackData_t*>(data);
+    auto* settingValue = static_cast<SettingValue_t*>(value);
+
+    bool tombstone = false;
+    if (std::get<0>(*callbackData)->findSettingsShard(key, key_len) != std::get<1>(*callbackData) ||
+        !std::get<0>(*callbackData)->selectSettingRecord(settingValue, StoreSettingsInMappedTree, tombstone))
+    {
+        return 0;
+    }
+
+    std::string& record = *std::get<4>(*callbackData);
+    if (!formatSettingRecord(*std::get<3>(*callbackData), record, key, key_len, settingValue))
+    {
+        return 1;
+    }
+    (*std::get<7>(*callbackData))++;
+
+    // Without a tree, every record is collected. Otherwise, only the ones that are not in the tree as they are.
+    const SettingsMappedTree* tree = std::get<2>(*callbackData);
+    std::string_view          storedRecord;
+    uint32_t                  id = 0;
+    if (tree != nullptr &&
+        tree->search(std::string_view(reinterpret_cast<const char*>(key), key_len), storedRecord, id) &&
+        storedRecord == record)
+    {
+        return 0;
+    }
+    std::string& records = *std::get<5>(*callbackData);
+    std::get<6>(*callbackData)->emplace_back(records.size(), record.size());
+    records.append(record);
+    return 0;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::storeSettingBlocks(const SettingsShard_t*     shard,
+                                                                    const SettingsDurability_t durability) const
+{
+    SettingsFile*         file         = shard == nullptr ? settingsFile : shard->settingsFile;
+    ExtendedSettingsFile* extendedFile = shard == nullptr ? extendedSettingsFile : shard->extendedSettingsFile;
+    const auto checksumAlgorithm = static_cast<SettingsChecksumAlgorithm_t>(CONFIG_SETTINGS_STORAGE_CHECKSUM_ALGORITHM);
+    getSlotIndex(shard).slots.clear();
+
+    SettingsFile::SettingsFileResult res = file->openForWrite();
+    if (res != SettingsFile::Success)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // Header line: \rv5\t<checksum algorithm>\n. Each block is formatted in memory, so its checksum is known before
+    // it is written after it.
+    const std::string header = "\rv" + std::to_string(SETTINGS_FILE_BLOCKED_FORMAT_VERSION) + '\t' +
+                               std::to_string(static_cast<int>(checksumAlgorithm)) + '\n';
+    settingsSerializer->begin(file, checksumAlgorithm);
+    res = settingsSerializer->append(header);
+
+    SettingsSerializer               blockSerializer;
+    std::string                      block;
+    uint32_t                         blockRecords = 0;
+    uint32_t                         blocks       = 0;
+    SettingsRecordCacheUpdate_t      recordCache{&getRecordCache(shard), 0};
+    SettingsBlockStoreCallbackData_t callbackData = std::make_tuple(
+        this, shard, &blockSerializer, &block, settingsSerializer, &blockRecords, &blocks, &recordCache);
+    blockSerializer.beginInMemory(&block, checksumAlgorithm);
+    if (res == SettingsFile::Success)
+    {
+        res = static_cast<SettingsFile::SettingsFileResult>(
+            shard == nullptr
+                ? settings->iterateOverAll(storeSettingBlockCallback, &callbackData)
+                : settings->iterateOverPrefix(shard->keyPrefix.c_str(), static_cast<int>(shard->keyPrefix.size()),
+                                              storeSettingBlockCallback, &callbackData));
+    }
+    recordCache.records->resize(recordCache.count);
+    if (res == SettingsFile::Success && blockRecords > 0)
+    {
+        res = writeSettingBlock(blockSerializer, block, settingsSerializer, checksumAlgorithm);
+        blocks++;
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = settingsSerializer->flush(false);
+    }
+    // Each block has its own checksum, so the last line holds the number of blocks, to detect truncated files.
+    if (res == SettingsFile::Success)
+    {
+        res = endSettingsFile(settingsSerializer, file, blocks, extendedFile, durability);
+    }
+    if (res != SettingsFile::Success)
+    {
+        file->forceClose();
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return NO_ERROR;
+}
+
+int SettingsStorage::storeSettingBlockCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    auto* callbackData = static_cast<SettingsBlockStoreCallbackData_t*>(data);
+    auto* settingValue = static_cast<SettingValue_t*>(value);
+
+    bool tombstone = false;
+    if (std::get<0>(*callbackData)->findSettingsShard(key, key_len) != std::get<1>(*callbackData) ||
+        !std::get<0>(*callbackData)->selectSettingRecord(settingValue, StoreSettingsInBlocks, tombstone))
+    {
+        return SettingsFile::Success;
+    }
+
+    SettingsSerializer&              blockSerializer = *std::get<2>(*callbackData);
+    uint32_t&                        blockRecords    = *std::get<5>(*callbackData);
+    SettingsFile::SettingsFileResult res             = serializeSettingRecord(
+        &blockSerializer, key, key_len, settingValue, tombstone,
+        nextSettingRecordText(std::get<7>(*callbackData), settingValue, tombstone));
+    if (res == SettingsFile::Success && ++blockRecords == CONFIG_SETTINGS_STORAGE_BLOCK_RECORDS)
+    {
+        res = writeSettingBlock(blockSerializer, *std::get<3>(*callbackData), std::get<4>(*callbackData),
+                                static_cast<SettingsChecksumAlgorithm_t>(CONFIG_SETTINGS_STORAGE_CHECKSUM_ALGORITHM));
+        blockRecords = 0;
+        (*std::get<6>(*callbackData))++;
+    }
+    return res;
+}
+
+SettingsFile::SettingsFileResult SettingsStorage::writeSettingBlock(SettingsSerializer& blockSerializer,
+                                                                    std::string&        block,
+                                                                    SettingsSerializer* fileSerializer,
+                                                                    const SettingsChecksumAlgorithm_t checksumAlgorithm)
+{
+    // Block format: its records, followed by \rb<checksum of the records>\n.
+    SettingsFile::SettingsFileResult res = blockSerializer.flush();
+    if (res == SettingsFile::Success)
+    {
+        res = fileSerializer->append(block);
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = fileSerializer->append(std::string_view("\rb"));
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = fileSerializer->append(blockSerializer.getChecksum());
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = fileSerializer->append('\n');
+    }
+    block.clear();
+    blockSerializer.beginInMemory(&block, checksumAlgorithm);
+    return res;
+}
+
+bool SettingsStorage::formatSettingRecord(SettingsSerializer& serializer, std::string& record,
+                                          const unsigned char* key, const uint32_t key_len,
+                                          const SettingValue_t* settingValue)
+{
+    // The record is formatted like the records of other files, without its new line.
+    record.clear();
+    serializer.beginInMemory(&record);
+    if (serializeSettingRecord(&serializer, key, key_len, settingValue, false) != SettingsFile::Success ||
+        serializer.flush(false) != SettingsFile::Success)
+    {
+        return false;
+    }
+    record.pop_back();
+    return true;
+}
+
+bool SettingsStorage::formatSettingSlot(SettingsSerializer& serializer, std::string& record, const unsigned char* key,
+                                        const uint32_t key_len, const SettingValue_t* settingValue,
+                                        const SettingsChecksumAlgorithm_t checksumAlgorithm, uint32_t& payloadSize)
+{
+    // The record is formatted like the records of other files, and then its value is moved into its slot.
+    if (!formatSettingRecord(serializer, record, key, key_len, settingValue))
+    {
+        return false;
+    }
+    const size_t valueStart = record.find('\t', key_len + 1) + 1;
+    const size_t valueSize  = record.size() - valueStart;
+
+    // A new slot fits any number, and strings get room to grow by half their size.
+    if (payloadSize == 0)
+    {
+        size_t capacity = SETTING_SLOT_NUMBER_SIZE;
+        if (settingValue->settingValueType == STRING)
+        {
+            capacity = std::max(valueSize + valueSize / 2, SETTING_SLOT_STRING_ALIGNMENT);
+            capacity = (capacity + SETTING_SLOT_STRING_ALIGNMENT - 1) / SETTING_SLOT_STRING_ALIGNMENT *
+                       SETTING_SLOT_STRING_ALIGNMENT;
+        }
+        payloadSize = static_cast<uint32_t>(std::to_string(capacity).size() + 1 + capacity);
+    }
+
+    // Slot format: key\ttype\t<value size>:<value padded with spaces>\t<checksum of the rest of the slot>\n
+    const std::string valuePrefix = std::to_string(valueSize) + ':';
+    if (valuePrefix.size() + valueSize > payloadSize)
+    {
+        return false;
+    }
+    record.insert(valueStart, valuePrefix);
+    record.append(payloadSize - valuePrefix.size() - valueSize, ' ');
+    const uint32_t checksum = SettingsChecksum::calculate(checksumAlgorithm, record.data(), record.size());
+    record.push_back('\t');
+    for (int shift = 28; shift >= 0; shift -= 4)
+    {
+        record.push_back("0123456789abcdef"[(checksum >> shift) & 0xF]);
+    }
+    record.push_back('\n');
+    return true;
+}
+
+bool SettingsStorage::decodeSettingSlot(const std::string_view            line,
+                                        const SettingsChecksumAlgorithm_t checksumAlgorithm, std::string& records,
+                                        SettingSlot_t* slot)
+{
+    if (line.size() <= SETTING_SLOT_CHECKSUM_SIZE || line.back() != '\n' ||
+        line[line.size() - SETTING_SLOT_CHECKSUM_SIZE] != '\t')
+    {
+        return false;
+    }
+    const std::string_view data        = line.substr(0, line.size() - SETTING_SLOT_CHECKSUM_SIZE);
+    const char*            checksumEnd = line.data() + line.size() - 1;
+    uint32_t               checksum    = 0;
+    auto [end, error] = std::from_chars(data.data() + data.size() + 1, checksumEnd, checksum, 16);
+    if (error != std::errc() || end != checksumEnd ||
+        checksum != SettingsChecksum::calculate(checksumAlgorithm, data.data(), data.size()))
+    {
+        return false;
+    }
+
+    // The value is copied without its size and padding, so the record is parsed like the records of other files.
+    const size_t keyEnd     = data.find('\t');
+    const size_t valueStart = keyEnd == std::string_view::npos ? keyEnd : data.find('\t', keyEnd + 1);
+    if (valueStart == std::string_view::npos)
+    {
+        return false;
+    }
+    const char* dataEnd   = data.data() + data.size();
+    size_t      valueSize = 0;
+    auto [sizeEnd, sizeError] = std::from_chars(data.data() + valueStart + 1, dataEnd, valueSize);
+    if (sizeError != std::errc() || sizeEnd == dataEnd || *sizeEnd != ':' ||
+        valueSize > static_cast<size_t>(dataEnd - sizeEnd - 1))
+    {
+        return false;
+    }
+    records.append(data.substr(0, valueStart + 1));
+    records.append(sizeEnd + 1, valueSize);
+    records.push_back('\n');
+
+    if (slot != nullptr)
+    {
+        slot->key.assign(data.substr(0, keyEnd));
+        slot->payloadSize = static_cast<uint32_t>(data.size() - valueStart - 1);
+        slot->recordHash  = std::hash<std::string_view>{}(line);
+    }
+    return true;
+}
+
+void SettingsStorage::indexSettingSlot(const std::string_view line, const uint32_t offset,
+                                       const SettingsChecksumAlgorithm_t checksumAlgorithm, std::string& records,
+                                       SettingsSlotIndex_t& slotIndex, bool& damaged,
+                                       std::vector<SettingsKeyRange_t>& damagedRanges)
+{
+    // A slot torn by an update in place is skipped. The slots are stored in key order, so its key is between the keys
+    // of the valid slots around it.
+    SettingSlot_t& slot = slotIndex.slots.emplace_back();
+    slot.offset         = offset;
+    if (!decodeSettingSlot(line, checksumAlgorithm, records, &slot))
+    {
+        slotIndex.slots.pop_back();
+        damaged = true;
+        return;
+    }
+    if (damaged)
+    {
+        const size_t slotsCount = slotIndex.slots.size();
+        damagedRanges.push_back({"", slotsCount > 1 ? slotIndex.slots[slotsCount - 2].key : "", slot.key});
+        damaged = false;
+    }
+}
+
+void SettingsStorage::endSettingSlots(SettingsSlotIndex_t& slotIndex, const bool damaged,
+                                      std::vector<SettingsKeyRange_t>& damagedRanges)
+{
+    if (damaged)
+    {
+        damagedRanges.push_back({"", slotIndex.slots.empty() ? "" : slotIndex.slots.back().key, ""});
+    }
+
+    // The skipped slots are not in the index, so the file is rewritten by the next store instead of updated in place.
+    if (!damagedRanges.empty())
+    {
+        slotIndex.slots.clear();
+    }
+}
+
+SettingsStorage::SettingError_t SettingsStorage::validateChecksum(SettingsFile* file, bool& blocked)
+{
+    uint32_t expectedCrc32 = 0;
+    uint32_t computedCrc32 = 0;
+
+    // Files without header line (format version 0) are protected by CRC32.
+    auto     checksumAlgorithm    = SettingsChecksumAlgorithm_t::CRC32;
+    auto     compressionAlgorithm = SettingsCompressionAlgorithm_t::NONE;
+    uint32_t version              = 0;
+    blocked                       = false;
+
+    SettingsFile::SettingsFileResult res = file->openForRead();
+    if (res != SettingsFile::Success)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // The checksum protects the uncompressed records.
+    SettingsDecompressor decompressor;
+    std::string          records;
+    bool                 firstLine   = true;
+    bool                 damagedSlot = false;
+    while (res == SettingsFile::Success)
+    {
+        std::string settingStr;
+        res = file->readLine(settingStr);
+
+        if (res == SettingsFile::EndOfFile)
+        {
+            break;
+        }
+
+        if (settingStr[0] == '\r' && settingStr[1] == 'v')
+        {
+            if (!firstLine ||
+                parseFileHeader(settingStr, checksumAlgorithm, compressionAlgorithm, version) != NO_ERROR)
+            {
+                file->close();
+                return SETTINGS_FILESYSTEM_ERROR;
+            }
+            // The blocks are validated one by one when they are loaded, since a corrupted block is only skipped.
+            if (version == SETTINGS_FILE_BLOCKED_FORMAT_VERSION)
+            {
+                blocked = true;
+                return file->close() == SettingsFile::Success ? NO_ERROR : SETTINGS_FILESYSTEM_ERROR;
+            }
+        }
+        else if (settingStr[0] == '\r')
+        {
+            char* end;
+            expectedCrc32 = static_cast<uint32_t>(std::strtol(&settingStr[1], &end, 10));
+            if (*end != '\n')
+            {
+                file->close();
+                return SETTINGS_FILESYSTEM_ERROR;
+            }
+        }
+        else if (version == SETTINGS_FILE_SLOTTED_FORMAT_VERSION)
+        {
+            // Each slot has its own checksum, and the last line holds the number of slots instead. A damaged slot is
+            // skipped when the file is loaded, and it may have lost or gained a new line, so the slots are not counted.
+            records.clear();
+            damagedSlot = damagedSlot || !decodeSettingSlot(settingStr, checksumAlgorithm, records, nullptr);
+            computedCrc32++;
+        }
+        else if (compressionAlgorithm != SettingsCompressionAlgorithm_t::NONE)
+        {
+            records.clear();
+            if (!decompressor.decompress(settingStr, records))
+            {
+                file->close();
+                return SETTINGS_FILESYSTEM_ERROR;
+            }
+            computedCrc32 =
+                SettingsChecksum::calculate(checksumAlgorithm, records.data(), records.size(), computedCrc32);
+        }
+        else
+        {
+            computedCrc32 =
+                SettingsChecksum::calculate(checksumAlgorithm, settingStr.c_str(), settingStr.size(), computedCrc32);
+        }
+        firstLine = false;
+    }
+
+    if (res != SettingsFile::EndOfFile)
+    {
+        file->close();
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    res = file->close();
+    if (res != SettingsFile::Success)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    if (expectedCrc32 != computedCrc32 && !damagedSlot)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::parseFileHeader(const std::string_view          headerLine,
+                                                                 SettingsChecksumAlgorithm_t&    checksumAlgorithm,
+                                                                 SettingsCompressionAlgorithm_t& compressionAlgorithm,
+                                                                 uint32_t&                       version)
+{
+    // Header line: \rv<format version>\t<checksum algorithm>\n, followed by \t<compression algorithm> in version 2.
+    // Mapped trees (version 4) have a binary header instead, see SettingsMappedTree.
+    const char* end = headerLine.data() + headerLine.size();
+    auto [versionEnd, versionError] = std::from_chars(headerLine.data() + 2, end, version);
+    if (versionError != std::errc() || versionEnd == end || *versionEnd != '\t' || version < 1 ||
+        version > SETTINGS_FILE_BLOCKED_FORMAT_VERSION || version == SETTINGS_FILE_MAPPED_FORMAT_VERSION)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    const char separator = version == SETTINGS_FILE_COMPRESSED_FORMAT_VERSION ? '\t' : '\n';
+    uint8_t    algorithm = 0;
+    auto [algorithmEnd, algorithmError] = std::from_chars(versionEnd + 1, end, algorithm);
+    if (algorithmError != std::errc() || algorithmEnd == end || *algorithmEnd != separator ||
+        !SettingsChecksum::isValidAlgorithm(static_cast<SettingsChecksumAlgorithm_t>(algorithm)))
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    uint8_t compression = 0;
+    if (version == SETTINGS_FILE_COMPRESSED_FORMAT_VERSION)
+    {
+        auto [compressionEnd, compressionError] = std::from_chars(algorithmEnd + 1, end, compression);
+        if (compressionError != std::errc() || compressionEnd == end || *compressionEnd != '\n' ||
+            compression == static_cast<uint8_t>(SettingsCompressionAlgorithm_t::NONE) ||
+            compression >= static_cast<uint8_t>(SettingsCompressionAlgorithm_t::MAX_SETTINGS_COMPRESSION_ALGORITHM))
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+    }
+
+    checksumAlgorithm    = static_cast<SettingsChecksumAlgorithm_t>(algorithm);
+    compressionAlgorithm = static_cast<SettingsCompressionAlgorithm_t>(compression);
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadSettingsFromPersistentStorage(const uint32_t threads) const
+{
+    if (persistence == nullptr)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    if (!persistenceIdle->wait(CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS))
+    {
+        return TIMEOUT_ERROR;
+    }
+    forgetStoredSettingsFiles();
+
+    // The pending records of a previous lazy load are replaced by this file.
+    SettingError_t result = discardLazySettings();
+    if (result == NO_ERROR)
+    {
+        // Each file is validated on its own, so a corrupted file does not prevent the other files from being loaded.
+        // The shards are loaded last, so they replace the records of their settings that the settings file may keep.
+        persistence->damagedKeyRanges.clear();
+        result = loadSettingsFile(settingsFile, extendedSettingsFile, *settingsSlotIndex, threads,
+                                  persistence->damagedKeyRanges);
+        const SettingError_t shardsResult = loadSettingsShards(threads);
+        result                            = result != NO_ERROR ? result : shardsResult;
+    }
+    persistenceIdle->signal();
+    return result;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::getDamagedKeyRanges(std::vector<SettingsKeyRange_t>& ranges) const
+{
+    if (persistence == nullptr)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    if (!persistenceIdle->wait(CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS))
+    {
+        return TIMEOUT_ERROR;
+    }
+    ranges = persistence->damagedKeyRanges;
+    persistenceIdle->signal();
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadSettingsShards(const uint32_t threads) const
+{
+    if (settingsShards->empty())
+    {
+        return NO_ERROR;
+    }
+
+    // The shards are taken one by one by the workers, and each one is loaded by a single thread. The tree is locked
+    // while each block of records is merged, so the workers only wait for each other there.
+    std::vector<const SettingsShard_t*> shards;
+    shards.reserve(settingsShards->size());
+    for (const SettingsShard_t& shard : *settingsShards)
+    {
+        shards.push_back(&shard);
+    }
+    // Each shard reports its damaged keys on its own, so they are kept in the order of the shards.
+    std::vector<std::vector<SettingsKeyRange_t>> damagedRanges(shards.size());
+    std::atomic<size_t>                          nextShard   = 0;
+    std::atomic<SettingError_t>                  firstResult = NO_ERROR;
+    const auto loadShards = [this, &shards, &damagedRanges, &nextShard, &firstResult](size_t)
+    {
+        for (size_t i = nextShard++; i < shards.size(); i = nextShard++)
+        {
+            if (const SettingError_t result = loadSettingsFile(shards[i]->settingsFile, shards[i]->extendedSettingsFile,
+                                                               shards[i]->slotIndex, 1, damagedRanges[i]);
+                result != NO_ERROR)
+            {
+                SettingError_t noError = NO_ERROR;
+                firstResult.compare_exchange_strong(noError, result);
+            }
+        }
+    };
+
+    runInParallel(std::min<size_t>(std::max<uint32_t>(threads, 1), shards.size()), "SettingsLoad", loadShards);
+    for (size_t i = 0; i < shards.size(); i++)
+    {
+        for (SettingsKeyRange_t& range : damagedRanges[i])
+        {
+            range.keyPrefix = shards[i]->keyPrefix;
+            persistence->damagedKeyRanges.push_back(std::move(range));
+        }
+    }
+    return firstResult;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadSettingsFile(SettingsFile*         file,
+                                                                  ExtendedSettingsFile* extendedFile,
+                                                                  SettingsSlotIndex_t&  slotIndex,
+                                                                  const uint32_t        threads,
+                                                                  std::vector<SettingsKeyRange_t>& damagedRanges) const
+{
+    // The slots are only known again once the file is loaded.
+    slotIndex.slots.clear();
+    if (extendedFile != nullptr)
+    {
+        if (extendedFile->openForRead() != SettingsFile::Success)
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+
+        // If the file can be mapped, it is parsed in place. Otherwise, it is read line by line.
+        std::string_view fileData;
+        if (extendedFile->mapForRead(fileData) == SettingsFile::Success)
+        {
+            const SettingError_t result = loadSettingsFromFileData(fileData, threads, &slotIndex, &damagedRanges);
+            if (extendedFile->close() != SettingsFile::Success)
+            {
+                return SETTINGS_FILESYSTEM_ERROR;
+            }
+            return result;
+        }
+        if (extendedFile->close() != SettingsFile::Success)
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+    }
+
+    // The parallel parser needs the whole file, and so do the blocks of a blocked file, so it is read in memory first.
+    bool blocked = false;
+    if (threads <= 1 && validateChecksum(file, blocked) != NO_ERROR)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    if (threads > 1 || blocked)
+    {
+        std::string fileData;
+        if (const SettingError_t result = readSettingsFile(file, fileData); result != NO_ERROR)
+        {
+            return result;
+        }
+        return loadSettingsFromFileData(fileData, threads, &slotIndex, &damagedRanges);
+    }
+
+    SettingsFile::SettingsFileResult res = file->openForRead();
+    if (res != SettingsFile::Success)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // The records are merged into the tree in blocks, so only one block of the file is kept in memory. A compressed
+    // line holds many records, and the last one may continue in the next line.
+    auto                             checksumAlgorithm    = SettingsChecksumAlgorithm_t::CRC32;
+    auto                             compressionAlgorithm = SettingsCompressionAlgorithm_t::NONE;
+    uint32_t                         version              = 0;
+    SettingsDecompressor             decompressor;
+    std::string                      block;
+    std::string                      line;
+    std::vector<SettingLoadRecord_t> records;
+    size_t                           blockRecords = 0;
+    SettingsSlotIndex_t              fileSlotIndex{SettingsChecksumAlgorithm_t::CRC32, {}};
+    std::vector<SettingsKeyRange_t>  fileDamagedRanges;
+    size_t                           lineOffset  = 0;
+    bool                             damagedSlot = false;
+    while (res == SettingsFile::Success)
+    {
+        line.clear();
+        res = file->readLine(line);
+        if (res == SettingsFile::Success && line.starts_with("\rv"))
+        {
+            // Already validated with the checksum.
+            parseFileHeader(line, checksumAlgorithm, compressionAlgorithm, version);
+            fileSlotIndex.checksumAlgorithm = checksumAlgorithm;
+        }
+        else if (res == SettingsFile::Success && !line.empty() && line[0] != '\r')
+        {
+            const size_t blockSize = block.size();
+            if (version == SETTINGS_FILE_SLOTTED_FORMAT_VERSION)
+            {
+                indexSettingSlot(line, static_cast<uint32_t>(lineOffset), checksumAlgorithm, block, fileSlotIndex,
+                                 damagedSlot, fileDamagedRanges);
+            }
+            else if (compressionAlgorithm == SettingsCompressionAlgorithm_t::NONE)
+            {
+                block.append(line);
+            }
+            else if (!decompressor.decompress(line, block))
+            {
+                file->close();
+                return SETTINGS_FILESYSTEM_ERROR;
+            }
+            blockRecords += std::count(block.begin() + static_cast<std::ptrdiff_t>(blockSize), block.end(), '\n');
+        }
+
+        const bool lastBlock = res != SettingsFile::Success && !block.empty();
+        if (blockRecords >= CONFIG_SETTINGS_STORAGE_LOAD_BATCH_SIZE || lastBlock)
+        {
+            const size_t blockEnd = lastBlock ? block.size() : block.rfind('\n') + 1;
+            records.clear();
+            if (parseSettingRecords(std::string_view(block).substr(0, blockEnd), records) != NO_ERROR ||
+                mergeSettingLoadRecords(records, mergeSettingLoadRecordCallback, checkSettingLoadRecordCallback) != 0)
+            {
+                file->close();
+                return SETTINGS_FILESYSTEM_ERROR;
+            }
+            block.erase(0, blockEnd);
+            blockRecords = 0;
+        }
+        lineOffset += line.size();
+    }
+
+    if (res != SettingsFile::EndOfFile)
+    {
+        file->close();
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    res = file->close();
+    if (res != SettingsFile::Success)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    endSettingSlots(fileSlotIndex, damagedSlot, fileDamagedRanges);
+    slotIndex = std::move(fileSlotIndex);
+    if (!fileDamagedRanges.empty())
+    {
+        damagedRanges.insert(damagedRanges.end(), fileDamagedRanges.begin(), fileDamagedRanges.end());
+        return DAMAGED_SETTINGS_ERROR;
+    }
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::readSettingsFile(SettingsFile* file, std::string& fileData)
+{
+    SettingsFile::SettingsFileResult res = file->openForRead();
+    while (res == SettingsFile::Success)
+    {
+        res = file->readLine(fileData);
+    }
+    if (res != SettingsFile::EndOfFile)
+    {
+        file->close();
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return file->close() == SettingsFile::Success ? NO_ERROR : SETTINGS_FILESYSTEM_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::parseFileData(std::string_view             fileData,
+                                                               SettingsChecksumAlgorithm_t& checksumAlgorithm,
+                                                               uint32_t& expectedChecksum, std::string_view& records,
+                                                               std::string&         decompressedRecords,
+                                                               SettingsSlotIndex_t* slotIndex, const uint32_t threads,
+                                                               std::vector<SettingsKeyRange_t>* damagedRanges) const
+{
+    // Files without header line (format version 0) are protected by CRC32.
+    checksumAlgorithm             = SettingsChecksumAlgorithm_t::CRC32;
+    auto         compressionAlgorithm = SettingsCompressionAlgorithm_t::NONE;
+    uint32_t     version              = 0;
+    const size_t fileSize             = fileData.size();
+    if (fileData.starts_with("\rv"))
+    {
+        const size_t headerEnd = fileData.find('\n');
+        if (headerEnd == std::string_view::npos ||
+            parseFileHeader(fileData.substr(0, headerEnd + 1), checksumAlgorithm, compressionAlgorithm, version) !=
+                NO_ERROR)
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+        fileData.remove_prefix(headerEnd + 1);
+    }
+    const size_t recordsOffset = fileSize - fileData.size();
+
+    // The records of the valid blocks are copied without their checksum lines, so they are loaded like the records of
+    // other files. Their checksum is combined from the checksums of the blocks.
+    if (version == SETTINGS_FILE_BLOCKED_FORMAT_VERSION)
+    {
+        parseSettingBlocks(fileData, checksumAlgorithm, threads, expectedChecksum, decompressedRecords, damagedRanges);
+        records = decompressedRecords;
+        return NO_ERROR;
+    }
+
+    // The checksum line (\r<checksum>\n) must be the last line of the file, and it protects every line before it.
+    const size_t checksumStart = fileData.rfind('\r');
+    if (fileData.empty() || fileData.back() != '\n' || checksumStart == std::string_view::npos ||
+        (checksumStart > 0 && fileData[checksumStart - 1] != '\n'))
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    const char* checksumEnd = fileData.data() + fileData.size() - 1;
+    auto [end, error] = std::from_chars(fileData.data() + checksumStart + 1, checksumEnd, expectedChecksum);
+    if (error != std::errc() || end != checksumEnd)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    records = fileData.substr(0, checksumStart);
+    if (version == SETTINGS_FILE_SLOTTED_FORMAT_VERSION)
+    {
+        // The records are copied without their slots, and checksummed again as a whole, so they are loaded like the
+        // records of other files. The last line holds the number of slots instead of the checksum.
+        // A damaged slot may have lost or gained a new line, so the slots are only counted if none is damaged.
+        SettingsSlotIndex_t             fileSlotIndex{checksumAlgorithm, {}};
+        std::vector<SettingsKeyRange_t> slotDamagedRanges;
+        bool                            damagedSlot = false;
+        size_t                          slotsCount  = 0;
+        decompressedRecords.clear();
+        for (size_t lineStart = 0; lineStart < records.size(); slotsCount++)
+        {
+            // The records end with a new line, the checksum line is preceded by one.
+            const size_t lineEnd = records.find('\n', lineStart) + 1;
+            indexSettingSlot(records.substr(lineStart, lineEnd - lineStart),
+                             static_cast<uint32_t>(recordsOffset + lineStart), checksumAlgorithm, decompressedRecords,
+                             fileSlotIndex, damagedSlot, slotDamagedRanges);
+            lineStart = lineEnd;
+        }
+        endSettingSlots(fileSlotIndex, damagedSlot, slotDamagedRanges);
+        if (slotsCount != expectedChecksum && slotDamagedRanges.empty())
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+        records          = decompressedRecords;
+        expectedChecksum = SettingsChecksum::calculate(checksumAlgorithm, records.data(), records.size());
+        if (slotIndex != nullptr)
+        {
+            *slotIndex = std::move(fileSlotIndex);
+        }
+        if (damagedRanges != nullptr)
+        {
+            damagedRanges->insert(damagedRanges->end(), slotDamagedRanges.begin(), slotDamagedRanges.end());
+        }
+        return NO_ERROR;
+    }
+    if (compressionAlgorithm == SettingsCompressionAlgorithm_t::NONE)
+    {
+        return NO_ERROR;
+    }
+
+    // The records are decompressed as a whole, so they can be parsed in place like the records of other files.
+    SettingsDecompressor decompressor;
+    decompressedRecords.clear();
+    while (!records.empty())
+    {
+        const size_t lineEnd = records.find('\n');
+        if (!decompressor.decompress(records.substr(0, lineEnd), decompressedRecords))
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+        records.remove_prefix(lineEnd == std::string_view::npos ? records.size() : lineEnd + 1);
+    }
+    records = decompressedRecords;
+    return NO_ERROR;
+}
+
+void SettingsStorage::parseSettingBlocks(std::string_view data, const SettingsChecksumAlgorithm_t checksumAlgorithm,
+                                         const uint32_t threads, uint32_t& checksum, std::string& records,
+                                         std::vector<SettingsKeyRange_t>* damagedRanges) const
+{
+    // The last line holds the number of blocks. If the file was truncated, the data after the last checksum line is
+    // an unterminated block instead.
+    const size_t dataSize       = data.size();
+    size_t       expectedBlocks = SIZE_MAX;
+    if (!data.empty() && data.back() == '\n')
+    {
+        const size_t lastLineStart = data.size() < 2 ? 0 : data.rfind('\n', data.size() - 2) + 1;
+        const char*  lastLineEnd   = data.data() + data.size() - 1;
+        if (data[lastLineStart] == '\r' && data.size() - lastLineStart > 2 && data[lastLineStart + 1] != 'b')
+        {
+            auto [end, error] = std::from_chars(data.data() + lastLineStart + 1, lastLineEnd, expectedBlocks);
+            if (error == std::errc() && end == lastLineEnd)
+            {
+                data.remove_suffix(data.size() - lastLineStart);
+            }
+            else
+            {
+                expectedBlocks = SIZE_MAX;
+            }
+        }
+    }
+
+    // Each block ends with its checksum line, the only lines that start with \r. A corrupted checksum line joins its
+    // block with the next one, and both are skipped.
+    std::vector<SettingsBlock_t> blocks;
+    while (!data.empty())
+    {
+        size_t checksumStart = data.find('\r');
+        while (checksumStart != std::string_view::npos && checksumStart > 0 && data[checksumStart - 1] != '\n')
+        {
+            checksumStart = data.find('\r', checksumStart + 1);
+        }
+        checksumStart            = std::min(checksumStart, data.size());
+        const size_t checksumEnd = std::min(data.find('\n', checksumStart), data.size() - 1) + 1;
+        blocks.push_back(
+            {data.substr(0, checksumStart), data.substr(checksumStart, checksumEnd - checksumStart), 0, false});
+        data.remove_prefix(checksumEnd);
+    }
+
+    // The blocks are split in contiguous ranges, validated by one thread each.
+    const size_t chunksCount = std::clamp<size_t>(dataSize / CONFIG_SETTINGS_STORAGE_PARALLEL_LOAD_MIN_CHUNK_SIZE, 1,
+                                                  std::max<size_t>(std::min<size_t>(threads, blocks.size()), 1));
+    const auto validateChunk = [checksumAlgorithm, &blocks, chunksCount](const size_t i)
+    {
+        validateSettingBlocks(checksumAlgorithm, blocks.data() + blocks.size() * i / chunksCount,
+                              blocks.data() + blocks.size() * (i + 1) / chunksCount);
+    };
+    runInParallel(chunksCount, "SettingsLoad", validateChunk);
+
+    // The records are stored in key order, so the keys of the skipped blocks are between the last key of the valid
+    // block before them and the first key of the valid block after them.
+    records.clear();
+    records.reserve(dataSize);
+    checksum = 0;
+    std::string_view lastKey;
+    bool             damaged      = false;
+    bool             damagedFound = false;
+    for (const SettingsBlock_t& block : blocks)
+    {
+        if (!block.valid || block.records.empty())
+        {
+            damaged      = damaged || !block.valid;
+            damagedFound = damagedFound || !block.valid;
+            continue;
+        }
+        if (damaged && damagedRanges != nullptr)
+        {
+            damagedRanges->push_back({"", std::string(lastKey), std::string(block.records.substr(
+                                                                    0, block.records.find('\t')))});
+        }
+        damaged = false;
+
+        const size_t lastRecordStart = block.records.rfind('\n', block.records.size() - 2) + 1;
+        lastKey = block.records.substr(lastRecordStart, block.records.find('\t', lastRecordStart) - lastRecordStart);
+        records.append(block.records);
+        checksum = SettingsChecksum::combine(checksumAlgorithm, checksum, block.checksum, block.records.size());
+    }
+    // A missing last line means the file was truncated. Joined blocks count as one, so a different number of blocks
+    // only means that blocks are missing when no block was skipped.
+    if ((damaged || expectedBlocks == SIZE_MAX || (blocks.size() != expectedBlocks && !damagedFound)) &&
+        damagedRanges != nullptr)
+    {
+        damagedRanges->push_back({"", std::string(lastKey), ""});
+    }
+}
+
+void SettingsStorage::validateSettingBlocks(const SettingsChecksumAlgorithm_t checksumAlgorithm,
+                                            SettingsBlock_t* firstBlock, SettingsBlock_t* lastBlock)
+{
+    for (SettingsBlock_t* block = firstBlock; block != lastBlock; ++block)
+    {
+        // Checksum line: \rb<checksum of the records of the block>\n.
+        const std::string_view line             = block->checksumLine;
+        uint32_t               expectedChecksum = 0;
+        block->valid                            = false;
+        if (line.size() < 4 || line[1] != 'b' || line.back() != '\n')
+        {
+            continue;
+        }
+        const char* lineEnd = line.data() + line.size() - 1;
+        auto [end, error]   = std::from_chars(line.data() + 2, lineEnd, expectedChecksum);
+        if (error != std::errc() || end != lineEnd)
+        {
+            continue;
+        }
+        block->checksum = SettingsChecksum::calculate(checksumAlgorithm, block->records.data(), block->records.size());
+        block->valid    = block->checksum == expectedChecksum;
+    }
+}
+
+SettingsStorage::SettingError_t
+SettingsStorage::loadSettingsFromFileData(const std::string_view fileData, const uint32_t threads,
+                                          SettingsSlotIndex_t*             slotIndex,
+                                          std::vector<SettingsKeyRange_t>* damagedRanges) const
+{
+    if (SettingsMappedTree::isMappedTree(fileData))
+    {
+        return loadMappedTree(fileData);
+    }
+
+    SettingsChecksumAlgorithm_t     checksumAlgorithm;
+    uint32_t                        expectedChecksum;
+    std::string_view                records;
+    std::string                     decompressedRecords;
+    SettingsSlotIndex_t             fileSlotIndex{SettingsChecksumAlgorithm_t::CRC32, {}};
+    std::vector<SettingsKeyRange_t> fileDamagedRanges;
+    if (const SettingError_t result = parseFileData(fileData, checksumAlgorithm, expectedChecksum, records,
+                                                    decompressedRecords, &fileSlotIndex, threads, &fileDamagedRanges);
+        result != NO_ERROR)
+    {
+        return result;
+    }
+
+    SettingError_t result = loadSettingRecords(records, threads, checksumAlgorithm, expectedChecksum);
+    if (result == NO_ERROR && slotIndex != nullptr)
+    {
+        *slotIndex = std::move(fileSlotIndex);
+    }
+    if (result == NO_ERROR && !fileDamagedRanges.empty())
+    {
+        result = DAMAGED_SETTINGS_ERROR;
+        if (damagedRanges != nullptr)
+        {
+            damagedRanges->insert(damagedRanges->end(), fileDamagedRanges.begin(), fileDamagedRanges.end());
+        }
+    }
+    return result;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadMappedTree(const std::string_view fileData) const
+{
+    SettingsMappedTree tree;
+    if (!tree.attach(fileData))
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    // Every node is validated before the records are merged, so a corrupted file does not modify the settings.
+    std::vector<SettingLoadRecord_t> records;
+    records.reserve(tree.getCount());
+    if (tree.iterate({}, {}, parseMappedRecordCallback, &records) != 0 ||
+        mergeSettingLoadRecords(records, mergeSettingLoadRecordCallback, checkSettingLoadRecordCallback) != 0)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return NO_ERROR;
+}
+
+int SettingsStorage::parseMappedRecordCallback(void* data, const std::string_view record,
+                                               [[maybe_unused]] const uint32_t id)
+{
+    SettingLoadRecord_t loadRecord{};
+    if (parseSettingRecord(record, loadRecord) != NO_ERROR)
+    {
+        return 1;
+    }
+    static_cast<std::vector<SettingLoadRecord_t>*>(data)->push_back(loadRecord);
+    return 0;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadSettingRecords(
+    const std::string_view records, const uint32_t threads, const SettingsChecksumAlgorithm_t checksumAlgorithm,
+    const uint32_t expectedChecksum) const
+{
+    // Split the records in chunks of whole lines, parsed by one thread each. Every record ends with a new line.
+    const size_t chunksCount =
+        std::clamp<size_t>(records.size() / CONFIG_SETTINGS_STORAGE_PARALLEL_LOAD_MIN_CHUNK_SIZE, 1, threads);
+    std::vector<SettingsLoadChunk_t> chunks(chunksCount);
+    size_t                           chunkStart = 0;
+    for (size_t i = 0; i < chunksCount; i++)
+    {
+        size_t chunkEnd = records.size();
+        if (i + 1 < chunksCount)
+        {
+            chunkEnd = records.find('\n', std::max(chunkStart, records.size() * (i + 1) / chunksCount - 1));
+            chunkEnd = chunkEnd == std::string_view::npos ? records.size() : chunkEnd + 1;
+        }
+        chunks[i].data = records.substr(chunkStart, chunkEnd - chunkStart);
+        chunkStart     = chunkEnd;
+    }
+
+    const auto parseChunk = [checksumAlgorithm, &chunks](const size_t i)
+    { parseSettingsChunk(checksumAlgorithm, &chunks[i]); };
+    runInParallel(chunksCount, "SettingsLoad", parseChunk);
+
+    // The whole file is validated before any setting is modified.
+    uint32_t checksum     = 0;
+    size_t   recordsCount = 0;
+    for (const auto& chunk : chunks)
+    {
+        if (chunk.result != NO_ERROR)
+        {
+            return chunk.result;
+        }
+        checksum = SettingsChecksum::combine(checksumAlgorithm, checksum, chunk.checksum, chunk.data.size());
+        recordsCount += chunk.records.size();
+    }
+    if (checksum != expectedChecksum)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    std::vector<SettingLoadRecord_t>& loadRecords = chunks.front().records;
+    loadRecords.reserve(recordsCount);
+    for (size_t i = 1; i < chunksCount; i++)
+    {
+        loadRecords.insert(loadRecords.end(), chunks[i].records.begin(), chunks[i].records.end());
+    }
+    if (mergeSettingLoadRecords(loadRecords, mergeSettingLoadRecordCallback, checkSettingLoadRecordCallback) != 0)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return NO_ERROR;
+}
+
+void SettingsStorage::parseSettingsChunk(const SettingsChecksumAlgorithm_t checksumAlgorithm,
+                                         SettingsLoadChunk_t*              chunk)
+{
+    chunk->checksum = SettingsChecksum::calculate(checksumAlgorithm, chunk->data.data(), chunk->data.size());
+    chunk->result   = parseSettingRecords(chunk->data, chunk->records);
+}
+
+SettingsStorage::SettingError_t SettingsStorage::parseSettingRecords(std::string_view                  data,
+                                                                     std::vector<SettingLoadRecord_t>& records)
+{
+    while (!data.empty())
+    {
+        const auto* recordEnd = static_cast<const char*>(memchr(data.data(), '\n', data.size()));
+        if (recordEnd == nullptr)
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+        const size_t recordSize = recordEnd - data.data();
+        if (const SettingError_t result = parseSettingRecord(data.substr(0, recordSize), records.emplace_back());
+            result != NO_ERROR)
+        {
+            return result;
+        }
+        data.remove_prefix(recordSize + 1);
+    }
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingValue_t* SettingsStorage::mergeSettingLoadRecordCallback(void*                data,
+                                                                                 SettingLoadRecord_t& record,
+                                                                                 SettingValue_t*      value)
+{
+    // Settings that are not registered yet are loaded as volatile, until their owner registers them. The pool is
+    // locked for the whole merge, see mergeSettingLoadRecords().
+    const auto* settingsStorage = static_cast<const SettingsStorage*>(data);
+    if (value == nullptr)
+    {
+        auto* newValue                  = settingsStorage->newSettingValue(true);
+        newValue->settingPermissions    = SettingPermissions_t::VOLATILE;
+        newValue->settingValueType      = record.valueType;
+        newValue->settingValuePersisted = true;
+        if (record.valueType == STRING)
+        {
+            if (!settingsStorage->assignDefaultSettingString(newValue, record.valueData.string, record.stringLength,
+                                                             true))
+            {
+                settingsStorage->deleteSettingValue(newValue, true);
+                return nullptr;
+            }
+            settingsStorage->shareDefaultSettingString(newValue, true);
+        }
+        else
+        {
+            newValue->settingValueData        = record.valueData;
+            newValue->settingDefaultValueData = record.valueData;
+        }
+        return newValue;
+    }
+
+    if (value->settingValueType != record.valueType)
+    {
+        return nullptr;
+    }
+    if (record.valueType == STRING)
+    {
+        if (!settingsStorage->assignSettingString(value, record.valueData.string, record.stringLength, true))
+        {
+            return nullptr;
+        }
+    }
+    else
+    {
+        value->settingValueData = record.valueData;
+    }
+    value->settingValuePersisted = true;
+    settingsStorage->updateSettingHash(reinterpret_cast<const unsigned char*>(record.key),
+                                       static_cast<uint32_t>(record.keyLength), value);
+    return value;
+}
+
+bool SettingsStorage::checkSettingLoadRecordCallback([[maybe_unused]] void* data, const SettingLoadRecord_t& record,
+                                                     const SettingValue_t* value)
+{
+    return value == nullptr || value->settingValueType == record.valueType;
+}
+
+int SettingsStorage::mergeSettingLoadRecords(std::vector<SettingLoadRecord_t>& records,
+                                             const SettingLoadRecordCallback_t cb,
+                                             const SettingLoadRecordCheck_t    check) const
+{
+    // A tombstone only resets a setting that is in the tree. If they were merged with the other records, the merge
+    // would stop at the first tombstone of a setting that is not in the tree, so they are applied one by one.
+    const auto tombstones = std::partition(records.begin(), records.end(),
+                                           [](const SettingLoadRecord_t& record) { return !record.tombstone; });
+
+    // The values and strings of the records are allocated while the tree is locked, so the pool is locked before it,
+    // once for the whole merge, and an allocation can not time out once some records are merged.
+    if (!lockSettingsValuePool())
+    {
+        return -1;
+    }
+    if (settings->upsertAll(records.data(), tombstones - records.begin(), cb, const_cast<SettingsStorage*>(this),
+                            check) != 0)
+    {
+        unlockSettingsValuePool();
+        return -1;
+    }
+    for (auto tombstone = tombstones; tombstone != records.end(); ++tombstone)
+    {
+        SettingsResetCallbackData_t callbackData = std::make_tuple(this, &*tombstone);
+        if (SettingValue_t* value =
+                settings->upsert(tombstone->key, tombstone->keyLength, resetSettingLoadRecordCallback, &callbackData);
+            value != nullptr)
+        {
+            updateSettingHash(reinterpret_cast<const unsigned char*>(tombstone->key),
+                              static_cast<uint32_t>(tombstone->keyLength), value);
+        }
+    }
+    unlockSettingsValuePool();
+    return 0;
+}
+
+SettingsStorage::SettingValue_t* SettingsStorage::resetSettingLoadRecordCallback(void* data, SettingValue_t* value)
+{
+    // Returning the same value, or nullptr if the setting is not in the tree, leaves the tree as it is.
+    const auto*                callbackData    = static_cast<const SettingsResetCallbackData_t*>(data);
+    const SettingsStorage*     settingsStorage = std::get<0>(*callbackData);
+    const SettingLoadRecord_t* record          = std::get<1>(*callbackData);
+    if (value == nullptr || value->settingValueType != record->valueType)
+    {
+        return value;
+    }
+    if (value->settingValueType == STRING)
+    {
+        settingsStorage->shareDefaultSettingString(value, true);
+    }
+    else
+    {
+        value->settingValueData = value->settingDefaultValueData;
+    }
+    value->settingValuePersisted = false;
+    return value;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::parseSettingRecord(const std::string_view record,
+                                                                    SettingLoadRecord_t&   loadRecord)
+{
+    // Record format: key\ttype\tvalue, or key\t~type for a tombstone.
+    const auto* keyEnd = static_cast<const char*>(memchr(record.data(), '\t', record.size()));
+    if (keyEnd == nullptr || keyEnd == record.data() ||
+        static_cast<size_t>(keyEnd - record.data()) >= MAX_SETTING_KEY_SIZE)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    loadRecord.key       = record.data();
+    loadRecord.keyLength = static_cast<int>(keyEnd - record.data());
+
+    const char* recordEnd = record.data() + record.size();
+    const auto* typeEnd   = static_cast<const char*>(memchr(keyEnd + 1, '\t', recordEnd - keyEnd - 1));
+    uint8_t     type      = 0;
+    loadRecord.tombstone  = typeEnd == nullptr && keyEnd + 1 < recordEnd && keyEnd[1] == SETTING_TOMBSTONE_MARKER;
+    if (loadRecord.tombstone)
+    {
+        keyEnd++;
+        typeEnd = recordEnd;
+    }
+    else if (typeEnd == nullptr || typeEnd + 1 == recordEnd)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    if (auto [end, error] = std::from_chars(keyEnd + 1, typeEnd, type);
+        error != std::errc() || end != typeEnd || type >= static_cast<uint8_t>(MAX_SETTING_VALUE_TYPE_ENUM))
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    loadRecord.valueType    = static_cast<SettingValueType_t>(type);
+    loadRecord.stringLength = 0;
+    if (loadRecord.tombstone)
+    {
+        loadRecord.valueData = {};
+        return NO_ERROR;
+    }
+    std::from_chars_result valueResult{recordEnd, std::errc()};
+    switch (loadRecord.valueType)
+    {
+        case REAL:
+            valueResult = std::from_chars(typeEnd + 1, recordEnd, loadRecord.valueData.real);
+            break;
+        case INTEGER:
+            valueResult = std::from_chars(typeEnd + 1, recordEnd, loadRecord.valueData.integer);
+            break;
+        default:
+            loadRecord.valueData.string = const_cast<char*>(typeEnd + 1);
+            loadRecord.stringLength     = recordEnd - typeEnd - 1;
+            break;
+    }
+    if (valueResult.ec != std::errc() || valueResult.ptr != recordEnd)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadSettingsFromPersistentStorageLazily() const
+{
+    if (lazyImage == nullptr)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    if (!persistenceIdle->wait(CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS))
+    {
+        return TIMEOUT_ERROR;
+    }
+    forgetStoredSettingsFiles();
+    const SettingError_t result = loadSettingsImageLazily();
+    persistenceIdle->signal();
+    return result;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadSettingsImageLazily() const
+{
+    stopLazySettingsLoader();
+    if (!lazyImageMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        return TIMEOUT_ERROR;
+    }
+
+    // The pending records of a previous lazy load are replaced by this file.
+    releaseLazyImage();
+    settingsSlotIndex->slots.clear();
+    persistence->damagedKeyRanges.clear();
+
+    // The mapped file is kept open while its records are pending. Otherwise, the file is copied in memory.
+    std::string_view fileData;
+    if (extendedSettingsFile != nullptr)
+    {
+        if (extendedSettingsFile->openForRead() != SettingsFile::Success)
+        {
+            lazyImageMutex->signal();
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+        lazyImage->fileMapped = extendedSettingsFile->mapForRead(fileData) == SettingsFile::Success;
+        if (!lazyImage->fileMapped && extendedSettingsFile->close() != SettingsFile::Success)
+        {
+            lazyImageMutex->signal();
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+    }
+    SettingError_t result = NO_ERROR;
+    if (!lazyImage->fileMapped)
+    {
+        result   = readSettingsFile(settingsFile, lazyImage->fileData);
+        fileData = lazyImage->fileData;
+    }
+
+    // The records of a mapped tree are searched in the tree, so only its header is read now.
+    const bool mappedTree = result == NO_ERROR && SettingsMappedTree::isMappedTree(fileData);
+    if (mappedTree)
+    {
+        result = attachLazyMappedTree(fileData);
+    }
+
+    SettingsChecksumAlgorithm_t checksumAlgorithm;
+    uint32_t                    expectedChecksum;
+    std::string_view            records;
+    SettingsSlotIndex_t         fileSlotIndex{SettingsChecksumAlgorithm_t::CRC32, {}};
+    if (result == NO_ERROR && !mappedTree)
+    {
+        result = parseFileData(fileData, checksumAlgorithm, expectedChecksum, records, lazyImage->decompressedRecords,
+                               &fileSlotIndex, 1, &persistence->damagedKeyRanges);
+    }
+    if (result == NO_ERROR && !mappedTree &&
+        SettingsChecksum::calculate(checksumAlgorithm, records.data(), records.size()) != expectedChecksum)
+    {
+        result = SETTINGS_FILESYSTEM_ERROR;
+    }
+
+    bool sorted = mappedTree;
+    if (result == NO_ERROR && !mappedTree)
+    {
+        result = indexSettingRecords(records, lazyImage->index, sorted);
+    }
+    if (result == NO_ERROR && !sorted)
+    {
+        // Without order there is no binary search, so the file is loaded as a whole.
+        lazyImage->index.clear();
+        result = loadSettingsFromFileData(fileData, 1, nullptr, nullptr);
+    }
+    if (result == NO_ERROR)
+    {
+        *settingsSlotIndex = std::move(fileSlotIndex);
+    }
+
+    // The records of a compressed file are decompressed in memory, so the file does not need to stay mapped.
+    if (lazyImage->fileMapped && !lazyImage->decompressedRecords.empty())
+    {
+        settingsFile->close();
+        lazyImage->fileMapped = false;
+    }
+
+    if (result == NO_ERROR && !lazyImage->index.empty())
+    {
+        lazyImage->records        = records;
+        lazyImage->pendingRecords = lazyImage->index.size();
+
+        // The records of the settings that belong to a shard are stale, they are loaded from the shard instead.
+        for (SettingLazyRecord_t& lazyRecord : lazyImage->index)
+        {
+            const std::string_view key = getLazyRecordKey(lazyRecord);
+            if (!settingsShards->empty() && findSettingsShard(reinterpret_cast<const unsigned char*>(key.data()),
+                                                              static_cast<uint32_t>(key.size())) != nullptr)
+            {
+                lazyRecord.loaded = true;
+                lazyImage->pendingRecords--;
+            }
+        }
+    }
+    if (result != NO_ERROR || lazyImage->pendingRecords == 0)
+    {
+        releaseLazyImage();
+    }
+    lazyImageMutex->signal();
+
+    // The records of the blocks that were not skipped are pending like the records of any other file.
+    if (result == NO_ERROR && !persistence->damagedKeyRanges.empty())
+    {
+        result = DAMAGED_SETTINGS_ERROR;
+    }
+
+    // The shards are small compared to the settings file, so they are not worth indexing.
+    const SettingError_t shardsResult = loadSettingsShards(1);
+    return result != NO_ERROR ? result : shardsResult;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::attachLazyMappedTree(const std::string_view fileData) const
+{
+    SettingsMappedTree& tree = lazyImage->mappedTree;
+    if (!tree.attach(fileData))
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    lazyImage->mappedRecordsLoaded.assign(tree.getCount(), false);
+    lazyImage->pendingRecords = tree.getCount();
+
+    // The records of the settings that belong to a shard are stale, they are loaded from the shard instead.
+    for (const SettingsShard_t& shard : *settingsShards)
+    {
+        if (tree.iterate(shard.keyPrefix, shard.keyPrefix, skipMappedRecordCallback, lazyImage) != 0)
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+    }
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::indexSettingRecords(const std::string_view            records,
+                                                                     std::vector<SettingLazyRecord_t>& index,
+                                                                     bool&                             sorted)
+{
+    // The offsets of the index are 32 bits wide, bigger files are loaded eagerly.
+    index.clear();
+    sorted = records.size() <= UINT32_MAX;
+
+    // Every record ends with a new line, because the checksum line starts right after one.
+    std::string_view previousKey;
+    size_t           offset = 0;
+    while (offset < records.size() && sorted)
+    {
+        const char*  record    = records.data() + offset;
+        const auto*  recordEnd = static_cast<const char*>(memchr(record, '\n', records.size() - offset));
+        const auto*  keyEnd    = static_cast<const char*>(memchr(record, '\t', recordEnd - record));
+        const size_t keyLength = keyEnd != nullptr ? keyEnd - record : 0;
+        if (keyLength == 0 || keyLength >= MAX_SETTING_KEY_SIZE)
+        {
+            return SETTINGS_FILESYSTEM_ERROR;
+        }
+
+        // The keys must be strictly increasing, a repeated key would hide the records that follow it.
+        const std::string_view key(record, keyLength);
+        sorted      = index.empty() || previousKey < key;
+        previousKey = key;
+        index.push_back({static_cast<uint32_t>(offset), static_cast<uint16_t>(keyLength), false});
+        offset = recordEnd - records.data() + 1;
+    }
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t
+SettingsStorage::loadSettingsFromPersistentStorageStaged(const char* keyPrefix, const SettingPermissions_t permissions,
+                                                         const SettingPermissionsFilterMode_t filterMode) const
+{
+    if (!validatePermissions(permissions))
+    {
+        return INVALID_INPUT_ERROR;
+    }
+    if (lazyImage == nullptr)
+    {
+        return SETTINGS_FILESYSTEM_ERROR;
+    }
+    if (!persistenceIdle->wait(CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS))
+    {
+        return TIMEOUT_ERROR;
+    }
+    forgetStoredSettingsFiles();
+    const SettingError_t result = loadSettingsImageInStages(keyPrefix, permissions, filterMode);
+    persistenceIdle->signal();
+    return result;
+}
+
+SettingsStorage::SettingError_t
+SettingsStorage::loadSettingsImageInStages(const char* keyPrefix, const SettingPermissions_t permissions,
+                                           const SettingPermissionsFilterMode_t filterMode) const
+{
+    // The settings of the blocks that were not skipped are still loaded, and the damage is reported at the end.
+    const SettingError_t loadResult = loadSettingsImageLazily();
+    if (loadResult != NO_ERROR && loadResult != DAMAGED_SETTINGS_ERROR)
+    {
+        return loadResult;
+    }
+    SettingError_t result = NO_ERROR;
+
+    // Only registered settings have permissions, the pending records are loaded as volatile.
+    SettingsKeysList_t         priorityKeys;
+    SettingsListCallbackData_t callbackData = std::make_tuple(permissions, filterMode, &priorityKeys);
+    result = static_cast<SettingError_t>(settings->iterateOverAll(listSettingsKeysCallback, &callbackData));
+    if (result == NO_ERROR)
+    {
+        result = loadLazySettings(priorityKeys, SETTINGS_STORAGE_MUTEX_TIMEOUT_MS);
+    }
+    if (result == NO_ERROR && keyPrefix != nullptr)
+    {
+        result = loadLazySettings(std::string_view(keyPrefix, strnlen(keyPrefix, MAX_SETTING_KEY_SIZE)), false,
+                                  SETTINGS_STORAGE_MUTEX_TIMEOUT_MS);
+    }
+    if (result != NO_ERROR)
+    {
+        return result;
+    }
+
+    // Without a task, the pending records are loaded on demand, by the lookups and waitForSettings().
+    if (lazyImage->pendingRecords > 0)
+    {
+        lazyImage->loader =
+            createTask(loadLazySettingsInBackgroundTask, const_cast<SettingsStorage*>(this), "SettingsLoad");
+    }
+    return loadResult;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::waitForSettings(const char* keyPrefix, const uint32_t timeoutMs) const
+{
+    if (keyPrefix == nullptr)
+    {
+        return INVALID_INPUT_ERROR;
+    }
+    return loadLazySettings(std::string_view(keyPrefix, strnlen(keyPrefix, MAX_SETTING_KEY_SIZE)), false, timeoutMs);
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadLazySettings(const std::string_view keyPrefix,
+                                                                  const bool wholeKey, const uint32_t timeoutMs) const
+{
+    // Fast path: nothing is pending once every record of the image is in the tree.
+    if (lazyImage == nullptr || lazyImage->pendingRecords == 0)
+    {
+        return NO_ERROR;
+    }
+    if (!lazyImageMutex->wait(timeoutMs))
+    {
+        return TIMEOUT_ERROR;
+    }
+
+    std::vector<SettingLoadRecord_t> batch;
+    if (lazyImage->mappedTree.isAttached())
+    {
+        SettingsMappedLoadCallbackData_t callbackData = std::make_tuple(this, &batch, nullptr, SIZE_MAX);
+        std::string_view                 record;
+        uint32_t                         id = 0;
+        if (!wholeKey)
+        {
+            loadMappedRecords(keyPrefix, keyPrefix, callbackData);
+        }
+        else if (lazyImage->mappedTree.search(keyPrefix, record, id))
+        {
+            loadMappedRecordCallback(&callbackData, record, id);
+        }
+    }
+    else
+    {
+        // The records are sorted by key, so the ones that match are contiguous.
+        auto lazyRecord = std::lower_bound(lazyImage->index.begin(), lazyImage->index.end(), keyPrefix,
+                                           [this](const SettingLazyRecord_t& indexRecord, std::string_view searchedKey)
+                                           { return getLazyRecordKey(indexRecord) < searchedKey; });
+        for (; lazyRecord != lazyImage->index.end() && lazyImage->pendingRecords > 0; ++lazyRecord)
+        {
+            const std::string_view key = getLazyRecordKey(*lazyRecord);
+            if (wholeKey ? key != keyPrefix : !key.starts_with(keyPrefix))
+            {
+                break;
+            }
+            if (!lazyRecord->loaded)
+            {
+                loadLazyRecord(*lazyRecord, batch);
+            }
+        }
+    }
+    const SettingError_t result = flushLazyRecords(batch);
+
+    if (lazyImage->pendingRecords == 0)
+    {
+        releaseLazyImage();
+    }
+    lazyImageMutex->signal();
+    return result;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::loadLazySettings(const SettingsKeysList_t& keys,
+                                                                  const uint32_t            timeoutMs) const
+{
+    if (lazyImage == nullptr || lazyImage->pendingRecords == 0)
+    {
+        return NO_ERROR;
+    }
+    if (!lazyImageMutex->wait(timeoutMs))
+    {
+        return TIMEOUT_ERROR;
+    }
+
+    // The keys are listed in order, so each key is searched after the record of the previous one.
+    std::vector<SettingLoadRecord_t> batch;
+    SettingsMappedLoadCallbackData_t callbackData = std::make_tuple(this, &batch, nullptr, SIZE_MAX);
+    auto                             lazyRecord   = lazyImage->index.begin();
+    for (auto key = keys.begin(); key != keys.end() && lazyImage->pendingRecords > 0; ++key)
+    {
+        std::string_view record;
+        uint32_t         id = 0;
+        if (lazyImage->mappedTree.isAttached())
+        {
+            if (lazyImage->mappedTree.search(*key, record, id))
+            {
+                loadMappedRecordCallback(&callbackData, record, id);
+            }
+            continue;
+        }
+
+        lazyRecord = std::lower_bound(lazyRecord, lazyImage->index.end(), *key,
+                                      [this](const SettingLazyRecord_t& indexRecord, std::string_view searchedKey)
+                                      { return getLazyRecordKey(indexRecord) < searchedKey; });
+        if (lazyRecord == lazyImage->index.end())
+        {
+            break;
+        }
+        if (!lazyRecord->loaded && getLazyRecordKey(*lazyRecord) == *key)
+        {
+            loadLazyRecord(*lazyRecord, batch);
+        }
+    }
+    const SettingError_t result = flushLazyRecords(batch);
+
+    if (lazyImage->pendingRecords == 0)
+    {
+        releaseLazyImage();
+    }
+    lazyImageMutex->signal();
+    return result;
+}
+
+std::string_view SettingsStorage::getLazyRecordKey(const SettingLazyRecord_t& lazyRecord) const
+{
+    return lazyImage->records.substr(lazyRecord.offset, lazyRecord.keyLength);
+}
+
+void SettingsStorage::loadLazyRecord(SettingLazyRecord_t&              lazyRecord,
+                                     std::vector<SettingLoadRecord_t>& batch) const
+{
+    const std::string_view records   = lazyImage->records.substr(lazyRecord.offset);
+    const auto*            recordEnd = static_cast<const char*>(memchr(records.data(), '\n', records.size()));
+    lazyRecord.loaded                = true;
+    loadPendingRecord(records.substr(0, recordEnd - records.data()), batch);
+}
+
+void SettingsStorage::loadPendingRecord(const std::string_view            record,
+                                        std::vector<SettingLoadRecord_t>& batch) const
+{
+    // The record was validated with its file or node, so a record that can not be parsed is discarded on its own.
+    SettingLoadRecord_t loadRecord{};
+    if (parseSettingRecord(record, loadRecord) == NO_ERROR)
+    {
+        batch.push_back(loadRecord);
+    }
+    lazyImage->pendingRecords--;
+
+    // A full batch that can not be merged stays pending, the flush at the end of the load reports it.
+    if (batch.size() >= CONFIG_SETTINGS_STORAGE_LOAD_BATCH_SIZE)
+    {
+        flushLazyRecords(batch);
+    }
+}
+
+int SettingsStorage::loadMappedRecords(const std::string_view firstKey, const std::string_view keyPrefix,
+                                       SettingsMappedLoadCallbackData_t& callbackData) const
+{
+    // A corrupted node hides the records below it, so the records that are still pending are discarded.
+    const int result = lazyImage->mappedTree.iterate(firstKey, keyPrefix, loadMappedRecordCallback, &callbackData);
+    if (result < 0)
+    {
+        lazyImage->pendingRecords = lazyImage->unmergedRecords.size();
+    }
+    return result;
+}
+
+int SettingsStorage::loadMappedRecordCallback(void* data, const std::string_view record, const uint32_t id)
+{
+    auto*                  callbackData = static_cast<SettingsMappedLoadCallbackData_t*>(data);
+    const SettingsStorage* storage      = std::get<0>(*callbackData);
+    SettingsLazyImage_t*   image        = storage->lazyImage;
+    if (!image->mappedRecordsLoaded[id])
+    {
+        image->mappedRecordsLoaded[id] = true;
+        storage->loadPendingRecord(record, *std::get<1>(*callbackData));
+    }
+
+    // The background loader stops after each batch, and resumes after the key of the last record.
+    if (std::string* lastKey = std::get<2>(*callbackData); lastKey != nullptr)
+    {
+        lastKey->assign(record.substr(0, record.find('\t')));
+    }
+    return image->pendingRecords == 0 || --std::get<3>(*callbackData) == 0 ? 1 : 0;
+}
+
+int SettingsStorage::skipMappedRecordCallback(void* data, [[maybe_unused]] const std::string_view record,
+                                              const uint32_t id)
+{
+    auto* image = static_cast<SettingsLazyImage_t*>(data);
+    if (!image->mappedRecordsLoaded[id])
+    {
+        image->mappedRecordsLoaded[id] = true;
+        image->pendingRecords--;
+    }
+    return 0;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::flushLazyRecords(std::vector<SettingLoadRecord_t>& batch) const
+{
+    // The records of a merge that failed are merged again with the next batch.
+    std::vector<SettingLoadRecord_t>& unmergedRecords = lazyImage->unmergedRecords;
+    if (!unmergedRecords.empty())
+    {
+        batch.insert(batch.begin(), unmergedRecords.begin(), unmergedRecords.end());
+        lazyImage->pendingRecords -= unmergedRecords.size();
+        unmergedRecords.clear();
+    }
+
+    // The records point to the image, so they must be flushed before it is released. If the tree can not be locked,
+    // they stay pending and the image is kept, otherwise the next store would write the values they replace.
+    SettingError_t result = NO_ERROR;
+    if (!batch.empty() && mergeSettingLoadRecords(batch, mergeLazyRecordCallback, nullptr) != 0)
+    {
+        lazyImage->pendingRecords += batch.size();
+        unmergedRecords.swap(batch);
+        result = TIMEOUT_ERROR;
+    }
+    batch.clear();
+    return result;
+}
+
+SettingsStorage::SettingValue_t* SettingsStorage::mergeLazyRecordCallback(void* data, SettingLoadRecord_t& record,
+                                                                          SettingValue_t* value)
+{
+    // A record that does not match the type of the registered setting is discarded, the rest of the batch goes on.
+    if (value != nullptr && value->settingValueType != record.valueType)
+    {
+        return value;
+    }
+    return mergeSettingLoadRecordCallback(data, record, value);
+}
+
+void SettingsStorage::loadLazySettingsInBackground() const
+{
+    // The records are loaded in batches, so the lookups of other pending settings do not wait for all of them.
+    std::vector<SettingLoadRecord_t> batch;
+    size_t                           nextRecord = 0;
+    std::string                      lastKey;
+    bool                             loaded = false;
+    while (!loaded && !lazyImage->stopLoader)
+    {
+        if (!lazyImageMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+        {
+            continue;
+        }
+        if (lazyImage->mappedTree.isAttached())
+        {
+            // The smallest key after the last one is the last one followed by a NUL character. Once the iteration
+            // reaches the end of the tree, every record was loaded.
+            const std::string firstKey = lastKey.empty() ? std::string() : lastKey + '\0';
+            SettingsMappedLoadCallbackData_t callbackData =
+                std::make_tuple(this, &batch, &lastKey, static_cast<size_t>(CONFIG_SETTINGS_STORAGE_LOAD_BATCH_SIZE));
+            if (loadMappedRecords(firstKey, {}, callbackData) == 0)
+            {
+                lazyImage->pendingRecords = lazyImage->unmergedRecords.size();
+            }
+        }
+        else
+        {
+            const size_t lastRecord =
+                std::min(nextRecord + CONFIG_SETTINGS_STORAGE_LOAD_BATCH_SIZE, lazyImage->index.size());
+            for (; nextRecord < lastRecord; nextRecord++)
+            {
+                if (!lazyImage->index[nextRecord].loaded)
+                {
+                    loadLazyRecord(lazyImage->index[nextRecord], batch);
+                }
+            }
+        }
+
+        // A batch that can not be merged stays pending, so the loader tries it again until it is merged.
+        flushLazyRecords(batch);
+        loaded = lazyImage->pendingRecords == 0;
+        if (loaded)
+        {
+            releaseLazyImage();
+        }
+        lazyImageMutex->signal();
+    }
+}
+
+void SettingsStorage::loadLazySettingsInBackgroundTask(void* data)
+{
+    static_cast<const SettingsStorage*>(data)->loadLazySettingsInBackground();
+}
+
+void SettingsStorage::stopLazySettingsLoader() const
+{
+    if (lazyImage->loader != nullptr)
+    {
+        lazyImage->stopLoader = true;
+        lazyImage->loader->join();
+        delete lazyImage->loader;
+        lazyImage->loader     = nullptr;
+        lazyImage->stopLoader = false;
+    }
+}
+
+void SettingsStorage::releaseLazyImage() const
+{
+    if (lazyImage->fileMapped)
+    {
+        settingsFile->close();
+    }
+    lazyImage->mappedTree.detach();
+    std::vector<bool>().swap(lazyImage->mappedRecordsLoaded);
+    lazyImage->fileMapped     = false;
+    lazyImage->records        = {};
+    lazyImage->pendingRecords = 0;
+    std::vector<SettingLazyRecord_t>().swap(lazyImage->index);
+    std::vector<SettingLoadRecord_t>().swap(lazyImage->unmergedRecords);
+    std::string().swap(lazyImage->fileData);
+    std::string().swap(lazyImage->decompressedRecords);
+}
+
+SettingsStorage::SettingError_t SettingsStorage::discardLazySettings() const
+{
+    if (lazyImage == nullptr)
+    {
+        return NO_ERROR;
+    }
+    stopLazySettingsLoader();
+    if (lazyImage->pendingRecords > 0)
+    {
+        if (!lazyImageMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+        {
+            return TIMEOUT_ERROR;
+        }
+        releaseLazyImage();
+        lazyImageMutex->signal();
+    }
+    return NO_ERROR;
+}
+
+constexpr uint32_t SETTINGS_IMAGE_MAGIC = 0x47495353; // "SSIG" in little endian, so the byte order is checked too.
+
+SettingsStorage::SettingError_t SettingsStorage::exportToBuffer(std::vector<std::byte>& outputBuffer) const
+{
+    // The pending records are part of the settings.
+    if (const SettingError_t result = loadLazySettings({}, false, SETTINGS_STORAGE_MUTEX_TIMEOUT_MS);
+        result != NO_ERROR)
+    {
+        return result;
+    }
+
+    // The entries are written after the header as the tree is iterated, and the strings are appended at the end.
+    std::string strings;
+    outputBuffer.clear();
+    outputBuffer.reserve(sizeof(SettingsImageHeader_t) + settings->size() * sizeof(SettingImageEntry_t));
+    outputBuffer.resize(sizeof(SettingsImageHeader_t));
+    SettingsExportCallbackData_t callbackData(&outputBuffer, &strings);
+    if (settings->iterateOverAll(exportSettingCallback, &callbackData) != 0 ||
+        strings.size() > std::numeric_limits<uint32_t>::max())
+    {
+        outputBuffer.clear();
+        return FATAL_ERROR;
+    }
+
+    const size_t entriesSize = outputBuffer.size() - sizeof(SettingsImageHeader_t);
+    outputBuffer.resize(outputBuffer.size() + strings.size());
+    memcpy(outputBuffer.data() + sizeof(SettingsImageHeader_t) + entriesSize, strings.data(), strings.size());
+
+    SettingsImageHeader_t header;
+    header.magic         = SETTINGS_IMAGE_MAGIC;
+    header.version       = SETTINGS_IMAGE_FORMAT_VERSION;
+    header.settingsCount = static_cast<uint32_t>(entriesSize / sizeof(SettingImageEntry_t));
+    header.stringsSize   = static_cast<uint32_t>(strings.size());
+    header.checksum      = SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32C,
+                                                       outputBuffer.data() + sizeof(SettingsImageHeader_t),
+                                                       outputBuffer.size() - sizeof(SettingsImageHeader_t));
+    header.entrySize     = sizeof(SettingImageEntry_t);
+    memcpy(outputBuffer.data(), &header, sizeof(header));
+    return NO_ERROR;
+}
+
+int SettingsStorage::exportSettingCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    auto*       callbackData = static_cast<SettingsExportCallbackData_t*>(data);
+    auto*       outputBuffer = std::get<0>(*callbackData);
+    auto*       strings      = std::get<1>(*callbackData);
+    const auto* settingValue = static_cast<SettingValue_t*>(value);
+
+    if (strings->size() > std::numeric_limits<uint32_t>::max() || key_len >= MAX_SETTING_KEY_SIZE)
+    {
+        return 1;
+    }
+
+    SettingImageEntry_t entry;
+    entry.keyOffset   = static_cast<uint32_t>(strings->size());
+    entry.keyLength   = static_cast<uint8_t>(key_len);
+    entry.durability  = static_cast<uint8_t>(settingValue->settingDurability);
+    entry.valueType   = static_cast<uint8_t>(settingValue->settingValueType);
+    entry.permissions = settingValue->settingPermissions;
+    strings->append(reinterpret_cast<const char*>(key), key_len);
+    if (settingValue->settingValueType == STRING)
+    {
+        const size_t valueLength        = settingValue->settingString.length;
+        const size_t defaultValueLength = settingValue->settingString.defaultLength;
+        entry.value.string.offset       = static_cast<uint32_t>(strings->size());
+        entry.value.string.length       = static_cast<uint32_t>(valueLength);
+        strings->append(settingValue->settingValueData.string, valueLength);
+        entry.defaultValue.string.offset = static_cast<uint32_t>(strings->size());
+        entry.defaultValue.string.length = static_cast<uint32_t>(defaultValueLength);
+        strings->append(settingValue->settingDefaultValueData.string, defaultValueLength);
+    }
+    else
+    {
+        static_assert(sizeof(SettingImageValue_t) == sizeof(SettingValueData_t));
+        memcpy(&entry.value, &settingValue->settingValueData, sizeof(entry.value));
+        memcpy(&entry.defaultValue, &settingValue->settingDefaultValueData, sizeof(entry.defaultValue));
+    }
+
+    const size_t entryPosition = outputBuffer->size();
+    outputBuffer->resize(entryPosition + sizeof(entry));
+    memcpy(outputBuffer->data() + entryPosition, &entry, sizeof(entry));
+    return 0;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::importFromBuffer(const std::span<const std::byte> inputBuffer) const
+{
+    SettingsImageHeader_t header;
+    if (inputBuffer.size() < sizeof(header))
+    {
+        return INVALID_INPUT_ERROR;
+    }
+    memcpy(&header, inputBuffer.data(), sizeof(header));
+    const std::span<const std::byte> body = inputBuffer.subspan(sizeof(header));
+    if (header.magic != SETTINGS_IMAGE_MAGIC || header.version != SETTINGS_IMAGE_FORMAT_VERSION ||
+        header.entrySize != sizeof(SettingImageEntry_t) ||
+        body.size() != static_cast<uint64_t>(header.settingsCount) * sizeof(SettingImageEntry_t) + header.stringsSize ||
+        header.checksum != SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32C, body.data(), body.size()))
+    {
+        return INVALID_INPUT_ERROR;
+    }
+
+    // Every entry is validated before the tree is modified, so a corrupted image does not restore any setting.
+    const size_t entriesSize   = header.settingsCount * sizeof(SettingImageEntry_t);
+    const auto*  strings       = reinterpret_cast<const char*>(body.data()) + entriesSize;
+    const auto   isStringValid = [&header](const uint32_t offset, const uint32_t length)
+    { return offset <= header.stringsSize && length <= header.stringsSize - offset; };
+    std::vector<SettingImportRecord_t> records(header.settingsCount);
+    for (uint32_t i = 0; i < header.settingsCount; i++)
+    {
+        SettingImportRecord_t& record = records[i];
+        memcpy(&record.entry, body.data() + i * sizeof(SettingImageEntry_t), sizeof(SettingImageEntry_t));
+        const SettingImageEntry_t& entry = record.entry;
+        if (entry.keyLength == 0 || entry.keyLength >= MAX_SETTING_KEY_SIZE ||
+            !isStringValid(entry.keyOffset, entry.keyLength) || entry.valueType >= MAX_SETTING_VALUE_TYPE_ENUM ||
+            entry.durability >= static_cast<uint8_t>(SettingsDurability_t::MAX_SETTINGS_DURABILITY) ||
+            !validatePermissions(entry.permissions) ||
+            (entry.valueType == STRING && (!isStringValid(entry.value.string.offset, entry.value.string.length) ||
+                                           !isStringValid(entry.defaultValue.string.offset,
+                                                          entry.defaultValue.string.length))))
+        {
+            return INVALID_INPUT_ERROR;
+        }
+        record.key       = strings + entry.keyOffset;
+        record.keyLength = entry.keyLength;
+    }
+
+    // The pending records of a previous lazy load are replaced by this image.
+    if (const SettingError_t result = discardLazySettings(); result != NO_ERROR)
+    {
+        return result;
+    }
+    // The values and strings are allocated while the tree is locked, so the pool is locked before it.
+    if (!lockSettingsValuePool())
+    {
+        return TIMEOUT_ERROR;
+    }
+    SettingsImportCallbackData_t callbackData = std::make_tuple(this, strings);
+    const int                    upsertResult =
+        settings->upsertAll(records.data(), records.size(), importSettingCallback, &callbackData);
+    unlockSettingsValuePool();
+    if (upsertResult != 0)
+    {
+        return FATAL_ERROR;
+    }
+    for (const SettingImportRecord_t& record : records)
+    {
+        if (record.entry.durability != static_cast<uint8_t>(SettingsDurability_t::NONE))
+        {
+            SettingsShard_t* shard = findSettingsShard(reinterpret_cast<const unsigned char*>(record.key),
+                                                       static_cast<uint32_t>(record.keyLength));
+            raiseDurability(shard == nullptr ? settingsFileDirtyDurability : shard->dirtyDurability,
+                            static_cast<SettingsDurability_t>(record.entry.durability));
+        }
+    }
+    for (SettingsShard_t& shard : *settingsShards)
+    {
+        shard.dirty = true;
+    }
+    settingsFileDirty = true;
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingValue_t* SettingsStorage::importSettingCallback(void* data, SettingImportRecord_t& record,
+                                                                        SettingValue_t* value)
+{
+    const auto*                callbackData    = static_cast<SettingsImportCallbackData_t*>(data);
+    const SettingsStorage*     settingsStorage = std::get<0>(*callbackData);
+    const char*                strings         = std::get<1>(*callbackData);
+    const SettingImageEntry_t& entry           = record.entry;
+
+    // The setting is replaced in place, so the pointers to it stay valid. The pool is locked for the whole import.
+    if (value == nullptr)
+    {
+        value = settingsStorage->newSettingValue(true);
+    }
+    else if (value->settingValueType == STRING)
+    {
+        // The value may share the default value, so it is only kept if it has a buffer of its own to reuse.
+        settingsStorage->releaseDefaultSettingString(value, true);
+        if (entry.valueType != STRING || value->settingString.capacity == 0)
+        {
+            settingsStorage->releaseSettingString(value, true);
+        }
+    }
+    value->settingValueType   = static_cast<SettingValueType_t>(entry.valueType);
+    value->settingPermissions = entry.permissions;
+    value->settingDurability  = static_cast<SettingsDurability_t>(entry.durability);
+    if (value->settingValueType == STRING)
+    {
+        const std::string_view string(strings + entry.value.string.offset, entry.value.string.length);
+        const std::string_view defaultString(strings + entry.defaultValue.string.offset,
+                                             entry.defaultValue.string.length);
+        bool allocated =
+            settingsStorage->assignDefaultSettingString(value, defaultString.data(), defaultString.size(), true);
+        if (allocated && string == defaultString)
+        {
+            settingsStorage->shareDefaultSettingString(value, true);
+        }
+        else if (allocated)
+        {
+            allocated = settingsStorage->assignSettingString(value, string.data(), string.size(), true);
+        }
+        if (!allocated)
+        {
+            return nullptr;
+        }
+    }
+    else
+    {
+        memcpy(&value->settingValueData, &entry.value, sizeof(value->settingValueData));
+        memcpy(&value->settingDefaultValueData, &entry.defaultValue, sizeof(value->settingDefaultValueData));
+    }
+    settingsStorage->updateSettingHash(reinterpret_cast<const unsigned char*>(record.key),
+                                       static_cast<uint32_t>(record.keyLength), value);
+    return value;
+}
+
+int SettingsStorage::listSettingsKeysCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    auto*                          callbackData = static_cast<SettingsListCallbackData_t*>(data);
+    SettingPermissions_t           permissions  = std::get<0>(*callbackData);
+    SettingPermissionsFilterMode_t filterMode   = std::get<1>(*callbackData);
+    SettingsKeysList_t*            outputKeys   = std::get<2>(*callbackData);
+    auto*                          settingValue = static_cast<SettingValue_t*>(value);
+
+    switch (filterMode)
+    {
+        case MatchSettingsWithAnyPermissionsListed:
+        {
+            if (static_cast<uint32_t>(settingValue->settingPermissions & permissions) >
+                0) // If a bit is set in both, the result is greater than 0.
+            {
+                outputKeys->emplace_back(reinterpret_cast<const char*>(key), key_len);
+            }
+            return NO_ERROR;
+        }
+
+        case MatchSettingsWithAllPermissionsListed:
+        {
+            if (settingValue->settingPermissions == permissions)
             {
                 outputKeys->emplace_back(reinterpret_cast<const char*>(key), key_len);
             }
@@ -448,125 +3546,519 @@ int SettingsStorage::listSettingsKeysCallback(void* data, const unsigned char* k
             }
             return NO_ERROR;
         }
-
-        case ExcludeSettingsWithAnyPermissionsListed:
+
+        case ExcludeSettingsWithAnyPermissionsListed:
+        {
+            if (static_cast<uint32_t>(settingValue->settingPermissions & permissions) == 0)
+            {
+                outputKeys->emplace_back(reinterpret_cast<const char*>(key), key_len);
+            }
+            return NO_ERROR;
+        }
+        default:
+            return INVALID_INPUT_ERROR;
+    }
+}
+
+int SettingsStorage::freeSettingValuesCallback(void* data, [[maybe_unused]] const unsigned char* key,
+                                               [[maybe_unused]] uint32_t key_len, void* value)
+{
+    auto* settingValue = static_cast<SettingValue_t*>(value);
+    static_cast<const SettingsStorage*>(data)->freeSettingValue(settingValue);
+
+    return NO_ERROR;
+}
+
+int SettingsStorage::storeSettingsInPersistentStorageCallback(void* data, const unsigned char* key, uint32_t key_len,
+                                                              void* value)
+{
+    auto* callbackData = static_cast<SettingsStoreCallbackData_t*>(data);
+    auto* settingValue = static_cast<SettingValue_t*>(value);
+
+    // The settings of a shard are only stored in its file, and a shard does not store those of its nested shards.
+    if (std::get<2>(*callbackData)->findSettingsShard(key, key_len) != std::get<3>(*callbackData))
+    {
+        return SettingsFile::Success;
+    }
+
+    bool tombstone = false;
+    if (!std::get<2>(*callbackData)->selectSettingRecord(settingValue, std::get<1>(*callbackData), tombstone))
+    {
+        return SettingsFile::Success;
+    }
+    SettingsRecordCacheUpdate_t* recordCache = std::get<4>(*callbackData);
+    return serializeSettingRecord(std::get<0>(*callbackData), key, key_len, settingValue, tombstone,
+                                  nextSettingRecordText(recordCache, settingValue, tombstone));
+}
+
+bool SettingsStorage::selectSettingRecord(SettingValue_t* settingValue, const SettingsStoreMode_t mode,
+                                          bool& tombstone) const
+{
+    // The last file is only known to have the record once it is written, so settingValuePersisted is updated by
+    // commitSettingRecords(). A store that fails leaves it as it is, and the next store writes the same tombstones.
+    tombstone = false;
+    bool selected;
+    if (static_cast<bool>(settingValue->settingPermissions & SettingPermissions_t::VOLATILE))
+    {
+        // If the setting is volatile, it should not be stored in the persistent storage.
+        settingValue->settingValueRecorded = settingValue->settingValuePersisted;
+        selected                           = false;
+    }
+    else if (mode == StoreModifiedSettings && isDefaultSettingValue(settingValue))
+    {
+        // A setting that keeps its default value is only stored to reset the value stored in the last file.
+        tombstone                          = settingValue->settingValuePersisted;
+        settingValue->settingValueRecorded = false;
+        selected                           = tombstone;
+    }
+    else
+    {
+        settingValue->settingValueRecorded = true;
+        selected                           = true;
+    }
+    if (settingValue->settingValueRecorded != settingValue->settingValuePersisted)
+    {
+        persistence->persistedChanges++;
+    }
+    return selected;
+}
+
+bool SettingsStorage::isDefaultSettingValue(const SettingValue_t* settingValue)
+{
+    switch (settingValue->settingValueType)
+    {
+        case REAL:
+            return settingValue->settingValueData.real == settingValue->settingDefaultValueData.real;
+        case INTEGER:
+            return settingValue->settingValueData.integer == settingValue->settingDefaultValueData.integer;
+        default:
+            // The values that were never modified share the buffer of their default value.
+            return settingValue->settingValueData.string == settingValue->settingDefaultValueData.string ||
+                   strcmp(settingValue->settingValueData.string, settingValue->settingDefaultValueData.string) == 0;
+    }
+}
+
+void SettingsStorage::commitSettingRecords(const SettingsShard_t* shard, const bool written,
+                                           uint64_t& persistedChanges) const
+{
+    // The settings of the file are only visited if its records changed. The file is already written, so an iteration
+    // that times out is retried.
+    if (written && persistedChanges != 0)
+    {
+        SettingsCommitCallbackData_t callbackData = std::make_tuple(this, shard);
+        while ((shard == nullptr ? settings->iterateOverAll(commitSettingRecordCallback, &callbackData)
+                                 : settings->iterateOverPrefix(shard->keyPrefix.c_str(),
+                                                               static_cast<int>(shard->keyPrefix.size()),
+                                                               commitSettingRecordCallback, &callbackData)) != 0)
+        {
+        }
+    }
+    persistedChanges = 0;
+}
+
+int SettingsStorage::commitSettingRecordCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    const auto* callbackData = static_cast<const SettingsCommitCallbackData_t*>(data);
+    auto*       settingValue = static_cast<SettingValue_t*>(value);
+    if (std::get<0>(*callbackData)->findSettingsShard(key, key_len) == std::get<1>(*callbackData))
+    {
+        settingValue->settingValuePersisted = settingValue->settingValueRecorded;
+    }
+    return 0;
+}
+
+SettingsFile::SettingsFileResult SettingsStorage::serializeSettingRecord(SettingsSerializer*   serializer,
+                                                                         const unsigned char*  key, uint32_t key_len,
+                                                                         const SettingValue_t* settingValue,
+                                                                         const bool            tombstone,
+                                                                         SettingRecordText_t*  recordText)
+{
+    // Record format: key\ttype\tvalue\n, or key\t~type\n for a tombstone.
+    SettingsFile::SettingsFileResult res =
+        serializer->append(std::string_view(reinterpret_cast<const char*>(key), key_len));
+    if (res == SettingsFile::Success && hasSettingRecordText(settingValue, tombstone))
+    {
+        SettingRecordText_t    uncachedText{};
+        const std::string_view text =
+            formatSettingRecordText(settingValue, recordText != nullptr ? *recordText : uncachedText);
+        return text.empty() ? SettingsFile::InvalidState : serializer->append(text);
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = serializer->append('\t');
+    }
+    if (res == SettingsFile::Success && tombstone)
+    {
+        res = serializer->append(SETTING_TOMBSTONE_MARKER);
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = serializer->append(static_cast<int64_t>(settingValue->settingValueType));
+    }
+    if (res == SettingsFile::Success)
+    {
+        res = serializer->append(tombstone ? '\n' : '\t');
+    }
+    if (res != SettingsFile::Success || tombstone)
+    {
+        return res;
+    }
+
+    if (settingValue->settingValueType != STRING)
+    {
+        return SettingsFile::InvalidState;
+    }
+    res = serializer->append(
+        std::string_view(settingValue->settingValueData.string, settingValue->settingString.length));
+    if (res != SettingsFile::Success)
+    {
+        return res;
+    }
+    return serializer->append('\n');
+}
+
+bool SettingsStorage::hasSettingRecordText(const SettingValue_t* settingValue, const bool tombstone)
+{
+    return !tombstone && (settingValue->settingValueType == REAL || settingValue->settingValueType == INTEGER);
+}
+
+SettingsStorage::SettingRecordText_t* SettingsStorage::nextSettingRecordText(SettingsRecordCacheUpdate_t* recordCache,
+                                                                             const SettingValue_t* settingValue,
+                                                                             const bool            tombstone)
+{
+    if (!hasSettingRecordText(settingValue, tombstone))
+    {
+        return nullptr;
+    }
+    if (recordCache->count == recordCache->records->size())
+    {
+        recordCache->records->emplace_back();
+    }
+    return &(*recordCache->records)[recordCache->count++];
+}
+
+std::string_view SettingsStorage::formatSettingRecordText(const SettingValue_t* settingValue,
+                                                          SettingRecordText_t&  recordText)
+{
+    // Most values do not change between two stores, so a record is only formatted again once its value changes. The
+    // type is part of the record, so the same bits of another type are formatted again.
+    const char type = static_cast<char>('0' + settingValue->settingValueType);
+    if (recordText.size != 0 && recordText.text[1] == type &&
+        memcmp(&recordText.value, &settingValue->settingValueData, sizeof(settingValue->settingValueData)) == 0)
+    {
+        return {recordText.text, recordText.size};
+    }
+
+    char* const               text  = recordText.text;
+    char* const               end   = text + MAX_SETTING_RECORD_TEXT_SIZE - 1; // Room for the new line.
+    const SettingValueData_t& value = recordText.value;
+    memcpy(&recordText.value, &settingValue->settingValueData, sizeof(value));
+    text[0]                   = '\t';
+    text[1]                   = type;
+    text[2]                   = '\t';
+    const auto [valueEnd, ec] = settingValue->settingValueType == REAL ? std::to_chars(text + 3, end, value.real)
+                                                                       : std::to_chars(text + 3, end, value.integer);
+    *valueEnd                 = '\n';
+    recordText.size           = ec == std::errc() ? static_cast<uint8_t>(valueEnd + 1 - text) : 0;
+    return {recordText.text, recordText.size};
+}
+
+int SettingsStorage::collectSettingRecordsCallback(void* data, const unsigned char* key, uint32_t key_len, void* value)
+{
+    auto* callbackData = static_cast<SettingsParallelStoreCallbackData_t*>(data);
+    auto* records      = std::get<3>(*callbackData);
+    auto* recordCache  = std::get<9>(*callbackData);
+    auto* settingValue = static_cast<SettingValue_t*>(value);
+
+    // The settings that are not stored are skipped here, so they do not unbalance the ranges of the workers. The
+    // records of the numbers are added to the cache here, so the workers only fill their own records.
+    bool tombstone = false;
+    if (std::get<0>(*callbackData)->findSettingsShard(key, key_len) == std::get<7>(*callbackData) &&
+        std::get<0>(*callbackData)->selectSettingRecord(settingValue, std::get<6>(*callbackData), tombstone))
+    {
+        const auto recordTextIndex = static_cast<uint32_t>(recordCache->count);
+        nextSettingRecordText(recordCache, settingValue, tombstone);
+        records->push_back({key, key_len, recordTextIndex, settingValue, tombstone});
+    }
+    return SettingsFile::Success;
+}
+
+int SettingsStorage::formatSettingRecordsInParallelCallback(void* data)
+{
+    auto*                             callbackData      = static_cast<SettingsParallelStoreCallbackData_t*>(data);
+    const SettingsStorage*            settingsStorage   = std::get<0>(*callbackData);
+    const uint32_t                    threads           = std::get<1>(*callbackData);
+    const SettingsChecksumAlgorithm_t checksumAlgorithm = std::get<2>(*callbackData);
+    const auto*                       records           = std::get<3>(*callbackData);
+    uint32_t*                         checksum          = std::get<4>(*callbackData);
+    SettingsCompressor*               compressor        = std::get<5>(*callbackData);
+    std::vector<std::string>*         outputs           = std::get<8>(*callbackData);
+    SettingsRecordCacheUpdate_t*      recordCache       = std::get<9>(*callbackData);
+
+    // The records are sorted by key, so splitting them in contiguous ranges keeps the output in order.
+    const size_t chunksCount = std::clamp<size_t>(
+        records->size() / CONFIG_SETTINGS_STORAGE_PARALLEL_STORE_MIN_SETTINGS_PER_THREAD, 1, threads);
+    const size_t                      chunkSize = (records->size() + chunksCount - 1) / chunksCount;
+    std::vector<SettingsStoreChunk_t> chunks(chunksCount);
+    const auto serializeChunk = [records, chunkSize, checksumAlgorithm, recordCache, &chunks](const size_t i)
+    {
+        serializeSettingRecords(records->data() + std::min(i * chunkSize, records->size()),
+                                records->data() + std::min((i + 1) * chunkSize, records->size()), checksumAlgorithm,
+                                recordCache->records, &chunks[i]);
+    };
+    settingsStorage->runInParallel(chunksCount, "SettingsStore", serializeChunk);
+
+    // The compressed stream continues from one chunk to the next, so the chunks are compressed in order.
+    outputs->resize(chunks.size());
+    *checksum = 0;
+    for (size_t i = 0; i < chunks.size(); i++)
+    {
+        SettingsStoreChunk_t& chunk = chunks[i];
+        if (chunk.result != SettingsFile::Success)
+        {
+            return chunk.result;
+        }
+        *checksum = SettingsChecksum::combine(checksumAlgorithm, *checksum, chunk.checksum, chunk.output.size());
+        if (compressor == nullptr)
+        {
+            (*outputs)[i] = std::move(chunk.output);
+            continue;
+        }
+        compressor->compress(chunk.output, (*outputs)[i]);
+        if (i + 1 == chunks.size())
+        {
+            compressor->end((*outputs)[i]);
+        }
+    }
+    return SettingsFile::Success;
+}
+
+SettingsFile::SettingsFileResult SettingsStorage::writeSettingOutputs(SettingsFile*                   file,
+                                                                      ExtendedSettingsFile*           extendedFile,
+                                                                      const std::vector<std::string>& outputs)
+{
+    // The outputs are submitted together if the file can do it, and written one by one otherwise.
+    if (extendedFile != nullptr)
+    {
+        std::vector<std::string_view> buffers;
+        buffers.reserve(outputs.size());
+        for (const std::string& output : outputs)
+        {
+            if (!output.empty())
+            {
+                buffers.emplace_back(output);
+            }
+        }
+        if (const SettingsFile::SettingsFileResult res = extendedFile->writeBuffers(buffers);
+            res != SettingsFile::InvalidState)
         {
-            if (static_cast<uint32_t>(settingValue->settingPermissions & permissions) == 0)
+            return res;
+        }
+    }
+    for (const std::string& output : outputs)
+    {
+        if (!output.empty())
+        {
+            if (const SettingsFile::SettingsFileResult res = file->write(output); res != SettingsFile::Success)
             {
-                outputKeys->emplace_back(reinterpret_cast<const char*>(key), key_len);
+                return res;
             }
-            return NO_ERROR;
         }
-        default:
-            return INVALID_INPUT_ERROR;
     }
+    return SettingsFile::Success;
 }
 
-int SettingsStorage::freeSettingValuesCallback([[maybe_unused]] void* data, [[maybe_unused]] const unsigned char* key,
-                                               [[maybe_unused]] uint32_t key_len, void* value)
+void SettingsStorage::serializeSettingRecords(const SettingRecord_t* firstRecord, const SettingRecord_t* lastRecord,
+                                              const SettingsChecksumAlgorithm_t checksumAlgorithm,
+                                              SettingsRecordCache_t*            recordCache,
+                                              SettingsStoreChunk_t*             chunk)
 {
-    auto* settingValue = static_cast<SettingValue_t*>(value);
-    freeSettingValue(settingValue);
+    SettingsSerializer serializer;
+    serializer.beginInMemory(&chunk->output, checksumAlgorithm);
 
-    return NO_ERROR;
+    chunk->result = SettingsFile::Success;
+    for (const SettingRecord_t* record = firstRecord; record != lastRecord && chunk->result == SettingsFile::Success;
+         ++record)
+    {
+        SettingRecordText_t* recordText = hasSettingRecordText(record->value, record->tombstone)
+                                              ? &(*recordCache)[record->recordTextIndex]
+                                              : nullptr;
+        chunk->result = serializeSettingRecord(&serializer, record->key, record->keyLength, record->value,
+                                               record->tombstone, recordText);
+    }
+    if (chunk->result == SettingsFile::Success)
+    {
+        chunk->result = serializer.flush();
+    }
+    chunk->checksum = serializer.getChecksum();
 }
 
-int SettingsStorage::storeSettingsInPersistentStorageCallback(void* data, const unsigned char* key, uint32_t key_len,
-                                                              void* value)
+SettingsStorage::SettingError_t SettingsStorage::listSettingsKeys(const char*                    keyPrefix,
+                                                                  SettingPermissions_t           permissions,
+                                                                  SettingPermissionsFilterMode_t filterMode,
+                                                                  SettingsKeysList_t&            outputKeys) const
 {
-    auto* callbackData = static_cast<SettingsStoreCallbackData_t*>(data);
-    auto* settingValue = static_cast<SettingValue_t*>(value);
-
-    // If the setting is volatile, it should not be stored in the persistent storage.
-    if (static_cast<bool>(settingValue->settingPermissions & SettingPermissions_t::VOLATILE))
+    if (keyPrefix == nullptr)
     {
-        return SettingsFile::Success;
+        return INVALID_INPUT_ERROR;
     }
 
-    SettingsFile*             settingsFile  = std::get<0>(*callbackData);
-    uint32_t*                 settingsCRC32 = std::get<1>(*callbackData);
-    bool*                     firstSetting  = std::get<2>(*callbackData);
-    CRC::Table<unsigned, 32>* crcTable      = std::get<3>(*callbackData);
-
-    if (*firstSetting)
+    if (!validatePermissions(permissions))
     {
-        *firstSetting  = false;
-        *settingsCRC32 = CRC::Calculate(key, key_len, *crcTable);
+        return INVALID_INPUT_ERROR;
     }
-    else
+
+    const size_t prefixLength = strnlen(keyPrefix, MAX_SETTING_KEY_SIZE);
+    if (const SettingError_t result =
+            loadLazySettings(std::string_view(keyPrefix, prefixLength), false, SETTINGS_STORAGE_MUTEX_TIMEOUT_MS);
+        result != NO_ERROR)
     {
-        *settingsCRC32 = CRC::Calculate(key, key_len, *crcTable, *settingsCRC32);
+        return result;
     }
 
-    SettingsFile::SettingsFileResult res = settingsFile->write(reinterpret_cast<const char*>(key));
-    if (res != SettingsFile::Success)
+    SettingsListCallbackData_t callbackData = std::make_tuple(permissions, filterMode, &outputKeys);
+    int res = settings->iterateOverPrefix(keyPrefix, static_cast<int>(prefixLength), listSettingsKeysCallback,
+                                          &callbackData);
+    return static_cast<SettingError_t>(res);
+}
+
+SettingsStorage::SettingError_t SettingsStorage::getRootHash(uint64_t& hash) const
+{
+    return getSubtreeHash("", hash);
+}
+
+SettingsStorage::SettingError_t SettingsStorage::getSubtreeHash(const char* keyPrefix, uint64_t& hash) const
+{
+    if (keyPrefix == nullptr)
     {
-        return res;
+        return INVALID_INPUT_ERROR;
     }
 
+    const size_t prefixLength = strnlen(keyPrefix, MAX_SETTING_KEY_SIZE);
+    if (const SettingError_t result =
+            loadLazySettings(std::string_view(keyPrefix, prefixLength), false, SETTINGS_STORAGE_MUTEX_TIMEOUT_MS);
+        result != NO_ERROR)
     {
-        const std::string formattedString = std::format("\t{}\t", static_cast<uint8_t>(settingValue->settingValueType));
+        return result;
+    }
 
-        *settingsCRC32 = CRC::Calculate(formattedString.c_str(), formattedString.size(), *crcTable, *settingsCRC32);
-        res            = settingsFile->write(formattedString);
-        if (res != SettingsFile::Success)
+    // Only the prefixes that end with '/' have their own hash, the settings of the others are summed.
+    if (prefixLength != 0 && keyPrefix[prefixLength - 1] != '/')
+    {
+        uint64_t sum = 0;
+        if (settings->iterateOverPrefix(keyPrefix, static_cast<int>(prefixLength), sumSubtreeHashCallback, &sum) !=
+            0)
         {
-            return res;
+            return TIMEOUT_ERROR;
         }
+        hash = sum;
+        return NO_ERROR;
     }
 
-    switch (settingValue->settingValueType)
+    if (prefixLength == 0)
     {
-        case REAL:
-        {
-            std::string formattedString = std::format("{:.{}g}\n", settingValue->settingValueData.real,
-                                                      std::numeric_limits<double>::max_digits10);
+        hash = settingsHashes->root;
+        return NO_ERROR;
+    }
+    const std::string_view prefix(keyPrefix, prefixLength);
+    SettingsHashStripe_t*  stripe = findSettingsHashStripe(prefix);
+    if (!stripe->mutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        return TIMEOUT_ERROR;
+    }
+    addPendingSubtreeHashes(*stripe);
+    const auto subtree = stripe->subtrees.find(prefix);
+    hash               = subtree == stripe->subtrees.end() ? 0 : subtree->second;
+    stripe->mutex->signal();
+    return NO_ERROR;
+}
 
-            *settingsCRC32 = CRC::Calculate(formattedString.c_str(), formattedString.size(), *crcTable, *settingsCRC32);
-            res            = settingsFile->write(formattedString);
-            break;
+SettingsStorage::SettingError_t
+SettingsStorage::listSubtreeHashes(const char*                                     keyPrefix,
+                                   std::vector<std::pair<std::string, uint64_t>>& outputHashes) const
+{
+    if (keyPrefix == nullptr)
+    {
+        return INVALID_INPUT_ERROR;
+    }
+    const size_t prefixLength = strnlen(keyPrefix, MAX_SETTING_KEY_SIZE);
+    if (prefixLength != 0 && keyPrefix[prefixLength - 1] != '/')
+    {
+        return INVALID_INPUT_ERROR;
+    }
+
+    if (const SettingError_t result =
+            loadLazySettings(std::string_view(keyPrefix, prefixLength), false, SETTINGS_STORAGE_MUTEX_TIMEOUT_MS);
+        result != NO_ERROR)
+    {
+        return result;
+    }
+    outputHashes.clear();
+
+    // The prefixes of the next level follow the prefix in the map of its stripe, up to the first key that does not
+    // start with it. The first level is in all the stripes.
+    const std::string_view      prefix(keyPrefix, prefixLength);
+    const SettingsHashStripe_t* prefixStripe = prefixLength == 0 ? nullptr : findSettingsHashStripe(prefix);
+    for (SettingsHashStripe_t& stripe : settingsHashes->stripes)
+    {
+        if (prefixStripe != nullptr && &stripe != prefixStripe)
+        {
+            continue;
         }
-        case INTEGER:
+        if (!stripe.mutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
         {
-            std::string formattedString = std::format("{}\n", settingValue->settingValueData.integer);
-
-            *settingsCRC32 = CRC::Calculate(formattedString.c_str(), formattedString.size(), *crcTable, *settingsCRC32);
-            res            = settingsFile->write(formattedString);
-            break;
+            outputHashes.clear();
+            return TIMEOUT_ERROR;
         }
-        case STRING:
+        addPendingSubtreeHashes(stripe);
+        for (auto subtree = stripe.subtrees.upper_bound(prefix);
+             subtree != stripe.subtrees.end() && subtree->first.starts_with(prefix); ++subtree)
         {
-            std::string formattedString = std::format("{}\n", settingValue->settingValueData.string);
-
-            *settingsCRC32 = CRC::Calculate(formattedString.c_str(), formattedString.size(), *crcTable, *settingsCRC32);
-            res            = settingsFile->write(formattedString);
-            break;
+            if (subtree->second != 0 && subtree->first.find('/', prefixLength) == subtree->first.size() - 1)
+            {
+                outputHashes.emplace_back(subtree->first, subtree->second);
+            }
         }
-        default:
-            res = SettingsFile::InvalidState;
+        stripe.mutex->signal();
     }
-    return res;
+    std::sort(outputHashes.begin(), outputHashes.end());
+
+    // The settings of the prefix are listed in the same order, so both lists are merged.
+    const auto                     subtreesEnd  = static_cast<std::ptrdiff_t>(outputHashes.size());
+    SettingsHashListCallbackData_t callbackData = std::make_tuple(&outputHashes, prefixLength);
+    if (settings->iterateOverPrefix(keyPrefix, static_cast<int>(prefixLength), listSubtreeHashesCallback,
+                                    &callbackData) != 0)
+    {
+        outputHashes.clear();
+        return TIMEOUT_ERROR;
+    }
+    std::inplace_merge(outputHashes.begin(), outputHashes.begin() + subtreesEnd, outputHashes.end());
+    return NO_ERROR;
 }
 
-SettingsStorage::SettingError_t SettingsStorage::listSettingsKeys(const char*                    keyPrefix,
-                                                                  SettingPermissions_t           permissions,
-                                                                  SettingPermissionsFilterMode_t filterMode,
-                                                                  SettingsKeysList_t&            outputKeys) const
+int SettingsStorage::sumSubtreeHashCallback(void* data, [[maybe_unused]] const unsigned char* key,
+                                            [[maybe_unused]] uint32_t key_len, void* value)
 {
-    if (keyPrefix == nullptr)
+    *static_cast<uint64_t*>(data) += std::atomic_ref<uint64_t>(static_cast<SettingValue_t*>(value)->settingHash).load();
+    return 0;
+}
+
+int SettingsStorage::listSubtreeHashesCallback(void* data, const unsigned char* key, const uint32_t key_len,
+                                               void* value)
+{
+    auto*                  callbackData = static_cast<SettingsHashListCallbackData_t*>(data);
+    const std::string_view keyView(reinterpret_cast<const char*>(key), key_len);
+    if (keyView.find('/', std::get<1>(*callbackData)) != std::string_view::npos)
     {
-        return INVALID_INPUT_ERROR;
+        return 0;
     }
 
-    if (!validatePermissions(permissions))
+    const uint64_t hash = std::atomic_ref<uint64_t>(static_cast<SettingValue_t*>(value)->settingHash).load();
+    if (hash != 0)
     {
-        return INVALID_INPUT_ERROR;
+        std::get<0>(*callbackData)->emplace_back(keyView, hash);
     }
-
-    SettingsListCallbackData_t callbackData = std::make_tuple(permissions, filterMode, &outputKeys);
-    int res = settings->iterateOverPrefix(keyPrefix, static_cast<int>(strnlen(keyPrefix, MAX_SETTING_KEY_SIZE)),
-                                          listSettingsKeysCallback, &callbackData);
-    return static_cast<SettingError_t>(res);
+    return 0;
 }
 
 SettingsStorage::SettingError_t SettingsStorage::getSettingAsInt(const char* key, int64_t& outputValue,
@@ -590,82 +4082,214 @@ SettingsStorage::SettingError_t SettingsStorage::getSettingAsString(const char*
 
 SettingsStorage::SettingError_t SettingsStorage::registerSettingAsInt(const char*                key,
                                                                       const SettingPermissions_t permissions,
-                                                                      const int64_t              defaultValue) const
+                                                                      const int64_t              defaultValue,
+                                                                      const SettingsDurability_t durability) const
 {
-    if (key == nullptr || key[0] == '\0' || !validatePermissions(permissions))
+    if (key == nullptr || key[0] == '\0' || !validatePermissions(permissions) ||
+        durability >= SettingsDurability_t::MAX_SETTINGS_DURABILITY)
     {
         return INVALID_INPUT_ERROR;
     }
 
-    auto* newValue                            = new SettingValue_t();
+    auto* newValue = newSettingValue();
+    if (newValue == nullptr)
+    {
+        return TIMEOUT_ERROR;
+    }
     newValue->settingPermissions              = permissions;
     newValue->settingValueType                = INTEGER;
     newValue->settingValueData.integer        = defaultValue;
     newValue->settingDefaultValueData.integer = defaultValue;
+    newValue->settingDurability               = durability;
     if (this->settings->insertIfNotExists(key, static_cast<int>(strnlen(key, MAX_SETTING_KEY_SIZE)), newValue) !=
         nullptr)
     {
-        delete newValue;
+        deleteSettingValue(newValue);
         return KEY_EXISTS_ERROR;
     }
+
+    updateSettingHash(reinterpret_cast<const unsigned char*>(key),
+                      static_cast<uint32_t>(strnlen(key, MAX_SETTING_KEY_SIZE)), newValue);
+    markSettingsFileDirty(key, durability);
+
+    // The persisted value of the setting replaces the default value if it is still pending. If it is not loaded in
+    // time, the background loader or the next lookup will load it.
+    loadLazySettings(key, true, CONFIG_SETTINGS_STORAGE_PENDING_SETTINGS_WAIT_MS);
     return NO_ERROR;
 }
 
 SettingsStorage::SettingError_t SettingsStorage::registerSettingAsReal(const char*                key,
                                                                        const SettingPermissions_t permissions,
-                                                                       const double               defaultValue) const
+                                                                       const double               defaultValue,
+                                                                       const SettingsDurability_t durability) const
 {
-    if (key == nullptr || key[0] == '\0' || !validatePermissions(permissions))
+    if (key == nullptr || key[0] == '\0' || !validatePermissions(permissions) ||
+        durability >= SettingsDurability_t::MAX_SETTINGS_DURABILITY)
     {
         return INVALID_INPUT_ERROR;
     }
 
-    auto* newValue                         = new SettingValue_t();
+    auto* newValue = newSettingValue();
+    if (newValue == nullptr)
+    {
+        return TIMEOUT_ERROR;
+    }
     newValue->settingPermissions           = permissions;
     newValue->settingValueType             = REAL;
     newValue->settingValueData.real        = defaultValue;
     newValue->settingDefaultValueData.real = defaultValue;
+    newValue->settingDurability            = durability;
     if (this->settings->insertIfNotExists(key, static_cast<int>(strnlen(key, MAX_SETTING_KEY_SIZE)), newValue) !=
         nullptr)
     {
-        delete newValue;
+        deleteSettingValue(newValue);
         return KEY_EXISTS_ERROR;
     }
+
+    updateSettingHash(reinterpret_cast<const unsigned char*>(key),
+                      static_cast<uint32_t>(strnlen(key, MAX_SETTING_KEY_SIZE)), newValue);
+    markSettingsFileDirty(key, durability);
+
+    // The persisted value of the setting replaces the default value if it is still pending. If it is not loaded in
+    // time, the background loader or the next lookup will load it.
+    loadLazySettings(key, true, CONFIG_SETTINGS_STORAGE_PENDING_SETTINGS_WAIT_MS);
     return NO_ERROR;
 }
 
 SettingsStorage::SettingError_t SettingsStorage::registerSettingAsString(const char*                key,
                                                                          const SettingPermissions_t permissions,
-                                                                         const char*                defaultValue) const
+                                                                         const char*                defaultValue,
+                                                                         const SettingsDurability_t durability) const
 {
-    if (key == nullptr || key[0] == '\0' || !validatePermissions(permissions) || defaultValue == nullptr)
+    if (key == nullptr || key[0] == '\0' || !validatePermissions(permissions) || defaultValue == nullptr ||
+        durability >= SettingsDurability_t::MAX_SETTINGS_DURABILITY)
     {
         return INVALID_INPUT_ERROR;
     }
 
-    auto* newValue                           = new SettingValue_t();
-    newValue->settingPermissions             = permissions;
-    newValue->settingValueType               = STRING;
-    newValue->settingValueData.string        = strdup(defaultValue);
-    newValue->settingDefaultValueData.string = strdup(defaultValue);
+    auto* newValue = newSettingValue();
+    if (newValue == nullptr)
+    {
+        return TIMEOUT_ERROR;
+    }
+    newValue->settingPermissions = permissions;
+    newValue->settingValueType   = STRING;
+    newValue->settingDurability  = durability;
+    if (!assignDefaultSettingString(newValue, defaultValue, strlen(defaultValue)))
+    {
+        deleteSettingValue(newValue);
+        return TIMEOUT_ERROR;
+    }
+    shareDefaultSettingString(newValue);
 
     if (this->settings->insertIfNotExists(key, static_cast<int>(strnlen(key, MAX_SETTING_KEY_SIZE)), newValue) !=
         nullptr)
     {
-        free(newValue->settingValueData.string);
-        free(newValue->settingDefaultValueData.string);
-        delete newValue;
+        freeSettingValue(newValue);
 
         return KEY_EXISTS_ERROR;
     }
+
+    updateSettingHash(reinterpret_cast<const unsigned char*>(key),
+                      static_cast<uint32_t>(strnlen(key, MAX_SETTING_KEY_SIZE)), newValue);
+    markSettingsFileDirty(key, durability);
+
+    // The persisted value of the setting replaces the default value if it is still pending. If it is not loaded in
+    // time, the background loader or the next lookup will load it.
+    loadLazySettings(key, true, CONFIG_SETTINGS_STORAGE_PENDING_SETTINGS_WAIT_MS);
     return NO_ERROR;
 }
 
+SettingsStorage::SettingError_t
+SettingsStorage::registerSettings(const std::span<const SettingDescriptor_t> descriptors) const
+{
+    for (const SettingDescriptor_t& descriptor : descriptors)
+    {
+        if (descriptor.key == nullptr || descriptor.key[0] == '\0' || !validatePermissions(descriptor.permissions) ||
+            descriptor.valueType >= MAX_SETTING_VALUE_TYPE_ENUM ||
+            (descriptor.valueType == STRING && descriptor.defaultValue.string == nullptr) ||
+            descriptor.durability >= SettingsDurability_t::MAX_SETTINGS_DURABILITY)
+        {
+            return INVALID_INPUT_ERROR;
+        }
+    }
+
+    // The values are built before the settings are locked, so the lock is only held to insert them. The pool is
+    // locked once for all of them.
+    if (!lockSettingsValuePool())
+    {
+        return TIMEOUT_ERROR;
+    }
+    std::vector<SettingRegisterRecord_t> records(descriptors.size());
+    for (size_t i = 0; i < descriptors.size(); i++)
+    {
+        const SettingDescriptor_t& descriptor = descriptors[i];
+        auto*                      newValue   = newSettingValue(true);
+        newValue->settingPermissions          = descriptor.permissions;
+        newValue->settingValueType            = descriptor.valueType;
+        newValue->settingDurability           = descriptor.durability;
+        switch (descriptor.valueType)
+        {
+            case REAL:
+                newValue->settingValueData.real        = descriptor.defaultValue.real;
+                newValue->settingDefaultValueData.real = descriptor.defaultValue.real;
+                break;
+            case INTEGER:
+                newValue->settingValueData.integer        = descriptor.defaultValue.integer;
+                newValue->settingDefaultValueData.integer = descriptor.defaultValue.integer;
+                break;
+            default:
+            {
+                // The default string is never modified, and the value shares it until it is modified too.
+                const char* defaultString                = descriptor.defaultValue.string;
+                newValue->settingDefaultValueData.string = const_cast<char*>(defaultString);
+                newValue->settingString.defaultLength    = static_cast<uint32_t>(strlen(defaultString));
+                newValue->settingString.defaultStatic    = true;
+                shareDefaultSettingString(newValue, true);
+                break;
+            }
+        }
+        records[i].key       = descriptor.key;
+        records[i].keyLength = static_cast<int>(strnlen(descriptor.key, MAX_SETTING_KEY_SIZE));
+        records[i].value     = newValue;
+    }
+    unlockSettingsValuePool();
+
+    if (settings->insertAllIfNotExists(records.data(), records.size()) != 0)
+    {
+        for (const SettingRegisterRecord_t& record : records)
+        {
+            freeSettingValue(record.value);
+        }
+        return TIMEOUT_ERROR;
+    }
+
+    SettingError_t result = NO_ERROR;
+    for (const SettingRegisterRecord_t& record : records)
+    {
+        if (record.existingValue != nullptr)
+        {
+            freeSettingValue(record.value);
+            result = KEY_EXISTS_ERROR;
+            continue;
+        }
+        updateSettingHash(reinterpret_cast<const unsigned char*>(record.key), static_cast<uint32_t>(record.keyLength),
+                          record.value);
+        markSettingsFileDirty(record.key, record.value->settingDurability);
+
+        // The persisted value of the setting replaces the default value if it is still pending. If it is not loaded
+        // in time, the background loader or the next lookup will load it.
+        loadLazySettings(std::string_view(record.key, record.keyLength), true,
+                         CONFIG_SETTINGS_STORAGE_PENDING_SETTINGS_WAIT_MS);
+    }
+    return result;
+}
+
 SettingsStorage::SettingError_t SettingsStorage::putSettingValueAsInt(const char* key, const int64_t value) const
 {
     SettingValue_t* outputValue;
 
-    if (SettingError_t result = getSettingValue(key, outputValue); result != NO_ERROR)
+    if (SettingError_t result = getSettingValue(key, outputValue, true); result != NO_ERROR)
     {
         return result;
     }
@@ -676,6 +4300,9 @@ SettingsStorage::SettingError_t SettingsStorage::putSettingValueAsInt(const char
     }
 
     outputValue->settingValueData.integer = value;
+    updateSettingHash(reinterpret_cast<const unsigned char*>(key),
+                      static_cast<uint32_t>(strnlen(key, MAX_SETTING_KEY_SIZE)), outputValue);
+    markSettingsFileDirty(key, outputValue->settingDurability);
 
     return NO_ERROR;
 }
@@ -684,7 +4311,7 @@ SettingsStorage::SettingError_t SettingsStorage::putSettingValueAsReal(const cha
 {
     SettingValue_t* outputValue;
 
-    if (SettingError_t result = getSettingValue(key, outputValue); result != NO_ERROR)
+    if (SettingError_t result = getSettingValue(key, outputValue, true); result != NO_ERROR)
     {
         return result;
     }
@@ -695,6 +4322,9 @@ SettingsStorage::SettingError_t SettingsStorage::putSettingValueAsReal(const cha
     }
 
     outputValue->settingValueData.real = value;
+    updateSettingHash(reinterpret_cast<const unsigned char*>(key),
+                      static_cast<uint32_t>(strnlen(key, MAX_SETTING_KEY_SIZE)), outputValue);
+    markSettingsFileDirty(key, outputValue->settingDurability);
 
     return NO_ERROR;
 }
@@ -708,7 +4338,7 @@ SettingsStorage::SettingError_t SettingsStorage::putSettingValueAsString(const c
 
     SettingValue_t* outputValue;
 
-    if (SettingError_t result = getSettingValue(key, outputValue); result != NO_ERROR)
+    if (SettingError_t result = getSettingValue(key, outputValue, true); result != NO_ERROR)
     {
         return result;
     }
@@ -718,8 +4348,13 @@ SettingsStorage::SettingError_t SettingsStorage::putSettingValueAsString(const c
         return TYPE_MISMATCH_ERROR;
     }
 
-    free(outputValue->settingValueData.string);
-    outputValue->settingValueData.string = strdup(value);
+    if (!assignSettingString(outputValue, value, strlen(value)))
+    {
+        return TIMEOUT_ERROR;
+    }
+    updateSettingHash(reinterpret_cast<const unsigned char*>(key),
+                      static_cast<uint32_t>(strnlen(key, MAX_SETTING_KEY_SIZE)), outputValue);
+    markSettingsFileDirty(key, outputValue->settingDurability);
 
     return NO_ERROR;
 }
@@ -748,14 +4383,25 @@ bool validatePermissions(const SettingPermissions_t permissions)
     return permissions <= ALL_PERMISSIONS_VOLATILE;
 }
 
-SettingsStorage::SettingError_t SettingsStorage::getSettingValue(const char* key, SettingValue_t*& outputValue) const
+SettingsStorage::SettingError_t SettingsStorage::getSettingValue(const char* key, SettingValue_t*& outputValue,
+                                                                 const bool forWrite) const
 {
     if (key == nullptr || key[0] == '\0')
     {
         return INVALID_INPUT_ERROR;
     }
 
-    outputValue = this->settings->search(key, static_cast<int>(strnlen(key, MAX_SETTING_KEY_SIZE)));
+    // If the setting is still pending and it is not loaded in time, a read uses the value in the tree. A write fails,
+    // otherwise the pending record would be merged later and replace the value written.
+    const size_t         keyLength  = strnlen(key, MAX_SETTING_KEY_SIZE);
+    const SettingError_t loadResult = loadLazySettings(std::string_view(key, keyLength), true,
+                                                       CONFIG_SETTINGS_STORAGE_PENDING_SETTINGS_WAIT_MS);
+    if (forWrite && loadResult != NO_ERROR)
+    {
+        return loadResult;
+    }
+
+    outputValue = this->settings->search(key, static_cast<int>(keyLength));
     if (outputValue == nullptr)
     {
         return KEY_NOT_FOUND_ERROR;
@@ -843,14 +4489,16 @@ SettingsStorage::SettingError_t SettingsStorage::getSettingValueAsString(const T
         return TYPE_MISMATCH_ERROR;
     }
 
-    const char* outputValue = value->settingValueData.string;
+    const char* outputValue       = value->settingValueData.string;
+    size_t      outputValueLength = value->settingString.length;
     if (type == DefaultValue)
     {
-        outputValue = value->settingDefaultValueData.string;
+        outputValue       = value->settingDefaultValueData.string;
+        outputValueLength = value->settingString.defaultLength;
     }
 
-    if (strlen(outputValue) >= outputValueSize) // Only allow the string to be copied if it fits in the buffer. (The ==
-                                                // is to account for the null terminator)
+    if (outputValueLength >= outputValueSize) // Only allow the string to be copied if it fits in the buffer. (The ==
+                                              // is to account for the null terminator)
     {
         return INSUFFICIENT_BUFFER_SIZE_ERROR;
     }
@@ -859,18 +4507,216 @@ SettingsStorage::SettingError_t SettingsStorage::getSettingValueAsString(const T
     {
         *outputPermissions = value->settingPermissions;
     }
-    strncpy(outputValueBuffer, outputValue, outputValueSize);
-    outputValueBuffer[outputValueSize] = '\0';
+    memcpy(outputValueBuffer, outputValue, outputValueLength + 1);
 
     return NO_ERROR;
 }
 
-void SettingsStorage::freeSettingValue(const SettingValue_t* settingValue)
+void SettingsStorage::freeSettingValue(SettingValue_t* settingValue) const
 {
     if (settingValue->settingValueType == STRING)
     {
-        free(settingValue->settingValueData.string);
-        free(settingValue->settingDefaultValueData.string);
+        releaseSettingString(settingValue);
+        releaseDefaultSettingString(settingValue);
+    }
+    deleteSettingValue(settingValue);
+}
+
+bool SettingsStorage::lockSettingsValuePool() const
+{
+    return settingsValuePool == nullptr || settingsValuePoolMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS);
+}
+
+void SettingsStorage::unlockSettingsValuePool() const
+{
+    if (settingsValuePool != nullptr)
+    {
+        settingsValuePoolMutex->signal();
+    }
+}
+
+SettingsStorage::SettingValue_t* SettingsStorage::newSettingValue(const bool poolLocked) const
+{
+    if (settingsValuePool == nullptr)
+    {
+        return new SettingValue_t();
+    }
+    if (!poolLocked && !settingsValuePoolMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        return nullptr;
+    }
+    void* memory = settingsValuePool->allocateObject();
+    if (!poolLocked)
+    {
+        settingsValuePoolMutex->signal();
+    }
+    return new (memory) SettingValue_t();
+}
+
+void SettingsStorage::deleteSettingValue(SettingValue_t* settingValue, const bool poolLocked) const
+{
+    if (settingsValuePool == nullptr)
+    {
+        delete settingValue;
+        return;
+    }
+    // A value that can not be given back in time stays in the pool, which releases it when it is destroyed.
+    if (!poolLocked && !settingsValuePoolMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        return;
+    }
+    settingsValuePool->freeObject(settingValue);
+    if (!poolLocked)
+    {
+        settingsValuePoolMutex->signal();
+    }
+}
+
+char* SettingsStorage::newSettingString(const char* value, const size_t length, const bool poolLocked) const
+{
+    const size_t capacity = getSettingStringCapacity(length);
+    char*        string;
+    if (settingsValuePool == nullptr)
+    {
+        string = static_cast<char*>(malloc(capacity));
+    }
+    else
+    {
+        if (!poolLocked && !settingsValuePoolMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+        {
+            return nullptr;
+        }
+        string = settingsValuePool->allocateString(capacity);
+        if (!poolLocked)
+        {
+            settingsValuePoolMutex->signal();
+        }
+    }
+    settingsStringsMemory += capacity;
+    memcpy(string, value, length);
+    string[length] = '\0';
+    return string;
+}
+
+size_t SettingsStorage::getSettingStringCapacity(const size_t length) const
+{
+    // A pooled string can use the whole block of its class, so the longer values that still fit are copied in place.
+    return settingsValuePool == nullptr ? length + 1 : SettingsValuePool::getStringCapacity(length + 1);
+}
+
+void SettingsStorage::deleteSettingString(char* string, const size_t capacity, const bool poolLocked) const
+{
+    settingsStringsMemory -= capacity;
+    if (settingsValuePool == nullptr)
+    {
+        free(string);
+        return;
+    }
+    // A string that can not be given back in time stays in the pool, which releases it when it is destroyed.
+    if (!poolLocked && !settingsValuePoolMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        return;
+    }
+    settingsValuePool->freeString(string, capacity);
+    if (!poolLocked)
+    {
+        settingsValuePoolMutex->signal();
+    }
+}
+
+bool SettingsStorage::assignSettingString(SettingValue_t* settingValue, const char* value, const size_t length,
+                                          const bool poolLocked) const
+{
+    // The value is copied in place if it fits in the current buffer, so most puts do not allocate.
+    if (length < settingValue->settingString.capacity)
+    {
+        memcpy(settingValue->settingValueData.string, value, length);
+        settingValue->settingValueData.string[length] = '\0';
+    }
+    else
+    {
+        char* string = newSettingString(value, length, poolLocked);
+        if (string == nullptr)
+        {
+            return false;
+        }
+        releaseSettingString(settingValue, poolLocked);
+        settingValue->settingValueData.string = string;
+        settingValue->settingString.capacity  = static_cast<uint32_t>(getSettingStringCapacity(length));
+    }
+    settingValue->settingString.length = static_cast<uint32_t>(length);
+    return true;
+}
+
+void SettingsStorage::releaseSettingString(SettingValue_t* settingValue, const bool poolLocked) const
+{
+    if (settingValue->settingString.capacity > 0)
+    {
+        deleteSettingString(settingValue->settingValueData.string, settingValue->settingString.capacity, poolLocked);
+    }
+    settingValue->settingValueData.string = nullptr;
+    settingValue->settingString.length    = 0;
+    settingValue->settingString.capacity  = 0;
+}
+
+bool SettingsStorage::assignDefaultSettingString(SettingValue_t* settingValue, const char* value, const size_t length,
+                                                 const bool poolLocked) const
+{
+    char* string = newSettingString(value, length, poolLocked);
+    if (string == nullptr)
+    {
+        return false;
+    }
+    settingValue->settingDefaultValueData.string = string;
+    settingValue->settingString.defaultLength    = static_cast<uint32_t>(length);
+    return true;
+}
+
+void SettingsStorage::releaseDefaultSettingString(SettingValue_t* settingValue, const bool poolLocked) const
+{
+    if (!settingValue->settingString.defaultStatic)
+    {
+        deleteSettingString(settingValue->settingDefaultValueData.string,
+                            getSettingStringCapacity(settingValue->settingString.defaultLength), poolLocked);
+    }
+    settingValue->settingDefaultValueData.string = nullptr;
+    settingValue->settingString.defaultLength    = 0;
+    settingValue->settingString.defaultStatic    = false;
+}
+
+void SettingsStorage::shareDefaultSettingString(SettingValue_t* settingValue, const bool poolLocked) const
+{
+    // The default value is never modified, so the value only needs a buffer of its own once it is modified.
+    releaseSettingString(settingValue, poolLocked);
+    settingValue->settingValueData.string = settingValue->settingDefaultValueData.string;
+    settingValue->settingString.length    = settingValue->settingString.defaultLength;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::reserveSettings(const size_t settingsCount) const
+{
+    if (settingsValuePool != nullptr)
+    {
+        if (!settingsValuePoolMutex->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+        {
+            return TIMEOUT_ERROR;
+        }
+        settingsValuePool->reserve(settingsCount);
+        settingsValuePoolMutex->signal();
+    }
+    if (settingsRecordCache != nullptr)
+    {
+        if (!persistenceIdle->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+        {
+            return TIMEOUT_ERROR;
+        }
+        settingsRecordCache->reserve(settingsCount);
+        persistenceIdle->signal();
     }
-    delete settingValue;
+    return NO_ERROR;
+}
+
+SettingsStorage::SettingError_t SettingsStorage::getStringsMemoryUsage(size_t& outputBytes) const
+{
+    outputBytes = settingsStringsMemory;
+    return NO_ERROR;
 }
@@ -0,0 +1,28 @@
+#include "SettingsTaskFactory.h"
+#include <thread>
+
+namespace
+{
+    class ThreadSettingsTask : public SettingsTask
+    {
+    public:
+        ThreadSettingsTask(void (*function)(void* arg), void* arg) : thread(function, arg)
+        {
+        }
+
+        void join() override
+        {
+            thread.join();
+        }
+
+    private:
+        std::thread thread;
+    };
+} // namespace
+
+SettingsTask* SettingsTaskFactory::createDefaultTask(void (*function)(void* arg), void* arg,
+                                                     const SettingsTaskConfig_t& config)
+{
+    (void)config;
+    return new ThreadSettingsTask(function, arg);
+}
@@ -0,0 +1,155 @@
+#include "SettingsValuePool.h"
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace
+{
+    constexpr size_t roundUp(const size_t size, const size_t alignment)
+    {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+} // namespace
+
+SettingsValuePool::SettingsValuePool(const size_t objectSize, const size_t objectsPerSlab,
+                                     const size_t stringSlabSize) :
+    objects(), strings(), bigStrings()
+{
+    assert(objectsPerSlab > 0 && stringSlabSize >= STRING_SIZE_CLASSES.back() && "Slabs too small");
+
+    // Every block of the values is aligned like the slab, and a freed block must be able to hold the free list link.
+    objects.blockSize     = roundUp(std::max(objectSize, sizeof(FreeBlock_t)), alignof(std::max_align_t));
+    objects.blocksPerSlab = objectsPerSlab;
+    for (size_t i = 0; i < strings.size(); i++)
+    {
+        strings[i].blockSize     = STRING_SIZE_CLASSES[i];
+        strings[i].blocksPerSlab = stringSlabSize / STRING_SIZE_CLASSES[i];
+    }
+    bigStrings.previous = &bigStrings;
+    bigStrings.next     = &bigStrings;
+}
+
+SettingsValuePool::~SettingsValuePool()
+{
+    for (void* slab : slabs)
+    {
+        ::operator delete(slab);
+    }
+    while (bigStrings.next != &bigStrings)
+    {
+        BigString_t* bigString = bigStrings.next;
+        bigStrings.next        = bigString->next;
+        ::operator delete(bigString);
+    }
+}
+
+void* SettingsValuePool::allocateObject()
+{
+    return allocateBlock(objects);
+}
+
+void SettingsValuePool::freeObject(void* object)
+{
+    auto* block        = static_cast<FreeBlock_t*>(object);
+    block->next        = objects.freeBlocks;
+    objects.freeBlocks = block;
+    objects.freeBlockCount++;
+    objects.allocatedBlocks--;
+}
+
+char* SettingsValuePool::allocateString(const size_t size)
+{
+    const auto stringClass = std::lower_bound(STRING_SIZE_CLASSES.begin(), STRING_SIZE_CLASSES.end(), size);
+    if (stringClass != STRING_SIZE_CLASSES.end())
+    {
+        return static_cast<char*>(allocateBlock(strings[stringClass - STRING_SIZE_CLASSES.begin()]));
+    }
+
+    // The big strings are rare, and their sizes are too different to share blocks.
+    auto* bigString           = static_cast<BigString_t*>(::operator new(sizeof(BigString_t) + size));
+    bigString->previous       = &bigStrings;
+    bigString->next           = bigStrings.next;
+    bigStrings.next->previous = bigString;
+    bigStrings.next           = bigString;
+    return reinterpret_cast<char*>(bigString + 1);
+}
+
+void SettingsValuePool::freeString(char* string, const size_t size)
+{
+    const auto stringClass = std::lower_bound(STRING_SIZE_CLASSES.begin(), STRING_SIZE_CLASSES.end(), size);
+    if (stringClass != STRING_SIZE_CLASSES.end())
+    {
+        BlockClass_t& blockClass = strings[stringClass - STRING_SIZE_CLASSES.begin()];
+        auto*         block      = reinterpret_cast<FreeBlock_t*>(string);
+        block->next              = blockClass.freeBlocks;
+        blockClass.freeBlocks    = block;
+        blockClass.freeBlockCount++;
+        blockClass.allocatedBlocks--;
+        return;
+    }
+
+    BigString_t* bigString    = reinterpret_cast<BigString_t*>(string) - 1;
+    bigString->previous->next = bigString->next;
+    bigString->next->previous = bigString->previous;
+    ::operator delete(bigString);
+}
+
+size_t SettingsValuePool::getStringCapacity(const size_t size)
+{
+    const auto stringClass = std::lower_bound(STRING_SIZE_CLASSES.begin(), STRING_SIZE_CLASSES.end(), size);
+    return stringClass == STRING_SIZE_CLASSES.end() ? size : *stringClass;
+}
+
+void SettingsValuePool::reserve(const size_t objectsCount)
+{
+    // The blocks in the free list and at the end of the last slab are used before the new slab.
+    const size_t available = objects.freeBlockCount + (objects.slabEnd - objects.nextBlock) / objects.blockSize;
+    if (objects.allocatedBlocks + available >= objectsCount)
+    {
+        return;
+    }
+
+    // The values reserved are allocated in a single slab, whose blocks are added to the free list in order.
+    const size_t missingBlocks = objectsCount - objects.allocatedBlocks - available;
+    auto*        slab          = static_cast<char*>(::operator new(missingBlocks * objects.blockSize));
+    slabs.push_back(slab);
+    for (size_t i = missingBlocks; i > 0; i--)
+    {
+        auto* block        = reinterpret_cast<FreeBlock_t*>(slab + (i - 1) * objects.blockSize);
+        block->next        = objects.freeBlocks;
+        objects.freeBlocks = block;
+    }
+    objects.freeBlockCount += missingBlocks;
+}
+
+size_t SettingsValuePool::getSlabCount() const
+{
+    return slabs.size();
+}
+
+void* SettingsValuePool::allocateBlock(BlockClass_t& blockClass)
+{
+    blockClass.allocatedBlocks++;
+    if (FreeBlock_t* block = blockClass.freeBlocks; block != nullptr)
+    {
+        blockClass.freeBlocks = block->next;
+        blockClass.freeBlockCount--;
+        return block;
+    }
+    if (blockClass.nextBlock == blockClass.slabEnd)
+    {
+        addSlab(blockClass);
+    }
+    void* block = blockClass.nextBlock;
+    blockClass.nextBlock += blockClass.blockSize;
+    return block;
+}
+
+void SettingsValuePool::addSlab(BlockClass_t& blockClass)
+{
+    const size_t slabSize = blockClass.blockSize * blockClass.blocksPerSlab;
+    auto*        slab     = static_cast<char*>(::operator new(slabSize));
+    slabs.push_back(slab);
+    blockClass.nextBlock = slab;
+    blockClass.slabEnd   = slab + slabSize;
+}
@@ -57,6 +57,20 @@ public:
      */
     virtual ValueType* insertIfNotExists(const char* key, int key_len, ValueType* value);
 
+    /**
+     * @brief Insert a new value into the art tree, or update the value of an existing key
+     *
+     * The callback receives the value currently stored under the key, or NULL if the key is not in the tree, and
+     * returns the value that must be stored under it. The memory of a replaced value is not freed.
+     *
+     * @param key The key
+     * @param key_len The length of the key
+     * @param cb The callback function to invoke
+     * @param data Opaque handle passed to the callback
+     * @return The value returned by the callback. If it is NULL, the tree is not modified.
+     */
+    virtual ValueType* upsert(const char* key, int key_len, ValueType* (*cb)(void* data, ValueType* value), void* data);
+
     /**
      * @brief Searches for a value in the ART tree
      *
@@ -147,6 +161,21 @@ ValueType* AdaptiveRadixTree<ValueType>::insertIfNotExists(const char* key, int
         art_insert_no_replace(&tree, reinterpret_cast<const unsigned char*>(key), key_len, value));
 }
 
+template <typename ValueType>
+ValueType* AdaptiveRadixTree<ValueType>::upsert(const char* key, int key_len,
+                                                ValueType* (*cb)(void* data, ValueType* value), void* callbackData)
+{
+    // The ART is used directly, so the derived classes can call this method while they hold their own locks.
+    ValueType* currentValue =
+        static_cast<ValueType*>(art_search(&tree, reinterpret_cast<const unsigned char*>(key), key_len));
+    ValueType* newValue = cb(callbackData, currentValue);
+    if (newValue != nullptr && newValue != currentValue)
+    {
+        art_insert(&tree, reinterpret_cast<const unsigned char*>(key), key_len, newValue);
+    }
+    return newValue;
+}
+
 template <typename ValueType> ValueType* AdaptiveRadixTree<ValueType>::deleteValue(const char* key, int key_len)
 {
     return static_cast<ValueType*>(art_delete(&tree, reinterpret_cast<const unsigned char*>(key), key_len));
@@ -58,6 +58,23 @@ public:
      */
     ValueType* insertIfNotExists(const char* key, int key_len, ValueType* value) override;
 
+    /**
+     * @brief Insert a new value into the art tree, or update the value of an existing key, while holding the write
+     * lock once
+     *
+     * The callback receives the value currently stored under the key, or NULL if the key is not in the tree, and
+     * returns the value that must be stored under it. The memory of a replaced value is not freed.
+     *
+     * @param key The key
+     * @param key_len The length of the key
+     * @param cb The callback function to invoke
+     * @param data Opaque handle passed to the callback
+     * @return The value returned by the callback, or NULL if the tree could not be locked or the callback returned
+     * NULL.
+     */
+    ValueType* upsert(const char* key, int key_len, ValueType* (*cb)(void* data, ValueType* value),
+                      void* data) override;
+
     /**
      * @brief Searches for a value in the ART tree
      *
@@ -89,6 +106,19 @@ public:
      */
     int iterateOverAll(art_callback cb, void* data) override;
 
+    /**
+     * Iterates through the entries pairs in the map,
+     * invoking a callback for each, and then invokes lockedCallback before releasing the read lock.
+     * The keys and values collected by the callback stay valid until lockedCallback returns,
+     * so lockedCallback may hand them to other threads without locking the tree again.
+     * If the callback returns non-zero, then the iteration stops and lockedCallback is not invoked.
+     * @param cb The callback function to invoke for each entry
+     * @param data Opaque handle passed to both callbacks
+     * @param lockedCallback The callback function to invoke after the iteration
+     * @return Zero on success, the return of the callback, or the return of lockedCallback.
+     */
+    int iterateOverAll(art_callback cb, void* data, int (*lockedCallback)(void* data));
+
     /**
      * Iterates through the entry pairs in the map,
      * invoking a callback for each that matches a given prefix.
@@ -102,6 +132,56 @@ public:
      */
     int iterateOverPrefix(const char* prefix, int prefix_len, art_callback cb, void* data) override;
 
+    /**
+     * Iterates through the entry pairs in the map that match a given prefix,
+     * invoking a callback for each, and then invokes lockedCallback before releasing the read lock.
+     * The keys and values collected by the callback stay valid until lockedCallback returns,
+     * so lockedCallback may hand them to other threads without locking the tree again.
+     * If the callback returns non-zero, then the iteration stops and lockedCallback is not invoked.
+     * @param prefix The prefix of keys to read
+     * @param prefix_len The length of the prefix
+     * @param cb The callback function to invoke for each entry
+     * @param data Opaque handle passed to both callbacks
+     * @param lockedCallback The callback function to invoke after the iteration
+     * @return Zero on success, the return of the callback, or the return of lockedCallback.
+     */
+    int iterateOverPrefix(const char* prefix, int prefix_len, art_callback cb, void* data,
+                          int (*lockedCallback)(void* data));
+
+    /**
+     * @brief Insert or update several entries while holding the write lock only once.
+     *
+     * For each entry, in order, the callback receives the value currently stored under the key of the entry, or NULL
+     * if the key is not in the tree, and returns the value that must be stored under it. The memory of a replaced value
+     * is not freed. If the callback returns NULL, the operation stops and the remaining entries are not processed.
+     *
+     * If a check callback is given, it receives every entry and the value currently stored under its key before any
+     * entry is processed, and the tree is not modified if it returns false for one of them.
+     *
+     * @tparam EntryType The type of the entries. It must have the members key (const char*) and keyLength (int).
+     * @param entries The entries to insert or update.
+     * @param count The number of entries.
+     * @param cb The callback function to invoke for each entry
+     * @param data Opaque handle passed to both callbacks
+     * @param check The callback function to invoke for each entry before the tree is modified, or NULL.
+     * @return Zero on success, or -1 if the tree could not be locked, the check failed or the callback returned NULL.
+     */
+    template <typename EntryType>
+    int upsertAll(EntryType* entries, size_t count, ValueType* (*cb)(void* data, EntryType& entry, ValueType* value),
+                  void* data, bool (*check)(void* data, const EntryType& entry, const ValueType* value) = nullptr);
+
+    /**
+     * @brief Insert several new values into the art tree (no replace) while holding the write lock only once.
+     *
+     * @tparam EntryType The type of the entries. It must have the members key (const char*), keyLength (int), value
+     * (ValueType*) and existingValue (ValueType*).
+     * @param entries The entries to insert. The existingValue of each one is set to NULL if its value was newly
+     * inserted, otherwise to the value already stored under its key.
+     * @param count The number of entries.
+     * @return Zero on success, or -1 if the tree could not be locked.
+     */
+    template <typename EntryType> int insertAllIfNotExists(EntryType* entries, size_t count);
+
     /**
      * @brief Returns the minimum valued leaf value in the tree
      *
@@ -189,6 +269,19 @@ ValueType* AtomicAdaptiveRadixTree<ValueType>::insertIfNotExists(const char* key
     return nullptr;
 }
 
+template <typename ValueType>
+ValueType* AtomicAdaptiveRadixTree<ValueType>::upsert(const char* key, int key_len,
+                                                      ValueType* (*cb)(void* data, ValueType* value), void* data)
+{
+    if (preWrite())
+    {
+        ValueType* result = AdaptiveRadixTree<ValueType>::upsert(key, key_len, cb, data);
+        postWrite();
+        return result;
+    }
+    return nullptr;
+}
+
 template <typename ValueType> ValueType* AtomicAdaptiveRadixTree<ValueType>::deleteValue(const char* key, int key_len)
 {
     if (preWrite())
@@ -226,6 +319,24 @@ template <typename ValueType> int AtomicAdaptiveRadixTree<ValueType>::iterateOve
     return -1;
 }
 
+template <typename ValueType>
+int AtomicAdaptiveRadixTree<ValueType>::iterateOverAll(art_callback cb, void* data, int (*lockedCallback)(void* data))
+{
+    if (preRead())
+    {
+        int result = AdaptiveRadixTree<ValueType>::iterateOverAll(cb, data);
+        if (result == 0)
+        {
+            result = lockedCallback(data);
+        }
+        if (postRead())
+        {
+            return result;
+        }
+    }
+    return -1;
+}
+
 template <typename ValueType> int
 AtomicAdaptiveRadixTree<ValueType>::iterateOverPrefix(const char* prefix, int prefix_len, art_callback cb, void* data)
 {
@@ -240,6 +351,90 @@ AtomicAdaptiveRadixTree<ValueType>::iterateOverPrefix(const char* prefix, int pr
     return -1;
 }
 
+template <typename ValueType>
+int AtomicAdaptiveRadixTree<ValueType>::iterateOverPrefix(const char* prefix, int prefix_len, art_callback cb,
+                                                          void* data, int (*lockedCallback)(void* data))
+{
+    if (preRead())
+    {
+        int result = AdaptiveRadixTree<ValueType>::iterateOverPrefix(prefix, prefix_len, cb, data);
+        if (result == 0)
+        {
+            result = lockedCallback(data);
+        }
+        if (postRead())
+        {
+            return result;
+        }
+    }
+    return -1;
+}
+
+template <typename ValueType> template <typename EntryType>
+int AtomicAdaptiveRadixTree<ValueType>::upsertAll(EntryType* entries, const size_t count,
+                                                  ValueType* (*cb)(void* data, EntryType& entry, ValueType* value),
+                                                  void* data,
+                                                  bool (*check)(void* data, const EntryType& entry,
+                                                                const ValueType* value))
+{
+    if (!preWrite())
+    {
+        return -1;
+    }
+    for (size_t i = 0; check != nullptr && i < count; i++)
+    {
+        if (!check(data, entries[i], AdaptiveRadixTree<ValueType>::search(entries[i].key, entries[i].keyLength)))
+        {
+            postWrite();
+            return -1;
+        }
+    }
+
+    // Binds each entry to the callback of the single key upsert.
+    struct EntryUpsert
+    {
+        EntryType* entry;
+        ValueType* (*cb)(void* data, EntryType& entry, ValueType* value);
+        void* data;
+
+        static ValueType* callback(void* entryUpsert, ValueType* value)
+        {
+            auto* context = static_cast<EntryUpsert*>(entryUpsert);
+            return context->cb(context->data, *context->entry, value);
+        }
+    };
+
+    int         result = 0;
+    EntryUpsert entryUpsert{nullptr, cb, data};
+    for (size_t i = 0; i < count && result == 0; i++)
+    {
+        entryUpsert.entry = &entries[i];
+        if (AdaptiveRadixTree<ValueType>::upsert(entries[i].key, entries[i].keyLength, EntryUpsert::callback,
+                                                 &entryUpsert) == nullptr)
+        {
+            result = -1;
+        }
+    }
+    postWrite();
+    return result;
+}
+
+template <typename ValueType> template <typename EntryType>
+int AtomicAdaptiveRadixTree<ValueType>::insertAllIfNotExists(EntryType* entries, const size_t count)
+{
+    if (!preWrite())
+    {
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        entries[i].existingValue =
+            AdaptiveRadixTree<ValueType>::insertIfNotExists(entries[i].key, entries[i].keyLength, entries[i].value);
+    }
+    postWrite();
+    return 0;
+}
+
 template <typename ValueType> ValueType* AtomicAdaptiveRadixTree<ValueType>::getMinimumValue()
 {
     if (preRead())
@@ -274,7 +469,13 @@ template <typename ValueType> bool AtomicAdaptiveRadixTree<ValueType>::preWrite(
         return false;
     }
     // ReSharper disable once CppDFAUnreachableCode False positive
-    return empty->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS);
+    if (!empty->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
+    {
+        // The readers keep the tree, so the turn is given back to let them, and the next writers, take it.
+        turn->signal();
+        return false;
+    }
+    return true;
 }
 
 template <typename ValueType> void AtomicAdaptiveRadixTree<ValueType>::postWrite() const
@@ -301,6 +502,9 @@ template <typename ValueType> bool AtomicAdaptiveRadixTree<ValueType>::preRead()
     {
         if (!empty->wait(SETTINGS_STORAGE_MUTEX_TIMEOUT_MS))
         {
+            // A writer keeps the tree, so this reader leaves, to let the next readers wait for it too.
+            readers--;
+            readersMutex->signal();
             return false;
         }
     }
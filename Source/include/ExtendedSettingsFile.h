@@ -0,0 +1,140 @@
+#ifndef SETTINGSSTORAGE_EXTENDEDSETTINGSFILE_H
+#define SETTINGSSTORAGE_EXTENDEDSETTINGSFILE_H
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include "SettingsFile.h"
+
+/// How far the data written to a settings file must get before a store returns. Each level includes the previous ones.
+enum class SettingsDurability_t : uint8_t
+{
+    NONE     = 0, // No requirement, the data may still be in the buffers of the settings file.
+    BUFFERED = 1, // The data was handed to the operating system, so it survives a crash of the process.
+    FLUSHED  = 2, // The data was written to the storage, with the metadata needed to read it back.
+    FSYNCED  = 3, // The data and the metadata of the file were written to the storage.
+    MAX_SETTINGS_DURABILITY
+};
+
+/**
+ * @brief A SettingsFile with optional capabilities that SettingsStorage uses to speed up its operations.
+ *
+ * Every capability has a default implementation that reports it as unsupported, so an implementation only overrides
+ * the ones it can provide. SettingsStorage falls back to the plain SettingsFile operations when a capability is not
+ * supported, and only uses them once the file is given to SettingsStorage::setExtendedSettingsFile().
+ */
+class ExtendedSettingsFile : public SettingsFile
+{
+public:
+    /**
+     * @brief Get a read-only view of the whole contents of the file, without copying it.
+     *
+     * @note The file must be opened for read. The view is valid until the file is closed.
+     *
+     * @param data The contents of the file.
+     * @return SettingsFile::Success if the view is available, or SettingsFile::InvalidState if it is not supported.
+     */
+    virtual SettingsFileResult mapForRead(std::string_view& data)
+    {
+        data = {};
+        return InvalidState;
+    }
+
+    /**
+     * @brief Open the file for write without truncating it, so parts of it can be overwritten with writeAt().
+     *
+     * @note The file must exist and be closed. While it is open, getOpenStatus() returns FileOpenedForWrite, and it is
+     * closed with close() like any other file.
+     *
+     * @return SettingsFile::Success if the file was opened, or SettingsFile::InvalidState if it is not supported.
+     */
+    virtual SettingsFileResult openForUpdate()
+    {
+        return InvalidState;
+    }
+
+    /**
+     * @brief Overwrite the data of the file that starts at the provided offset.
+     *
+     * @note The file must be opened with openForUpdate(), and the data must not extend past the end of the file.
+     *
+     * @param offset The offset of the first byte overwritten, from the start of the file.
+     * @param data The data written at the offset.
+     * @return SettingsFile::Success if the data was written, or SettingsFile::InvalidState if it is not supported.
+     */
+    virtual SettingsFileResult writeAt(size_t offset, std::string_view data)
+    {
+        (void)offset;
+        (void)data;
+        return InvalidState;
+    }
+
+    /**
+     * @brief Open the file for read and write, and map it in memory, so it can be modified in place.
+     *
+     * @note The file is created if it does not exist, and it is extended with zeros if it is smaller than the provided
+     * size. If the file is already mapped for update, it is mapped again, and the previous mapping is no longer valid.
+     * While it is mapped, getOpenStatus() returns FileOpenedForWrite, and it is unmapped and closed with close(). The
+     * changes can reach the file at any time and in any order, syncMapped() waits until they do.
+     *
+     * @param size The minimum size of the file, or 0 to keep its size.
+     * @param data The start of the mapped file, or nullptr if it is empty.
+     * @param mappedSize The size of the mapped file.
+     * @return SettingsFile::Success if the file was mapped, or SettingsFile::InvalidState if it is not supported.
+     */
+    virtual SettingsFileResult mapForUpdate(size_t size, char*& data, size_t& mappedSize)
+    {
+        (void)size;
+        data       = nullptr;
+        mappedSize = 0;
+        return InvalidState;
+    }
+
+    /**
+     * @brief Write the changes of a range of the file mapped with mapForUpdate() to the storage, and wait until they
+     * are written.
+     *
+     * @param offset The offset of the first byte of the range, from the start of the file.
+     * @param length The length of the range.
+     * @return SettingsFile::Success if the range was written, or SettingsFile::InvalidState if it is not supported.
+     */
+    virtual SettingsFileResult syncMapped(size_t offset, size_t length)
+    {
+        (void)offset;
+        (void)length;
+        return InvalidState;
+    }
+
+    /**
+     * @brief Write several buffers after the data already written, in order, and wait once until all of them are
+     * written, so the implementation can submit them together.
+     *
+     * @note The file must be opened with openForWrite(). The buffers only need to stay valid until it returns.
+     *
+     * @param buffers The buffers to write.
+     * @return SettingsFile::Success if the buffers were written, or SettingsFile::InvalidState if it is not supported.
+     */
+    virtual SettingsFileResult writeBuffers(std::span<const std::string_view> buffers)
+    {
+        (void)buffers;
+        return InvalidState;
+    }
+
+    /**
+     * @brief Wait until the data written since the file was opened reaches the provided durability.
+     *
+     * @note The file must be opened for write, with openForWrite(), openForUpdate() or mapForUpdate(). It is still open
+     * afterward, and it is closed with close() as usual.
+     *
+     * @param durability The durability the data must reach.
+     * @return SettingsFile::Success if the data reached the durability, or SettingsFile::InvalidState if it is not
+     * supported.
+     */
+    virtual SettingsFileResult sync(SettingsDurability_t durability)
+    {
+        (void)durability;
+        return InvalidState;
+    }
+};
+
+#endif // SETTINGSSTORAGE_EXTENDEDSETTINGSFILE_H
@@ -0,0 +1,96 @@
+#ifndef SETTINGSSTORAGE_SETTINGSCHECKSUM_H
+#define SETTINGSSTORAGE_SETTINGSCHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// Checksum algorithms that can protect a settings file. The value is stored in the file header, so never renumber.
+enum class SettingsChecksumAlgorithm_t : uint8_t
+{
+    CRC32  = 0, // IEEE 802.3 polynomial, used by the files without header.
+    CRC32C = 1, // Castagnoli polynomial, hardware accelerated on SSE4.2.
+    MAX_SETTINGS_CHECKSUM_ALGORITHM
+};
+
+#ifndef CONFIG_SETTINGS_STORAGE_CHECKSUM_ALGORITHM
+    #define CONFIG_SETTINGS_STORAGE_CHECKSUM_ALGORITHM 1 // SettingsChecksumAlgorithm_t::CRC32C
+#endif
+
+/**
+ * @brief Incremental CRC engine used to protect the settings files.
+ *
+ * The software implementation uses slicing-by-8 over lookup tables built at compile time. On x86-64 Linux, the
+ * SSE4.2 crc32 instruction (CRC32C) and PCLMULQDQ folding (CRC32) are used when the CPU supports them.
+ * Every value handled by this class is a finished CRC, so it can be stored and resumed later.
+ */
+class SettingsChecksum
+{
+public:
+    /**
+     * @brief Build a new checksum with no data.
+     * @param algorithm The algorithm to use.
+     */
+    explicit SettingsChecksum(SettingsChecksumAlgorithm_t algorithm);
+
+    /// Discard all the data added to the checksum.
+    void reset();
+
+    /**
+     * @brief Add data to the checksum.
+     * @param data The data to add.
+     * @param size The size of data in bytes.
+     */
+    void update(const void* data, size_t size);
+
+    /// Get the checksum of all the data added since the last reset.
+    [[nodiscard]] uint32_t getValue() const;
+
+    /// Get the number of bytes added since the last reset.
+    [[nodiscard]] uint64_t getSize() const;
+
+    /// Get the algorithm used by this checksum.
+    [[nodiscard]] SettingsChecksumAlgorithm_t getAlgorithm() const;
+
+    /**
+     * @brief Calculate the checksum of a buffer, optionally resuming from the checksum of the preceding data.
+     * @param algorithm The algorithm to use.
+     * @param data The data to checksum.
+     * @param size The size of data in bytes.
+     * @param crc The checksum of the preceding data, or 0 to start a new checksum.
+     * @param allowHardwareAcceleration If false, the software implementation is always used.
+     * @return uint32_t The checksum of the preceding data followed by data.
+     */
+    static uint32_t calculate(SettingsChecksumAlgorithm_t algorithm, const void* data, size_t size, uint32_t crc = 0,
+                              bool allowHardwareAcceleration = true);
+
+    /**
+     * @brief Merge the checksums of two consecutive chunks of data.
+     * @param algorithm The algorithm used to calculate both checksums.
+     * @param crc1 The checksum of the first chunk.
+     * @param crc2 The checksum of the second chunk, calculated from scratch.
+     * @param size2 The size of the second chunk in bytes.
+     * @return uint32_t The checksum of the first chunk followed by the second chunk.
+     */
+    static uint32_t combine(SettingsChecksumAlgorithm_t algorithm, uint32_t crc1, uint32_t crc2, uint64_t size2);
+
+    /**
+     * @brief Check if the calculation of an algorithm is accelerated by hardware on this CPU.
+     * @param algorithm The algorithm to check.
+     * @return True if a hardware implementation is used, false otherwise.
+     */
+    static bool isHardwareAccelerated(SettingsChecksumAlgorithm_t algorithm);
+
+    /**
+     * @brief Check if an algorithm identifier read from a file is supported.
+     * @param algorithm The algorithm to check.
+     * @return True if the algorithm is supported, false otherwise.
+     */
+    static bool isValidAlgorithm(SettingsChecksumAlgorithm_t algorithm);
+
+private:
+    SettingsChecksumAlgorithm_t algorithm;
+    uint32_t                    crc;
+    uint64_t                    size;
+};
+
+#endif // SETTINGSSTORAGE_SETTINGSCHECKSUM_H
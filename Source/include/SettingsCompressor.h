@@ -0,0 +1,120 @@
+#ifndef SETTINGSSTORAGE_SETTINGSCOMPRESSOR_H
+#define SETTINGSSTORAGE_SETTINGSCOMPRESSOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// Compression algorithms of the records of a settings file. The value is stored in the file header, so never renumber.
+enum class SettingsCompressionAlgorithm_t : uint8_t
+{
+    NONE            = 0, // The records are stored as text.
+    FRONT_CODING_LZ = 1, // Front coding of the keys followed by an LZ77 codec, in blocks.
+    MAX_SETTINGS_COMPRESSION_ALGORITHM
+};
+
+#ifndef CONFIG_SETTINGS_STORAGE_COMPRESSION_ALGORITHM
+    #define CONFIG_SETTINGS_STORAGE_COMPRESSION_ALGORITHM 0 // SettingsCompressionAlgorithm_t::NONE
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_COMPRESSION_BLOCK_SIZE
+    #define CONFIG_SETTINGS_STORAGE_COMPRESSION_BLOCK_SIZE 4096
+#endif
+
+/// Biggest block of front coded records that a compressed line can hold, so the LZ77 offsets fit in 16 bits.
+constexpr size_t SETTINGS_COMPRESSION_MAX_BLOCK_SIZE = 65536;
+
+/**
+ * @brief Streaming encoder of the records of a compressed settings file.
+ *
+ * Each key is replaced by the length of the prefix it shares with the previous key, followed by the rest of the key.
+ * The settings are stored sorted by key, so most keys only keep their last characters. The front coded records are
+ * then split in blocks of a fixed size, and each block is compressed with an LZ77 codec whose matches never cross the
+ * block. Each compressed block is escaped so it contains no NUL, carriage return or new line characters, and stored as
+ * one line, so compressed files can be read with SettingsFile::readLine() like any other settings file.
+ *
+ * The records can be fed in pieces of any size; only the front coding state and one block are kept in memory.
+ */
+class SettingsCompressor
+{
+public:
+    /**
+     * @brief Build a new Settings Compressor object.
+     *
+     * @param blockSize The size of the blocks of front coded records that are compressed as a whole. Bigger blocks
+     * compress better, at the cost of RAM. It must not be bigger than SETTINGS_COMPRESSION_MAX_BLOCK_SIZE.
+     */
+    explicit SettingsCompressor(size_t blockSize = CONFIG_SETTINGS_STORAGE_COMPRESSION_BLOCK_SIZE);
+
+    /// Start a new stream of records, discarding any data that was not compressed yet.
+    void begin();
+
+    /**
+     * @brief Add records to the stream.
+     * @param records The records to add. They do not need to start or end at a record boundary.
+     * @param output The string where the lines of the blocks that are completed are appended.
+     */
+    void compress(std::string_view records, std::string& output);
+
+    /**
+     * @brief Compress the last block of the stream and start a new stream.
+     * @param output The string where the line of the last block is appended, if any data is pending.
+     */
+    void end(std::string& output);
+
+private:
+    std::string          block;
+    std::string          key;
+    std::string          previousKey;
+    std::vector<int32_t> hashTable;
+    size_t               blockSize;
+    bool                 inKey;
+
+    void compressBlock(std::string_view data, std::string& output);
+};
+
+/**
+ * @brief Streaming decoder of the records of a compressed settings file, see SettingsCompressor.
+ *
+ * The lines must be decompressed in the order they are stored. Corrupted lines are detected when they can not be
+ * decoded, and the checksum of the decompressed records detects the rest.
+ */
+class SettingsDecompressor
+{
+public:
+    /// Build a new Settings Decompressor object.
+    SettingsDecompressor();
+
+    /// Start a new stream of records.
+    void begin();
+
+    /**
+     * @brief Decompress the next line of the stream.
+     * @param data The line, with or without its new line character.
+     * @param records The string where the decompressed records are appended. The last record may be incomplete, and
+     * it is completed by the next line.
+     * @return True if the line was decompressed, false if it is corrupted.
+     */
+    [[nodiscard]] bool decompress(std::string_view data, std::string& records);
+
+private:
+    typedef enum
+    {
+        RecordStart,
+        Key,
+        Value
+    } DecoderState_t;
+
+    std::string    line;
+    std::string    block;
+    std::string    key;
+    std::string    previousKey;
+    DecoderState_t state;
+
+    [[nodiscard]] bool decompressBlock(std::string_view data);
+    [[nodiscard]] bool decodeRecords(std::string_view data, std::string& records);
+};
+
+#endif // SETTINGSSTORAGE_SETTINGSCOMPRESSOR_H
@@ -0,0 +1,202 @@
+#ifndef SETTINGSSTORAGE_SETTINGSMAPPEDTREE_H
+#define SETTINGSSTORAGE_SETTINGSMAPPEDTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+/**
+ * @brief Tree of setting records laid out in a region of memory, usually a settings file mapped in memory, so the
+ * records are looked up in place instead of being parsed when the file is opened.
+ *
+ * Each record is a line of the text settings files without its new line, key\ttype\tvalue, so it is parsed like them.
+ * The nodes reference each other by their offset from the start of the region, so the region can be mapped at any
+ * address. The tree is a treap ordered by key, whose priorities are the checksums of the keys, so it stays balanced
+ * without storing anything else, and each node has a checksum of its own.
+ *
+ * The nodes are never modified once they are committed. Each change copies the nodes from the root to the record into
+ * the free space after them, and commit() publishes the new root in one of the two superblocks of the header, the one
+ * that does not hold the last committed tree. Once the new nodes are written to the file, and then the header, a crash
+ * at any point leaves either the previous or the new tree in the file. When most of the space is taken by nodes that
+ * are no longer used, the tree is built again with rebuild(), at the start of the region if it fits there.
+ *
+ * The region starts like the header line of the settings files of format version 4, so the text parsers reject it.
+ */
+class SettingsMappedTree
+{
+public:
+    /// The size of the header of the region, with the superblocks. The nodes are stored after it.
+    static constexpr size_t HEADER_SIZE = 4096;
+
+    /// Called for each record by iterate(), with the id of the record. It returns non-zero to stop the iteration.
+    typedef int (*SettingsMappedRecordCallback_t)(void* data, std::string_view record, uint32_t id);
+
+    /// Build a new Settings Mapped Tree object that is not attached to any region.
+    SettingsMappedTree();
+
+    /**
+     * @brief Check if the data starts like a mapped tree, without validating it.
+     * @param data The data to check, e.g. the contents of a settings file.
+     * @return True if the data starts with the signature of a mapped tree, false otherwise.
+     */
+    static bool isMappedTree(std::string_view data);
+
+    /**
+     * @brief Attach the tree to a region that can only be read. Only the header is validated, the nodes are validated
+     * when they are read.
+     * @param data The region. It must stay valid until the tree is detached.
+     * @return True if the region holds a committed tree, false otherwise.
+     */
+    bool attach(std::string_view data);
+
+    /**
+     * @brief Attach the tree to a region that can be modified, see attach(std::string_view).
+     * @param data The region. It must stay valid until the tree is detached or remapped.
+     * @param size The size of the region.
+     * @return True if the region holds a committed tree, false otherwise.
+     */
+    bool attach(char* data, size_t size);
+
+    /**
+     * @brief Attach the tree to a region that does not hold a tree, and start an empty tree in it.
+     *
+     * @note The signature is written and both superblocks are cleared, so the region does not hold a valid tree until
+     * the empty tree, or the tree built on it, is committed.
+     *
+     * @param data The region. It must stay valid until the tree is detached or remapped.
+     * @param size The size of the region. It must be at least HEADER_SIZE.
+     */
+    void create(char* data, size_t size);
+
+    /**
+     * @brief Move the tree to another address or size of the same region, e.g. after the file is extended.
+     * @param data The region, with the same contents up to the smallest of both sizes.
+     * @param size The size of the region.
+     */
+    void remap(char* data, size_t size);
+
+    /// Detach the tree from its region, discarding the changes that are not committed.
+    void detach();
+
+    /// Check if the tree is attached to a region.
+    [[nodiscard]] bool isAttached() const;
+
+    /// Get the size of the region.
+    [[nodiscard]] size_t getRegionSize() const;
+
+    /// Get the number of records of the tree. The ids of the records are lower than it.
+    [[nodiscard]] uint32_t getCount() const;
+
+    /// Check if the nodes that are no longer used take more space than the ones of the tree.
+    [[nodiscard]] bool needsCompaction() const;
+
+    /**
+     * @brief Search the record of a key.
+     * @param key The key.
+     * @param record The record of the key. It is valid until the region is detached or remapped.
+     * @param id The id of the record.
+     * @return True if the key was found, false if it was not found or its node is corrupted.
+     */
+    bool search(std::string_view key, std::string_view& record, uint32_t& id) const;
+
+    /**
+     * @brief Invoke a callback for each record whose key starts with a prefix, in key order.
+     * @param firstKey The records whose key is lower than this one are skipped.
+     * @param prefix The prefix of the keys of the records, or "" for every record.
+     * @param cb The callback function to invoke.
+     * @param data Opaque handle passed to the callback.
+     * @return Zero on success, the return of the callback, or -1 if a corrupted node was found.
+     */
+    int iterate(std::string_view firstKey, std::string_view prefix, SettingsMappedRecordCallback_t cb,
+                void* data) const;
+
+    /**
+     * @brief Insert a record, or replace the record of its key, without committing it.
+     * @param record The record, key\ttype\tvalue.
+     * @param requiredSize Set to the size of the region needed to insert the record if it does not fit, or 0.
+     * @return True if the record was inserted, false if it does not fit or the tree is corrupted. The tree is not
+     * modified if it fails.
+     */
+    bool put(std::string_view record, size_t& requiredSize);
+
+    /**
+     * @brief Replace the whole tree by a new tree with the provided records, without committing it. The changes that
+     * were not committed are discarded.
+     * @param records The records, sorted by key, without repeated keys.
+     * @param requiredSize Set to the size of the region needed to build the tree if it does not fit, or 0.
+     * @return True if the tree was built, false if it does not fit or the records are invalid. The tree is not
+     * modified if it fails.
+     */
+    bool rebuild(std::span<const std::string_view> records, size_t& requiredSize);
+
+    /// Check if the tree has changes that are not committed.
+    [[nodiscard]] bool hasChanges() const;
+
+    /**
+     * @brief Get the range of the region written by the changes that are not committed, except the header. It must be
+     * written to the file before the changes are committed.
+     * @param offset The offset of the range.
+     * @param length The length of the range.
+     */
+    void getChanges(size_t& offset, size_t& length) const;
+
+    /**
+     * @brief Publish the changes in the superblock that does not hold the last committed tree. The header must be
+     * written to the file afterward, and the tree in it is the committed tree from then on.
+     */
+    void commit();
+
+private:
+    /// The root of a tree, stored twice in the header. The one with the highest generation is the committed tree.
+    typedef struct SettingsMappedSuperblock_t
+    {
+        uint64_t generation; // 0 if the superblock was never written.
+        uint32_t root;       // Offset of the root node, 0 if the tree is empty.
+        uint32_t count;
+        uint32_t nodesStart; // The nodes of the tree are in [nodesStart, nodesEnd).
+        uint32_t nodesEnd;
+        uint32_t liveSize; // Size of the nodes of the tree, the rest of the range is no longer used.
+        uint32_t checksum; // CRC32C of the other members.
+    } SettingsMappedSuperblock_t;
+
+    /// A node of the tree, followed by its record and padded to NODE_ALIGNMENT.
+    typedef struct SettingsMappedNode_t
+    {
+        uint32_t left; // Offsets of the children, 0 if there is none.
+        uint32_t right;
+        uint32_t priority; // CRC32C of the key, no child has a higher one.
+        uint32_t id;
+        uint32_t recordLength;
+        uint16_t keyLength;
+        uint16_t reserved;
+        uint32_t checksum; // CRC32C of the record and the other members.
+        uint32_t padding;
+    } SettingsMappedNode_t;
+
+    char*                      region;
+    size_t                     regionSize;
+    bool                       writable;
+    uint32_t                   committedSlot; // Superblock of the committed tree.
+    SettingsMappedSuperblock_t committed;
+    SettingsMappedSuperblock_t current; // The committed tree with the changes that are not committed.
+    uint32_t                   changesStart;
+    bool                       changed;
+
+    bool                        attachRegion(char* data, size_t size, bool canWrite);
+    const SettingsMappedNode_t* getNode(uint32_t offset) const;
+    SettingsMappedNode_t*       getFreshNode(uint32_t offset) const;
+    uint32_t                    allocateNode(std::string_view record, uint16_t keyLength, uint32_t id);
+    uint32_t                    copyNode(uint32_t offset);
+    uint32_t                    putNode(uint32_t offset, std::string_view record, uint16_t keyLength, bool& inserted,
+                                        uint32_t& replacedSize);
+    void                        sealNodes(uint32_t start, uint32_t end) const;
+    static std::string_view     getRecord(const SettingsMappedNode_t* node);
+    static std::string_view     getKey(const SettingsMappedNode_t* node);
+    static uint32_t             getNodeSize(size_t recordLength);
+    static uint32_t             getNodeChecksum(const SettingsMappedNode_t* node);
+    static uint32_t             getSuperblockChecksum(const SettingsMappedSuperblock_t& superblock);
+    static size_t               getKeyLength(std::string_view record);
+};
+
+#endif // SETTINGSSTORAGE_SETTINGSMAPPEDTREE_H
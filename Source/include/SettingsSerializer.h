@@ -0,0 +1,118 @@
+#ifndef SETTINGSSTORAGE_SETTINGSSERIALIZER_H
+#define SETTINGSSTORAGE_SETTINGSSERIALIZER_H
+
+#include <string>
+#include <string_view>
+#include "SettingsChecksum.h"
+#include "SettingsCompressor.h"
+#include "SettingsFile.h"
+
+#ifndef CONFIG_SETTINGS_STORAGE_SERIALIZER_BUFFER_SIZE
+    #define CONFIG_SETTINGS_STORAGE_SERIALIZER_BUFFER_SIZE 512
+#endif
+
+/**
+ * @brief Buffered writer used to serialize the settings into a SettingsFile.
+ *
+ * The records are formatted into a fixed-size buffer that is allocated once, when the serializer is built, and
+ * flushed to the SettingsFile in whole blocks. Numbers are formatted with std::to_chars, so appending data never
+ * allocates memory in the heap. The checksum of the flushed data is updated once per block.
+ *
+ * When a compressor is attached, the checksummed data is compressed before it is written, and the checksum is still
+ * calculated over the uncompressed data.
+ */
+class SettingsSerializer
+{
+public:
+    /**
+     * @brief Build a new Settings Serializer object.
+     *
+     * @param bufferSize The size of the block buffer. It must be big enough to hold any formatted number.
+     */
+    explicit SettingsSerializer(size_t bufferSize = CONFIG_SETTINGS_STORAGE_SERIALIZER_BUFFER_SIZE);
+
+    /**
+     * @brief Start a new serialization, discarding any buffered data and resetting the checksum.
+     *
+     * @param settingsFile The settings file where the blocks will be flushed. It must be opened for write.
+     * @param checksumAlgorithm The algorithm used to checksum the flushed data.
+     * @param compressor The compressor of the checksummed data, or nullptr to write it as it is.
+     */
+    void begin(SettingsFile*               settingsFile,
+               SettingsChecksumAlgorithm_t checksumAlgorithm = SettingsChecksumAlgorithm_t::CRC32,
+               SettingsCompressor*         compressor        = nullptr);
+
+    /**
+     * @brief Start a new serialization into memory, discarding any buffered data and resetting the checksum.
+     *
+     * @param output The string where the blocks will be appended when flushed, instead of writing them to a file.
+     * @param checksumAlgorithm The algorithm used to checksum the flushed data.
+     */
+    void beginInMemory(std::string*               output,
+                       SettingsChecksumAlgorithm_t checksumAlgorithm = SettingsChecksumAlgorithm_t::CRC32);
+
+    /**
+     * @brief Append raw data to the buffer, flushing it as many times as needed.
+     * @param data The data to append.
+     * @return SettingsFile::Success if the data was appended, or the error returned by the settings file otherwise.
+     */
+    SettingsFile::SettingsFileResult append(std::string_view data);
+
+    /**
+     * @brief Append a single character to the buffer, flushing it if it is full.
+     * @param character The character to append.
+     * @return SettingsFile::Success if the data was appended, or the error returned by the settings file otherwise.
+     */
+    SettingsFile::SettingsFileResult append(char character);
+
+    /**
+     * @brief Append the decimal representation of an integer to the buffer.
+     * @param value The value to append.
+     * @return SettingsFile::Success if the data was appended, or the error returned by the settings file otherwise.
+     */
+    SettingsFile::SettingsFileResult append(int64_t value);
+
+    /**
+     * @brief Append the decimal representation of an unsigned integer to the buffer.
+     * @param value The value to append.
+     * @return SettingsFile::Success if the data was appended, or the error returned by the settings file otherwise.
+     */
+    SettingsFile::SettingsFileResult append(uint32_t value);
+
+    /**
+     * @brief Append the shortest representation of a real that parses back to the same value.
+     * @param value The value to append.
+     * @return SettingsFile::Success if the data was appended, or the error returned by the settings file otherwise.
+     */
+    SettingsFile::SettingsFileResult append(double value);
+
+    /**
+     * @brief Write the buffered data to the settings file and empty the buffer.
+     * @note Data that is not checksummed, like the header and checksum lines, is never compressed. Flushing it ends
+     * the compressed stream first, so the compressed data is written before it.
+     * @param updateChecksum If true, the flushed data is added to the checksum.
+     * @return SettingsFile::Success if the data was written, or the error returned by the settings file otherwise.
+     */
+    SettingsFile::SettingsFileResult flush(bool updateChecksum = true);
+
+    /**
+     * @brief Get the checksum of all the data flushed with updateChecksum enabled since the last call to begin().
+     * @note Buffered data is not included until it is flushed.
+     * @return uint32_t The checksum.
+     */
+    [[nodiscard]] uint32_t getChecksum() const;
+
+private:
+    SettingsFile*       settingsFile;
+    std::string*        output;
+    SettingsCompressor* compressor;
+    std::string         buffer;
+    std::string         compressedBuffer;
+    size_t              bufferSize;
+    SettingsChecksum    checksum;
+
+    SettingsFile::SettingsFileResult reserve(size_t size);
+    SettingsFile::SettingsFileResult write(const std::string& data);
+};
+
+#endif // SETTINGSSTORAGE_SETTINGSSERIALIZER_H
@@ -1,21 +1,91 @@
 #ifndef SETTINGSSTORAGE_SETTINGS_H
 #define SETTINGSSTORAGE_SETTINGS_H
 
-#define CRCPP_USE_CPP11
-
+#include <atomic>
+#include <cstddef>
+#include <map>
+#include <span>
 #include <string>
+#include <vector>
 #include "AtomicLibARTCpp.h"
-#include "CRC.h"
+#include "ExtendedSettingsFile.h"
 #include "OSInterface.h"
 #include "SettingsFile.h"
+#include "SettingsMappedTree.h"
+#include "SettingsSerializer.h"
+#include "SettingsTaskFactory.h"
+#include "SettingsValuePool.h"
 #include "list"
 
 #ifndef CONFIG_SETTINGS_STORAGE_FORCE_DISABLE_PERSISTENT_STORAGE
     #define CONFIG_SETTINGS_STORAGE_FORCE_DISABLE_PERSISTENT_STORAGE false
 #endif
 
-constexpr size_t PERMISSION_STRING_SIZE = 34;
-constexpr size_t MAX_SETTING_KEY_SIZE   = 128;
+#ifndef CONFIG_SETTINGS_STORAGE_STORE_THREADS
+    #define CONFIG_SETTINGS_STORAGE_STORE_THREADS 1
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_PARALLEL_STORE_MIN_SETTINGS_PER_THREAD
+    #define CONFIG_SETTINGS_STORAGE_PARALLEL_STORE_MIN_SETTINGS_PER_THREAD 4096
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_LOAD_THREADS
+    #define CONFIG_SETTINGS_STORAGE_LOAD_THREADS 1
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_PARALLEL_LOAD_MIN_CHUNK_SIZE
+    #define CONFIG_SETTINGS_STORAGE_PARALLEL_LOAD_MIN_CHUNK_SIZE 65536
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_LOAD_BATCH_SIZE
+    #define CONFIG_SETTINGS_STORAGE_LOAD_BATCH_SIZE 256
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_PENDING_SETTINGS_WAIT_MS
+    #define CONFIG_SETTINGS_STORAGE_PENDING_SETTINGS_WAIT_MS 100
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_SPARSE_STORE
+    #define CONFIG_SETTINGS_STORAGE_SPARSE_STORE false
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS
+    #define CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS 10000
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_STORE_DURABILITY
+    #define CONFIG_SETTINGS_STORAGE_STORE_DURABILITY 0
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_STORE_UNCHANGED_FILES
+    #define CONFIG_SETTINGS_STORAGE_STORE_UNCHANGED_FILES false
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_BLOCK_RECORDS
+    #define CONFIG_SETTINGS_STORAGE_BLOCK_RECORDS 64
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_TASK_STACK_SIZE
+    #define CONFIG_SETTINGS_STORAGE_TASK_STACK_SIZE 8192
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_TASK_PRIORITY
+    #define CONFIG_SETTINGS_STORAGE_TASK_PRIORITY 5
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_TASK_CORE
+    #define CONFIG_SETTINGS_STORAGE_TASK_CORE (-1)
+#endif
+
+constexpr size_t   PERMISSION_STRING_SIZE                  = 34;
+constexpr size_t   MAX_SETTING_KEY_SIZE                    = 128;
+constexpr size_t   MAX_SETTING_RECORD_TEXT_SIZE            = 28; // Longest number record after its key, with its tabs.
+constexpr uint32_t SETTINGS_FILE_FORMAT_VERSION            = 1; // Files without header line are version 0.
+constexpr uint32_t SETTINGS_FILE_COMPRESSED_FORMAT_VERSION = 2; // Adds the compression algorithm to the header line.
+constexpr uint32_t SETTINGS_FILE_SLOTTED_FORMAT_VERSION    = 3; // Records of fixed size, each with its own checksum.
+constexpr uint32_t SETTINGS_FILE_MAPPED_FORMAT_VERSION     = 4; // Binary tree of records, see SettingsMappedTree.
+constexpr uint32_t SETTINGS_FILE_BLOCKED_FORMAT_VERSION    = 5; // Blocks of records, each with its own checksum.
+constexpr uint32_t SETTINGS_IMAGE_FORMAT_VERSION           = 1; // Version of the buffers of exportToBuffer().
 
 /**
  * @brief The permissions that can be granted to a setting.
@@ -44,6 +114,16 @@ enum SettingPermissionsFilterMode_t
     ExcludeSettingsWithAnyPermissionsListed
 };
 
+/// Enum that stores the modes in which the settings are stored in the persistent storage.
+enum SettingsStoreMode_t
+{
+    StoreAllSettings = 0,      // Every setting that is not volatile is stored.
+    StoreModifiedSettings,     // Only the settings whose value differs from their default value are stored.
+    StoreSettingsInSlots,      // Every setting that is not volatile is stored in a record of fixed size.
+    StoreSettingsInMappedTree, // Every setting that is not volatile is stored in a tree of records, mapped in memory.
+    StoreSettingsInBlocks,     // Every setting that is not volatile is stored in blocks of records, each checksummed.
+};
+
 /// This operator overload allows the enum SettingPermissions_t to have a bitwise OR operator.
 SettingPermissions_t operator|(SettingPermissions_t lhs, SettingPermissions_t rhs);
 
@@ -74,6 +154,14 @@ public:
     /// List of keys that match the provided key prefix.
     using SettingsKeysList_t = std::list<std::string>;
 
+    /// The keys of a settings file whose records were corrupted, and were skipped by the last load.
+    typedef struct SettingsKeyRange_t
+    {
+        std::string keyPrefix; // Of the shard of the file, "" for the settings file of the constructor.
+        std::string afterKey;  // The keys are after this one, or "" if they can start at the first key of the file.
+        std::string beforeKey; // The keys are before this one, or "" if they can end at the last key of the file.
+    } SettingsKeyRange_t;
+
     /// Enum that stores the possible errors returned by the SettingsStorage API.
     typedef enum
     {
@@ -84,7 +172,9 @@ public:
         KEY_EXISTS_ERROR,
         SETTINGS_FILESYSTEM_ERROR,
         INVALID_INPUT_ERROR,
-        INSUFFICIENT_BUFFER_SIZE_ERROR
+        INSUFFICIENT_BUFFER_SIZE_ERROR,
+        TIMEOUT_ERROR,
+        DAMAGED_SETTINGS_ERROR
     } SettingError_t;
 
     /// Enum with the types of data that can be saved.
@@ -104,21 +194,72 @@ public:
         char*   string;
     } SettingValueData_t;
 
+    /// The lengths of a string setting, kept so they are not counted on every read.
+    typedef struct SettingStringData_t
+    {
+        uint32_t length;
+        uint32_t capacity; // Size of the buffer of the string value, 0 if it has none.
+        uint32_t defaultLength;
+        bool     defaultStatic; // The default value is in the table of registerSettings().
+    } SettingStringData_t;
+
+    /// The record of a number after its key (\t<type>\t<value>\n) as formatted by a store, and the value it was
+    /// formatted from, see SettingsRecordCache_t.
+    typedef struct SettingRecordText_t
+    {
+        SettingValueData_t value;
+        uint8_t            size; // 0 if the record was not formatted.
+        char               text[MAX_SETTING_RECORD_TEXT_SIZE];
+    } SettingRecordText_t;
+
     /// The value of each setting element.
     typedef struct SettingValue_t
     {
-        SettingValueType_t   settingValueType;
-        SettingValueData_t   settingValueData;
-        SettingValueData_t   settingDefaultValueData;
+        SettingValueType_t settingValueType;
+        SettingValueData_t settingValueData;
+        SettingValueData_t settingDefaultValueData;
+        // The string value shares the buffer of the default value until it is modified. It then has a buffer of its
+        // own, from the pool if there is one, that the shorter values reuse.
+        SettingStringData_t  settingString; // Only used if settingValueType is STRING.
         SettingPermissions_t settingPermissions;
+        bool                 settingValuePersisted; // The last settings file stored or loaded has a record of it.
+        bool                 settingValueRecorded;  // The file being stored has a record of it.
+        SettingsDurability_t settingDurability;     // Required by the stores of its file once it changes.
+        // Hash of its key and value, 0 if it is volatile, see getSubtreeHash(). It is changed and read atomically.
+        alignas(std::atomic_ref<uint64_t>::required_alignment) uint64_t settingHash;
     } SettingValue_t;
 
+    // Every setting has a value, so the records of the numbers and the short strings are kept out of it, in the caches
+    // of the stores and in the pool, and it only grows with new fields of its own.
+    static_assert(sizeof(SettingValue_t) <= 56, "SettingValue_t must not hold the caches of the stores");
+
+    /// Union with the default value of a setting described at compile time.
+    typedef union
+    {
+        double      real;
+        int64_t     integer;
+        const char* string;
+    } SettingDescriptorValue_t;
+
+    /// A setting created by registerSettings(). The tables of descriptors can be constexpr, kept in read-only memory.
+    typedef struct SettingDescriptor_t
+    {
+        const char*              key;
+        SettingValueType_t       valueType;
+        SettingPermissions_t     permissions;
+        SettingDescriptorValue_t defaultValue;
+        SettingsDurability_t     durability = SettingsDurability_t::NONE;
+    } SettingDescriptor_t;
+
     /// String with the name of the component.
     constexpr static const char* const COMPONENT_TAG = "PurifyMyWater - SettingsStorage";
 
     /// The data structure used internally to store the settings.
     typedef AtomicAdaptiveRadixTree<SettingValue_t> Settings_t;
 
+    /// Called with the result of a store started by storeSettingsAsync().
+    typedef void (*SettingsStoreCompletionCallback_t)(void* data, SettingError_t result);
+
     /**
      * @brief Build a new empty Settings Storage object.
      *
@@ -149,6 +290,67 @@ public:
      */
     [[nodiscard]] bool disablePersistentStorage();
 
+    /**
+     * @brief Store the settings whose key starts with the provided prefix in their own settings file, called a shard.
+     *
+     * @note Each shard is a complete settings file, with its own header and checksum. A setting belongs to the shard
+     * with the longest prefix of its key, and the settings that do not belong to any shard are stored in the settings
+     * file of the constructor. Once a shard is added, storeSettingsInPersistentStorage() only rewrites the files whose
+     * settings were registered, updated or restored since they were last stored, so updating a setting does not
+     * rewrite the settings of the other files. Without shards, the settings file is rewritten by every store whose
+     * settings changed. In both cases, a file whose settings hash the same as when it was last written, the same way,
+     * is not rewritten, see getSubtreeHash(), unless CONFIG_SETTINGS_STORAGE_STORE_UNCHANGED_FILES is enabled. The
+     * file is only compared by the 64-bit sum of the hashes of its settings, so it is not rewritten either if its
+     * settings changed to values with the same sum, about once in 2^64 stores, or if it was modified by another
+     * writer since it was stored, without being loaded again.
+     *
+     * @note loadSettingsFromPersistentStorage() loads the settings file of the constructor, and then the shards
+     * independently, in parallel when it is given more than one thread. The records of the settings file that belong to
+     * a shard, e.g. stored before the shard was added, are replaced by the shard. A corrupted file does not modify its
+     * settings, nor prevents the other files from being loaded. The lazy and staged loads load the shards eagerly.
+     *
+     * @note The shards must be added before the settings are loaded or stored, and they can not be removed.
+     *
+     * @param keyPrefix The prefix of the keys of the settings of the shard, e.g. "component/".
+     * @param shardFile The settings file of the shard. It must outlive this object.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The shard was added.
+     * @retval INVALID_INPUT_ERROR The keyPrefix is nullptr, "" or too long.
+     * @retval INVALID_INPUT_ERROR The shardFile is nullptr.
+     * @retval INVALID_INPUT_ERROR There is no settings file.
+     * @retval KEY_EXISTS_ERROR There is already a shard with the same prefix.
+     */
+    [[nodiscard]] SettingError_t addSettingsShard(const char* keyPrefix, SettingsFile* shardFile);
+
+    /**
+     * @brief Use the extended capabilities of a settings file to speed up the persistent storage operations, e.g. the
+     * settings are parsed in place when the file can be mapped in memory.
+     *
+     * @note Without it, only the SettingsFile interface of the file is used. It must be called before the settings are
+     * loaded or stored.
+     *
+     * @param settingsFile The settings file of the constructor or of a shard, as the ExtendedSettingsFile it is.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The capabilities of the file are used.
+     * @retval INVALID_INPUT_ERROR The settingsFile is nullptr.
+     * @retval INVALID_INPUT_ERROR The settingsFile is neither the settings file of the constructor nor of a shard.
+     */
+    [[nodiscard]] SettingError_t setExtendedSettingsFile(ExtendedSettingsFile* settingsFile);
+
+    /**
+     * @brief Create the tasks of the parallel loads and stores, of storeSettingsAsync() and of
+     * loadSettingsFromPersistentStorageStaged() with the provided factory, so it decides their stack size, priority and
+     * core, see CONFIG_SETTINGS_STORAGE_TASK_STACK_SIZE, CONFIG_SETTINGS_STORAGE_TASK_PRIORITY and
+     * CONFIG_SETTINGS_STORAGE_TASK_CORE.
+     *
+     * @note Without it, the tasks are created with SettingsTaskFactory::createDefaultTask(). It must be called before
+     * the settings are loaded or stored.
+     *
+     * @param taskFactory The factory of the tasks, typically the OS shim of the constructor. It must outlive this
+     * object. If it is nullptr, the tasks are created by default.
+     */
+    void setTaskFactory(SettingsTaskFactory* taskFactory);
+
     /**
      * @brief Restores the default settings of the settings that match the provided keyPrefix, or all settings if
      * componentName is "".
@@ -161,6 +363,7 @@ public:
      * @retval INVALID_INPUT_ERROR If keyPrefix is nullptr.
      * @retval INVALID_INPUT_ERROR The permissions are invalid.
      * @retval INVALID_INPUT_ERROR The filterMode is invalid.
+     * @retval TIMEOUT_ERROR A setting is still pending in a lazy or staged load and it was not loaded in time.
      */
     [[nodiscard]] SettingError_t
     restoreDefaultSettings(const char* keyPrefix, SettingPermissions_t permissions = ALL_PERMISSIONS,
@@ -172,12 +375,131 @@ public:
      * @note If there are settings in the settingsStorage that are marked as volatile,
      * they will not be saved in the persistent storage.
      *
+     * @note When more than one thread is used, the key space is split into contiguous ranges that are formatted and
+     * checksummed by worker threads, and then written in order. The stored file is identical to the one stored by a
+     * single thread. Each thread formats at least CONFIG_SETTINGS_STORAGE_PARALLEL_STORE_MIN_SETTINGS_PER_THREAD
+     * settings, so small trees are always stored by the calling thread.
+     *
+     * @note When the records are compressed, they are compressed by the calling thread as they are written, see
+     * SettingsCompressor. The algorithm is recorded in the file header, so the settings are loaded the same way
+     * whether they are compressed or not. The checksum protects the uncompressed records.
+     *
+     * @note With StoreModifiedSettings, the settings whose value equals their default value are not stored, so they
+     * keep their current value when the file is loaded, i.e. their default value if they were just registered. A
+     * setting that was stored with another value in the last file stored or loaded is stored as a tombstone record
+     * instead (key\t~type\n), which resets it to its default value when the file is loaded. Older versions of the
+     * library can not load files with tombstone records.
+     *
+     * @note With StoreSettingsInSlots, the records are not compressed, and each one is stored in a slot of fixed size
+     * with its own checksum: key\ttype\t<value size>:<value padded with spaces>\t<checksum in hex>\n. The last line of
+     * the file is the number of records instead of the checksum of the file. Numbers always fit in their slot, and
+     * strings get room to grow, so when the file can be updated in place (see ExtendedSettingsFile::openForUpdate()),
+     * only the slots of the settings that changed are overwritten. The file is rewritten when a setting is added or
+     * removed, when a string outgrows its slot, or when the file was last stored in another mode. A corrupted slot,
+     * e.g. torn by an update that was interrupted, is skipped while the other slots are loaded (see
+     * getDamagedKeyRanges()), and the next store rewrites the file. Older versions of the library can not load slotted
+     * files.
+     *
+     * @note With StoreSettingsInMappedTree, the records are not compressed, and the file holds a SettingsMappedTree
+     * that is updated in place through ExtendedSettingsFile::mapForUpdate(). Only the records that changed are written,
+     * in new nodes of the tree, and the new tree is published once they reach the storage, so a crash leaves either
+     * the previous or the new settings in the file. The tree is built again when a setting is removed, or when most of
+     * the file is taken by nodes that are no longer used. A file stored in another mode is converted to a tree in
+     * place, which is not protected against crashes. The settings file must be an ExtendedSettingsFile that can be
+     * mapped, and older versions of the library can not load mapped tree files.
+     *
+     * @note With StoreSettingsInBlocks, the records are not compressed, and they are grouped in blocks of
+     * CONFIG_SETTINGS_STORAGE_BLOCK_RECORDS records, each one followed by the checksum of its records
+     * (\rb<checksum>\n). The last line of the file is the number of blocks instead of the checksum of the file. The
+     * blocks are validated independently, in parallel when the file is loaded by several threads, and a corrupted
+     * block is skipped while the records of the other blocks are loaded, see getDamagedKeyRanges(). Older versions of
+     * the library can not load blocked files.
+     *
+     * @note Only one store or load uses the files at a time, the others wait for it up to
+     * CONFIG_SETTINGS_STORAGE_PERSISTENCE_WAIT_MS. A store that waited for another one that started after it was
+     * called, with the same compression and mode, and at least the same durability, returns its result instead of
+     * writing the same files again.
+     *
+     * @note Each file written is synced with ExtendedSettingsFile::sync() to the highest of the durability of the store
+     * and the durabilities of the settings that changed in it since it was last stored, see registerSettingAsInt().
+     * The files that are not written keep the durability of the store that wrote them, so with shards, the settings
+     * that need a high durability can be kept in a small shard, and only that shard is synced when they change. A file
+     * that needs a durability above SettingsDurability_t::NONE must be an ExtendedSettingsFile that supports it.
+     * Mapped trees always reach the storage, since their updates depend on it, so they are only synced again for
+     * SettingsDurability_t::FSYNCED.
+     *
+     * @param threads The maximum number of threads used to format the settings, including the calling thread.
+     * @param compression The algorithm used to compress the records.
+     * @param mode The settings that are stored.
+     * @param durability The minimum durability of the files written.
      * @return SettingError_t The result of the operation.
      * @retval NO_ERROR The settings were successfully saved.
+     * @retval INVALID_INPUT_ERROR The compression algorithm is invalid.
+     * @retval INVALID_INPUT_ERROR The mode is invalid.
+     * @retval INVALID_INPUT_ERROR The records stored in slots, in a mapped tree or in blocks can not be compressed.
+     * @retval INVALID_INPUT_ERROR The durability is invalid.
      * @retval SETTINGS_FILESYSTEM_ERROR The settings filesystem is corrupted, and the settings were not saved.
+     * @retval SETTINGS_FILESYSTEM_ERROR A file could not be synced to its durability.
      * @retval SETTINGS_FILESYSTEM_ERROR The persisten storage is disabled, and the settings were not saved.
+     * @retval TIMEOUT_ERROR Another store or load did not finish in time, and the settings were not saved.
+     */
+    [[nodiscard]] SettingError_t storeSettingsInPersistentStorage(
+        uint32_t                       threads     = CONFIG_SETTINGS_STORAGE_STORE_THREADS,
+        SettingsCompressionAlgorithm_t compression = static_cast<SettingsCompressionAlgorithm_t>(
+            CONFIG_SETTINGS_STORAGE_COMPRESSION_ALGORITHM),
+        SettingsStoreMode_t  mode = CONFIG_SETTINGS_STORAGE_SPARSE_STORE ? StoreModifiedSettings : StoreAllSettings,
+        SettingsDurability_t durability =
+            static_cast<SettingsDurability_t>(CONFIG_SETTINGS_STORAGE_STORE_DURABILITY)) const;
+
+    /**
+     * @brief Saves the settings to the persistent storage in the background, without waiting for them to be written.
+     *
+     * @note A copy of the settings that are stored is taken by the calling thread, while the tree is locked, and
+     * then it is formatted and written by a background thread, so the tree is not locked while the files are written.
+     * The files written are the same that storeSettingsInPersistentStorage() writes with a single thread.
+     *
+     * @note The stores requested while another one is being written are coalesced: when it finishes, the background
+     * thread copies the settings again and writes them once for all of them, with the compression and mode of the last
+     * request, and the highest durability requested. A store or load of another thread that is using the files delays
+     * the copy until it finishes. The files are synced like in storeSettingsInPersistentStorage().
+     *
+     * @param callback The function called by the background thread with the result of the store that includes the
+     * settings of this request, or nullptr. The failures to copy the settings are also reported here. It must not
+     * destroy this object, and waitForStore() does not wait when called from it.
+     * @param callbackData The data passed to the callback.
+     * @param compression The algorithm used to compress the records.
+     * @param mode The settings that are stored.
+     * @param durability The minimum durability of the files written.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The store was started or coalesced with the one in progress, and callback will be called.
+     * @retval INVALID_INPUT_ERROR The compression algorithm is invalid.
+     * @retval INVALID_INPUT_ERROR The durability is invalid.
+     * @retval INVALID_INPUT_ERROR The mode is invalid. StoreSettingsInSlots and StoreSettingsInMappedTree update the
+     * files in place, from the tree, so they are not supported in the background.
+     * @retval SETTINGS_FILESYSTEM_ERROR There is no settings file.
+     * @retval TIMEOUT_ERROR The state of the stores in progress could not be locked.
      */
-    [[nodiscard]] SettingError_t storeSettingsInPersistentStorage() const;
+    [[nodiscard]] SettingError_t storeSettingsAsync(
+        SettingsStoreCompletionCallback_t callback = nullptr, void* callbackData = nullptr,
+        SettingsCompressionAlgorithm_t compression =
+            static_cast<SettingsCompressionAlgorithm_t>(CONFIG_SETTINGS_STORAGE_COMPRESSION_ALGORITHM),
+        SettingsStoreMode_t  mode = CONFIG_SETTINGS_STORAGE_SPARSE_STORE ? StoreModifiedSettings : StoreAllSettings,
+        SettingsDurability_t durability =
+            static_cast<SettingsDurability_t>(CONFIG_SETTINGS_STORAGE_STORE_DURABILITY)) const;
+
+    /**
+     * @brief Wait until the stores started by storeSettingsAsync() are written.
+     *
+     * Called from a completion callback of storeSettingsAsync(), it returns without waiting, since the store of the
+     * callback is written and the background thread can not write the next one before the callback returns.
+     *
+     * @param timeoutMs The maximum time to wait, in milliseconds.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR No store is in progress, and their callbacks were called. From a completion callback, no store
+     * was requested since the one of the callback.
+     * @retval TIMEOUT_ERROR A store is still in progress, or its state could not be locked.
+     */
+    [[nodiscard]] SettingError_t waitForStore(uint32_t timeoutMs) const;
 
     /**
      * @brief This function loads the settings from the persistent storage, replacing the old copy of them.
@@ -186,11 +508,160 @@ public:
      * they will be loaded but marked as volatile,
      * which means they will not be saved in the persistent storage.
      *
+     * @note When more than one thread is used, the whole file is read in memory (or mapped, if the settings file
+     * supports it) and split into chunks of whole lines that are parsed and checksummed by worker threads. The parsed
+     * settings are then merged into the tree while holding its write lock only once. Each thread parses at least
+     * CONFIG_SETTINGS_STORAGE_PARALLEL_LOAD_MIN_CHUNK_SIZE bytes, so small files are parsed by the calling thread.
+     *
+     * @note The shards are loaded after the settings file, see addSettingsShard().
+     *
+     * @note The blocks of a file stored with StoreSettingsInBlocks are validated by the worker threads, a range of
+     * blocks each, and the file is then parsed like any other. The corrupted blocks are skipped, and the keys of their
+     * records are reported by getDamagedKeyRanges(). Blocked files are always read in memory, or mapped.
+     *
+     * @note No store or other load uses the files while they are loaded, they wait for it to finish.
+     *
+     * @param threads The maximum number of threads used to parse the settings, including the calling thread.
      * @return SettingError_t The result of the operation.
      * @retval NO_ERROR The settings were successfully loaded.
+     * @retval DAMAGED_SETTINGS_ERROR Some blocks of a blocked file, or slots of a slotted file, were corrupted, and the
+     * settings of the other ones were loaded, see getDamagedKeyRanges().
+     * @retval SETTINGS_FILESYSTEM_ERROR The settings file is corrupted and settings were not modified.
+     * @retval SETTINGS_FILESYSTEM_ERROR A setting of the file does not match the type of the registered setting. The
+     * settings were not modified, unless the file was loaded by one thread, which merges it in batches of
+     * CONFIG_SETTINGS_STORAGE_LOAD_BATCH_SIZE settings: the batches before the one of the setting were then loaded.
+     * @retval SETTINGS_FILESYSTEM_ERROR There is no settings file.
+     * @retval TIMEOUT_ERROR Another store or load did not finish in time, and the settings were not modified.
+     */
+    [[nodiscard]] SettingError_t
+    loadSettingsFromPersistentStorage(uint32_t threads = CONFIG_SETTINGS_STORAGE_LOAD_THREADS) const;
+
+    /**
+     * @brief This function loads the settings from the persistent storage on demand, replacing the old copy of them
+     * as they are used.
+     *
+     * @note The file is validated and its records are indexed, but they are not parsed. The settings are stored in key
+     * order, so the record of a setting is found by binary search and placed in the tree the first time the setting is
+     * registered, read, written or listed. A setting registered after this call takes its persisted value, keeping the
+     * permissions and the default value of the registration. Records that do not match the type of the registered
+     * setting are discarded. Files whose records are not sorted by key are loaded eagerly.
+     *
+     * @note A file stored with StoreSettingsInMappedTree is not indexed either: only its header is validated, and the
+     * record of a setting is searched in the tree of the file, whose nodes are validated as they are read. A record
+     * whose node is corrupted is discarded, with the records that can only be reached through it.
+     *
+     * @note The file is kept mapped (or in memory, if the settings file can not be mapped) until all its records are
+     * in the tree. Storing the settings places the remaining records in the tree first, and loading the settings
+     * again discards them.
+     *
+     * @note A lookup of a pending setting waits up to CONFIG_SETTINGS_STORAGE_PENDING_SETTINGS_WAIT_MS while other
+     * pending settings are loaded. If it times out, a read uses the value already in the tree, and a write fails with
+     * TIMEOUT_ERROR, because the pending record would replace the value written once it is loaded.
+     *
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The settings file is valid, and its settings will be loaded when they are used.
+     * @retval DAMAGED_SETTINGS_ERROR Some blocks or slots of the file were corrupted, see getDamagedKeyRanges().
+     * @retval SETTINGS_FILESYSTEM_ERROR The settings file is corrupted and settings were not modified.
+     * @retval TIMEOUT_ERROR The pending settings are being loaded by another thread.
+     * @retval TIMEOUT_ERROR Another store or load did not finish in time, see loadSettingsFromPersistentStorage().
+     */
+    [[nodiscard]] SettingError_t loadSettingsFromPersistentStorageLazily() const;
+
+    /**
+     * @brief This function loads the settings from the persistent storage in two stages: the settings needed to boot
+     * are loaded before returning, and the rest are loaded by a background thread.
+     *
+     * @note The file is loaded as in loadSettingsFromPersistentStorageLazily(). The settings that match keyPrefix, and
+     * the registered settings that match the permissions filter, are placed in the tree before returning. The other
+     * settings are placed in the tree by a background thread, in batches of
+     * CONFIG_SETTINGS_STORAGE_LOAD_BATCH_SIZE settings, or earlier if they are used. Use waitForSettings() to
+     * wait until the settings of a component are loaded.
+     *
+     * @param keyPrefix The prefix of the settings to load before returning, or nullptr to select them only by their
+     * permissions.
+     * @param permissions The permissions filter of the registered settings to load before returning.
+     * @param filterMode The filter mode to apply to the permissions.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The settings that match the filters were loaded, and the rest will be loaded in the background.
+     * @retval INVALID_INPUT_ERROR The permissions are invalid.
+     * @retval INVALID_INPUT_ERROR The filterMode is invalid.
+     * @retval DAMAGED_SETTINGS_ERROR Some blocks or slots of the file were corrupted, see getDamagedKeyRanges().
      * @retval SETTINGS_FILESYSTEM_ERROR The settings file is corrupted and settings were not modified.
+     * @retval TIMEOUT_ERROR The pending settings are being loaded by another thread.
+     * @retval TIMEOUT_ERROR Another store or load did not finish in time, see loadSettingsFromPersistentStorage().
      */
-    [[nodiscard]] SettingError_t loadSettingsFromPersistentStorage() const;
+    [[nodiscard]] SettingError_t loadSettingsFromPersistentStorageStaged(
+        const char* keyPrefix, SettingPermissions_t permissions = NO_PERMISSIONS,
+        SettingPermissionsFilterMode_t filterMode = MatchSettingsWithAnyPermissionsListed) const;
+
+    /**
+     * @brief This function waits until the persisted settings that match the provided key prefix are loaded.
+     *
+     * @note The settings of the prefix that are still pending in a lazy or staged load are loaded by the calling
+     * thread, so it only waits while other pending settings are being loaded.
+     *
+     * @param keyPrefix The prefix of the settings to wait for. An empty string will wait for all settings.
+     * @param timeoutMs The maximum time to wait.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The settings that match the key prefix are loaded.
+     * @retval INVALID_INPUT_ERROR The keyPrefix is nullptr.
+     * @retval TIMEOUT_ERROR The settings were not loaded in time.
+     */
+    [[nodiscard]] SettingError_t waitForSettings(const char* keyPrefix, uint32_t timeoutMs) const;
+
+    /**
+     * @brief This function gets the keys of the records that the last load skipped because they were corrupted.
+     *
+     * @note Only the blocks of the files stored with StoreSettingsInBlocks, and the slots of the files stored with
+     * StoreSettingsInSlots, are skipped, other corrupted files are not loaded at all. The records of a block or slot
+     * can not be trusted once it is corrupted, so each range is bounded by the keys of the blocks or slots around it.
+     * The settings of the range keep the value they had before the load.
+     *
+     * @param ranges The ranges of keys of the corrupted blocks and slots, in the order of their files. Its previous
+     * content is replaced.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The ranges were copied, ranges is empty if the last load did not skip any record.
+     * @retval SETTINGS_FILESYSTEM_ERROR There is no settings file.
+     * @retval TIMEOUT_ERROR Another store or load did not finish in time, see loadSettingsFromPersistentStorage().
+     */
+    [[nodiscard]] SettingError_t getDamagedKeyRanges(std::vector<SettingsKeyRange_t>& ranges) const;
+
+    /**
+     * @brief This function serializes all the settings to a buffer, including the volatile ones.
+     *
+     * @note The buffer is a compact binary image that keeps the type, the value, the default value and the permissions
+     * of each setting: a header, one fixed size entry per setting in key order, and the keys and strings. The entries
+     * use the byte order and layout of the host, so the image can only be imported by the same build of the library,
+     * e.g. to clone the settings to another instance or process, or to back them up in memory.
+     *
+     * @note The pending settings of a lazy or staged load are loaded before the settings are serialized.
+     *
+     * @param outputBuffer The buffer where the image is written. Its previous content is replaced.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The settings were successfully serialized.
+     * @retval FATAL_ERROR The settings do not fit in an image.
+     * @retval TIMEOUT_ERROR The pending settings are being loaded by another thread.
+     */
+    [[nodiscard]] SettingError_t exportToBuffer(std::vector<std::byte>& outputBuffer) const;
+
+    /**
+     * @brief This function restores the settings serialized by exportToBuffer().
+     *
+     * @note Each setting of the image replaces the setting with the same key, including its type, its default value and
+     * its permissions, or is inserted if the key is not in the tree. The other settings are not modified. The whole
+     * image is validated before the settings are merged into the tree while holding its write lock only once.
+     *
+     * @note The pending settings of a previous lazy or staged load are discarded, so they do not replace the imported
+     * settings later.
+     *
+     * @param inputBuffer The image to restore. It does not need to be aligned.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The settings were successfully restored.
+     * @retval INVALID_INPUT_ERROR The image is corrupted or has an unsupported version, and settings were not modified.
+     * @retval TIMEOUT_ERROR The pending settings are being loaded by another thread.
+     * @retval TIMEOUT_ERROR The memory of the settings could not be locked in time, and settings were not modified.
+     */
+    [[nodiscard]] SettingError_t importFromBuffer(std::span<const std::byte> inputBuffer) const;
 
     /**
      * @brief This lists the settings keys that match the provided key prefix.
@@ -208,6 +679,52 @@ public:
                                                   SettingPermissionsFilterMode_t filterMode,
                                                   SettingsKeysList_t&            outputKeys) const;
 
+    /**
+     * @brief This gets the hash of the content of all the settings, see getSubtreeHash().
+     * @param hash The hash of the settings that are not volatile.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The hash was calculated.
+     * @retval TIMEOUT_ERROR The pending settings are being loaded by another thread.
+     */
+    [[nodiscard]] SettingError_t getRootHash(uint64_t& hash) const;
+
+    /**
+     * @brief This gets the hash of the content of the settings whose key starts with the provided prefix.
+     *
+     * @note The hash combines the key, the type and the value of each setting that is not volatile, so two storages
+     * with the same settings have the same hashes, whatever the order in which their settings were registered,
+     * updated or loaded. The hashes are updated by every change of a setting, and the hashes of the prefixes that end
+     * with '/' are kept up to date, so getting them does not read the settings. The hash of any other prefix is
+     * calculated from the settings of the prefix. The hashes are not cryptographic, they detect changes, not tampering.
+     *
+     * @param keyPrefix The prefix of the keys of the settings. An empty string gets the hash of all the settings.
+     * @param hash The hash of the settings of the prefix, 0 if there are none.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The hash was calculated.
+     * @retval INVALID_INPUT_ERROR The keyPrefix is nullptr.
+     * @retval TIMEOUT_ERROR The pending settings are being loaded by another thread.
+     * @retval TIMEOUT_ERROR The settings of a prefix that does not end with '/' could not be locked.
+     * @retval TIMEOUT_ERROR The hashes of a prefix that ends with '/' could not be locked.
+     */
+    [[nodiscard]] SettingError_t getSubtreeHash(const char* keyPrefix, uint64_t& hash) const;
+
+    /**
+     * @brief This lists the hashes of the children of a prefix, so two storages can find the settings that differ by
+     * only descending into the children whose hashes differ.
+     *
+     * @param keyPrefix The prefix of the children, "" or a prefix that ends with '/'.
+     * @param outputHashes The children of the prefix ordered in lexical order: the prefixes of the next level, that end
+     * with '/', and the keys of the settings that are directly in the prefix, each one with its hash. The volatile
+     * settings, and the prefixes that only have volatile settings, are not listed. Its previous content is replaced.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The hashes were listed.
+     * @retval INVALID_INPUT_ERROR The keyPrefix is nullptr, or it does not end with '/'.
+     * @retval TIMEOUT_ERROR The pending settings are being loaded by another thread.
+     * @retval TIMEOUT_ERROR The settings or the hashes of the prefixes could not be locked, outputHashes is empty.
+     */
+    [[nodiscard]] SettingError_t listSubtreeHashes(const char*                                     keyPrefix,
+                                                   std::vector<std::pair<std::string, uint64_t>>& outputHashes) const;
+
     /**
      * @brief This function returns the value of the setting with the provided key.
      * @param key The key of the setting to get.
@@ -256,48 +773,116 @@ public:
     [[nodiscard]] SettingError_t getSettingAsString(const char* key, char* outputValueBuffer, size_t outputValueSize,
                                                     SettingPermissions_t* outputPermissions = nullptr) const;
 
+    /**
+     * @brief This prepares the memory of a number of settings, so registering them does not allocate it one by one.
+     *
+     * @note Unless CONFIG_SETTINGS_STORAGE_VALUE_POOL_SLAB_SIZE is 0, the values of the settings are taken from slabs
+     * of that many values, and their strings from slabs of CONFIG_SETTINGS_STORAGE_STRING_POOL_SLAB_SIZE bytes per
+     * size class, so the settings do not fragment the heap. The memory of a setting or string that is freed is reused
+     * by the next one, and the slabs are released at once when this object is destroyed. The nodes of the tree are
+     * still allocated by the tree. If the pool is disabled, only the records of the numbers are reserved.
+     *
+     * @note The records of the numbers of the settings file of the constructor are kept for its next store, so room
+     * for that many records is reserved too, and a store does not allocate them. The files of addSettingsShard() get
+     * theirs on their first store.
+     *
+     * @param settingsCount The number of settings expected, including the settings already registered.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The memory was reserved.
+     * @retval TIMEOUT_ERROR The memory of the settings could not be locked in time.
+     * @retval TIMEOUT_ERROR The records of the numbers could not be locked in time, because a store or load kept the
+     * settings file.
+     */
+    [[nodiscard]] SettingError_t reserveSettings(size_t settingsCount) const;
+
+    /**
+     * @brief This function gets the memory used by the string values of the settings.
+     *
+     * @note The string values share the memory of their default value until they are modified, and are restored by
+     * sharing it again, so only the default value is counted for the settings that keep it. The strings short enough
+     * to be stored in the settings themselves are not counted.
+     *
+     * @param outputBytes The number of bytes allocated for the strings of the settings and their default values.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The memory used was returned.
+     */
+    [[nodiscard]] SettingError_t getStringsMemoryUsage(size_t& outputBytes) const;
+
     /**
      * @brief This function creates an empty setting located at the specified path, with the provided permissions.
      * @param key The key of the setting to create. It must not contain the tab (\t) character.
      * @param permissions The set of permissions associated with the setting.
      * @param defaultValue The default value of the setting.
+     * @param durability The durability that the stores of its settings file must reach once the setting is registered,
+     * updated or restored, until the file is stored, see storeSettingsInPersistentStorage().
      * @return SettingError_t The result of the operation.
      * @retval NO_ERROR The setting was successfully created.
      * @retval KEY_EXISTS_ERROR The setting with the provided key already exists.
      * @retval INVALID_INPUT_ERROR The key is nullptr or "".
      * @retval INVALID_INPUT_ERROR The permissions are invalid.
+     * @retval INVALID_INPUT_ERROR The durability is invalid.
+     * @retval TIMEOUT_ERROR The memory of the setting could not be allocated in time.
      */
-    [[nodiscard]] SettingError_t registerSettingAsInt(const char* key, SettingPermissions_t permissions,
-                                                      int64_t defaultValue) const;
+    [[nodiscard]] SettingError_t
+    registerSettingAsInt(const char* key, SettingPermissions_t permissions, int64_t defaultValue,
+                         SettingsDurability_t durability = SettingsDurability_t::NONE) const;
 
     /**
      * @brief This function creates an empty setting located at the specified path, with the provided permissions.
      * @param key The key of the setting to create. It must not contain the tab (\t) character.
      * @param permissions The set of permissions associated with the setting.
      * @param defaultValue The default value of the setting.
+     * @param durability The durability that the stores of its settings file must reach once the setting is registered,
+     * updated or restored, until the file is stored, see storeSettingsInPersistentStorage().
      * @return SettingError_t The result of the operation.
      * @retval NO_ERROR The setting was successfully created.
      * @retval KEY_EXISTS_ERROR The setting with the provided key already exists.
      * @retval INVALID_INPUT_ERROR The key is nullptr or "".
      * @retval INVALID_INPUT_ERROR The permissions are invalid.
+     * @retval INVALID_INPUT_ERROR The durability is invalid.
+     * @retval TIMEOUT_ERROR The memory of the setting could not be allocated in time.
      */
-    [[nodiscard]] SettingError_t registerSettingAsReal(const char* key, SettingPermissions_t permissions,
-                                                       double defaultValue) const;
+    [[nodiscard]] SettingError_t
+    registerSettingAsReal(const char* key, SettingPermissions_t permissions, double defaultValue,
+                          SettingsDurability_t durability = SettingsDurability_t::NONE) const;
 
     /**
      * @brief This function creates an empty setting located at the specified path, with the provided permissions.
      * @param key The key of the setting to create. It must not contain the tab (\t) character.
      * @param permissions The set of permissions associated with the setting.
      * @param defaultValue The default value of the setting. It will be copied to SettingsStorage memory.
+     * @param durability The durability that the stores of its settings file must reach once the setting is registered,
+     * updated or restored, until the file is stored, see storeSettingsInPersistentStorage().
      * @return SettingError_t The result of the operation.
      * @retval NO_ERROR The setting was successfully created.
      * @retval KEY_EXISTS_ERROR The setting with the provided key already exists.
      * @retval INVALID_INPUT_ERROR The key is nullptr or "".
      * @retval INVALID_INPUT_ERROR The permissions are invalid.
      * @retval INVALID_INPUT_ERROR The defaultValue is nullptr.
+     * @retval INVALID_INPUT_ERROR The durability is invalid.
+     * @retval TIMEOUT_ERROR The memory of the setting could not be allocated in time.
      */
-    [[nodiscard]] SettingError_t registerSettingAsString(const char* key, SettingPermissions_t permissions,
-                                                         const char* defaultValue) const;
+    [[nodiscard]] SettingError_t
+    registerSettingAsString(const char* key, SettingPermissions_t permissions, const char* defaultValue,
+                            SettingsDurability_t durability = SettingsDurability_t::NONE) const;
+
+    /**
+     * @brief This function creates the settings of a table, with their permissions and default values, locking the
+     * settings only once for the whole table.
+     *
+     * @note The default values are not copied. The settings point to the default strings of the table, and share them
+     * until their value is modified, so the table and its strings must stay valid and unchanged while this object
+     * exists, e.g. a constexpr or static const table.
+     *
+     * @param descriptors The settings to create. Their keys must not contain the tab (\t) character.
+     * @return SettingError_t The result of the operation.
+     * @retval NO_ERROR The settings were successfully created.
+     * @retval KEY_EXISTS_ERROR Some settings already exist. They are left unchanged, the others are created.
+     * @retval INVALID_INPUT_ERROR A key is nullptr or "", or a type, permissions, durability or default string is
+     * invalid. No setting is created.
+     * @retval TIMEOUT_ERROR The settings, or the memory of their values, could not be locked. No setting is created.
+     */
+    [[nodiscard]] SettingError_t registerSettings(std::span<const SettingDescriptor_t> descriptors) const;
 
     /**
      * @brief This function updates the value of the setting with the provided key.
@@ -308,6 +893,7 @@ public:
      * @retval KEY_NOT_FOUND_ERROR The setting with the provided key was not found.
      * @retval TYPE_MISMATCH_ERROR The setting with the provided key is not of the expected type or void.
      * @retval INVALID_INPUT_ERROR The key is nullptr or "".
+     * @retval TIMEOUT_ERROR The setting is still pending in a lazy or staged load and it was not loaded in time.
      */
     [[nodiscard]] SettingError_t putSettingValueAsInt(const char* key, int64_t value) const;
 
@@ -320,6 +906,7 @@ public:
      * @retval KEY_NOT_FOUND_ERROR The setting with the provided key was not found.
      * @retval TYPE_MISMATCH_ERROR The setting with the provided key is not of the expected type or void.
      * @retval INVALID_INPUT_ERROR The key is nullptr or "".
+     * @retval TIMEOUT_ERROR The setting is still pending in a lazy or staged load and it was not loaded in time.
      */
     [[nodiscard]] SettingError_t putSettingValueAsReal(const char* key, double value) const;
 
@@ -333,6 +920,8 @@ public:
      * @retval TYPE_MISMATCH_ERROR The setting with the provided key is not of the expected type or void.
      * @retval INVALID_INPUT_ERROR The key is nullptr or "".
      * @retval INVALID_INPUT_ERROR The value is nullptr.
+     * @retval TIMEOUT_ERROR The setting is still pending in a lazy or staged load and it was not loaded in time.
+     * @retval TIMEOUT_ERROR The memory of the value could not be allocated in time. The setting is not modified.
      */
     [[nodiscard]] SettingError_t putSettingValueAsString(const char* key, const char* value) const;
 
@@ -392,23 +981,522 @@ public:
 
 private:
     typedef std::tuple<SettingPermissions_t, SettingPermissionsFilterMode_t, SettingsKeysList_t*>
-                                                                                   SettingsListCallbackData_t;
-    typedef std::tuple<SettingsFile*, uint32_t*, bool*, CRC::Table<unsigned, 32>*> SettingsStoreCallbackData_t;
+        SettingsListCallbackData_t;
     using TypeofSettingValue = enum { Value, DefaultValue };
 
-    OSInterface_Mutex* moduleConfigMutex;
-    SettingsFile*      settingsFile;
-    bool               persistentStorageEnabled;
-    Settings_t*        settings;
-    OSInterface*       osInterface;
+    /// A setting collected from the tree to be stored by a worker thread.
+    typedef struct SettingRecord_t
+    {
+        const unsigned char* key;
+        uint32_t             keyLength;
+        uint32_t             recordTextIndex; // Of its record in the cache of the store, if it is a number.
+        SettingValue_t*      value;
+        bool                 tombstone;
+    } SettingRecord_t;
+
+    /// The output of a worker thread of the parallel store.
+    typedef struct SettingsStoreChunk_t
+    {
+        std::string                      output;
+        uint32_t                         checksum;
+        SettingsFile::SettingsFileResult result;
+    } SettingsStoreChunk_t;
+
+    /// The record of a setting in a slotted settings file, see StoreSettingsInSlots.
+    typedef struct SettingSlot_t
+    {
+        std::string key;
+        uint32_t    offset;      // Offset of the record from the start of the file.
+        uint32_t    payloadSize; // Size of the value field, with its size and padding, that the value must fit in.
+        size_t      recordHash;  // Hash of the stored record, to find the records whose value changed.
+    } SettingSlot_t;
+
+    /// The records of the last slotted file stored or loaded, in key order. It is empty for any other file.
+    typedef struct SettingsSlotIndex_t
+    {
+        SettingsChecksumAlgorithm_t checksumAlgorithm;
+        std::vector<SettingSlot_t>  slots;
+    } SettingsSlotIndex_t;
+
+    /// The records of the numbers formatted by the last store of a file, in the order they were written, so the next
+    /// store keeps the records whose value did not change instead of formatting them again. A record is only kept if
+    /// it was formatted from the same type and value, so a setting added or removed only costs the records after it to
+    /// be formatted once. Only the store that holds the files uses it, see persistenceIdle.
+    typedef std::vector<SettingRecordText_t> SettingsRecordCache_t;
+
+    /// The cache of the records of a file while it is stored, and how many records this store wrote to it so far.
+    typedef struct SettingsRecordCacheUpdate_t
+    {
+        SettingsRecordCache_t* records;
+        size_t                 count;
+    } SettingsRecordCacheUpdate_t;
+
+    /// The hash of the settings of a file, and what its last store wrote, so the next store can skip it.
+    typedef struct SettingsFileHash_t
+    {
+        std::atomic<uint64_t>          current; // Sum of the hashes of its settings, updated by their changes.
+        uint64_t                       stored;  // The hash of the settings written by the last store.
+        bool                           storedValid; // The file holds the settings of stored, written as follows.
+        SettingsCompressionAlgorithm_t storedCompression;
+        SettingsStoreMode_t            storedMode;
+        SettingsDurability_t           storedDurability;
+    } SettingsFileHash_t;
+
+    /// A settings file that stores the settings whose key starts with its prefix, see addSettingsShard().
+    typedef struct SettingsShard_t
+    {
+        std::string                 keyPrefix;
+        SettingsFile*               settingsFile;
+        ExtendedSettingsFile*       extendedSettingsFile;
+        std::atomic<bool>           dirty;           // Its settings changed since it was last stored.
+        std::atomic<uint8_t>        dirtyDurability; // Highest SettingsDurability_t of the settings that changed.
+        mutable SettingsSlotIndex_t   slotIndex;
+        mutable SettingsRecordCache_t recordCache;
+        mutable SettingsFileHash_t    hash;
+    } SettingsShard_t;
+
+    typedef std::tuple<const SettingsStorage*, const SettingsShard_t*, SettingsSlotIndex_t*, size_t,
+                       SettingsSerializer*, std::string*, std::vector<std::pair<size_t, std::string>>*>
+        SettingsSlotUpdateCallbackData_t;
+
+    typedef std::tuple<const SettingsStorage*, const SettingsShard_t*, SettingsSlotIndex_t*, SettingsSerializer*,
+                       std::string*, SettingsSerializer*, uint32_t*>
+        SettingsSlotStoreCallbackData_t;
+
+    typedef std::tuple<const SettingsStorage*, const SettingsShard_t*, const SettingsMappedTree*, SettingsSerializer*,
+                       std::string*, std::string*, std::vector<std::pair<size_t, size_t>>*, size_t*>
+        SettingsMappedStoreCallbackData_t;
+
+    typedef std::tuple<SettingsSerializer*, SettingsStoreMode_t, const SettingsStorage*, const SettingsShard_t*,
+                       SettingsRecordCacheUpdate_t*>
+        SettingsStoreCallbackData_t;
+
+    typedef std::tuple<const SettingsStorage*, const SettingsShard_t*, SettingsSerializer*, std::string*,
+                       SettingsSerializer*, uint32_t*, uint32_t*, SettingsRecordCacheUpdate_t*>
+        SettingsBlockStoreCallbackData_t;
+
+    typedef std::tuple<const SettingsStorage*, uint32_t, SettingsChecksumAlgorithm_t, std::vector<SettingRecord_t>*,
+                       uint32_t*, SettingsCompressor*, SettingsStoreMode_t, const SettingsShard_t*,
+                       std::vector<std::string>*, SettingsRecordCacheUpdate_t*>
+        SettingsParallelStoreCallbackData_t;
+
+    typedef std::tuple<const SettingsStorage*, const SettingsShard_t*> SettingsCommitCallbackData_t;
+
+    /// A setting parsed from the settings file. Its key and string value point to the file data, unterminated.
+    typedef struct SettingLoadRecord_t
+    {
+        const char*        key;
+        int                keyLength;
+        SettingValueType_t valueType;
+        SettingValueData_t valueData;
+        size_t             stringLength;
+        bool               tombstone; // The setting is reset to its default value, the record has no value.
+    } SettingLoadRecord_t;
+
+    /// Merges a setting parsed from the settings file into the tree, see AtomicAdaptiveRadixTree::upsertAll().
+    typedef SettingValue_t* (*SettingLoadRecordCallback_t)(void* data, SettingLoadRecord_t& record,
+                                                           SettingValue_t* value);
+
+    /// Checks a setting parsed from the settings file before any is merged, see AtomicAdaptiveRadixTree::upsertAll().
+    typedef bool (*SettingLoadRecordCheck_t)(void* data, const SettingLoadRecord_t& record,
+                                             const SettingValue_t* value);
+
+    /// The input and output of a worker thread of the parallel load.
+    typedef struct SettingsLoadChunk_t
+    {
+        std::string_view                 data;
+        std::vector<SettingLoadRecord_t> records;
+        uint32_t                         checksum;
+        SettingError_t                   result;
+    } SettingsLoadChunk_t;
+
+    /// A block of records of a blocked settings file, see StoreSettingsInBlocks.
+    typedef struct SettingsBlock_t
+    {
+        std::string_view records;      // Its records, without its checksum line.
+        std::string_view checksumLine; // \rb<checksum>\n, or empty if the file ends before it.
+        uint32_t         checksum;     // Checksum of its records.
+        bool             valid;        // Its checksum line matches its records.
+    } SettingsBlock_t;
+
+    typedef std::tuple<const SettingsStorage*, std::vector<SettingLoadRecord_t>*, std::string*, size_t>
+        SettingsMappedLoadCallbackData_t;
+
+    /// A copy of a setting that is stored by storeSettingsAsync(). Its key and string value are in its snapshot.
+    typedef struct SettingSnapshotRecord_t
+    {
+        uint32_t       keyOffset;
+        uint32_t       keyLength;
+        uint32_t       valueOffset; // Only valid for string values, NUL terminated.
+        SettingValue_t value;       // Its string pointers are not valid.
+        bool           tombstone;
+    } SettingSnapshotRecord_t;
+
+    /// The settings of one file, copied so they can be written without locking the tree.
+    typedef struct SettingsFileSnapshot_t
+    {
+        SettingsShard_t*                     shard; // nullptr for the settings file of the constructor.
+        SettingsDurability_t                 durability;
+        uint64_t                             hash; // The hash of the file when its settings were copied.
+        uint64_t                             persistedChanges; // See SettingsPersistenceState_t.
+        std::vector<SettingSnapshotRecord_t> records;
+        std::string                          strings;
+    } SettingsFileSnapshot_t;
+
+    typedef std::tuple<const SettingsStorage*, SettingsFileSnapshot_t*, SettingsStoreMode_t>
+        SettingsSnapshotCallbackData_t;
+
+    typedef std::vector<std::pair<SettingsStoreCompletionCallback_t, void*>> SettingsStoreCompletionList_t;
+
+    typedef std::tuple<const SettingsStorage*, std::vector<SettingsFileSnapshot_t>, SettingError_t, bool,
+                       SettingsCompressionAlgorithm_t, SettingsStoreMode_t, SettingsDurability_t,
+                       SettingsStoreCompletionList_t>
+        SettingsBackgroundStoreData_t;
+
+    /// A task of runInParallel(), that runs the function with its index.
+    typedef struct SettingsParallelTask_t
+    {
+        void (*run)(const void* function, size_t index);
+        const void*   function;
+        size_t        index;
+        SettingsTask* task; // nullptr if it could not be created, then the index runs in the calling task.
+    } SettingsParallelTask_t;
+
+    /// The stores started by storeSettingsAsync(), see asyncStoreMutex.
+    typedef struct SettingsAsyncStore_t
+    {
+        SettingsTask*                  worker;            // nullptr if no store was started yet.
+        std::atomic<bool>              inFlight;          // The worker is writing or about to write a store.
+        bool                           followUpRequested; // Another store was requested while it was in flight.
+        SettingsCompressionAlgorithm_t compression;       // Of the follow-up store.
+        SettingsStoreMode_t            mode;              // Of the follow-up store.
+        SettingsDurability_t           durability;        // Of the follow-up store, the highest requested.
+        SettingsStoreCompletionList_t  callbacks;         // Of the follow-up store.
+    } SettingsAsyncStore_t;
+
+    /// The stores and loads of the files, see persistenceIdle. Only the one that holds it writes the members but
+    /// storesStarted.
+    typedef struct SettingsPersistenceState_t
+    {
+        std::atomic<uint64_t>           storesStarted;  // Incremented before the settings of a store are read.
+        uint64_t                        storesFinished; // storesStarted when the last store finished.
+        SettingError_t                  lastStoreResult;
+        SettingsCompressionAlgorithm_t  lastStoreCompression;
+        SettingsStoreMode_t             lastStoreMode;
+        SettingsDurability_t            lastStoreDurability;
+        std::vector<SettingsKeyRange_t> damagedKeyRanges; // Skipped by the last load, see getDamagedKeyRanges().
+        uint64_t                        persistedChanges; // Records selected for the file being stored that change
+                                                          // settingValuePersisted, see commitSettingRecords().
+    } SettingsPersistenceState_t;
+
+    /// A record of the settings file that is loaded on demand. The key is at the start of the record.
+    typedef struct SettingLazyRecord_t
+    {
+        uint32_t offset;
+        uint16_t keyLength;
+        bool     loaded;
+    } SettingLazyRecord_t;
+
+    /// The settings file that is loaded on demand, see loadSettingsFromPersistentStorageLazily().
+    typedef struct SettingsLazyImage_t
+    {
+        std::string                      fileData;            // Copy of the file, only used if it can not be mapped.
+        std::string                      decompressedRecords; // Records of a compressed file, decompressed in memory.
+        std::string_view                 records;             // The records of the file, sorted by key.
+        std::vector<SettingLazyRecord_t> index;               // One entry per record, in the same order.
+        std::atomic<size_t>              pendingRecords;      // Records that are not in the tree yet.
+        bool                             fileMapped;          // The settings file stays open while records are pending.
+        SettingsTask*                    loader;              // Background task of a staged load, or nullptr.
+        std::atomic<bool>                stopLoader;          // Asks the background thread to return.
+        SettingsMappedTree               mappedTree;          // Tree of a mapped tree file, instead of the index.
+        std::vector<bool>                mappedRecordsLoaded; // One entry per record of the tree, by id.
+        std::vector<SettingLoadRecord_t> unmergedRecords;     // Records whose merge failed, they are still pending.
+    } SettingsLazyImage_t;
+
+    /// Header of the images of exportToBuffer(). It is followed by the entries and the strings.
+    typedef struct SettingsImageHeader_t
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t settingsCount;
+        uint32_t stringsSize;
+        uint32_t checksum; // CRC32C of the entries and the strings.
+        uint32_t entrySize;
+    } SettingsImageHeader_t;
+
+    /// A value of an image. Strings are stored in the strings of the image, unterminated.
+    typedef union
+    {
+        double  real;
+        int64_t integer;
+        struct
+        {
+            uint32_t offset;
+            uint32_t length;
+        } string;
+    } SettingImageValue_t;
+
+    /// A setting of an image. The key is stored in the strings of the image, unterminated.
+    typedef struct SettingImageEntry_t
+    {
+        uint32_t             keyOffset;
+        uint8_t              keyLength;  // Shorter than MAX_SETTING_KEY_SIZE.
+        uint8_t              durability; // Was the high byte of keyLength, always 0 for SettingsDurability_t::NONE.
+        uint8_t              valueType;
+        SettingPermissions_t permissions;
+        SettingImageValue_t  value;
+        SettingImageValue_t  defaultValue;
+    } SettingImageEntry_t;
+
+    /// A setting of an image that is being imported, see importFromBuffer().
+    typedef struct SettingImportRecord_t
+    {
+        const char*         key;
+        int                 keyLength;
+        SettingImageEntry_t entry;
+    } SettingImportRecord_t;
+
+    typedef std::tuple<std::vector<std::byte>*, std::string*> SettingsExportCallbackData_t;
+
+    /// A setting of registerSettings(), inserted in the tree unless its key is already there.
+    typedef struct SettingRegisterRecord_t
+    {
+        const char*     key;
+        int             keyLength;
+        SettingValue_t* value;
+        SettingValue_t* existingValue; // The setting already registered with its key, nullptr if it was inserted.
+    } SettingRegisterRecord_t;
+
+    /// A change of the hash of a setting that could not lock its stripe in time, added by the next thread that does.
+    typedef struct SettingsHashChange_t
+    {
+        std::string           key;
+        uint64_t              difference;
+        SettingsHashChange_t* next;
+    } SettingsHashChange_t;
+
+    /// The hashes of the prefixes of the keys that end with '/', e.g. "menu1/" and "menu1/menu2/" for
+    /// "menu1/menu2/setting". Each one is the sum of the hashes of its settings, so it is updated by adding the
+    /// difference between the new and the old hash of a setting. All the prefixes of a key start with its first level,
+    /// so they are in the stripe of that level, and the settings of the other stripes are changed in parallel.
+    typedef struct SettingsHashStripe_t
+    {
+        OSInterface_Mutex*                           mutex;
+        std::map<std::string, uint64_t, std::less<>> subtrees;
+        std::atomic<SettingsHashChange_t*>           pending;
+    } SettingsHashStripe_t;
+
+    constexpr static size_t SETTINGS_HASH_STRIPES = 8;
+
+    typedef struct SettingsHashIndex_t
+    {
+        std::atomic<uint64_t> root;
+        SettingsHashStripe_t  stripes[SETTINGS_HASH_STRIPES];
+    } SettingsHashIndex_t;
+
+    typedef std::tuple<std::vector<std::pair<std::string, uint64_t>>*, size_t> SettingsHashListCallbackData_t;
+
+    typedef std::tuple<const SettingsStorage*, const char*> SettingsImportCallbackData_t;
+
+    typedef std::tuple<const SettingsStorage*, const SettingLoadRecord_t*> SettingsResetCallbackData_t;
+
+    OSInterface_Mutex*           moduleConfigMutex;
+    SettingsFile*                settingsFile;
+    ExtendedSettingsFile*        extendedSettingsFile;
+    SettingsSerializer*          settingsSerializer;
+    SettingsCompressor*          settingsCompressor;
+    std::list<SettingsShard_t>*  settingsShards;
+    SettingsSlotIndex_t*         settingsSlotIndex;   // Slots of the settings file of the constructor.
+    SettingsRecordCache_t*       settingsRecordCache; // Records of the settings file of the constructor.
+    SettingsFileHash_t*          settingsFileHash;    // Hash of the settings file of the constructor.
+    SettingsHashIndex_t*         settingsHashes;
+    SettingsValuePool*           settingsValuePool; // nullptr if the values are allocated on their own.
+    OSInterface_Mutex*           settingsValuePoolMutex;
+    mutable std::atomic<size_t>  settingsStringsMemory; // Bytes of the strings allocated, see getStringsMemoryUsage().
+    mutable std::atomic<bool>    settingsFileDirty; // Its settings changed since it was last stored.
+    mutable std::atomic<uint8_t> settingsFileDirtyDurability; // Highest SettingsDurability_t of those settings.
+    OSInterface_Mutex*           lazyImageMutex;
+    SettingsLazyImage_t*         lazyImage;
+    OSInterface_Mutex*           asyncStoreMutex;
+    OSInterface_BinarySemaphore* asyncStoreIdle; // Given while no store started by storeSettingsAsync() is in flight.
+    SettingsAsyncStore_t*        asyncStore;
+    OSInterface_BinarySemaphore* persistenceIdle; // Given while no store or load uses the files.
+    SettingsPersistenceState_t*  persistence;
+    bool                         persistentStorageEnabled;
+    Settings_t*                  settings;
+    OSInterface*                 osInterface;
+    SettingsTaskFactory*         taskFactory; // nullptr if the tasks are created by default.
+
+    SettingsTask* createTask(void (*function)(void* arg), void* arg, const char* name) const;
+    static void   runParallelTask(void* arg);
+    template <typename Function> void runInParallel(size_t count, const char* name, const Function& function) const;
 
     static int listSettingsKeysCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
     static int freeSettingValuesCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
     static int storeSettingsInPersistentStorageCallback(void* data, const unsigned char* key, uint32_t key_len,
                                                         void* value);
-    [[nodiscard]] SettingError_t validateChecksum() const;
+    [[nodiscard]] SettingError_t storeSettingsFile(const SettingsShard_t* shard, uint32_t threads,
+                                                   SettingsCompressionAlgorithm_t compression, SettingsStoreMode_t mode,
+                                                   SettingsDurability_t durability) const;
+    SettingsShard_t*             findSettingsShard(const unsigned char* key, uint32_t key_len) const;
+    void                         markSettingsFileDirty(const char* key, SettingsDurability_t durability) const;
+    void updateSettingHash(const unsigned char* key, uint32_t key_len, SettingValue_t* settingValue) const;
+    SettingsHashStripe_t* findSettingsHashStripe(std::string_view key) const;
+    static void addSubtreeHashes(SettingsHashStripe_t& stripe, std::string_view key, uint64_t difference);
+    static void addPendingSubtreeHashes(SettingsHashStripe_t& stripe);
+    static uint64_t     hashSetting(const unsigned char* key, uint32_t key_len, const SettingValue_t* settingValue);
+    SettingsFileHash_t& getFileHash(const SettingsShard_t* shard) const;
+    [[nodiscard]] bool  isSettingsFileStored(const SettingsShard_t* shard, uint64_t hash,
+                                             SettingsCompressionAlgorithm_t compression, SettingsStoreMode_t mode,
+                                             SettingsDurability_t durability) const;
+    void                recordStoredSettingsFile(const SettingsShard_t* shard, bool dirty, uint64_t hash,
+                                                 SettingsCompressionAlgorithm_t compression, SettingsStoreMode_t mode,
+                                                 SettingsDurability_t durability) const;
+    void                forgetStoredSettingsFiles() const;
+    static int sumFileHashesCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    static int sumSubtreeHashCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    static int listSubtreeHashesCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    static void                  raiseDurability(std::atomic<uint8_t>& dirtyDurability,
+                                                 SettingsDurability_t  durability);
+    static SettingsFile::SettingsFileResult syncSettingsFile(ExtendedSettingsFile* file,
+                                                             SettingsDurability_t  durability);
+    static SettingsFile::SettingsFileResult beginSettingsFile(SettingsSerializer* serializer, SettingsFile* file,
+                                                              SettingsCompressor*            compressor,
+                                                              SettingsCompressionAlgorithm_t compression);
+    static SettingsFile::SettingsFileResult endSettingsFile(SettingsSerializer* serializer, SettingsFile* file,
+                                                            uint32_t checksum, ExtendedSettingsFile* extendedFile,
+                                                            SettingsDurability_t durability);
+    [[nodiscard]] SettingError_t takeSettingsSnapshot(SettingsCompressionAlgorithm_t compression,
+                                                      SettingsStoreMode_t mode, SettingsDurability_t durability,
+                                                      std::vector<SettingsFileSnapshot_t>& snapshots) const;
+    static int snapshotSettingCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    [[nodiscard]] SettingError_t writeSettingsSnapshot(const SettingsFileSnapshot_t& snapshot,
+                                                       SettingsCompressionAlgorithm_t compression,
+                                                       SettingsSerializer& serializer,
+                                                       SettingsCompressor& compressor) const;
+    void storeSettingsInBackground(std::vector<SettingsFileSnapshot_t> snapshots, SettingError_t result,
+                                   bool snapshotTaken, SettingsCompressionAlgorithm_t compression,
+                                   SettingsStoreMode_t mode, SettingsDurability_t durability,
+                                   SettingsStoreCompletionList_t callbacks) const;
+    static void storeSettingsInBackgroundTask(void* data);
+    [[nodiscard]] SettingError_t storeSettingsFiles(uint32_t threads, SettingsCompressionAlgorithm_t compression,
+                                                    SettingsStoreMode_t mode, SettingsDurability_t durability) const;
+    void finishStore(SettingError_t result, SettingsCompressionAlgorithm_t compression, SettingsStoreMode_t mode,
+                     SettingsDurability_t durability) const;
+    SettingsSlotIndex_t&         getSlotIndex(const SettingsShard_t* shard) const;
+    SettingsRecordCache_t&       getRecordCache(const SettingsShard_t* shard) const;
+    [[nodiscard]] SettingError_t storeSettingSlots(const SettingsShard_t* shard, SettingsDurability_t durability) const;
+    [[nodiscard]] SettingError_t writeSettingSlots(const SettingsShard_t* shard, SettingsDurability_t durability) const;
+    static int updateSettingSlotCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    static int storeSettingSlotCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    [[nodiscard]] SettingError_t storeMappedTree(const SettingsShard_t* shard, SettingsDurability_t durability) const;
+    [[nodiscard]] SettingError_t storeSettingBlocks(const SettingsShard_t* shard,
+                                                    SettingsDurability_t   durability) const;
+    static int storeSettingBlockCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    static SettingsFile::SettingsFileResult writeSettingBlock(SettingsSerializer& blockSerializer, std::string& block,
+                                                              SettingsSerializer*         fileSerializer,
+                                                              SettingsChecksumAlgorithm_t checksumAlgorithm);
+    static bool growMappedTree(ExtendedSettingsFile* file, SettingsMappedTree& tree, size_t requiredSize);
+    static int  collectMappedRecordCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    static bool formatSettingRecord(SettingsSerializer& serializer, std::string& record, const unsigned char* key,
+                                    uint32_t key_len, const SettingValue_t* settingValue);
+    static bool formatSettingSlot(SettingsSerializer& serializer, std::string& record, const unsigned char* key,
+                                  uint32_t key_len, const SettingValue_t* settingValue,
+                                  SettingsChecksumAlgorithm_t checksumAlgorithm, uint32_t& payloadSize);
+    static bool decodeSettingSlot(std::string_view line, SettingsChecksumAlgorithm_t checksumAlgorithm,
+                                  std::string& records, SettingSlot_t* slot);
+    static void indexSettingSlot(std::string_view line, uint32_t offset, SettingsChecksumAlgorithm_t checksumAlgorithm,
+                                 std::string& records, SettingsSlotIndex_t& slotIndex, bool& damaged,
+                                 std::vector<SettingsKeyRange_t>& damagedRanges);
+    static void endSettingSlots(SettingsSlotIndex_t& slotIndex, bool damaged,
+                                std::vector<SettingsKeyRange_t>& damagedRanges);
+    [[nodiscard]] SettingError_t loadSettingsImageLazily() const;
+    [[nodiscard]] SettingError_t loadSettingsImageInStages(const char* keyPrefix, SettingPermissions_t permissions,
+                                                           SettingPermissionsFilterMode_t filterMode) const;
+    static int collectSettingRecordsCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    static int formatSettingRecordsInParallelCallback(void* data);
+    static SettingsFile::SettingsFileResult writeSettingOutputs(SettingsFile* file, ExtendedSettingsFile* extendedFile,
+                                                                const std::vector<std::string>& outputs);
+    bool        selectSettingRecord(SettingValue_t* settingValue, SettingsStoreMode_t mode, bool& tombstone) const;
+    static bool isDefaultSettingValue(const SettingValue_t* settingValue);
+    void        commitSettingRecords(const SettingsShard_t* shard, bool written, uint64_t& persistedChanges) const;
+    static int  commitSettingRecordCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    // The record of a number is formatted into recordText, unless it already holds it.
+    static SettingsFile::SettingsFileResult serializeSettingRecord(SettingsSerializer*   serializer,
+                                                                   const unsigned char*  key, uint32_t key_len,
+                                                                   const SettingValue_t* settingValue, bool tombstone,
+                                                                   SettingRecordText_t*  recordText = nullptr);
+    static bool                 hasSettingRecordText(const SettingValue_t* settingValue, bool tombstone);
+    static SettingRecordText_t* nextSettingRecordText(SettingsRecordCacheUpdate_t* recordCache,
+                                                      const SettingValue_t* settingValue, bool tombstone);
+    static std::string_view     formatSettingRecordText(const SettingValue_t* settingValue,
+                                                        SettingRecordText_t&  recordText);
+    static void serializeSettingRecords(const SettingRecord_t* firstRecord, const SettingRecord_t* lastRecord,
+                                        SettingsChecksumAlgorithm_t checksumAlgorithm,
+                                        SettingsRecordCache_t* recordCache, SettingsStoreChunk_t* chunk);
+    static SettingError_t        validateChecksum(SettingsFile* file, bool& blocked);
+    static SettingError_t        parseFileHeader(std::string_view                headerLine,
+                                                 SettingsChecksumAlgorithm_t&    checksumAlgorithm,
+                                                 SettingsCompressionAlgorithm_t& compressionAlgorithm,
+                                                 uint32_t&                       version);
+    SettingError_t               parseFileData(std::string_view             fileData,
+                                               SettingsChecksumAlgorithm_t& checksumAlgorithm,
+                                               uint32_t& expectedChecksum, std::string_view& records,
+                                               std::string& decompressedRecords, SettingsSlotIndex_t* slotIndex,
+                                               uint32_t threads, std::vector<SettingsKeyRange_t>* damagedRanges) const;
+    void parseSettingBlocks(std::string_view data, SettingsChecksumAlgorithm_t checksumAlgorithm, uint32_t threads,
+                            uint32_t& checksum, std::string& records,
+                            std::vector<SettingsKeyRange_t>* damagedRanges) const;
+    static void validateSettingBlocks(SettingsChecksumAlgorithm_t checksumAlgorithm, SettingsBlock_t* firstBlock,
+                                      SettingsBlock_t* lastBlock);
+    static SettingError_t        readSettingsFile(SettingsFile* file, std::string& fileData);
+    [[nodiscard]] SettingError_t loadSettingsFile(SettingsFile* file, ExtendedSettingsFile* extendedFile,
+                                                  SettingsSlotIndex_t& slotIndex, uint32_t threads,
+                                                  std::vector<SettingsKeyRange_t>& damagedRanges) const;
+    [[nodiscard]] SettingError_t loadSettingsShards(uint32_t threads) const;
+    [[nodiscard]] SettingError_t loadSettingsFromFileData(std::string_view fileData, uint32_t threads,
+                                                          SettingsSlotIndex_t*             slotIndex,
+                                                          std::vector<SettingsKeyRange_t>* damagedRanges) const;
+    [[nodiscard]] SettingError_t loadMappedTree(std::string_view fileData) const;
+    static int parseMappedRecordCallback(void* data, std::string_view record, uint32_t id);
+    [[nodiscard]] SettingError_t loadSettingRecords(std::string_view records, uint32_t threads,
+                                                    SettingsChecksumAlgorithm_t checksumAlgorithm,
+                                                    uint32_t                    expectedChecksum) const;
+    static void parseSettingsChunk(SettingsChecksumAlgorithm_t checksumAlgorithm, SettingsLoadChunk_t* chunk);
+    static SettingValue_t*       mergeSettingLoadRecordCallback(void* data, SettingLoadRecord_t& record,
+                                                                SettingValue_t* value);
+    static bool checkSettingLoadRecordCallback(void* data, const SettingLoadRecord_t& record,
+                                               const SettingValue_t* value);
+    int         mergeSettingLoadRecords(std::vector<SettingLoadRecord_t>& records, SettingLoadRecordCallback_t cb,
+                                        SettingLoadRecordCheck_t check) const;
+    static SettingValue_t* resetSettingLoadRecordCallback(void* data, SettingValue_t* value);
+    static SettingError_t        parseSettingRecord(std::string_view record, SettingLoadRecord_t& loadRecord);
+    static SettingError_t parseSettingRecords(std::string_view data, std::vector<SettingLoadRecord_t>& records);
+    static SettingError_t  indexSettingRecords(std::string_view records, std::vector<SettingLazyRecord_t>& index,
+                                               bool& sorted);
+    SettingError_t         loadLazySettings(std::string_view keyPrefix, bool wholeKey, uint32_t timeoutMs) const;
+    SettingError_t         loadLazySettings(const SettingsKeysList_t& keys, uint32_t timeoutMs) const;
+    std::string_view       getLazyRecordKey(const SettingLazyRecord_t& lazyRecord) const;
+    void                   loadLazyRecord(SettingLazyRecord_t&              lazyRecord,
+                                          std::vector<SettingLoadRecord_t>& batch) const;
+    void                   loadPendingRecord(std::string_view record, std::vector<SettingLoadRecord_t>& batch) const;
+    SettingError_t         attachLazyMappedTree(std::string_view fileData) const;
+    int                    loadMappedRecords(std::string_view firstKey, std::string_view keyPrefix,
+                                             SettingsMappedLoadCallbackData_t& callbackData) const;
+    static int             loadMappedRecordCallback(void* data, std::string_view record, uint32_t id);
+    static int             skipMappedRecordCallback(void* data, std::string_view record, uint32_t id);
+    SettingError_t         flushLazyRecords(std::vector<SettingLoadRecord_t>& batch) const;
+    static SettingValue_t* mergeLazyRecordCallback(void* data, SettingLoadRecord_t& record, SettingValue_t* value);
+    void                   loadLazySettingsInBackground() const;
+    static void            loadLazySettingsInBackgroundTask(void* data);
+    void                   stopLazySettingsLoader() const;
+    void                   releaseLazyImage() const;
+    [[nodiscard]] SettingError_t discardLazySettings() const;
+    static int             exportSettingCallback(void* data, const unsigned char* key, uint32_t key_len, void* value);
+    static SettingValue_t* importSettingCallback(void* data, SettingImportRecord_t& record, SettingValue_t* value);
 
-    SettingError_t               getSettingValue(const char* key, SettingValue_t*& outputValue) const;
+    SettingError_t               getSettingValue(const char* key, SettingValue_t*& outputValue,
+                                                 bool forWrite = false) const;
     [[nodiscard]] SettingError_t getSettingValueAsInt(TypeofSettingValue type, const char* key, int64_t& outputValue,
                                                       SettingPermissions_t* outputPermissions = nullptr) const;
     [[nodiscard]] SettingError_t getSettingValueAsReal(TypeofSettingValue type, const char* key, double& outputValue,
@@ -417,7 +1505,24 @@ private:
                                                          char* outputValueBuffer, size_t outputValueSize,
                                                          SettingPermissions_t* outputPermissions = nullptr) const;
 
-    static void freeSettingValue(const SettingValue_t* settingValue);
+    // The values and strings are allocated and freed under the pool mutex, unless poolLocked is true because the caller
+    // holds it, see lockSettingsValuePool(). If it can not be taken in time, the allocations return nullptr or false,
+    // and the memory freed stays in the pool until it is destroyed.
+    [[nodiscard]] bool lockSettingsValuePool() const;
+    void               unlockSettingsValuePool() const;
+    void               freeSettingValue(SettingValue_t* settingValue) const;
+    SettingValue_t*    newSettingValue(bool poolLocked = false) const;
+    void               deleteSettingValue(SettingValue_t* settingValue, bool poolLocked = false) const;
+    char*              newSettingString(const char* value, size_t length, bool poolLocked = false) const;
+    size_t             getSettingStringCapacity(size_t length) const;
+    void               deleteSettingString(char* string, size_t capacity, bool poolLocked = false) const;
+    [[nodiscard]] bool assignSettingString(SettingValue_t* settingValue, const char* value, size_t length,
+                                           bool poolLocked = false) const;
+    void               releaseSettingString(SettingValue_t* settingValue, bool poolLocked = false) const;
+    [[nodiscard]] bool assignDefaultSettingString(SettingValue_t* settingValue, const char* value, size_t length,
+                                                  bool poolLocked = false) const;
+    void               releaseDefaultSettingString(SettingValue_t* settingValue, bool poolLocked = false) const;
+    void               shareDefaultSettingString(SettingValue_t* settingValue, bool poolLocked = false) const;
 };
 
 #endif // SETTINGSSTORAGE_SETTINGS_H
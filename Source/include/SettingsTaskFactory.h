@@ -0,0 +1,66 @@
+#ifndef SETTINGSSTORAGE_SETTINGSTASKFACTORY_H
+#define SETTINGSSTORAGE_SETTINGSTASKFACTORY_H
+
+#include <cstdint>
+
+/// How a task created by SettingsTaskFactory::createTask() runs.
+typedef struct SettingsTaskConfig_t
+{
+    const char* name;      // Name of the task, only used for debugging.
+    uint32_t    stackSize; // Size of the stack of the task in bytes, 0 for the default of the OS.
+    uint32_t    priority;  // Priority of the task, 0 for the default of the OS.
+    int32_t     core;      // Core the task is pinned to, -1 to let the OS choose.
+} SettingsTaskConfig_t;
+
+/// A task created by SettingsTaskFactory::createTask(). Deleting it does not stop the task, it must be joined first.
+class SettingsTask
+{
+public:
+    virtual ~SettingsTask() = default;
+
+    /**
+     * @brief Wait until the function of the task returns.
+     */
+    virtual void join() = 0;
+};
+
+/**
+ * @brief Creates the tasks in which SettingsStorage runs its parallel and background work, as an extension of the
+ * OSInterface, which can not create tasks.
+ *
+ * The default implementation runs each task in a std::thread, with the stack size, priority and core of the platform,
+ * so an OS shim that can place its tasks also implements this class and overrides createTask(), e.g. with
+ * xTaskCreatePinnedToCore(). SettingsStorage only uses it once it is given to SettingsStorage::setTaskFactory(), and
+ * creates its tasks with createDefaultTask() otherwise.
+ */
+class SettingsTaskFactory
+{
+public:
+    virtual ~SettingsTaskFactory() = default;
+
+    /**
+     * @brief Run a function in a new task.
+     *
+     * @param function The function run by the task.
+     * @param arg The argument of the function.
+     * @param config How the task runs.
+     * @return SettingsTask* The task, that must be joined and deleted by the caller, or nullptr if it could not be
+     * created.
+     */
+    virtual SettingsTask* createTask(void (*function)(void* arg), void* arg, const SettingsTaskConfig_t& config)
+    {
+        return createDefaultTask(function, arg, config);
+    }
+
+    /**
+     * @brief Run a function in a new std::thread, ignoring the stack size, priority and core of the config.
+     *
+     * @param function The function run by the task.
+     * @param arg The argument of the function.
+     * @param config How the task runs.
+     * @return SettingsTask* The task, that must be joined and deleted by the caller.
+     */
+    static SettingsTask* createDefaultTask(void (*function)(void* arg), void* arg, const SettingsTaskConfig_t& config);
+};
+
+#endif // SETTINGSSTORAGE_SETTINGSTASKFACTORY_H
@@ -0,0 +1,122 @@
+#ifndef SETTINGSSTORAGE_SETTINGSVALUEPOOL_H
+#define SETTINGSSTORAGE_SETTINGSVALUEPOOL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifndef CONFIG_SETTINGS_STORAGE_VALUE_POOL_SLAB_SIZE
+    #define CONFIG_SETTINGS_STORAGE_VALUE_POOL_SLAB_SIZE 256 // 0 allocates each value and string on its own.
+#endif
+
+#ifndef CONFIG_SETTINGS_STORAGE_STRING_POOL_SLAB_SIZE
+    #define CONFIG_SETTINGS_STORAGE_STRING_POOL_SLAB_SIZE 4096
+#endif
+
+/**
+ * @brief Allocator of the values of the settings and of their strings, that takes their memory from a few big slabs.
+ *
+ * The values all have the same size, and are carved from slabs that hold a fixed number of them. The strings are
+ * rounded up to a few size classes, and each class is carved from its own slabs, so a freed string is reused by the
+ * next string of its class and the slabs do not fragment the heap. The strings bigger than the biggest class are
+ * allocated on their own, and linked together so they are freed with the slabs.
+ *
+ * Freed values and strings are kept for the next allocations, the memory is only released when the pool is destroyed,
+ * in one operation per slab. The pool is not thread safe.
+ */
+class SettingsValuePool
+{
+public:
+    /// The sizes of the blocks of the strings, including the NUL character. Bigger strings are allocated on their own.
+    static constexpr std::array<size_t, 5> STRING_SIZE_CLASSES = {16, 32, 64, 128, 256};
+
+    /**
+     * @brief Build a new empty Settings Value Pool object. No memory is allocated until it is needed.
+     *
+     * @param objectSize The size of the values.
+     * @param objectsPerSlab The number of values of each slab.
+     * @param stringSlabSize The size of the slabs of each class of strings, in bytes.
+     */
+    SettingsValuePool(size_t objectSize, size_t objectsPerSlab,
+                      size_t stringSlabSize = CONFIG_SETTINGS_STORAGE_STRING_POOL_SLAB_SIZE);
+
+    /**
+     * @brief Destroy the Settings Value Pool object, releasing every slab and big string at once. The values and
+     * strings that were not freed are released too, without calling their destructors.
+     */
+    ~SettingsValuePool();
+
+    /**
+     * Disallow copying or moving the object.
+     */
+    SettingsValuePool& operator=(SettingsValuePool&&) = delete;
+
+    /// Get the memory of a value, aligned for any type. Its content is undefined.
+    [[nodiscard]] void* allocateObject();
+
+    /// Give back the memory of a value, so the next value reuses it.
+    void freeObject(void* object);
+
+    /**
+     * @brief Get the memory of a string.
+     * @param size The size of the string, including the NUL character.
+     * @return The memory of the string. Its content is undefined.
+     */
+    [[nodiscard]] char* allocateString(size_t size);
+
+    /**
+     * @brief Give back the memory of a string, so the next string of its class reuses it.
+     * @param string The string, as returned by allocateString().
+     * @param size The size the string was allocated with.
+     */
+    void freeString(char* string, size_t size);
+
+    /// Get the number of bytes a string of the given size uses, so it can grow in place up to it.
+    [[nodiscard]] static size_t getStringCapacity(size_t size);
+
+    /**
+     * @brief Allocate the slabs of a number of values in advance, so they are not allocated while the values are.
+     * @param objects The number of values that will be allocated, including the ones already allocated.
+     */
+    void reserve(size_t objects);
+
+    /// Get the number of slabs allocated, of values and of strings.
+    [[nodiscard]] size_t getSlabCount() const;
+
+private:
+    /// A freed block, linked to the next freed block of its size.
+    typedef struct FreeBlock_t
+    {
+        FreeBlock_t* next;
+    } FreeBlock_t;
+
+    /// Blocks of the same size, taken from the free list, or from the end of the last slab.
+    typedef struct BlockClass_t
+    {
+        size_t       blockSize;
+        size_t       blocksPerSlab;
+        FreeBlock_t* freeBlocks;
+        char*        nextBlock; // Next block of the last slab that was never used.
+        char*        slabEnd;
+        size_t       freeBlockCount;
+        size_t       allocatedBlocks;
+    } BlockClass_t;
+
+    /// Header of a string bigger than the biggest class, linked to the other big strings.
+    typedef struct alignas(std::max_align_t) BigString_t
+    {
+        BigString_t* previous;
+        BigString_t* next;
+    } BigString_t;
+
+    BlockClass_t                                         objects;
+    std::array<BlockClass_t, STRING_SIZE_CLASSES.size()> strings;
+    std::vector<void*>                                   slabs;
+    BigString_t                                          bigStrings; // Empty header, the list is circular.
+
+    void* allocateBlock(BlockClass_t& blockClass);
+    void  addSlab(BlockClass_t& blockClass);
+};
+
+#endif // SETTINGSSTORAGE_SETTINGSVALUEPOOL_H
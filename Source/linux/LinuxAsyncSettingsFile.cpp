@@ -0,0 +1,535 @@
+#include "LinuxAsyncSettingsFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+LinuxAsyncSettingsFile::LinuxAsyncSettingsFile(const char* filePath, const size_t bufferSize,
+                                               const uint32_t queueDepth, const bool useRing)
+{
+    this->filePath              = filePath;
+    this->fileStatus            = FileClosed;
+    this->fileDescriptor        = -1;
+    this->bufferSize            = std::max<size_t>(bufferSize, 1);
+    this->queueDepth            = std::max<uint32_t>(queueDepth, 1);
+    this->readIndex             = 0;
+    this->writeOffset           = 0;
+    this->writeResult           = Success;
+    this->unsubmittedRequests   = 0;
+    this->ringFd                = -1;
+    this->submissionRing        = nullptr;
+    this->submissionRingSize    = 0;
+    this->completionRing        = nullptr;
+    this->completionRingSize    = 0;
+    this->submissionEntries     = nullptr;
+    this->submissionEntriesSize = 0;
+    this->submissionTail        = nullptr;
+    this->submissionMask        = 0;
+    this->submissionArray       = nullptr;
+    this->completionHead        = nullptr;
+    this->completionTail        = nullptr;
+    this->completionMask        = 0;
+    this->completionEntries     = nullptr;
+
+    // The buffers in flight must not move, so the vector is never reallocated.
+    pendingBuffers.reserve(this->queueDepth);
+    requests.reserve(this->queueDepth);
+    if (useRing)
+    {
+        setupRing();
+    }
+}
+
+LinuxAsyncSettingsFile::~LinuxAsyncSettingsFile()
+{
+    forceClose();
+    teardownRing();
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::read(char* byte)
+{
+    if (fileStatus != FileOpenedForRead)
+    {
+        return InvalidState;
+    }
+    if (readIndex >= readData.size())
+    {
+        return EndOfFile;
+    }
+
+    *byte = readData[readIndex++];
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::readLine(std::string& buffer)
+{
+    if (fileStatus != FileOpenedForRead)
+    {
+        return InvalidState;
+    }
+    if (readIndex >= readData.size())
+    {
+        return EndOfFile;
+    }
+
+    // The line is returned with its new line character, if it has one.
+    const size_t lineEnd  = readData.find('\n', readIndex);
+    const size_t lineSize = lineEnd != std::string::npos ? lineEnd - readIndex + 1 : readData.size() - readIndex;
+    buffer.append(readData, readIndex, lineSize);
+    readIndex += lineSize;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::write(const char byte)
+{
+    if (fileStatus != FileOpenedForWrite)
+    {
+        return InvalidState;
+    }
+
+    writeBuffer.push_back(byte);
+    return writeBuffer.size() >= bufferSize ? submitWriteBuffer() : writeResult;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::write(const std::string& data)
+{
+    if (fileStatus != FileOpenedForWrite)
+    {
+        return InvalidState;
+    }
+
+    writeBuffer.append(data);
+    return writeBuffer.size() >= bufferSize ? submitWriteBuffer() : writeResult;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::openForRead()
+{
+    if (fileStatus != FileClosed)
+    {
+        return InvalidState;
+    }
+
+    fileDescriptor = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0)
+    {
+        return InvalidState;
+    }
+
+    struct stat fileStat{};
+    if (fstat(fileDescriptor, &fileStat) != 0)
+    {
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+        return InvalidState;
+    }
+
+    // The file is split in at most one block per request in flight, so all of them are submitted together.
+    const auto   fileSize  = static_cast<size_t>(fileStat.st_size);
+    const size_t blockSize = std::max(bufferSize, (fileSize + queueDepth - 1) / queueDepth);
+    readData.resize(fileSize);
+    SettingsFileResult res = Success;
+    for (size_t offset = 0; offset < fileSize && res == Success; offset += blockSize)
+    {
+        res = queueRequest(readData.data() + offset, std::min(blockSize, fileSize - offset), offset, false);
+    }
+    const SettingsFileResult waitResult = waitForRequests();
+    ::close(fileDescriptor);
+    fileDescriptor = -1;
+    if (res != Success || waitResult != Success)
+    {
+        readData.clear();
+        return IOError;
+    }
+
+    readIndex  = 0;
+    fileStatus = FileOpenedForRead;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::openForWrite()
+{
+    if (fileStatus != FileClosed)
+    {
+        return InvalidState;
+    }
+
+    fileDescriptor = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fileDescriptor < 0)
+    {
+        return InvalidState;
+    }
+
+    writeBuffer.clear();
+    writeBuffer.reserve(bufferSize);
+    writeOffset = 0;
+    writeResult = Success;
+    fileStatus  = FileOpenedForWrite;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::close()
+{
+    SettingsFileResult result = Success;
+    switch (fileStatus)
+    {
+        case FileOpenedForRead:
+            readData.clear();
+            readData.shrink_to_fit();
+            break;
+        case FileOpenedForWrite:
+            // The file is only closed once every buffer submitted is written.
+            submitWriteBuffer();
+            waitForRequests();
+            result = writeResult;
+            if (::close(fileDescriptor) != 0 && result == Success)
+            {
+                result = IOError;
+            }
+            fileDescriptor = -1;
+            writeBuffer.clear();
+            writeBuffer.shrink_to_fit();
+            break;
+        default:
+            return InvalidState;
+    }
+
+    fileStatus = FileClosed;
+    return result;
+}
+
+void LinuxAsyncSettingsFile::forceClose()
+{
+    if (fileStatus != FileClosed)
+    {
+        close();
+    }
+}
+
+SettingsFile::FileStatus LinuxAsyncSettingsFile::getOpenStatus()
+{
+    return fileStatus;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::mapForRead(std::string_view& data)
+{
+    if (fileStatus != FileOpenedForRead)
+    {
+        data = {};
+        return InvalidState;
+    }
+
+    data = readData;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::writeBuffers(const std::span<const std::string_view> buffers)
+{
+    if (fileStatus != FileOpenedForWrite)
+    {
+        return InvalidState;
+    }
+
+    // The data written before goes first. The buffers are not copied, so they are waited for before returning.
+    SettingsFileResult res = submitWriteBuffer();
+    for (size_t i = 0; i < buffers.size() && res == Success; i++)
+    {
+        if (!buffers[i].empty())
+        {
+            res = queueRequest(const_cast<char*>(buffers[i].data()), buffers[i].size(), writeOffset, true);
+            writeOffset += buffers[i].size();
+        }
+    }
+    if (const SettingsFileResult waitResult = waitForRequests(); res == Success)
+    {
+        res = waitResult;
+    }
+    if (writeResult == Success)
+    {
+        writeResult = res;
+    }
+    return writeResult;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::sync(const SettingsDurability_t durability)
+{
+    if (fileStatus != FileOpenedForWrite || durability >= SettingsDurability_t::MAX_SETTINGS_DURABILITY)
+    {
+        return InvalidState;
+    }
+    if (durability == SettingsDurability_t::NONE)
+    {
+        return writeResult;
+    }
+
+    // The data is only handed to the kernel once its buffer is submitted and the request completed.
+    submitWriteBuffer();
+    waitForRequests();
+    if (writeResult == Success && durability > SettingsDurability_t::BUFFERED)
+    {
+        const int result =
+            durability == SettingsDurability_t::FSYNCED ? fsync(fileDescriptor) : fdatasync(fileDescriptor);
+        if (result != 0)
+        {
+            writeResult = IOError;
+        }
+    }
+    return writeResult;
+}
+
+bool LinuxAsyncSettingsFile::isUsingRing() const
+{
+    return ringFd >= 0;
+}
+
+bool LinuxAsyncSettingsFile::setupRing()
+{
+    io_uring_params params{};
+    const auto      fd = static_cast<int>(syscall(__NR_io_uring_setup, queueDepth, &params));
+    if (fd < 0)
+    {
+        return false;
+    }
+    ringFd = fd;
+
+    // Older kernels map the submission and completion rings separately.
+    submissionRingSize    = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    completionRingSize    = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    submissionEntriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    const bool singleMap  = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+    {
+        submissionRingSize = std::max(submissionRingSize, completionRingSize);
+        completionRingSize = submissionRingSize;
+    }
+
+    void* mapping = mmap(nullptr, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                         IORING_OFF_SQ_RING);
+    if (mapping == MAP_FAILED)
+    {
+        teardownRing();
+        return false;
+    }
+    submissionRing = mapping;
+    if (singleMap)
+    {
+        completionRing = submissionRing;
+    }
+    else
+    {
+        mapping = mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                       IORING_OFF_CQ_RING);
+        if (mapping == MAP_FAILED)
+        {
+            teardownRing();
+            return false;
+        }
+        completionRing = mapping;
+    }
+    mapping = mmap(nullptr, submissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                   IORING_OFF_SQES);
+    if (mapping == MAP_FAILED)
+    {
+        teardownRing();
+        return false;
+    }
+    submissionEntries = static_cast<io_uring_sqe*>(mapping);
+
+    auto* submission  = static_cast<char*>(submissionRing);
+    auto* completion  = static_cast<char*>(completionRing);
+    submissionTail    = reinterpret_cast<uint32_t*>(submission + params.sq_off.tail);
+    submissionMask    = *reinterpret_cast<uint32_t*>(submission + params.sq_off.ring_mask);
+    submissionArray   = reinterpret_cast<uint32_t*>(submission + params.sq_off.array);
+    completionHead    = reinterpret_cast<uint32_t*>(completion + params.cq_off.head);
+    completionTail    = reinterpret_cast<uint32_t*>(completion + params.cq_off.tail);
+    completionMask    = *reinterpret_cast<uint32_t*>(completion + params.cq_off.ring_mask);
+    completionEntries = reinterpret_cast<io_uring_cqe*>(completion + params.cq_off.cqes);
+    return true;
+}
+
+void LinuxAsyncSettingsFile::teardownRing()
+{
+    if (submissionEntries != nullptr)
+    {
+        munmap(submissionEntries, submissionEntriesSize);
+    }
+    if (completionRing != nullptr && completionRing != submissionRing)
+    {
+        munmap(completionRing, completionRingSize);
+    }
+    if (submissionRing != nullptr)
+    {
+        munmap(submissionRing, submissionRingSize);
+    }
+    if (ringFd >= 0)
+    {
+        ::close(ringFd);
+    }
+    ringFd            = -1;
+    submissionRing    = nullptr;
+    completionRing    = nullptr;
+    submissionEntries = nullptr;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::queueRequest(char* data, const size_t size,
+                                                                    const uint64_t offset, const bool write)
+{
+    if (ringFd < 0)
+    {
+        return transfer({data, size, offset, write}, 0);
+    }
+    if (requests.size() == queueDepth)
+    {
+        if (const SettingsFileResult res = waitForRequests(); res != Success)
+        {
+            return res;
+        }
+    }
+
+    // Only this object produces submissions, so its own tail is read without synchronization.
+    const uint32_t tail  = *submissionTail;
+    const uint32_t index = tail & submissionMask;
+    io_uring_sqe&  entry = submissionEntries[index];
+    memset(&entry, 0, sizeof(entry));
+    entry.opcode    = write ? IORING_OP_WRITE : IORING_OP_READ;
+    entry.fd        = fileDescriptor;
+    entry.addr      = reinterpret_cast<uint64_t>(data);
+    entry.len       = static_cast<uint32_t>(std::min<size_t>(size, 1U << 30)); // The rest is transferred later.
+    entry.off       = offset;
+    entry.user_data = requests.size();
+    submissionArray[index] = index;
+    requests.push_back({data, size, offset, write});
+    std::atomic_ref(*submissionTail).store(tail + 1, std::memory_order_release);
+    unsubmittedRequests++;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::startRequests()
+{
+    if (ringFd < 0 || unsubmittedRequests == 0)
+    {
+        return Success;
+    }
+
+    // The requests are not waited for. If they can not be submitted now, waitForRequests() submits them.
+    const auto submitted =
+        static_cast<int>(syscall(__NR_io_uring_enter, ringFd, unsubmittedRequests, 0, 0, nullptr, 0));
+    if (submitted > 0)
+    {
+        unsubmittedRequests -= static_cast<uint32_t>(submitted);
+    }
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::waitForRequests()
+{
+    SettingsFileResult result    = Success;
+    size_t             completed = 0;
+    while (ringFd >= 0 && completed < requests.size())
+    {
+        const auto submitted =
+            static_cast<int>(syscall(__NR_io_uring_enter, ringFd, unsubmittedRequests, requests.size() - completed,
+                                     IORING_ENTER_GETEVENTS, nullptr, 0));
+        if (submitted < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            {
+                continue;
+            }
+
+            // The ring is no longer usable, so it is closed, and the next requests are transferred with pread() and
+            // pwrite().
+            teardownRing();
+            result = IOError;
+            break;
+        }
+        unsubmittedRequests -= static_cast<uint32_t>(submitted);
+
+        // A short transfer is completed here, instead of submitting the rest again.
+        uint32_t       head = *completionHead;
+        const uint32_t tail = std::atomic_ref(*completionTail).load(std::memory_order_acquire);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe&          completion = completionEntries[head & completionMask];
+            const SettingsFileRequest_t& request    = requests[completion.user_data];
+            if (completion.res <= 0 ||
+                (static_cast<size_t>(completion.res) < request.size &&
+                 transfer(request, static_cast<size_t>(completion.res)) != Success))
+            {
+                result = IOError;
+            }
+            completed++;
+        }
+        std::atomic_ref(*completionHead).store(head, std::memory_order_release);
+    }
+
+    requests.clear();
+    pendingBuffers.clear();
+    unsubmittedRequests = 0;
+    if (result != Success && fileStatus == FileOpenedForWrite && writeResult == Success)
+    {
+        writeResult = result;
+    }
+    return result;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::submitWriteBuffer()
+{
+    if (writeBuffer.empty() || writeResult != Success)
+    {
+        return writeResult;
+    }
+    if (ringFd >= 0 && requests.size() == queueDepth && waitForRequests() != Success)
+    {
+        return writeResult;
+    }
+
+    // The buffer is kept until it is written, and the next data goes to a new one.
+    std::string& buffer = pendingBuffers.emplace_back(std::move(writeBuffer));
+    writeBuffer         = std::string();
+    writeBuffer.reserve(bufferSize);
+    SettingsFileResult res = queueRequest(buffer.data(), buffer.size(), writeOffset, true);
+    writeOffset += buffer.size();
+    if (res == Success)
+    {
+        res = startRequests();
+    }
+    if (ringFd < 0)
+    {
+        pendingBuffers.clear();
+    }
+    if (writeResult == Success)
+    {
+        writeResult = res;
+    }
+    return writeResult;
+}
+
+SettingsFile::SettingsFileResult LinuxAsyncSettingsFile::transfer(const SettingsFileRequest_t& request,
+                                                                  size_t                       done) const
+{
+    while (done < request.size)
+    {
+        const ssize_t transferred =
+            request.write ? ::pwrite(fileDescriptor, request.data + done, request.size - done,
+                                     static_cast<off_t>(request.offset + done))
+                          : ::pread(fileDescriptor, request.data + done, request.size - done,
+                                    static_cast<off_t>(request.offset + done));
+        if (transferred < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        // A read that ends early means the file was truncated meanwhile.
+        if (transferred <= 0)
+        {
+            return IOError;
+        }
+        done += static_cast<size_t>(transferred);
+    }
+    return Success;
+}
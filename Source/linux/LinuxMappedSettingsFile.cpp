@@ -0,0 +1,366 @@
+#include "LinuxMappedSettingsFile.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LinuxMappedSettingsFile::LinuxMappedSettingsFile(const char* filePath)
+{
+    this->filePath        = filePath;
+    this->fileStatus      = FileClosed;
+    this->fileDescriptor  = -1;
+    this->mappedData      = nullptr;
+    this->mappedSize      = 0;
+    this->readIndex       = 0;
+    this->updateSize      = 0;
+    this->updating        = false;
+    this->mappedForUpdate = false;
+}
+
+LinuxMappedSettingsFile::~LinuxMappedSettingsFile()
+{
+    forceClose();
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::read(char* byte)
+{
+    if (fileStatus != FileOpenedForRead)
+    {
+        return InvalidState;
+    }
+    if (readIndex >= mappedSize)
+    {
+        return EndOfFile;
+    }
+
+    *byte = mappedData[readIndex++];
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::readLine(std::string& buffer)
+{
+    if (fileStatus != FileOpenedForRead)
+    {
+        return InvalidState;
+    }
+    if (readIndex >= mappedSize)
+    {
+        return EndOfFile;
+    }
+
+    // The line is returned with its new line character, if it has one.
+    const char* lineStart = mappedData + readIndex;
+    const auto* lineEnd   = static_cast<const char*>(memchr(lineStart, '\n', mappedSize - readIndex));
+    const size_t lineSize = lineEnd != nullptr ? lineEnd - lineStart + 1 : mappedSize - readIndex;
+    buffer.append(lineStart, lineSize);
+    readIndex += lineSize;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::write(const char byte)
+{
+    // A file opened for update is only written at explicit offsets, or through its mapping.
+    return updating || mappedForUpdate ? InvalidState : writeAll(&byte, 1);
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::write(const std::string& data)
+{
+    return updating || mappedForUpdate ? InvalidState : writeAll(data.data(), data.size());
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::openForRead()
+{
+    if (fileStatus != FileClosed)
+    {
+        return InvalidState;
+    }
+
+    const int descriptor = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (descriptor < 0)
+    {
+        return InvalidState;
+    }
+
+    struct stat fileStat{};
+    if (fstat(descriptor, &fileStat) != 0)
+    {
+        ::close(descriptor);
+        return InvalidState;
+    }
+
+    // An empty file can not be mapped, but it is a valid file with no data.
+    mappedData = nullptr;
+    mappedSize = static_cast<size_t>(fileStat.st_size);
+    if (mappedSize > 0)
+    {
+        void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE | MAP_POPULATE, descriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            ::close(descriptor);
+            mappedSize = 0;
+            return InvalidState;
+        }
+        madvise(mapping, mappedSize, MADV_SEQUENTIAL);
+        mappedData = static_cast<const char*>(mapping);
+    }
+
+    // The mapping keeps its own reference to the file.
+    ::close(descriptor);
+    readIndex  = 0;
+    fileStatus = FileOpenedForRead;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::openForWrite()
+{
+    if (fileStatus != FileClosed)
+    {
+        return InvalidState;
+    }
+
+    fileDescriptor = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fileDescriptor < 0)
+    {
+        return InvalidState;
+    }
+
+    fileStatus = FileOpenedForWrite;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::close()
+{
+    SettingsFileResult result = Success;
+    switch (fileStatus)
+    {
+        case FileOpenedForRead:
+            if (mappedData != nullptr && munmap(const_cast<char*>(mappedData), mappedSize) != 0)
+            {
+                result = InvalidState;
+            }
+            mappedData = nullptr;
+            mappedSize = 0;
+            break;
+        case FileOpenedForWrite:
+            if (mappedData != nullptr && munmap(const_cast<char*>(mappedData), mappedSize) != 0)
+            {
+                result = InvalidState;
+            }
+            if (::close(fileDescriptor) != 0)
+            {
+                result = InvalidState;
+            }
+            mappedData      = nullptr;
+            mappedSize      = 0;
+            fileDescriptor  = -1;
+            updating        = false;
+            updateSize      = 0;
+            mappedForUpdate = false;
+            break;
+        default:
+            return InvalidState;
+    }
+
+    fileStatus = FileClosed;
+    return result;
+}
+
+void LinuxMappedSettingsFile::forceClose()
+{
+    if (fileStatus != FileClosed)
+    {
+        close();
+    }
+}
+
+SettingsFile::FileStatus LinuxMappedSettingsFile::getOpenStatus()
+{
+    return fileStatus;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::mapForRead(std::string_view& data)
+{
+    if (fileStatus != FileOpenedForRead)
+    {
+        data = {};
+        return InvalidState;
+    }
+
+    data = std::string_view(mappedData, mappedSize);
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::openForUpdate()
+{
+    if (fileStatus != FileClosed)
+    {
+        return InvalidState;
+    }
+
+    fileDescriptor = ::open(filePath.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fileDescriptor < 0)
+    {
+        return InvalidState;
+    }
+
+    struct stat fileStat{};
+    if (fstat(fileDescriptor, &fileStat) != 0)
+    {
+        ::close(fileDescriptor);
+        fileDescriptor = -1;
+        return InvalidState;
+    }
+
+    updateSize = static_cast<size_t>(fileStat.st_size);
+    updating   = true;
+    fileStatus = FileOpenedForWrite;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::writeAt(size_t offset, std::string_view data)
+{
+    if (fileStatus != FileOpenedForWrite || !updating || offset > updateSize || data.size() > updateSize - offset)
+    {
+        return InvalidState;
+    }
+
+    while (!data.empty())
+    {
+        const ssize_t written = ::pwrite(fileDescriptor, data.data(), data.size(), static_cast<off_t>(offset));
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return InvalidState;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+        offset += static_cast<size_t>(written);
+    }
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::mapForUpdate(const size_t size, char*& data,
+                                                                      size_t& mappedSize)
+{
+    data       = nullptr;
+    mappedSize = 0;
+    if (fileStatus == FileClosed)
+    {
+        fileDescriptor = ::open(filePath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fileDescriptor < 0)
+        {
+            return InvalidState;
+        }
+        fileStatus      = FileOpenedForWrite;
+        mappedForUpdate = true;
+    }
+    else if (!mappedForUpdate)
+    {
+        return InvalidState;
+    }
+
+    struct stat fileStat{};
+    if (fstat(fileDescriptor, &fileStat) != 0)
+    {
+        return InvalidState;
+    }
+
+    // The blocks of the new size are allocated, so a full filesystem is reported here instead of when the mapping is
+    // written, which would raise SIGBUS.
+    auto fileSize = static_cast<size_t>(fileStat.st_size);
+    if (size > fileSize)
+    {
+        if (posix_fallocate(fileDescriptor, 0, static_cast<off_t>(size)) != 0)
+        {
+            return InvalidState;
+        }
+        fileSize = size;
+    }
+
+    if (mappedData != nullptr)
+    {
+        munmap(const_cast<char*>(mappedData), this->mappedSize);
+        mappedData       = nullptr;
+        this->mappedSize = 0;
+    }
+    if (fileSize > 0)
+    {
+        void* mapping = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            return InvalidState;
+        }
+        mappedData       = static_cast<const char*>(mapping);
+        this->mappedSize = fileSize;
+    }
+    data       = const_cast<char*>(mappedData);
+    mappedSize = this->mappedSize;
+    return Success;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::syncMapped(const size_t offset, const size_t length)
+{
+    if (fileStatus != FileOpenedForWrite || !mappedForUpdate || offset > mappedSize || length > mappedSize - offset)
+    {
+        return InvalidState;
+    }
+    if (length == 0)
+    {
+        return Success;
+    }
+
+    // msync() only takes ranges that start at a page boundary.
+    const auto   pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t start    = offset / pageSize * pageSize;
+    return msync(const_cast<char*>(mappedData) + start, offset + length - start, MS_SYNC) == 0 ? Success
+                                                                                             : InvalidState;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::sync(const SettingsDurability_t durability)
+{
+    if (fileStatus != FileOpenedForWrite || durability >= SettingsDurability_t::MAX_SETTINGS_DURABILITY)
+    {
+        return InvalidState;
+    }
+    if (durability <= SettingsDurability_t::BUFFERED)
+    {
+        return Success;
+    }
+
+    // The changes of a shared mapping are only written by the kernel when it chooses to, fdatasync() does not wait
+    // for them.
+    if (mappedForUpdate && mappedData != nullptr && msync(const_cast<char*>(mappedData), mappedSize, MS_SYNC) != 0)
+    {
+        return InvalidState;
+    }
+    const int result = durability == SettingsDurability_t::FSYNCED ? fsync(fileDescriptor) : fdatasync(fileDescriptor);
+    return result == 0 ? Success : InvalidState;
+}
+
+SettingsFile::SettingsFileResult LinuxMappedSettingsFile::writeAll(const char* data, size_t size) const
+{
+    if (fileStatus != FileOpenedForWrite)
+    {
+        return InvalidState;
+    }
+
+    while (size > 0)
+    {
+        const ssize_t written = ::write(fileDescriptor, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return InvalidState;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return Success;
+}
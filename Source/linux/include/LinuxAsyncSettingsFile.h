@@ -0,0 +1,129 @@
+#ifndef SETTINGSSTORAGE_LINUXASYNCSETTINGSFILE_H
+#define SETTINGSSTORAGE_LINUXASYNCSETTINGSFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ExtendedSettingsFile.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * @brief SettingsFile backed by a file of the Linux filesystem, that reads and writes it in large blocks submitted
+ * through io_uring, so the calls of SettingsStorage do not wait for each block.
+ *
+ * When the file is opened for read, the whole file is read with one request per block, submitted together, and then
+ * parsed in memory through mapForRead(). The data written is gathered in a buffer, and each full buffer is submitted
+ * without waiting for it, up to a number of buffers in flight. Once a write fails, the next calls report it, and
+ * close() waits until every buffer is written. writeBuffers() submits several buffers of the caller together and
+ * waits once. sync() submits the data gathered and waits for every buffer before calling fdatasync() or fsync().
+ *
+ * If io_uring is not available, the blocks are read and written with pread() and pwrite() when they are submitted.
+ */
+class LinuxAsyncSettingsFile : public ExtendedSettingsFile
+{
+public:
+    /// The default size of the blocks read and written.
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 64 * 1024;
+
+    /// The default number of requests in flight.
+    static constexpr uint32_t DEFAULT_QUEUE_DEPTH = 8;
+
+    /**
+     * @brief Build a new Linux Async Settings File object. The file is not opened until it is needed.
+     * @param filePath The path of the file.
+     * @param bufferSize The size of the blocks read and written.
+     * @param queueDepth The maximum number of requests in flight.
+     * @param useRing Whether io_uring is used if it is available, or pread() and pwrite() are always used.
+     */
+    explicit LinuxAsyncSettingsFile(const char* filePath, size_t bufferSize = DEFAULT_BUFFER_SIZE,
+                                    uint32_t queueDepth = DEFAULT_QUEUE_DEPTH, bool useRing = true);
+
+    /**
+     * @brief Destroy the Linux Async Settings File object, closing the file if it is open.
+     */
+    ~LinuxAsyncSettingsFile() override;
+
+    SettingsFileResult read(char* byte) override;
+
+    SettingsFileResult readLine(std::string& buffer) override;
+
+    SettingsFileResult write(char byte) override;
+
+    SettingsFileResult write(const std::string& data) override;
+
+    SettingsFileResult openForRead() override;
+
+    SettingsFileResult openForWrite() override;
+
+    SettingsFileResult close() override;
+
+    void forceClose() override;
+
+    FileStatus getOpenStatus() override;
+
+    SettingsFileResult mapForRead(std::string_view& data) override;
+
+    SettingsFileResult writeBuffers(std::span<const std::string_view> buffers) override;
+
+    SettingsFileResult sync(SettingsDurability_t durability) override;
+
+    /// Check if the requests are submitted through io_uring, or with pread() and pwrite().
+    [[nodiscard]] bool isUsingRing() const;
+
+    /**
+     * Disallow copying or moving the object.
+     */
+    LinuxAsyncSettingsFile& operator=(LinuxAsyncSettingsFile&&) = delete;
+
+private:
+    /// A read or write of a block of the file.
+    typedef struct SettingsFileRequest_t
+    {
+        char*    data;
+        size_t   size;
+        uint64_t offset;
+        bool     write;
+    } SettingsFileRequest_t;
+
+    std::string                        filePath;
+    FileStatus                         fileStatus;
+    int                                fileDescriptor;
+    size_t                             bufferSize;
+    uint32_t                           queueDepth;
+    std::string                        readData;
+    size_t                             readIndex;
+    std::string                        writeBuffer;    // Data written that is not submitted yet.
+    std::vector<std::string>           pendingBuffers; // Buffers submitted that may not be written yet.
+    uint64_t                           writeOffset;    // Offset of the next buffer submitted.
+    SettingsFileResult                 writeResult;    // First error of the writes since the file was opened.
+    std::vector<SettingsFileRequest_t> requests;       // Requests in flight, their index is their user data.
+    uint32_t                           unsubmittedRequests;
+
+    // The rings shared with the kernel. ringFd is -1 if io_uring is not used.
+    int           ringFd;
+    void*         submissionRing;
+    size_t        submissionRingSize;
+    void*         completionRing;
+    size_t        completionRingSize;
+    io_uring_sqe* submissionEntries;
+    size_t        submissionEntriesSize;
+    uint32_t*     submissionTail;
+    uint32_t      submissionMask;
+    uint32_t*     submissionArray;
+    uint32_t*     completionHead;
+    uint32_t*     completionTail;
+    uint32_t      completionMask;
+    io_uring_cqe* completionEntries;
+
+    bool               setupRing();
+    void               teardownRing();
+    SettingsFileResult queueRequest(char* data, size_t size, uint64_t offset, bool write);
+    SettingsFileResult startRequests();
+    SettingsFileResult waitForRequests();
+    SettingsFileResult submitWriteBuffer();
+    SettingsFileResult transfer(const SettingsFileRequest_t& request, size_t done) const;
+};
+
+#endif // SETTINGSSTORAGE_LINUXASYNCSETTINGSFILE_H
@@ -0,0 +1,80 @@
+#ifndef SETTINGSSTORAGE_LINUXMAPPEDSETTINGSFILE_H
+#define SETTINGSSTORAGE_LINUXMAPPEDSETTINGSFILE_H
+
+#include <string>
+#include "ExtendedSettingsFile.h"
+
+/**
+ * @brief SettingsFile backed by a file of the Linux filesystem.
+ *
+ * When the file is opened for read, it is memory-mapped, so it can be parsed in place through mapForRead() without
+ * copying it. Writes go straight to the file descriptor, so the callers are expected to write in blocks. When it is
+ * opened with openForUpdate(), writeAt() overwrites parts of the file with positioned writes, without truncating it.
+ * When it is mapped with mapForUpdate(), the mapping is shared with the file, and syncMapped() flushes it with msync().
+ * Since every write reaches the kernel when it returns, sync() only needs fdatasync() or fsync() for the durabilities
+ * above SettingsDurability_t::BUFFERED.
+ */
+class LinuxMappedSettingsFile : public ExtendedSettingsFile
+{
+public:
+    /**
+     * @brief Build a new Linux Mapped Settings File object. The file is not opened until it is needed.
+     * @param filePath The path of the file.
+     */
+    explicit LinuxMappedSettingsFile(const char* filePath);
+
+    /**
+     * @brief Destroy the Linux Mapped Settings File object, closing the file if it is open.
+     */
+    ~LinuxMappedSettingsFile() override;
+
+    SettingsFileResult read(char* byte) override;
+
+    SettingsFileResult readLine(std::string& buffer) override;
+
+    SettingsFileResult write(char byte) override;
+
+    SettingsFileResult write(const std::string& data) override;
+
+    SettingsFileResult openForRead() override;
+
+    SettingsFileResult openForWrite() override;
+
+    SettingsFileResult close() override;
+
+    void forceClose() override;
+
+    FileStatus getOpenStatus() override;
+
+    SettingsFileResult mapForRead(std::string_view& data) override;
+
+    SettingsFileResult openForUpdate() override;
+
+    SettingsFileResult writeAt(size_t offset, std::string_view data) override;
+
+    SettingsFileResult mapForUpdate(size_t size, char*& data, size_t& mappedSize) override;
+
+    SettingsFileResult syncMapped(size_t offset, size_t length) override;
+
+    SettingsFileResult sync(SettingsDurability_t durability) override;
+
+    /**
+     * Disallow copying or moving the object.
+     */
+    LinuxMappedSettingsFile& operator=(LinuxMappedSettingsFile&&) = delete;
+
+private:
+    std::string filePath;
+    FileStatus  fileStatus;
+    int         fileDescriptor;
+    const char* mappedData;
+    size_t      mappedSize;
+    size_t      readIndex;
+    size_t      updateSize; // Size of the file opened for update, 0 if it was opened for write.
+    bool        updating;
+    bool        mappedForUpdate; // The mapping is writable and shared with the file.
+
+    SettingsFileResult writeAll(const char* data, size_t size) const;
+};
+
+#endif // SETTINGSSTORAGE_LINUXMAPPEDSETTINGSFILE_H
@@ -0,0 +1,64 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<bool>     countingEnabled{false};
+static std::atomic<uint64_t> allocationCount{0};
+
+void* operator new(const size_t size)
+{
+    if (countingEnabled.load(std::memory_order_relaxed))
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* pointer = malloc(size == 0 ? 1 : size);
+    if (pointer == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete(void* pointer, [[maybe_unused]] size_t size) noexcept
+{
+    free(pointer);
+}
+
+AllocationCounter::AllocationCounter()
+{
+    this->initialAllocations = allocationCount.load();
+    this->finalAllocations   = this->initialAllocations;
+    this->counting           = true;
+    countingEnabled.store(true);
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    stop();
+}
+
+uint64_t AllocationCounter::getAllocations() const
+{
+    if (counting)
+    {
+        return allocationCount.load() - initialAllocations;
+    }
+    return finalAllocations - initialAllocations;
+}
+
+void AllocationCounter::stop()
+{
+    if (counting)
+    {
+        countingEnabled.store(false);
+        finalAllocations = allocationCount.load();
+        counting         = false;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include "cstdint"
+
+/**
+ * @brief Counts the calls to the global operator new made while an AllocationCounter object is alive.
+ *
+ * The test executable replaces the global operator new/delete, so every heap allocation done through them is counted.
+ * Only one AllocationCounter must be alive at a time.
+ */
+class AllocationCounter
+{
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+
+    /// Number of allocations made since this object was built.
+    [[nodiscard]] uint64_t getAllocations() const;
+
+    /// Stop counting. Further allocations are ignored.
+    void stop();
+
+private:
+    uint64_t initialAllocations;
+    uint64_t finalAllocations;
+    bool     counting;
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -28,17 +28,23 @@ SettingsFileMock::SettingsFileMock(const char* internalBuffer, int64_t internalB
     this->fileDataSize  = static_cast<uint32_t>(strlen(internalBuffer));
     this->fileDataIndex = 0;
     this->fileStatus    = FileClosed;
+    this->updating      = false;
 
     fullMockEnabled = false;
     readResult      = Success;
     readOutput      = 'a';
     readLineResult  = Success;
     strcpy(readLineOutput, "a");
-    writeResult        = Success;
-    writeBufferResult  = Success;
-    openForReadResult  = Success;
-    openForWriteResult = Success;
-    closeResult        = Success;
+    writeResult         = Success;
+    writeBufferResult   = Success;
+    openForReadResult   = Success;
+    openForWriteResult  = Success;
+    closeResult         = Success;
+    openForUpdateResult = Success;
+    writeAtResult       = Success;
+    syncResult          = Success;
+    syncCount           = 0;
+    lastSyncDurability  = SettingsDurability_t::NONE;
 }
 SettingsFileMock::~SettingsFileMock()
 {
@@ -101,7 +107,7 @@ SettingsFile::SettingsFileResult SettingsFileMock::write(char byte)
         return writeResult;
     }
 
-    if (this->fileStatus != FileOpenedForWrite)
+    if (this->fileStatus != FileOpenedForWrite || this->updating)
     {
         return InvalidState;
     }
@@ -124,7 +130,7 @@ SettingsFile::SettingsFileResult SettingsFileMock::write(const std::string& data
         return writeBufferResult;
     }
 
-    if (this->fileStatus != FileOpenedForWrite)
+    if (this->fileStatus != FileOpenedForWrite || this->updating)
     {
         return InvalidState;
     }
@@ -191,11 +197,13 @@ SettingsFile::SettingsFileResult SettingsFileMock::close()
         return InvalidState;
     }
 
-    if (this->fileStatus == FileOpenedForWrite)
+    // A file opened for update keeps its size.
+    if (this->fileStatus == FileOpenedForWrite && !this->updating)
     {
         this->internalBuffer[this->fileDataIndex] = '\0';
     }
-    fileStatus = FileClosed;
+    fileStatus     = FileClosed;
+    this->updating = false;
     return Success;
 }
 
@@ -209,6 +217,59 @@ SettingsFile::FileStatus SettingsFileMock::getOpenStatus()
     return this->fileStatus;
 }
 
+SettingsFile::SettingsFileResult SettingsFileMock::openForUpdate()
+{
+    if (fullMockEnabled)
+    {
+        return openForUpdateResult;
+    }
+
+    if (this->fileStatus != FileClosed)
+    {
+        return InvalidState;
+    }
+
+    this->fileStatus   = FileOpenedForWrite;
+    this->updating     = true;
+    this->fileDataSize = static_cast<uint32_t>(strlen(this->internalBuffer));
+    return Success;
+}
+
+SettingsFile::SettingsFileResult SettingsFileMock::writeAt(const size_t offset, const std::string_view data)
+{
+    if (fullMockEnabled)
+    {
+        return writeAtResult;
+    }
+
+    if (this->fileStatus != FileOpenedForWrite || !this->updating || offset > this->fileDataSize ||
+        data.size() > this->fileDataSize - offset)
+    {
+        return InvalidState;
+    }
+
+    memcpy(this->internalBuffer + offset, data.data(), data.size());
+    return Success;
+}
+
+SettingsFile::SettingsFileResult SettingsFileMock::sync(const SettingsDurability_t durability)
+{
+    if (fullMockEnabled)
+    {
+        return syncResult;
+    }
+
+    if (this->fileStatus != FileOpenedForWrite)
+    {
+        return InvalidState;
+    }
+
+    // The data is always in memory, so the sync is only recorded.
+    this->syncCount++;
+    this->lastSyncDurability = durability;
+    return syncResult;
+}
+
 char* SettingsFileMock::_getInternalBuffer() const
 {
     return this->internalBuffer;
@@ -263,3 +324,28 @@ void SettingsFileMock::_setCloseResult(SettingsFileResult result)
 {
     this->closeResult = result;
 }
+
+void SettingsFileMock::_setOpenForUpdateResult(SettingsFileResult result)
+{
+    this->openForUpdateResult = result;
+}
+
+void SettingsFileMock::_setWriteAtResult(SettingsFileResult result)
+{
+    this->writeAtResult = result;
+}
+
+void SettingsFileMock::_setSyncResult(SettingsFileResult result)
+{
+    this->syncResult = result;
+}
+
+uint32_t SettingsFileMock::_getSyncCount() const
+{
+    return this->syncCount;
+}
+
+SettingsDurability_t SettingsFileMock::_getLastSyncDurability() const
+{
+    return this->lastSyncDurability;
+}
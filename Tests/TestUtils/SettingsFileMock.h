@@ -1,10 +1,10 @@
 #ifndef SETTINGSFILEMOCK_H
 #define SETTINGSFILEMOCK_H
 
-#include "SettingsFile.h"
+#include "ExtendedSettingsFile.h"
 #include "cstdint"
 
-class SettingsFileMock : public SettingsFile
+class SettingsFileMock : public ExtendedSettingsFile
 {
 public:
     explicit SettingsFileMock(const char* fileData, int64_t internalBufferSize = -1);
@@ -28,6 +28,12 @@ public:
 
     FileStatus getOpenStatus() override;
 
+    SettingsFileResult openForUpdate() override;
+
+    SettingsFileResult writeAt(size_t offset, std::string_view data) override;
+
+    SettingsFileResult sync(SettingsDurability_t durability) override;
+
     [[nodiscard]] char* _getInternalBuffer() const;
 
     void _setForceMockMode(bool fullMockEnabled);
@@ -45,6 +51,12 @@ public:
     void _setOpenForReadResult(SettingsFileResult result);
     void _setOpenForWriteResult(SettingsFileResult result);
     void _setCloseResult(SettingsFileResult result);
+    void _setOpenForUpdateResult(SettingsFileResult result);
+    void _setWriteAtResult(SettingsFileResult result);
+    void _setSyncResult(SettingsFileResult result);
+
+    [[nodiscard]] uint32_t             _getSyncCount() const;
+    [[nodiscard]] SettingsDurability_t _getLastSyncDurability() const;
 
 private:
     char*      internalBuffer;
@@ -52,6 +64,7 @@ private:
     uint32_t   fileDataIndex;
     FileStatus fileStatus;
     uint32_t   internalBufferSize;
+    bool       updating;
 
     bool               fullMockEnabled;
     SettingsFileResult readResult;
@@ -63,6 +76,12 @@ private:
     SettingsFileResult openForReadResult;
     SettingsFileResult openForWriteResult;
     SettingsFileResult closeResult;
+    SettingsFileResult openForUpdateResult;
+    SettingsFileResult writeAtResult;
+    SettingsFileResult syncResult;
+
+    uint32_t             syncCount;
+    SettingsDurability_t lastSyncDurability;
 };
 
 #endif // SETTINGSFILEMOCK_H
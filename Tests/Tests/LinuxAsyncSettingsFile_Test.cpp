@@ -0,0 +1,245 @@
+#include "LinuxAsyncSettingsFile.h"
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include "LinuxOSInterface.h"
+#include "SettingsStorage.h"
+#include "gtest/gtest.h"
+
+static LinuxOSInterface linuxOSInterface;
+
+// Builds a path in the temporary directory that is unique to the running test.
+static std::string temporaryFilePath()
+{
+    const testing::TestInfo* testInfo = testing::UnitTest::GetInstance()->current_test_info();
+    return (std::filesystem::temp_directory_path() /
+            (std::string(testInfo->test_suite_name()) + "_" + testInfo->name() + ".dat"))
+        .string();
+}
+
+static void writeFile(const std::string& filePath, const std::string& data)
+{
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    file << data;
+}
+
+static std::string readFile(const std::string& filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+TEST(LinuxAsyncSettingsFile, WriteAndReadLines)
+{
+    const std::string filePath = temporaryFilePath();
+    for (const bool useRing : {true, false})
+    {
+        // Tiny buffers, so every write submits a buffer and the queue fills up.
+        LinuxAsyncSettingsFile settingsFile(filePath.c_str(), 4, 2, useRing);
+
+        ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+        EXPECT_EQ(SettingsFile::FileOpenedForWrite, settingsFile.getOpenStatus());
+        EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("line1\nline2")));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.write('\n'));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("end")));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+        EXPECT_EQ("line1\nline2\nend", readFile(filePath));
+
+        ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+        EXPECT_EQ(SettingsFile::FileOpenedForRead, settingsFile.getOpenStatus());
+        std::string line;
+        EXPECT_EQ(SettingsFile::Success, settingsFile.readLine(line));
+        EXPECT_EQ("line1\n", line);
+        line.clear();
+        EXPECT_EQ(SettingsFile::Success, settingsFile.readLine(line));
+        EXPECT_EQ("line2\n", line);
+        char byte;
+        EXPECT_EQ(SettingsFile::Success, settingsFile.read(&byte));
+        EXPECT_EQ('e', byte);
+        line.clear();
+        EXPECT_EQ(SettingsFile::Success, settingsFile.readLine(line));
+        EXPECT_EQ("nd", line);
+        EXPECT_EQ(SettingsFile::EndOfFile, settingsFile.readLine(line));
+        EXPECT_EQ(SettingsFile::EndOfFile, settingsFile.read(&byte));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+        EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+    }
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxAsyncSettingsFile, ReadAndWriteLargeFile)
+{
+    const std::string filePath = temporaryFilePath();
+    std::string       data;
+    for (uint32_t i = 0; data.size() < 1024 * 1024; i++)
+    {
+        data += "component" + std::to_string(i % 50) + "/setting" + std::to_string(i) + "\t1\t" + std::to_string(i) +
+                '\n';
+    }
+
+    for (const bool useRing : {true, false})
+    {
+        LinuxAsyncSettingsFile settingsFile(filePath.c_str(), 4096, 4, useRing);
+        ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+        for (size_t offset = 0; offset < data.size(); offset += 1000)
+        {
+            ASSERT_EQ(SettingsFile::Success, settingsFile.write(data.substr(offset, 1000)));
+        }
+        ASSERT_EQ(SettingsFile::Success, settingsFile.close());
+        EXPECT_EQ(data, readFile(filePath));
+
+        std::string_view fileData;
+        ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+        EXPECT_EQ(SettingsFile::Success, settingsFile.mapForRead(fileData));
+        EXPECT_EQ(data, fileData);
+        EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+        EXPECT_EQ(SettingsFile::InvalidState, settingsFile.mapForRead(fileData));
+    }
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxAsyncSettingsFile, WriteBuffers)
+{
+    const std::string filePath = temporaryFilePath();
+    for (const bool useRing : {true, false})
+    {
+        LinuxAsyncSettingsFile                settingsFile(filePath.c_str(), 8, 2, useRing);
+        const std::string                     longBuffer(10000, 'x');
+        const std::array<std::string_view, 5> buffers = {"first\n", "", longBuffer, "\n", "last\n"};
+
+        EXPECT_EQ(SettingsFile::InvalidState, settingsFile.writeBuffers(buffers));
+        ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+        EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("header\n")));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.writeBuffers(buffers));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("trailer\n")));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+        EXPECT_EQ("header\nfirst\n" + longBuffer + "\nlast\ntrailer\n", readFile(filePath));
+    }
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxAsyncSettingsFile, ReadEmptyFile)
+{
+    const std::string      filePath = temporaryFilePath();
+    LinuxAsyncSettingsFile settingsFile(filePath.c_str());
+    writeFile(filePath, "");
+
+    std::string_view data = "not empty";
+    std::string      line;
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::Success, settingsFile.mapForRead(data));
+    EXPECT_TRUE(data.empty());
+    EXPECT_EQ(SettingsFile::EndOfFile, settingsFile.readLine(line));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxAsyncSettingsFile, OpenMissingFile)
+{
+    LinuxAsyncSettingsFile settingsFile("/nonexistent/directory/settings.dat");
+
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+}
+
+TEST(LinuxAsyncSettingsFile, InvalidStates)
+{
+    const std::string      filePath = temporaryFilePath();
+    LinuxAsyncSettingsFile settingsFile(filePath.c_str());
+    std::string            line;
+    char                   byte;
+
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.close());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.write('a'));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.readLine(line));
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.read(&byte));
+    settingsFile.forceClose();
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.write(std::string("data")));
+    settingsFile.forceClose();
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxAsyncSettingsFile, StoreAndLoadSettings)
+{
+    const std::string filePath      = temporaryFilePath();
+    const auto        compressions = {SettingsCompressionAlgorithm_t::NONE,
+                                      SettingsCompressionAlgorithm_t::FRONT_CODING_LZ};
+    for (const uint32_t threads : {1U, 4U})
+    {
+        for (const auto compression : compressions)
+        {
+            LinuxAsyncSettingsFile settingsFile(filePath.c_str(), 1024, 2);
+            char                   key[MAX_SETTING_KEY_SIZE];
+            {
+                SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+                for (uint32_t i = 0; i < 5000; i++)
+                {
+                    snprintf(key, sizeof(key), "menu%u/setting%u", i % 10, i);
+                    ASSERT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage.registerSettingAsInt(key, SettingPermissions_t::USER, i));
+                }
+                ASSERT_EQ(SettingsStorage::NO_ERROR,
+                          settingsStorage.storeSettingsInPersistentStorage(threads, compression));
+            }
+
+            SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+            ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+            ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+            for (uint32_t i = 0; i < 5000; i += 7)
+            {
+                int64_t value = -1;
+                snprintf(key, sizeof(key), "menu%u/setting%u", i % 10, i);
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt(key, value));
+                EXPECT_EQ(i, value);
+            }
+            EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+        }
+    }
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxAsyncSettingsFile, Sync)
+{
+    const std::string filePath = temporaryFilePath();
+    for (const bool useRing : {true, false})
+    {
+        LinuxAsyncSettingsFile settingsFile(filePath.c_str(), 1024, 2, useRing);
+        EXPECT_EQ(SettingsFile::InvalidState, settingsFile.sync(SettingsDurability_t::BUFFERED));
+
+        // The data gathered is written by the sync, before the file is closed.
+        ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+        EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("first\n")));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.sync(SettingsDurability_t::NONE));
+        EXPECT_EQ("", readFile(filePath));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.sync(SettingsDurability_t::BUFFERED));
+        EXPECT_EQ("first\n", readFile(filePath));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("second\n")));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.sync(SettingsDurability_t::FLUSHED));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("third\n")));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.sync(SettingsDurability_t::FSYNCED));
+        EXPECT_EQ(SettingsFile::InvalidState, settingsFile.sync(SettingsDurability_t::MAX_SETTINGS_DURABILITY));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+        EXPECT_EQ("first\nsecond\nthird\n", readFile(filePath));
+
+        ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+        EXPECT_EQ(SettingsFile::InvalidState, settingsFile.sync(SettingsDurability_t::FLUSHED));
+        EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+    }
+
+    std::filesystem::remove(filePath);
+}
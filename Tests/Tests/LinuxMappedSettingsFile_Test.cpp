@@ -0,0 +1,487 @@
+#include "LinuxMappedSettingsFile.h"
+#include <filesystem>
+#include <fstream>
+#include "LinuxOSInterface.h"
+#include "SettingsStorage.h"
+#include "gtest/gtest.h"
+
+static LinuxOSInterface linuxOSInterface;
+
+// Builds a path in the temporary directory that is unique to the running test.
+static std::string temporaryFilePath()
+{
+    const testing::TestInfo* testInfo = testing::UnitTest::GetInstance()->current_test_info();
+    return (std::filesystem::temp_directory_path() /
+            (std::string(testInfo->test_suite_name()) + "_" + testInfo->name() + ".dat"))
+        .string();
+}
+
+static void writeFile(const std::string& filePath, const std::string& data)
+{
+    std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+    file << data;
+}
+
+static std::string readFile(const std::string& filePath)
+{
+    std::ifstream file(filePath, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+TEST(LinuxMappedSettingsFile, WriteAndReadLines)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::FileOpenedForWrite, settingsFile.getOpenStatus());
+    EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("line1\nline2")));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.write('\n'));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("end")));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+    EXPECT_EQ("line1\nline2\nend", readFile(filePath));
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::FileOpenedForRead, settingsFile.getOpenStatus());
+    std::string line;
+    EXPECT_EQ(SettingsFile::Success, settingsFile.readLine(line));
+    EXPECT_EQ("line1\n", line);
+    line.clear();
+    EXPECT_EQ(SettingsFile::Success, settingsFile.readLine(line));
+    EXPECT_EQ("line2\n", line);
+    char byte;
+    EXPECT_EQ(SettingsFile::Success, settingsFile.read(&byte));
+    EXPECT_EQ('e', byte);
+    line.clear();
+    EXPECT_EQ(SettingsFile::Success, settingsFile.readLine(line));
+    EXPECT_EQ("nd", line);
+    EXPECT_EQ(SettingsFile::EndOfFile, settingsFile.readLine(line));
+    EXPECT_EQ(SettingsFile::EndOfFile, settingsFile.read(&byte));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, MapForRead)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    writeFile(filePath, "menu1/setting1\t0\t1.23\n");
+
+    std::string_view data;
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.mapForRead(data));
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::Success, settingsFile.mapForRead(data));
+    EXPECT_EQ("menu1/setting1\t0\t1.23\n", data);
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, MapEmptyFile)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    writeFile(filePath, "");
+
+    std::string_view data = "not empty";
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::Success, settingsFile.mapForRead(data));
+    EXPECT_TRUE(data.empty());
+    std::string line;
+    EXPECT_EQ(SettingsFile::EndOfFile, settingsFile.readLine(line));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, OpenMissingFile)
+{
+    LinuxMappedSettingsFile settingsFile("/nonexistent/directory/settings.dat");
+
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+}
+
+TEST(LinuxMappedSettingsFile, InvalidStates)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    std::string             line;
+    char                    byte;
+
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.close());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.write('a'));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.readLine(line));
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.read(&byte));
+    settingsFile.forceClose();
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.write(std::string("data")));
+    settingsFile.forceClose();
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, WriteAt)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    writeFile(filePath, "line1\nline2\n");
+
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.writeAt(0, "LINE"));
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForUpdate());
+    EXPECT_EQ(SettingsFile::FileOpenedForWrite, settingsFile.getOpenStatus());
+    EXPECT_EQ(SettingsFile::Success, settingsFile.writeAt(6, "LINE2"));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.writeAt(8, "LINE2"));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.write(std::string("data")));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+    EXPECT_EQ("line1\nLINE2\n", readFile(filePath));
+
+    // A file opened for write is written from its start, not updated.
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.writeAt(0, "a"));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("new")));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+    EXPECT_EQ("new", readFile(filePath));
+
+    std::filesystem::remove(filePath);
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.openForUpdate());
+}
+
+TEST(LinuxMappedSettingsFile, StoreAndLoadSettings)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    {
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage.registerSettingAsReal("menu1/setting1", SettingPermissions_t::USER, 1.23));
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage.registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 45));
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage.registerSettingAsString("menu2/setting3", SettingPermissions_t::USER, "string3"));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    }
+    EXPECT_EQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n",
+              readFile(filePath));
+
+    SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 0));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+
+    double               realValue = 0;
+    int64_t              intValue  = 0;
+    char                 stringValue[16];
+    SettingPermissions_t permissions;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsReal("menu1/setting1", realValue, &permissions));
+    EXPECT_EQ(1.23, realValue);
+    EXPECT_EQ(SettingPermissions_t::VOLATILE, permissions);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt("menu1/setting2", intValue, &permissions));
+    EXPECT_EQ(45, intValue);
+    EXPECT_EQ(SettingPermissions_t::USER, permissions);
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("string3", stringValue);
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, LoadLegacySettingsFile)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    writeFile(filePath, "menu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r1874197929\n");
+
+    SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(45, intValue);
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, LoadInvalidSettingsFiles)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+
+    const char* invalidFiles[] = {
+        "",                                                       // No checksum.
+        "menu1/setting1\t0\t1.23\n",                              // No checksum.
+        "menu1/setting1\t0\t1.23\n\r",                            // Empty checksum.
+        "menu1/setting1\t0\t1.23\n\r1874197929\n",                // Invalid checksum.
+        "menu1/setting1\t0\t1.23\n\r1048123282",                  // No new line after the checksum.
+        "menu1/setting1\t0\t1.23\n\r1048123282\nmenu2/a\t0\t1\n", // Data after the checksum.
+        "\rv1\t1\nmenu1/setting1\t0\t1.23\n\r1048123282\n",       // Checksum of another algorithm.
+        "\rv2\t0\nmenu1/setting1\t0\t1.23\n\r1048123282\n",       // Unsupported version.
+        "\rv1\t9\nmenu1/setting1\t0\t1.23\n\r1048123282\n",       // Unsupported algorithm.
+    };
+    for (const char* invalidFile : invalidFiles)
+    {
+        writeFile(filePath, invalidFile);
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+        EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage.loadSettingsFromPersistentStorage())
+            << "File: " << invalidFile;
+        EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+    }
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, LoadInvalidRecords)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+
+    const char* invalidRecords[] = {
+        "menu1/setting1\n",          // No type.
+        "menu1/setting1\t0\n",       // No value.
+        "menu1/setting1\t0\t\n",     // Empty value.
+        "\t0\t1.23\n",               // Empty key.
+        "menu1/setting1\t0\t1.2x\n", // Invalid real.
+        "menu1/setting1\t1\t4.5\n",  // Invalid integer.
+        "menu1/setting1\t3\t1\n",    // Invalid type.
+        "menu1/setting1\t-1\t1\n",   // Negative type.
+        "menu1/setting1\ta\t1\n",    // Non numeric type.
+        "menu1/setting1\t\t1\n",     // Empty type.
+        "menu1/setting1\t~\n",       // Tombstone without type.
+        "menu1/setting1\t~0\t1\n",   // Tombstone with value.
+    };
+    for (const char* invalidRecord : invalidRecords)
+    {
+        const uint32_t checksum =
+            SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32, invalidRecord, strlen(invalidRecord));
+        writeFile(filePath, std::string(invalidRecord) + "\r" + std::to_string(checksum) + "\n");
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+        EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage.loadSettingsFromPersistentStorage())
+            << "Record: " << invalidRecord;
+    }
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, LoadTypeMismatch)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    writeFile(filePath, "menu1/setting1\t0\t1.23\n\r1048123282\n");
+
+    SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsString("menu1/setting1", SettingPermissions_t::USER, "string"));
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, LoadSettingsLazily)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    writeFile(filePath, "menu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r1874197929\n");
+
+    SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorageLazily());
+
+    // The mapping is kept while there are pending settings.
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsFile::FileOpenedForRead, settingsFile.getOpenStatus());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(45, intValue);
+    EXPECT_EQ(SettingsFile::FileOpenedForRead, settingsFile.getOpenStatus());
+
+    // Storing places the remaining settings in the tree and releases the mapping before the file is rewritten.
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsReal("menu1/setting1", SettingPermissions_t::USER, 0));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+    EXPECT_EQ("\rv1\t1\nmenu1/setting1\t0\t1.23\n\r" +
+                  std::to_string(SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32C,
+                                                             "menu1/setting1\t0\t1.23\n", 22)) +
+                  "\n",
+              readFile(filePath));
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, StoreSettingsInSlots)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    SettingsStorage         settingsStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 45));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsString("menu2/setting3", SettingPermissions_t::USER, "string3"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage(
+                                             1, SettingsCompressionAlgorithm_t::NONE, StoreSettingsInSlots));
+    const std::string storedFile = readFile(filePath);
+
+    // Only the slot of the setting that changed is overwritten, and the file keeps its size.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("menu1/setting2", -7));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage(
+                                             1, SettingsCompressionAlgorithm_t::NONE, StoreSettingsInSlots));
+    const std::string updatedFile = readFile(filePath);
+    ASSERT_EQ(storedFile.size(), updatedFile.size());
+    const size_t slotStart = storedFile.find("menu1/setting2");
+    const size_t slotEnd   = storedFile.find('\n', slotStart) + 1;
+    EXPECT_EQ(storedFile.substr(0, slotStart), updatedFile.substr(0, slotStart));
+    EXPECT_EQ(storedFile.substr(slotEnd), updatedFile.substr(slotEnd));
+    EXPECT_EQ(slotStart, updatedFile.find("menu1/setting2\t1\t2:-7 "));
+
+    // The mapped file is loaded like any other settings file.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("menu1/setting2", 0));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(-7, intValue);
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, MapForUpdate)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    std::filesystem::remove(filePath);
+
+    // The file is created and extended with zeros, and the changes to the mapping reach the file.
+    char*  data       = nullptr;
+    size_t mappedSize = 0;
+    ASSERT_EQ(SettingsFile::Success, settingsFile.mapForUpdate(0, data, mappedSize));
+    EXPECT_EQ(nullptr, data);
+    EXPECT_EQ(0U, mappedSize);
+    EXPECT_EQ(SettingsFile::FileOpenedForWrite, settingsFile.getOpenStatus());
+    ASSERT_EQ(SettingsFile::Success, settingsFile.mapForUpdate(100, data, mappedSize));
+    ASSERT_NE(nullptr, data);
+    EXPECT_EQ(100U, mappedSize);
+    EXPECT_EQ(std::string(100, '\0'), std::string(data, mappedSize));
+    memcpy(data + 10, "mapped", 6);
+    EXPECT_EQ(SettingsFile::Success, settingsFile.syncMapped(10, 6));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.syncMapped(95, 6));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.write(std::string("text")));
+
+    // A bigger mapping keeps the contents, and a smaller size keeps the size of the file.
+    ASSERT_EQ(SettingsFile::Success, settingsFile.mapForUpdate(5000, data, mappedSize));
+    EXPECT_EQ(5000U, mappedSize);
+    EXPECT_EQ("mapped", std::string(data + 10, 6));
+    ASSERT_EQ(SettingsFile::Success, settingsFile.mapForUpdate(10, data, mappedSize));
+    EXPECT_EQ(5000U, mappedSize);
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+    const std::string storedFile = readFile(filePath);
+    EXPECT_EQ(5000U, storedFile.size());
+    EXPECT_EQ("mapped", storedFile.substr(10, 6));
+
+    // A file opened for read or write is not mapped for update.
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.mapForUpdate(0, data, mappedSize));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.syncMapped(0, 0));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, StoreSettingsInMappedTree)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    writeFile(filePath, "menu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r1874197929\n");
+    SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 0));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsString("menu2/setting3", SettingPermissions_t::USER, ""));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+
+    // The text file is converted to a tree, and then only the nodes of the changes are appended to it.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage(
+                                             1, SettingsCompressionAlgorithm_t::NONE, StoreSettingsInMappedTree));
+    const std::string storedFile = readFile(filePath);
+    EXPECT_TRUE(storedFile.starts_with("\rv4\n"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("menu1/setting2", -7));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage(
+                                             1, SettingsCompressionAlgorithm_t::NONE, StoreSettingsInMappedTree));
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFile.getOpenStatus());
+    const std::string updatedFile = readFile(filePath);
+    const size_t      oldRecord   = storedFile.find("menu1/setting2\t1\t45");
+    ASSERT_NE(std::string::npos, oldRecord);
+    EXPECT_EQ(oldRecord, updatedFile.find("menu1/setting2\t1\t45"));
+    EXPECT_GT(updatedFile.find("menu1/setting2\t1\t-7"), oldRecord);
+
+    // The mapped file is loaded eagerly and lazily.
+    for (const bool lazily : {false, true})
+    {
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("menu1/setting2", 0));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, lazily ? settingsStorage.loadSettingsFromPersistentStorageLazily()
+                                                    : settingsStorage.loadSettingsFromPersistentStorage());
+        int64_t intValue = 0;
+        double  realValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(-7, intValue);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsReal("menu1/setting1", realValue));
+        EXPECT_EQ(1.23, realValue);
+    }
+
+    std::filesystem::remove(filePath);
+}
+
+TEST(LinuxMappedSettingsFile, Sync)
+{
+    const std::string       filePath = temporaryFilePath();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+
+    // The file is only synced while it is written, in any of the ways it can be written.
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.sync(SettingsDurability_t::BUFFERED));
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForWrite());
+    EXPECT_EQ(SettingsFile::Success, settingsFile.write(std::string("data\n")));
+    for (const auto durability : {SettingsDurability_t::NONE, SettingsDurability_t::BUFFERED,
+                                  SettingsDurability_t::FLUSHED, SettingsDurability_t::FSYNCED})
+    {
+        EXPECT_EQ(SettingsFile::Success, settingsFile.sync(durability));
+    }
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.sync(SettingsDurability_t::MAX_SETTINGS_DURABILITY));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForUpdate());
+    EXPECT_EQ(SettingsFile::Success, settingsFile.writeAt(0, "DATA"));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.sync(SettingsDurability_t::FLUSHED));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+
+    char*  data       = nullptr;
+    size_t mappedSize = 0;
+    ASSERT_EQ(SettingsFile::Success, settingsFile.mapForUpdate(0, data, mappedSize));
+    memcpy(data, "Data", 4);
+    EXPECT_EQ(SettingsFile::Success, settingsFile.sync(SettingsDurability_t::FSYNCED));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+    EXPECT_EQ("Data\n", readFile(filePath));
+
+    ASSERT_EQ(SettingsFile::Success, settingsFile.openForRead());
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFile.sync(SettingsDurability_t::FLUSHED));
+    EXPECT_EQ(SettingsFile::Success, settingsFile.close());
+
+    std::filesystem::remove(filePath);
+}
@@ -0,0 +1,135 @@
+#include "SettingsChecksum.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "gtest/gtest.h"
+
+static const char checkData[] = "123456789";
+
+static std::vector<uint8_t> buildPseudoRandomData(const size_t size)
+{
+    std::vector<uint8_t> data(size);
+    uint32_t             state = 0x12345678;
+    for (auto& byte : data)
+    {
+        state = state * 1103515245 + 12345;
+        byte  = static_cast<uint8_t>(state >> 24);
+    }
+    return data;
+}
+
+TEST(SettingsChecksum, CheckValueCRC32)
+{
+    EXPECT_EQ(0xCBF43926U, SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32, checkData, 9));
+    EXPECT_EQ(0xCBF43926U, SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32, checkData, 9, 0, false));
+}
+
+TEST(SettingsChecksum, CheckValueCRC32C)
+{
+    EXPECT_EQ(0xE3069283U, SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32C, checkData, 9));
+    EXPECT_EQ(0xE3069283U, SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32C, checkData, 9, 0, false));
+}
+
+TEST(SettingsChecksum, EmptyData)
+{
+    EXPECT_EQ(0U, SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32, checkData, 0));
+    EXPECT_EQ(0U, SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32C, checkData, 0));
+}
+
+TEST(SettingsChecksum, HardwareMatchesSoftware)
+{
+    const std::vector<uint8_t> data = buildPseudoRandomData(4099);
+
+    for (const auto algorithm : {SettingsChecksumAlgorithm_t::CRC32, SettingsChecksumAlgorithm_t::CRC32C})
+    {
+        // Cover every alignment and the tails left by the 16 and 64 byte blocks of the hardware implementations.
+        for (size_t offset = 0; offset < 8; offset++)
+        {
+            for (const size_t size : {1UL, 15UL, 16UL, 63UL, 64UL, 65UL, 127UL, 1000UL, 4091UL})
+            {
+                EXPECT_EQ(SettingsChecksum::calculate(algorithm, data.data() + offset, size, 0, false),
+                          SettingsChecksum::calculate(algorithm, data.data() + offset, size, 0, true))
+                    << "offset " << offset << ", size " << size;
+            }
+        }
+    }
+}
+
+TEST(SettingsChecksum, ResumeCalculation)
+{
+    const std::vector<uint8_t> data = buildPseudoRandomData(1000);
+
+    for (const auto algorithm : {SettingsChecksumAlgorithm_t::CRC32, SettingsChecksumAlgorithm_t::CRC32C})
+    {
+        const uint32_t expected = SettingsChecksum::calculate(algorithm, data.data(), data.size());
+        const uint32_t first    = SettingsChecksum::calculate(algorithm, data.data(), 333);
+        EXPECT_EQ(expected, SettingsChecksum::calculate(algorithm, data.data() + 333, data.size() - 333, first));
+    }
+}
+
+TEST(SettingsChecksum, IncrementalUpdate)
+{
+    const std::vector<uint8_t> data = buildPseudoRandomData(1000);
+    SettingsChecksum           checksum(SettingsChecksumAlgorithm_t::CRC32C);
+
+    checksum.update(data.data(), 100);
+    checksum.update(data.data() + 100, 900);
+
+    EXPECT_EQ(SettingsChecksumAlgorithm_t::CRC32C, checksum.getAlgorithm());
+    EXPECT_EQ(1000U, checksum.getSize());
+    EXPECT_EQ(SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32C, data.data(), data.size()),
+              checksum.getValue());
+
+    checksum.reset();
+    EXPECT_EQ(0U, checksum.getSize());
+    EXPECT_EQ(0U, checksum.getValue());
+}
+
+TEST(SettingsChecksum, Combine)
+{
+    const std::vector<uint8_t> data = buildPseudoRandomData(1000);
+
+    for (const auto algorithm : {SettingsChecksumAlgorithm_t::CRC32, SettingsChecksumAlgorithm_t::CRC32C})
+    {
+        for (const size_t split : {0UL, 1UL, 500UL, 999UL, 1000UL})
+        {
+            const uint32_t crc1 = SettingsChecksum::calculate(algorithm, data.data(), split);
+            const uint32_t crc2 = SettingsChecksum::calculate(algorithm, data.data() + split, data.size() - split);
+            EXPECT_EQ(SettingsChecksum::calculate(algorithm, data.data(), data.size()),
+                      SettingsChecksum::combine(algorithm, crc1, crc2, data.size() - split))
+                << "split " << split;
+        }
+    }
+}
+
+TEST(SettingsChecksum, IsValidAlgorithm)
+{
+    EXPECT_TRUE(SettingsChecksum::isValidAlgorithm(SettingsChecksumAlgorithm_t::CRC32));
+    EXPECT_TRUE(SettingsChecksum::isValidAlgorithm(SettingsChecksumAlgorithm_t::CRC32C));
+    EXPECT_FALSE(SettingsChecksum::isValidAlgorithm(SettingsChecksumAlgorithm_t::MAX_SETTINGS_CHECKSUM_ALGORITHM));
+    EXPECT_FALSE(SettingsChecksum::isValidAlgorithm(static_cast<SettingsChecksumAlgorithm_t>(200)));
+}
+
+TEST(SettingsChecksum, DISABLED_Throughput)
+{
+    const std::vector<uint8_t> data = buildPseudoRandomData(1 << 20);
+    constexpr int              rounds = 64;
+
+    for (const auto algorithm : {SettingsChecksumAlgorithm_t::CRC32, SettingsChecksumAlgorithm_t::CRC32C})
+    {
+        for (const bool hardware : {false, true})
+        {
+            uint32_t   crc   = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < rounds; i++)
+            {
+                crc = SettingsChecksum::calculate(algorithm, data.data(), data.size(), crc, hardware);
+            }
+            const auto   end     = std::chrono::steady_clock::now();
+            const double seconds = std::chrono::duration<double>(end - start).count();
+            std::cout << "[ BENCH    ] " << (algorithm == SettingsChecksumAlgorithm_t::CRC32 ? "CRC32" : "CRC32C")
+                      << (hardware && SettingsChecksum::isHardwareAccelerated(algorithm) ? " hardware" : " software")
+                      << ": " << static_cast<int64_t>(rounds / seconds) << " MiB/s (crc " << crc << ")" << std::endl;
+        }
+    }
+}
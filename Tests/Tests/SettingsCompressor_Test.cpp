@@ -0,0 +1,143 @@
+#include "SettingsCompressor.h"
+#include "gtest/gtest.h"
+
+// Sorted records with long shared key prefixes and repeated values, like the ones stored by SettingsStorage.
+static std::string makeRecords(const uint32_t recordsCount)
+{
+    std::string records;
+    char        record[128];
+    for (uint32_t i = 0; i < recordsCount; i++)
+    {
+        snprintf(record, sizeof(record), "component%03u/subcomponent/setting%06u\t%u\t%s\n", i / 100, i, i % 3,
+                 i % 3 == 2 ? "automatic" : std::to_string(i % 7).c_str());
+        records.append(record);
+    }
+    return records;
+}
+
+static bool decompressLines(const std::string& compressed, std::string& records)
+{
+    SettingsDecompressor decompressor;
+    std::string_view     lines = compressed;
+    while (!lines.empty())
+    {
+        const size_t lineEnd = lines.find('\n');
+        if (lineEnd == std::string_view::npos || !decompressor.decompress(lines.substr(0, lineEnd + 1), records))
+        {
+            return false;
+        }
+        lines.remove_prefix(lineEnd + 1);
+    }
+    return true;
+}
+
+TEST(SettingsCompressor, RoundTrip)
+{
+    const std::string  records = makeRecords(1000);
+    SettingsCompressor compressor(1024);
+    std::string        compressed;
+
+    compressor.begin();
+    compressor.compress(records, compressed);
+    compressor.end(compressed);
+
+    std::string decompressed;
+    ASSERT_TRUE(decompressLines(compressed, decompressed));
+    EXPECT_EQ(records, decompressed);
+    EXPECT_LT(compressed.size() * 4, records.size());
+}
+
+TEST(SettingsCompressor, RoundTripInPieces)
+{
+    const std::string records = makeRecords(300);
+
+    // The records can be split anywhere, even in the middle of a key, and the output does not change.
+    SettingsCompressor compressor(256);
+    std::string        expected;
+    compressor.begin();
+    compressor.compress(records, expected);
+    compressor.end(expected);
+
+    for (const size_t pieceSize : {1U, 7U, 100U, 4096U})
+    {
+        std::string compressed;
+        compressor.begin();
+        for (size_t i = 0; i < records.size(); i += pieceSize)
+        {
+            compressor.compress(std::string_view(records).substr(i, pieceSize), compressed);
+        }
+        compressor.end(compressed);
+        EXPECT_EQ(expected, compressed);
+    }
+
+    std::string decompressed;
+    ASSERT_TRUE(decompressLines(expected, decompressed));
+    EXPECT_EQ(records, decompressed);
+}
+
+TEST(SettingsCompressor, LinesAreText)
+{
+    // Binary data and long values are escaped, so every block is one line without NUL or carriage returns.
+    std::string records;
+    for (int i = 0; i < 2000; i++)
+    {
+        records += "key" + std::to_string(i) + "\t2\t" + static_cast<char>(i % 256 == '\n' ? 1 : i % 256) + "\x10\r\n";
+    }
+    records += "last\t2\t" + std::string(5000, 'x') + "\n";
+    SettingsCompressor compressor(512);
+    std::string        compressed;
+    compressor.begin();
+    compressor.compress(records, compressed);
+    compressor.end(compressed);
+
+    EXPECT_EQ(std::string::npos, compressed.find('\0'));
+    EXPECT_EQ(std::string::npos, compressed.find('\r'));
+    EXPECT_EQ('\n', compressed.back());
+
+    std::string decompressed;
+    ASSERT_TRUE(decompressLines(compressed, decompressed));
+    EXPECT_EQ(records, decompressed);
+}
+
+TEST(SettingsCompressor, EmptyStream)
+{
+    SettingsCompressor compressor;
+    std::string        compressed;
+    compressor.begin();
+    compressor.compress("", compressed);
+    compressor.end(compressed);
+    EXPECT_TRUE(compressed.empty());
+
+    // A stream that ends in the middle of a key keeps it.
+    compressor.compress("menu1/setting1\t0\t1.23\nmenu1/set", compressed);
+    compressor.end(compressed);
+    std::string decompressed;
+    ASSERT_TRUE(decompressLines(compressed, decompressed));
+    EXPECT_EQ("menu1/setting1\t0\t1.23\nmenu1/set", decompressed);
+}
+
+TEST(SettingsCompressor, DecompressCorruptedLines)
+{
+    const std::string  records = makeRecords(50); // A single block.
+    SettingsCompressor compressor;
+    std::string        compressed;
+    compressor.begin();
+    compressor.compress(records, compressed);
+    compressor.end(compressed);
+
+    SettingsDecompressor decompressor;
+    std::string          decompressed;
+    EXPECT_FALSE(decompressor.decompress("", decompressed));
+    EXPECT_FALSE(decompressor.decompress(std::string_view(compressed).substr(0, compressed.size() / 2), decompressed));
+
+    decompressor.begin();
+    EXPECT_FALSE(decompressor.decompress(compressed.substr(0, compressed.size() - 2) + "\x10\n", decompressed));
+
+    decompressor.begin();
+    EXPECT_FALSE(decompressor.decompress(std::string("\x05\x50") + "abcde\n", decompressed));
+
+    decompressor.begin();
+    decompressed.clear();
+    EXPECT_TRUE(decompressor.decompress(compressed, decompressed));
+    EXPECT_EQ(records, decompressed);
+}
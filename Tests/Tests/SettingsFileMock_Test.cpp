@@ -567,3 +567,32 @@ TEST(SettingsFileMock, getOpenStatusClosed)
 
     EXPECT_EQ(expected_result, result);
 }
+
+TEST(SettingsFileMock, writeAtOpenForUpdate)
+{
+    SettingsFileMock settingsFileMock("internal buffer");
+
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFileMock.writeAt(0, "INTERNAL"));
+    ASSERT_EQ(SettingsFile::Success, settingsFileMock.openForUpdate());
+    EXPECT_EQ(SettingsFile::FileOpenedForWrite, settingsFileMock.getOpenStatus());
+    EXPECT_EQ(SettingsFile::Success, settingsFileMock.writeAt(0, "INTERNAL"));
+    EXPECT_EQ(SettingsFile::Success, settingsFileMock.writeAt(9, "BUFFER"));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFileMock.writeAt(10, "BUFFER"));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFileMock.write(std::string("data")));
+    EXPECT_EQ(SettingsFile::InvalidState, settingsFileMock.openForUpdate());
+    EXPECT_EQ(SettingsFile::Success, settingsFileMock.close());
+
+    EXPECT_STREQ("INTERNAL BUFFER", settingsFileMock._getInternalBuffer());
+}
+
+TEST(SettingsFileMock, writeAtForceMockMode)
+{
+    SettingsFileMock settingsFileMock("internal buffer");
+    settingsFileMock._setForceMockMode(true);
+    settingsFileMock._setOpenForUpdateResult(SettingsFile::IOError);
+    settingsFileMock._setWriteAtResult(SettingsFile::EndOfFile);
+
+    EXPECT_EQ(SettingsFile::IOError, settingsFileMock.openForUpdate());
+    EXPECT_EQ(SettingsFile::EndOfFile, settingsFileMock.writeAt(0, "INTERNAL"));
+    EXPECT_STREQ("internal buffer", settingsFileMock._getInternalBuffer());
+}
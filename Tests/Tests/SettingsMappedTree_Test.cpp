@@ -0,0 +1,286 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include "SettingsMappedTree.h"
+#include "gtest/gtest.h"
+
+static std::string makeRecord(const uint32_t i, const char* value = nullptr)
+{
+    char record[128];
+    snprintf(record, sizeof(record), "component%02u/setting%05u\t1\t%s", i / 100, i,
+             value != nullptr ? value : std::to_string(i).c_str());
+    return record;
+}
+
+static int collectRecordsCallback(void* data, const std::string_view record, [[maybe_unused]] const uint32_t id)
+{
+    static_cast<std::vector<std::string>*>(data)->emplace_back(record);
+    return 0;
+}
+
+static std::vector<std::string> collectRecords(const SettingsMappedTree& tree, const std::string_view firstKey = {},
+                                               const std::string_view prefix = {}, int* result = nullptr)
+{
+    std::vector<std::string> records;
+    const int                iterateResult = tree.iterate(firstKey, prefix, collectRecordsCallback, &records);
+    if (result != nullptr)
+    {
+        *result = iterateResult;
+    }
+    return records;
+}
+
+// Puts the records, growing the region when they do not fit, and commits them.
+static void putRecords(SettingsMappedTree& tree, std::string& region, const std::vector<std::string>& records)
+{
+    for (const std::string& record : records)
+    {
+        size_t requiredSize = 0;
+        while (!tree.put(record, requiredSize))
+        {
+            ASSERT_NE(0U, requiredSize);
+            region.resize(requiredSize);
+            tree.remap(region.data(), region.size());
+        }
+    }
+    tree.commit();
+}
+
+TEST(SettingsMappedTree, PutSearchIterate)
+{
+    std::string        region(SettingsMappedTree::HEADER_SIZE, '\0');
+    SettingsMappedTree tree;
+    tree.create(region.data(), region.size());
+    EXPECT_TRUE(SettingsMappedTree::isMappedTree(region));
+    EXPECT_EQ(0U, tree.getCount());
+
+    std::vector<uint32_t> order(1000);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+    std::vector<std::string> records;
+    for (const uint32_t i : order)
+    {
+        records.push_back(makeRecord(i));
+    }
+    putRecords(tree, region, records);
+    EXPECT_EQ(1000U, tree.getCount());
+    EXPECT_FALSE(tree.hasChanges());
+
+    // Every record is found by its key, and the ids are unique.
+    std::vector<bool> ids(1000, false);
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        const std::string expected = makeRecord(i);
+        std::string_view  record;
+        uint32_t          id = UINT32_MAX;
+        ASSERT_TRUE(tree.search(expected.substr(0, expected.find('\t')), record, id));
+        EXPECT_EQ(expected, record);
+        ASSERT_LT(id, 1000U);
+        EXPECT_FALSE(ids[id]);
+        ids[id] = true;
+    }
+    std::string_view record;
+    uint32_t         id = 0;
+    EXPECT_FALSE(tree.search("component00/setting", record, id));
+    EXPECT_FALSE(tree.search("component09/setting00999/", record, id));
+
+    // The records are iterated in key order, from a key and within a prefix.
+    std::sort(records.begin(), records.end());
+    EXPECT_EQ(records, collectRecords(tree));
+    const std::vector<std::string> fromKey = collectRecords(tree, "component05/setting00550");
+    EXPECT_EQ(std::vector<std::string>(records.begin() + 550, records.end()), fromKey);
+    const std::vector<std::string> prefix = collectRecords(tree, "component03/", "component03/");
+    EXPECT_EQ(std::vector<std::string>(records.begin() + 300, records.begin() + 400), prefix);
+    EXPECT_TRUE(collectRecords(tree, "component10/", "component10/").empty());
+
+    // The tree is found again when the region is attached to another tree.
+    SettingsMappedTree attachedTree;
+    ASSERT_TRUE(attachedTree.attach(std::string_view(region)));
+    EXPECT_EQ(1000U, attachedTree.getCount());
+    EXPECT_EQ(records, collectRecords(attachedTree));
+}
+
+TEST(SettingsMappedTree, ReplaceRecords)
+{
+    std::string        region(SettingsMappedTree::HEADER_SIZE, '\0');
+    SettingsMappedTree tree;
+    tree.create(region.data(), region.size());
+    std::vector<std::string> records;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        records.push_back(makeRecord(i));
+    }
+    const std::vector<std::string_view> recordViews(records.begin(), records.end());
+    size_t                              requiredSize = 0;
+    region.resize(SettingsMappedTree::HEADER_SIZE * 4);
+    tree.remap(region.data(), region.size());
+    ASSERT_TRUE(tree.rebuild(recordViews, requiredSize));
+    tree.commit();
+
+    // A record of a key already in the tree replaces the old one, keeping its id.
+    std::string_view record;
+    uint32_t         id    = 0;
+    uint32_t         oldId = 0;
+    ASSERT_TRUE(tree.search("component00/setting00042", record, oldId));
+    putRecords(tree, region, {makeRecord(42, "new value")});
+    EXPECT_EQ(100U, tree.getCount());
+    ASSERT_TRUE(tree.search("component00/setting00042", record, id));
+    EXPECT_EQ(makeRecord(42, "new value"), record);
+    EXPECT_EQ(oldId, id);
+
+    // Each change copies the nodes of its path, so the old nodes pile up until the tree needs to be compacted.
+    EXPECT_FALSE(tree.needsCompaction());
+    for (uint32_t i = 0; i < 100 && !tree.needsCompaction(); i++)
+    {
+        putRecords(tree, region, {makeRecord(i, "another value")});
+    }
+    EXPECT_TRUE(tree.needsCompaction());
+}
+
+TEST(SettingsMappedTree, CommitIsAtomic)
+{
+    std::string        region(SettingsMappedTree::HEADER_SIZE, '\0');
+    SettingsMappedTree tree;
+    tree.create(region.data(), region.size());
+
+    // The signature is written by create(), but there is no tree until the first commit.
+    EXPECT_FALSE(SettingsMappedTree().attach(std::string_view(region)));
+    putRecords(tree, region, {makeRecord(1), makeRecord(2)});
+
+    // The changes are not visible in the region until they are committed.
+    size_t requiredSize = 0;
+    while (!tree.put(makeRecord(3), requiredSize))
+    {
+        region.resize(requiredSize);
+        tree.remap(region.data(), region.size());
+    }
+    EXPECT_TRUE(tree.hasChanges());
+    size_t offset = 0;
+    size_t length = 0;
+    tree.getChanges(offset, length);
+    EXPECT_GE(offset, SettingsMappedTree::HEADER_SIZE);
+    EXPECT_EQ(region.size(), offset + length);
+
+    const std::string  uncommittedRegion = region;
+    SettingsMappedTree previousTree;
+    ASSERT_TRUE(previousTree.attach(std::string_view(uncommittedRegion)));
+    EXPECT_EQ(2U, previousTree.getCount());
+
+    tree.commit();
+    SettingsMappedTree newTree;
+    ASSERT_TRUE(newTree.attach(std::string_view(region)));
+    EXPECT_EQ(3U, newTree.getCount());
+
+    // Detaching the tree discards the changes that were not committed.
+    region.resize(region.size() + SettingsMappedTree::HEADER_SIZE);
+    tree.remap(region.data(), region.size());
+    EXPECT_TRUE(tree.put(makeRecord(1, "discarded"), requiredSize));
+    tree.detach();
+    EXPECT_FALSE(tree.isAttached());
+    ASSERT_TRUE(tree.attach(region.data(), region.size()));
+    EXPECT_EQ((std::vector<std::string>{makeRecord(1), makeRecord(2), makeRecord(3)}), collectRecords(tree));
+}
+
+TEST(SettingsMappedTree, Rebuild)
+{
+    std::string        region(SettingsMappedTree::HEADER_SIZE, '\0');
+    SettingsMappedTree tree;
+    tree.create(region.data(), region.size());
+
+    std::vector<std::string> records;
+    for (uint32_t i = 0; i < 500; i++)
+    {
+        records.push_back(makeRecord(i));
+    }
+    const std::vector<std::string_view> recordViews(records.begin(), records.end());
+    size_t                              requiredSize = 0;
+    ASSERT_FALSE(tree.rebuild(recordViews, requiredSize));
+    ASSERT_GT(requiredSize, region.size());
+    region.resize(requiredSize);
+    tree.remap(region.data(), region.size());
+    ASSERT_TRUE(tree.rebuild(recordViews, requiredSize));
+    tree.commit();
+    EXPECT_EQ(500U, tree.getCount());
+    EXPECT_EQ(records, collectRecords(tree));
+    std::string_view record;
+    uint32_t         id = 0;
+    EXPECT_TRUE(tree.search("component04/setting00499", record, id));
+    EXPECT_EQ(499U, id);
+
+    // The committed nodes are kept until the new tree is committed, so a smaller tree is built after them.
+    const std::vector<std::string_view> fewerRecords(recordViews.begin(), recordViews.begin() + 10);
+    ASSERT_FALSE(tree.rebuild(fewerRecords, requiredSize));
+    region.resize(requiredSize);
+    tree.remap(region.data(), region.size());
+    ASSERT_TRUE(tree.rebuild(fewerRecords, requiredSize));
+    tree.commit();
+    EXPECT_EQ(10U, tree.getCount());
+    EXPECT_FALSE(tree.search("component04/setting00499", record, id));
+
+    // Once the nodes at the start of the region are no longer used, the tree is built there again.
+    const size_t regionSize = region.size();
+    ASSERT_TRUE(tree.rebuild(fewerRecords, requiredSize));
+    size_t offset = 0;
+    size_t length = 0;
+    tree.getChanges(offset, length);
+    EXPECT_EQ(SettingsMappedTree::HEADER_SIZE, offset);
+    tree.commit();
+    EXPECT_EQ(regionSize, region.size());
+
+    // The records must be sorted, without repeated keys.
+    const std::vector<std::string_view> unsorted = {recordViews[1], recordViews[0]};
+    const std::vector<std::string_view> repeated = {recordViews[0], recordViews[0]};
+    EXPECT_FALSE(tree.rebuild(unsorted, requiredSize));
+    EXPECT_EQ(0U, requiredSize);
+    EXPECT_FALSE(tree.rebuild(repeated, requiredSize));
+    EXPECT_EQ(10U, tree.getCount());
+}
+
+TEST(SettingsMappedTree, CorruptedRegion)
+{
+    std::string        region(SettingsMappedTree::HEADER_SIZE, '\0');
+    SettingsMappedTree tree;
+    tree.create(region.data(), region.size());
+    std::vector<std::string> records;
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        records.push_back(makeRecord(i));
+    }
+    putRecords(tree, region, records);
+    putRecords(tree, region, {makeRecord(7, "last")});
+    tree.detach();
+
+    // A node whose record changed is not read, nor the nodes below it.
+    std::string corruptedNode = region;
+    corruptedNode[corruptedNode.rfind("setting00007\t1\tlast") + 13] = '2';
+    ASSERT_TRUE(tree.attach(corruptedNode.data(), corruptedNode.size()));
+    std::string_view record;
+    uint32_t         id = 0;
+    EXPECT_FALSE(tree.search("component00/setting00007", record, id));
+    int result = 0;
+    collectRecords(tree, {}, {}, &result);
+    EXPECT_EQ(-1, result);
+    size_t requiredSize = 0;
+    EXPECT_FALSE(tree.put(makeRecord(7), requiredSize));
+    EXPECT_EQ(0U, requiredSize);
+
+    // A superblock that does not match its checksum is ignored, so the previous tree is attached. The first commit
+    // after create() is stored in the superblock at offset 512, the second one at offset 1024.
+    std::string corruptedSuperblock = region;
+    corruptedSuperblock[1024 + 8] ^= 1;
+    ASSERT_TRUE(tree.attach(corruptedSuperblock.data(), corruptedSuperblock.size()));
+    EXPECT_EQ(records, collectRecords(tree));
+    corruptedSuperblock[512 + 8] ^= 1;
+    EXPECT_FALSE(tree.attach(corruptedSuperblock.data(), corruptedSuperblock.size()));
+
+    // Text settings files and truncated regions are not trees.
+    EXPECT_FALSE(SettingsMappedTree::isMappedTree("\rv1\t1\nmenu1/setting1\t1\t1\n\r123\n"));
+    EXPECT_FALSE(tree.attach(std::string_view(region).substr(0, SettingsMappedTree::HEADER_SIZE - 1)));
+    EXPECT_FALSE(tree.attach(std::string_view(region).substr(0, SettingsMappedTree::HEADER_SIZE + 64)));
+
+    // A region truncated after the end of the previous tree still holds it.
+    ASSERT_TRUE(tree.attach(std::string_view(region).substr(0, region.size() - 1)));
+    EXPECT_EQ(records, collectRecords(tree));
+}
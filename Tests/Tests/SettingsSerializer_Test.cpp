@@ -0,0 +1,156 @@
+#include "SettingsSerializer.h"
+#include "AllocationCounter.h"
+#include "SettingsFileMock.h"
+#include "gtest/gtest.h"
+
+TEST(SettingsSerializer, AppendIsBufferedUntilFlush)
+{
+    SettingsFileMock   settingsFileMock("", 1024);
+    SettingsSerializer serializer(64);
+
+    ASSERT_EQ(SettingsFile::Success, settingsFileMock.openForWrite());
+    serializer.begin(&settingsFileMock);
+
+    EXPECT_EQ(SettingsFile::Success, serializer.append(std::string_view("menu1/setting1")));
+    EXPECT_EQ(SettingsFile::Success, serializer.append('\t'));
+    EXPECT_STREQ("", settingsFileMock._getInternalBuffer());
+
+    EXPECT_EQ(SettingsFile::Success, serializer.flush());
+    EXPECT_STREQ("menu1/setting1\t", settingsFileMock._getInternalBuffer());
+}
+
+TEST(SettingsSerializer, AppendFlushesFullBlocks)
+{
+    SettingsFileMock   settingsFileMock("", 1024);
+    SettingsSerializer serializer(32);
+    const std::string  data(100, 'a');
+
+    ASSERT_EQ(SettingsFile::Success, settingsFileMock.openForWrite());
+    serializer.begin(&settingsFileMock);
+
+    EXPECT_EQ(SettingsFile::Success, serializer.append(std::string_view(data)));
+    EXPECT_EQ(96U, strlen(settingsFileMock._getInternalBuffer()));
+
+    EXPECT_EQ(SettingsFile::Success, serializer.flush());
+    EXPECT_STREQ(data.c_str(), settingsFileMock._getInternalBuffer());
+}
+
+TEST(SettingsSerializer, AppendNumbers)
+{
+    SettingsFileMock   settingsFileMock("", 1024);
+    SettingsSerializer serializer(32);
+
+    ASSERT_EQ(SettingsFile::Success, settingsFileMock.openForWrite());
+    serializer.begin(&settingsFileMock);
+
+    EXPECT_EQ(SettingsFile::Success, serializer.append(1.23));
+    EXPECT_EQ(SettingsFile::Success, serializer.append(' '));
+    EXPECT_EQ(SettingsFile::Success, serializer.append(0.1 + 0.2));
+    EXPECT_EQ(SettingsFile::Success, serializer.append(' '));
+    EXPECT_EQ(SettingsFile::Success, serializer.append(std::numeric_limits<int64_t>::min()));
+    EXPECT_EQ(SettingsFile::Success, serializer.append(' '));
+    EXPECT_EQ(SettingsFile::Success, serializer.append(static_cast<uint32_t>(4294967295U)));
+    EXPECT_EQ(SettingsFile::Success, serializer.flush());
+
+    EXPECT_STREQ("1.23 0.30000000000000004 -9223372036854775808 4294967295", settingsFileMock._getInternalBuffer());
+}
+
+TEST(SettingsSerializer, ChecksumDoesNotDependOnBlockSize)
+{
+    SettingsFileMock   smallBlocksFileMock("", 1024);
+    SettingsFileMock   bigBlocksFileMock("", 1024);
+    SettingsSerializer smallBlocksSerializer(32);
+    SettingsSerializer bigBlocksSerializer(512);
+    const char*        data = "menu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n";
+
+    ASSERT_EQ(SettingsFile::Success, smallBlocksFileMock.openForWrite());
+    ASSERT_EQ(SettingsFile::Success, bigBlocksFileMock.openForWrite());
+    smallBlocksSerializer.begin(&smallBlocksFileMock);
+    bigBlocksSerializer.begin(&bigBlocksFileMock);
+
+    EXPECT_EQ(SettingsFile::Success, smallBlocksSerializer.append(std::string_view(data)));
+    EXPECT_EQ(SettingsFile::Success, smallBlocksSerializer.flush());
+    EXPECT_EQ(SettingsFile::Success, bigBlocksSerializer.append(std::string_view(data)));
+    EXPECT_EQ(SettingsFile::Success, bigBlocksSerializer.flush());
+
+    EXPECT_EQ(1874197929U, smallBlocksSerializer.getChecksum());
+    EXPECT_EQ(1874197929U, bigBlocksSerializer.getChecksum());
+}
+
+TEST(SettingsSerializer, FlushWithoutChecksum)
+{
+    SettingsFileMock   settingsFileMock("", 1024);
+    SettingsSerializer serializer(32);
+
+    ASSERT_EQ(SettingsFile::Success, settingsFileMock.openForWrite());
+    serializer.begin(&settingsFileMock);
+
+    EXPECT_EQ(SettingsFile::Success, serializer.append(std::string_view("data")));
+    EXPECT_EQ(SettingsFile::Success, serializer.flush(false));
+
+    EXPECT_EQ(0U, serializer.getChecksum());
+    EXPECT_STREQ("data", settingsFileMock._getInternalBuffer());
+}
+
+TEST(SettingsSerializer, FlushInMemory)
+{
+    std::string        output;
+    SettingsSerializer serializer(32);
+    const std::string  data(100, 'a');
+
+    serializer.beginInMemory(&output, SettingsChecksumAlgorithm_t::CRC32C);
+
+    EXPECT_EQ(SettingsFile::Success, serializer.append(std::string_view(data)));
+    EXPECT_EQ(96U, output.size());
+
+    EXPECT_EQ(SettingsFile::Success, serializer.flush());
+    EXPECT_EQ(data, output);
+    EXPECT_EQ(SettingsChecksum::calculate(SettingsChecksumAlgorithm_t::CRC32C, data.data(), data.size()),
+              serializer.getChecksum());
+}
+
+TEST(SettingsSerializer, FlushWriteError)
+{
+    SettingsFileMock   settingsFileMock("", 1024);
+    SettingsSerializer serializer(32);
+
+    settingsFileMock._setForceMockMode(true);
+    settingsFileMock._setWriteBufferResult(SettingsFile::InvalidState);
+    serializer.begin(&settingsFileMock);
+
+    EXPECT_EQ(SettingsFile::Success, serializer.append(std::string_view("data")));
+    EXPECT_EQ(SettingsFile::InvalidState, serializer.flush());
+}
+
+TEST(SettingsSerializer, FlushWithoutFile)
+{
+    SettingsSerializer serializer(32);
+
+    serializer.begin(nullptr);
+
+    EXPECT_EQ(SettingsFile::Success, serializer.append('a'));
+    EXPECT_EQ(SettingsFile::InvalidState, serializer.flush());
+}
+
+TEST(SettingsSerializer, AppendDoesNotAllocate)
+{
+    SettingsFileMock   settingsFileMock("", 4096);
+    SettingsSerializer serializer(64);
+    const std::string  data(1000, 'a');
+
+    ASSERT_EQ(SettingsFile::Success, settingsFileMock.openForWrite());
+    serializer.begin(&settingsFileMock);
+
+    AllocationCounter                      allocationCounter;
+    const SettingsFile::SettingsFileResult stringResult  = serializer.append(std::string_view(data));
+    const SettingsFile::SettingsFileResult realResult    = serializer.append(123.456);
+    const SettingsFile::SettingsFileResult integerResult = serializer.append(static_cast<int64_t>(-42));
+    const SettingsFile::SettingsFileResult flushResult   = serializer.flush();
+    allocationCounter.stop();
+
+    EXPECT_EQ(SettingsFile::Success, stringResult);
+    EXPECT_EQ(SettingsFile::Success, realResult);
+    EXPECT_EQ(SettingsFile::Success, integerResult);
+    EXPECT_EQ(SettingsFile::Success, flushResult);
+    EXPECT_EQ(0U, allocationCounter.getAllocations());
+}
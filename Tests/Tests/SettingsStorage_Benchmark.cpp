@@ -0,0 +1,1334 @@
+#include <chrono>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "AllocationCounter.h"
+#include "LinuxAsyncSettingsFile.h"
+#include "LinuxMappedSettingsFile.h"
+#include "LinuxOSInterface.h"
+#include "SettingsFileMock.h"
+#include "SettingsStorage.h"
+#include "gtest/gtest.h"
+
+// Benchmarks are regular gtest cases that report their measurements through RecordProperty and stdout.
+// The slow ones are disabled by default, run them with --gtest_also_run_disabled_tests.
+
+constexpr uint32_t BENCHMARK_SETTINGS_COUNT       = 20000;
+constexpr int64_t  BENCHMARK_SETTINGS_RECORD_SIZE = 64; // Upper bound of a serialized benchmark record.
+
+static LinuxOSInterface linuxOSInterface;
+
+// Registers settingsCount settings, cycling over the three value types.
+static void registerBenchmarkSettings(const SettingsStorage& settingsStorage, const uint32_t settingsCount)
+{
+    char key[MAX_SETTING_KEY_SIZE];
+    for (uint32_t i = 0; i < settingsCount; i++)
+    {
+        snprintf(key, sizeof(key), "component%03u/setting%06u", i % 50, i);
+        switch (i % 3)
+        {
+            case 0:
+                ASSERT_EQ(SettingsStorage::NO_ERROR,
+                          settingsStorage.registerSettingAsInt(key, SettingPermissions_t::USER, i));
+                break;
+            case 1:
+                ASSERT_EQ(SettingsStorage::NO_ERROR,
+                          settingsStorage.registerSettingAsReal(key, SettingPermissions_t::ADMIN, i * 0.1));
+                break;
+            default:
+                ASSERT_EQ(SettingsStorage::NO_ERROR,
+                          settingsStorage.registerSettingAsString(key, SettingPermissions_t::SYSTEM, "auto"));
+                break;
+        }
+    }
+}
+
+static void reportMeasurement(const char* name, const int64_t value)
+{
+    testing::Test::RecordProperty(name, std::to_string(value));
+    std::cout << "[ BENCH    ] " << name << ": " << value << std::endl;
+}
+
+// Reference implementation of the record formatting used before the buffered serializer: one std::string per field.
+static size_t legacyFormatSetting(const char* key, const SettingsStorage::SettingValue_t& value)
+{
+    const std::string keyString(key); // SettingsFile::write(const std::string&) was called with the raw key.
+    const std::string typeString = std::format("\t{}\t", static_cast<uint8_t>(value.settingValueType));
+    std::string       valueString;
+    switch (value.settingValueType)
+    {
+        case SettingsStorage::REAL:
+            valueString =
+                std::format("{:.{}g}\n", value.settingValueData.real, std::numeric_limits<double>::max_digits10);
+            break;
+        case SettingsStorage::INTEGER:
+            valueString = std::format("{}\n", value.settingValueData.integer);
+            break;
+        default:
+            valueString = std::format("{}\n", value.settingValueData.string);
+            break;
+    }
+    return keyString.size() + typeString.size() + valueString.size();
+}
+
+// Reference implementation of the load used before the bulk loader: every record is put, or registered when it is
+// not in the tree yet, with its own lookup and write lock.
+static void legacyLoadSettings(const SettingsStorage& settingsStorage, const char* fileData)
+{
+    std::istringstream file(fileData);
+    std::string        line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '\r')
+        {
+            continue;
+        }
+        std::istringstream iss(line);
+        std::string        key;
+        std::string        type;
+        std::string        value;
+        std::getline(iss, key, '\t');
+        std::getline(iss, type, '\t');
+        std::getline(iss, value);
+        switch (std::stoi(type))
+        {
+            case SettingsStorage::REAL:
+                if (settingsStorage.putSettingValueAsReal(key.c_str(), std::stod(value)) ==
+                    SettingsStorage::KEY_NOT_FOUND_ERROR)
+                {
+                    ASSERT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage.registerSettingAsReal(key.c_str(), SettingPermissions_t::VOLATILE,
+                                                                    std::stod(value)));
+                }
+                break;
+            case SettingsStorage::INTEGER:
+                if (settingsStorage.putSettingValueAsInt(key.c_str(), std::stoi(value)) ==
+                    SettingsStorage::KEY_NOT_FOUND_ERROR)
+                {
+                    ASSERT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage.registerSettingAsInt(key.c_str(), SettingPermissions_t::VOLATILE,
+                                                                   std::stoi(value)));
+                }
+                break;
+            default:
+                if (settingsStorage.putSettingValueAsString(key.c_str(), value.c_str()) ==
+                    SettingsStorage::KEY_NOT_FOUND_ERROR)
+                {
+                    ASSERT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage.registerSettingAsString(key.c_str(), SettingPermissions_t::VOLATILE,
+                                                                      value.c_str()));
+                }
+                break;
+        }
+    }
+}
+
+TEST(SettingsStorageBenchmark, StoreSettingsInPersistentStorageAllocations)
+{
+    SettingsFileMock settingsFileMock("", BENCHMARK_SETTINGS_COUNT * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsStorage  settingsStorage(linuxOSInterface, &settingsFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.reserveSettings(BENCHMARK_SETTINGS_COUNT));
+    registerBenchmarkSettings(settingsStorage, BENCHMARK_SETTINGS_COUNT);
+
+    AllocationCounter                     storeAllocationCounter;
+    const auto                            start  = std::chrono::steady_clock::now();
+    const SettingsStorage::SettingError_t result = settingsStorage.storeSettingsInPersistentStorage();
+    const auto                            end    = std::chrono::steady_clock::now();
+    storeAllocationCounter.stop();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, result);
+
+    // Replay the legacy formatting of one record of each type, as registered by registerBenchmarkSettings().
+    char                            stringValue[] = "auto";
+    SettingsStorage::SettingValue_t legacyValues[] = {
+        {.settingValueType = SettingsStorage::INTEGER, .settingValueData = {.integer = 123456}},
+        {.settingValueType = SettingsStorage::REAL, .settingValueData = {.real = 12345.6}},
+        {.settingValueType = SettingsStorage::STRING, .settingValueData = {.string = stringValue}}};
+    size_t            legacyOutputSize = 0;
+    AllocationCounter legacyAllocationCounter;
+    for (const auto& legacyValue : legacyValues)
+    {
+        legacyOutputSize += legacyFormatSetting("component000/setting123456", legacyValue);
+    }
+    legacyAllocationCounter.stop();
+    EXPECT_LT(0U, legacyOutputSize);
+
+    reportMeasurement("StoreAllocations", static_cast<int64_t>(storeAllocationCounter.getAllocations()));
+    reportMeasurement("LegacyStoreAllocationsEstimate",
+                      static_cast<int64_t>(legacyAllocationCounter.getAllocations() * BENCHMARK_SETTINGS_COUNT / 3));
+    reportMeasurement("StoreTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+
+    EXPECT_EQ(0U, storeAllocationCounter.getAllocations());
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsInPersistentStorageParallel)
+{
+    constexpr uint32_t settingsCount = 200000;
+    const uint32_t     threads       = std::max(2U, std::thread::hardware_concurrency());
+    SettingsFileMock   serialFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsFileMock   parallelFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsStorage    serialStorage(linuxOSInterface, &serialFileMock);
+    SettingsStorage    parallelStorage(linuxOSInterface, &parallelFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, serialStorage.setExtendedSettingsFile(&serialFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, parallelStorage.setExtendedSettingsFile(&parallelFileMock));
+    registerBenchmarkSettings(serialStorage, settingsCount);
+    registerBenchmarkSettings(parallelStorage, settingsCount);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, serialStorage.storeSettingsInPersistentStorage(1));
+    const auto serialTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, parallelStorage.storeSettingsInPersistentStorage(threads));
+    const auto parallelTime = std::chrono::steady_clock::now() - start;
+
+    EXPECT_STREQ(serialFileMock._getInternalBuffer(), parallelFileMock._getInternalBuffer());
+
+    reportMeasurement("StoreThreads", threads);
+    reportMeasurement("SerialStoreTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(serialTime).count());
+    reportMeasurement("ParallelStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(parallelTime).count());
+    reportMeasurement("ParallelStoreSpeedupPercent", 100 * serialTime / parallelTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_LoadSettingsFromPersistentStorageMapped)
+{
+    constexpr uint32_t settingsCount = 50000;
+    const std::string  filePath =
+        (std::filesystem::temp_directory_path() / "SettingsStorageBenchmark_Load.dat").string();
+
+    // Build the settings file once, and load it through the line reader and through the mapped file.
+    SettingsFileMock settingsFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    {
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFileMock);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFileMock));
+        registerBenchmarkSettings(settingsStorage, settingsCount);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    }
+    std::ofstream(filePath, std::ios::binary | std::ios::trunc) << settingsFileMock._getInternalBuffer();
+
+    SettingsStorage streamStorage(linuxOSInterface, &settingsFileMock);
+    registerBenchmarkSettings(streamStorage, settingsCount);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, streamStorage.loadSettingsFromPersistentStorage());
+    const auto streamTime = std::chrono::steady_clock::now() - start;
+
+    LinuxMappedSettingsFile mappedSettingsFile(filePath.c_str());
+    SettingsStorage         mappedStorage(linuxOSInterface, &mappedSettingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, mappedStorage.setExtendedSettingsFile(&mappedSettingsFile));
+    registerBenchmarkSettings(mappedStorage, settingsCount);
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, mappedStorage.loadSettingsFromPersistentStorage());
+    const auto mappedTime = std::chrono::steady_clock::now() - start;
+
+    std::filesystem::remove(filePath);
+
+    reportMeasurement("StreamLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(streamTime).count());
+    reportMeasurement("MappedLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(mappedTime).count());
+    reportMeasurement("MappedLoadSpeedupPercent", 100 * streamTime / mappedTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_LoadSettingsFromPersistentStorageParallel)
+{
+    constexpr uint32_t settingsCount = 200000;
+    const uint32_t     threads       = std::max(2U, std::thread::hardware_concurrency());
+    const std::string  filePath =
+        (std::filesystem::temp_directory_path() / "SettingsStorageBenchmark_ParallelLoad.dat").string();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    {
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+        registerBenchmarkSettings(settingsStorage, settingsCount);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    }
+
+    SettingsStorage serialStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, serialStorage.setExtendedSettingsFile(&settingsFile));
+    registerBenchmarkSettings(serialStorage, settingsCount);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, serialStorage.loadSettingsFromPersistentStorage(1));
+    const auto serialTime = std::chrono::steady_clock::now() - start;
+
+    SettingsStorage parallelStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, parallelStorage.setExtendedSettingsFile(&settingsFile));
+    registerBenchmarkSettings(parallelStorage, settingsCount);
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, parallelStorage.loadSettingsFromPersistentStorage(threads));
+    const auto parallelTime = std::chrono::steady_clock::now() - start;
+
+    std::filesystem::remove(filePath);
+
+    reportMeasurement("LoadThreads", threads);
+    reportMeasurement("SerialLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(serialTime).count());
+    reportMeasurement("ParallelLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(parallelTime).count());
+    reportMeasurement("ParallelLoadSpeedupPercent", 100 * serialTime / parallelTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_LoadSettingsFromPersistentStorageLazily)
+{
+    constexpr uint32_t settingsCount = 200000;
+    const std::string  filePath =
+        (std::filesystem::temp_directory_path() / "SettingsStorageBenchmark_LazyLoad.dat").string();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    {
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+        registerBenchmarkSettings(settingsStorage, settingsCount);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    }
+
+    // Boot that only uses the settings of one component out of 50.
+    const auto registerUsedSettings = [](const SettingsStorage& settingsStorage)
+    {
+        char key[MAX_SETTING_KEY_SIZE];
+        for (uint32_t i = 0; i < settingsCount; i += 50 * 3)
+        {
+            snprintf(key, sizeof(key), "component%03u/setting%06u", i % 50, i);
+            ASSERT_EQ(SettingsStorage::NO_ERROR,
+                      settingsStorage.registerSettingAsInt(key, SettingPermissions_t::USER, 0));
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        SettingsStorage eagerStorage(linuxOSInterface, &settingsFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, eagerStorage.setExtendedSettingsFile(&settingsFile));
+        registerUsedSettings(eagerStorage);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, eagerStorage.loadSettingsFromPersistentStorage());
+    }
+    const auto eagerTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    {
+        SettingsStorage lazyStorage(linuxOSInterface, &settingsFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, lazyStorage.setExtendedSettingsFile(&settingsFile));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, lazyStorage.loadSettingsFromPersistentStorageLazily());
+        registerUsedSettings(lazyStorage);
+    }
+    const auto lazyTime = std::chrono::steady_clock::now() - start;
+
+    std::filesystem::remove(filePath);
+
+    reportMeasurement("EagerBootTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(eagerTime).count());
+    reportMeasurement("LazyBootTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(lazyTime).count());
+    reportMeasurement("LazyBootSpeedupPercent", 100 * eagerTime / lazyTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_LoadSettingsFromPersistentStorageStaged)
+{
+    constexpr uint32_t settingsCount = 200000;
+    const std::string  filePath =
+        (std::filesystem::temp_directory_path() / "SettingsStorageBenchmark_StagedLoad.dat").string();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+    {
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+        registerBenchmarkSettings(settingsStorage, settingsCount);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    }
+
+    // Time until the settings of the critical component (one out of 50) can be used.
+    SettingsStorage eagerStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, eagerStorage.setExtendedSettingsFile(&settingsFile));
+    registerBenchmarkSettings(eagerStorage, settingsCount);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, eagerStorage.loadSettingsFromPersistentStorage());
+    const auto eagerTime = std::chrono::steady_clock::now() - start;
+
+    SettingsStorage stagedStorage(linuxOSInterface, &settingsFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, stagedStorage.setExtendedSettingsFile(&settingsFile));
+    registerBenchmarkSettings(stagedStorage, settingsCount);
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, stagedStorage.loadSettingsFromPersistentStorageStaged("component000/"));
+    const auto stagedTime = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, stagedStorage.waitForSettings("", 10000));
+    const auto completeTime = std::chrono::steady_clock::now() - start;
+
+    std::filesystem::remove(filePath);
+
+    reportMeasurement("EagerLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(eagerTime).count());
+    reportMeasurement("StagedPriorityLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(stagedTime).count());
+    reportMeasurement("StagedCompleteLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(completeTime).count());
+    reportMeasurement("StagedPrioritySpeedupPercent", 100 * eagerTime / stagedTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_LoadSettingsFromPersistentStorageBulk)
+{
+    for (const uint32_t settingsCount : {10000U, 100000U})
+    {
+        SettingsFileMock settingsFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+        {
+            SettingsStorage settingsStorage(linuxOSInterface, &settingsFileMock);
+            registerBenchmarkSettings(settingsStorage, settingsCount);
+            ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+        }
+        const std::string fileData = settingsFileMock._getInternalBuffer();
+
+        // Boot before the owners register their settings, so every loaded setting is inserted in the tree.
+        SettingsStorage legacyStorage(linuxOSInterface, &settingsFileMock);
+        auto            start = std::chrono::steady_clock::now();
+        legacyLoadSettings(legacyStorage, fileData.c_str());
+        const auto legacyTime = std::chrono::steady_clock::now() - start;
+
+        SettingsStorage bulkStorage(linuxOSInterface, &settingsFileMock);
+        start = std::chrono::steady_clock::now();
+        ASSERT_EQ(SettingsStorage::NO_ERROR, bulkStorage.loadSettingsFromPersistentStorage());
+        const auto bulkTime = std::chrono::steady_clock::now() - start;
+
+        // Boot after the owners registered their settings, so every loaded setting updates the tree.
+        SettingsStorage registeredLegacyStorage(linuxOSInterface, &settingsFileMock);
+        registerBenchmarkSettings(registeredLegacyStorage, settingsCount);
+        start = std::chrono::steady_clock::now();
+        legacyLoadSettings(registeredLegacyStorage, fileData.c_str());
+        const auto registeredLegacyTime = std::chrono::steady_clock::now() - start;
+
+        SettingsStorage registeredBulkStorage(linuxOSInterface, &settingsFileMock);
+        registerBenchmarkSettings(registeredBulkStorage, settingsCount);
+        start = std::chrono::steady_clock::now();
+        ASSERT_EQ(SettingsStorage::NO_ERROR, registeredBulkStorage.loadSettingsFromPersistentStorage());
+        const auto registeredBulkTime = std::chrono::steady_clock::now() - start;
+
+        const std::string prefix = std::to_string(settingsCount);
+        reportMeasurement((prefix + "LegacyInsertLoadTimeUs").c_str(),
+                          std::chrono::duration_cast<std::chrono::microseconds>(legacyTime).count());
+        reportMeasurement((prefix + "BulkInsertLoadTimeUs").c_str(),
+                          std::chrono::duration_cast<std::chrono::microseconds>(bulkTime).count());
+        reportMeasurement((prefix + "BulkInsertLoadSpeedupPercent").c_str(), 100 * legacyTime / bulkTime);
+        reportMeasurement((prefix + "LegacyUpdateLoadTimeUs").c_str(),
+                          std::chrono::duration_cast<std::chrono::microseconds>(registeredLegacyTime).count());
+        reportMeasurement((prefix + "BulkUpdateLoadTimeUs").c_str(),
+                          std::chrono::duration_cast<std::chrono::microseconds>(registeredBulkTime).count());
+        reportMeasurement((prefix + "BulkUpdateLoadSpeedupPercent").c_str(),
+                          100 * registeredLegacyTime / registeredBulkTime);
+    }
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_ImportFromBuffer)
+{
+    constexpr uint32_t     settingsCount = 100000;
+    SettingsFileMock       settingsFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    std::vector<std::byte> buffer;
+    {
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFileMock);
+        registerBenchmarkSettings(settingsStorage, settingsCount);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+        const auto start = std::chrono::steady_clock::now();
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.exportToBuffer(buffer));
+        const auto exportTime = std::chrono::steady_clock::now() - start;
+        reportMeasurement("ExportTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(exportTime).count());
+    }
+
+    SettingsStorage loadStorage(linuxOSInterface, &settingsFileMock);
+    auto            start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, loadStorage.loadSettingsFromPersistentStorage());
+    const auto loadTime = std::chrono::steady_clock::now() - start;
+
+    SettingsStorage importStorage(linuxOSInterface);
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, importStorage.importFromBuffer(buffer));
+    const auto importTime = std::chrono::steady_clock::now() - start;
+
+    reportMeasurement("ImageSizeBytes", static_cast<int64_t>(buffer.size()));
+    reportMeasurement("TextLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(loadTime).count());
+    reportMeasurement("ImportTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(importTime).count());
+    reportMeasurement("ImportSpeedupPercent", 100 * loadTime / importTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsInPersistentStorageCompressed)
+{
+    constexpr uint32_t settingsCount = 100000;
+    SettingsFileMock   plainFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsFileMock   compressedFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsStorage    settingsStorage(linuxOSInterface, &plainFileMock);
+    SettingsStorage    compressedStorage(linuxOSInterface, &compressedFileMock);
+    registerBenchmarkSettings(settingsStorage, settingsCount);
+    registerBenchmarkSettings(compressedStorage, settingsCount);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE));
+    const auto plainStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              compressedStorage.storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ));
+    const auto compressedStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+    const auto plainLoadTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, compressedStorage.loadSettingsFromPersistentStorage());
+    const auto compressedLoadTime = std::chrono::steady_clock::now() - start;
+
+    const auto plainSize      = static_cast<int64_t>(strlen(plainFileMock._getInternalBuffer()));
+    const auto compressedSize = static_cast<int64_t>(strlen(compressedFileMock._getInternalBuffer()));
+    reportMeasurement("PlainFileBytes", plainSize);
+    reportMeasurement("CompressedFileBytes", compressedSize);
+    reportMeasurement("CompressionRatioPercent", 100 * compressedSize / plainSize);
+    reportMeasurement("PlainStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(plainStoreTime).count());
+    reportMeasurement("CompressedStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(compressedStoreTime).count());
+    reportMeasurement("PlainLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(plainLoadTime).count());
+    reportMeasurement("CompressedLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(compressedLoadTime).count());
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsInPersistentStorageSparse)
+{
+    constexpr uint32_t settingsCount  = 30000;
+    constexpr uint32_t modifiedPeriod = 10; // One setting out of modifiedPeriod does not keep its default value.
+    SettingsFileMock   fullFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsFileMock   sparseFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsStorage    fullStorage(linuxOSInterface, &fullFileMock);
+    SettingsStorage    sparseStorage(linuxOSInterface, &sparseFileMock);
+    registerBenchmarkSettings(fullStorage, settingsCount);
+    registerBenchmarkSettings(sparseStorage, settingsCount);
+    char key[MAX_SETTING_KEY_SIZE];
+    for (uint32_t i = 0; i < settingsCount; i += 3 * modifiedPeriod)
+    {
+        snprintf(key, sizeof(key), "component%03u/setting%06u", i % 50, i);
+        for (const SettingsStorage* settingsStorage : {&fullStorage, &sparseStorage})
+        {
+            ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt(key, i + 1));
+        }
+        snprintf(key, sizeof(key), "component%03u/setting%06u", (i + 1) % 50, i + 1);
+        for (const SettingsStorage* settingsStorage : {&fullStorage, &sparseStorage})
+        {
+            ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsReal(key, i * 0.5));
+        }
+        snprintf(key, sizeof(key), "component%03u/setting%06u", (i + 2) % 50, i + 2);
+        for (const SettingsStorage* settingsStorage : {&fullStorage, &sparseStorage})
+        {
+            ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString(key, "manual"));
+        }
+    }
+
+    const auto compression = SettingsCompressionAlgorithm_t::NONE;
+    auto       start       = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              fullStorage.storeSettingsInPersistentStorage(1, compression, StoreAllSettings));
+    const auto fullStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              sparseStorage.storeSettingsInPersistentStorage(1, compression, StoreModifiedSettings));
+    const auto sparseStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, fullStorage.loadSettingsFromPersistentStorage());
+    const auto fullLoadTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, sparseStorage.loadSettingsFromPersistentStorage());
+    const auto sparseLoadTime = std::chrono::steady_clock::now() - start;
+
+    reportMeasurement("FullFileBytes", static_cast<int64_t>(strlen(fullFileMock._getInternalBuffer())));
+    reportMeasurement("SparseFileBytes", static_cast<int64_t>(strlen(sparseFileMock._getInternalBuffer())));
+    reportMeasurement("FullStoreTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(fullStoreTime).count());
+    reportMeasurement("SparseStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(sparseStoreTime).count());
+    reportMeasurement("FullLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(fullLoadTime).count());
+    reportMeasurement("SparseLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(sparseLoadTime).count());
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsInPersistentStorageShards)
+{
+    constexpr uint32_t settingsCount   = 30000;
+    constexpr uint32_t componentsCount = 50; // registerBenchmarkSettings() spreads the settings over 50 components.
+    SettingsFileMock   singleFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsFileMock   mainFileMock("", BENCHMARK_SETTINGS_RECORD_SIZE);
+
+    std::vector<std::unique_ptr<SettingsFileMock>> shardFileMocks;
+    for (uint32_t i = 0; i < componentsCount; i++)
+    {
+        shardFileMocks.push_back(std::make_unique<SettingsFileMock>(
+            "", settingsCount / componentsCount * BENCHMARK_SETTINGS_RECORD_SIZE));
+    }
+    SettingsStorage singleStorage(linuxOSInterface, &singleFileMock);
+    SettingsStorage shardedStorage(linuxOSInterface, &mainFileMock);
+    char            key[MAX_SETTING_KEY_SIZE];
+    for (uint32_t i = 0; i < componentsCount; i++)
+    {
+        snprintf(key, sizeof(key), "component%03u/", i);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, shardedStorage.addSettingsShard(key, shardFileMocks[i].get()));
+    }
+    registerBenchmarkSettings(singleStorage, settingsCount);
+    registerBenchmarkSettings(shardedStorage, settingsCount);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, singleStorage.storeSettingsInPersistentStorage());
+    ASSERT_EQ(SettingsStorage::NO_ERROR, shardedStorage.storeSettingsInPersistentStorage());
+
+    // One setting of one component changes, so only its shard is rewritten, and not the settings file either.
+    snprintf(key, sizeof(key), "component%03u/setting%06u", 7U, 7U);
+    for (const SettingsStorage* settingsStorage : {&singleStorage, &shardedStorage})
+    {
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsReal(key, 1.5));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, singleStorage.storeSettingsInPersistentStorage());
+    const auto singleStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, shardedStorage.storeSettingsInPersistentStorage());
+    const auto shardedStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, singleStorage.loadSettingsFromPersistentStorage());
+    const auto singleLoadTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, shardedStorage.loadSettingsFromPersistentStorage(4));
+    const auto shardedLoadTime = std::chrono::steady_clock::now() - start;
+
+    reportMeasurement("SingleFileRewrittenBytes", static_cast<int64_t>(strlen(singleFileMock._getInternalBuffer())));
+    reportMeasurement("ShardedRewrittenBytes",
+                      static_cast<int64_t>(strlen(shardFileMocks[7]->_getInternalBuffer())));
+    reportMeasurement("SingleFileStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(singleStoreTime).count());
+    reportMeasurement("ShardedStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(shardedStoreTime).count());
+    reportMeasurement("SingleFileLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(singleLoadTime).count());
+    reportMeasurement("ShardedLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(shardedLoadTime).count());
+}
+
+// A settings file whose writes take as long as those of a slow flash, and that counts how many times it is written.
+class SlowSettingsFileMock : public SettingsFileMock
+{
+public:
+    using SettingsFileMock::SettingsFileMock;
+
+    SettingsFileResult openForWrite() override
+    {
+        opens++;
+        return SettingsFileMock::openForWrite();
+    }
+
+    SettingsFileResult write(const std::string& data) override
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        return SettingsFileMock::write(data);
+    }
+
+    std::atomic<uint32_t> opens = 0;
+};
+
+// Longest time that a registration of another thread, which locks the tree for writing, waits while the settings are
+// stored. The registrations are spaced like those of a running application.
+static int64_t measureMaxRegisterStallUs(const SettingsStorage& settingsStorage, const char* keyPrefix,
+                                         const std::function<void()>& store)
+{
+    std::atomic<bool> storing  = true;
+    int64_t           maxStall = 0;
+    std::thread       writer([&settingsStorage, keyPrefix, &storing, &maxStall]() {
+        char key[MAX_SETTING_KEY_SIZE];
+        for (uint32_t i = 0; storing; i++)
+        {
+            snprintf(key, sizeof(key), "%s%06u", keyPrefix, i);
+            const auto start = std::chrono::steady_clock::now();
+            ASSERT_EQ(SettingsStorage::NO_ERROR,
+                      settingsStorage.registerSettingAsInt(key, SettingPermissions_t::USER, i));
+            maxStall = std::max<int64_t>(maxStall, std::chrono::duration_cast<std::chrono::microseconds>(
+                                                       std::chrono::steady_clock::now() - start)
+                                                       .count());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    store();
+    storing = false;
+    writer.join();
+    return maxStall;
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsAsync)
+{
+    SlowSettingsFileMock settingsFileMock("", BENCHMARK_SETTINGS_COUNT * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsStorage      settingsStorage(linuxOSInterface, &settingsFileMock);
+    registerBenchmarkSettings(settingsStorage, BENCHMARK_SETTINGS_COUNT);
+
+    // The synchronous store locks the tree while the file is written, so the registrations wait for the whole store,
+    // up to the timeout of the lock of the tree.
+    std::chrono::steady_clock::duration syncStoreTime{};
+    const int64_t syncMaxStall = measureMaxRegisterStallUs(settingsStorage, "sync/", [&]() {
+        const auto start = std::chrono::steady_clock::now();
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+        syncStoreTime = std::chrono::steady_clock::now() - start;
+    });
+
+    // The asynchronous store only locks the tree while it copies the settings.
+    std::chrono::steady_clock::duration asyncCallTime{};
+    std::chrono::steady_clock::duration asyncStoreTime{};
+    SettingsStorage::SettingError_t     asyncResult = SettingsStorage::TIMEOUT_ERROR;
+    const int64_t asyncMaxStall = measureMaxRegisterStallUs(settingsStorage, "async/", [&]() {
+        const auto start = std::chrono::steady_clock::now();
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsAsync(
+                                                 [](void* data, const SettingsStorage::SettingError_t result) {
+                                                     *static_cast<SettingsStorage::SettingError_t*>(data) = result;
+                                                 },
+                                                 &asyncResult));
+        asyncCallTime = std::chrono::steady_clock::now() - start;
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.waitForStore(60000));
+        asyncStoreTime = std::chrono::steady_clock::now() - start;
+    });
+    EXPECT_EQ(SettingsStorage::NO_ERROR, asyncResult);
+
+    reportMeasurement("SyncStoreTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(syncStoreTime).count());
+    reportMeasurement("SyncMaxRegisterStallUs", syncMaxStall);
+    reportMeasurement("AsyncStoreCallTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(asyncCallTime).count());
+    reportMeasurement("AsyncStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(asyncStoreTime).count());
+    reportMeasurement("AsyncMaxRegisterStallUs", asyncMaxStall);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsInPersistentStorageConcurrently)
+{
+    constexpr uint32_t   settingsCount   = 2000;
+    constexpr uint32_t   threadsCount    = 8;
+    constexpr uint32_t   storesPerThread = 20;
+    SlowSettingsFileMock settingsFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsStorage      settingsStorage(linuxOSInterface, &settingsFileMock);
+    registerBenchmarkSettings(settingsStorage, settingsCount);
+
+    // Every thread changes an integer setting and stores it, like components that save their settings when they
+    // change them.
+    // The stores called while another one is written share the next store, so the file is written fewer times.
+    std::atomic<uint32_t>    failedStores = 0;
+    std::vector<std::thread> threads;
+    const auto               start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < threadsCount; i++)
+    {
+        threads.emplace_back([&settingsStorage, &failedStores, i]() {
+            char key[MAX_SETTING_KEY_SIZE];
+            snprintf(key, sizeof(key), "component%03u/setting%06u", i * 3 % 50, i * 3);
+            for (uint32_t j = 0; j < storesPerThread; j++)
+            {
+                if (settingsStorage.putSettingValueAsInt(key, j) != SettingsStorage::NO_ERROR ||
+                    settingsStorage.storeSettingsInPersistentStorage() != SettingsStorage::NO_ERROR)
+                {
+                    failedStores++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const auto storeTime = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(0U, failedStores);
+
+    // The last file has the last value of every setting.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+    for (uint32_t i = 0; i < threadsCount; i++)
+    {
+        char    key[MAX_SETTING_KEY_SIZE];
+        int64_t value = 0;
+        snprintf(key, sizeof(key), "component%03u/setting%06u", i * 3 % 50, i * 3);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt(key, value));
+        EXPECT_EQ(storesPerThread - 1, value);
+    }
+
+    reportMeasurement("StoreCalls", threadsCount * storesPerThread);
+    reportMeasurement("FileWrites", settingsFileMock.opens);
+    reportMeasurement("StoreTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(storeTime).count());
+}
+
+// A settings file that counts the bytes written to it, including the positioned writes.
+class ByteCountingSettingsFileMock : public SettingsFileMock
+{
+public:
+    using SettingsFileMock::SettingsFileMock;
+
+    SettingsFileResult write(const std::string& data) override
+    {
+        writtenBytes += data.size();
+        return SettingsFileMock::write(data);
+    }
+
+    SettingsFileResult writeAt(size_t offset, std::string_view data) override
+    {
+        writtenBytes += data.size();
+        return SettingsFileMock::writeAt(offset, data);
+    }
+
+    uint64_t writtenBytes = 0;
+};
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsInSlots)
+{
+    constexpr uint32_t           settingsCount = 30000;
+    ByteCountingSettingsFileMock fullFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    ByteCountingSettingsFileMock slotsFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE * 2);
+    SettingsStorage              fullStorage(linuxOSInterface, &fullFileMock);
+    SettingsStorage              slotsStorage(linuxOSInterface, &slotsFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, fullStorage.setExtendedSettingsFile(&fullFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, slotsStorage.setExtendedSettingsFile(&slotsFileMock));
+    registerBenchmarkSettings(fullStorage, settingsCount);
+    registerBenchmarkSettings(slotsStorage, settingsCount);
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              fullStorage.storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE, StoreAllSettings));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, slotsStorage.storeSettingsInPersistentStorage(
+                                             1, SettingsCompressionAlgorithm_t::NONE, StoreSettingsInSlots));
+    const auto fullFileSize  = static_cast<int64_t>(strlen(fullFileMock._getInternalBuffer()));
+    const auto slotsFileSize = static_cast<int64_t>(strlen(slotsFileMock._getInternalBuffer()));
+
+    // One numeric setting changes, so the slotted file only overwrites its slot.
+    char key[MAX_SETTING_KEY_SIZE];
+    snprintf(key, sizeof(key), "component%03u/setting%06u", 7U, 7U);
+    for (const SettingsStorage* settingsStorage : {&fullStorage, &slotsStorage})
+    {
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsReal(key, 1.5));
+    }
+    fullFileMock.writtenBytes  = 0;
+    slotsFileMock.writtenBytes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              fullStorage.storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE, StoreAllSettings));
+    const auto fullStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, slotsStorage.storeSettingsInPersistentStorage(
+                                             1, SettingsCompressionAlgorithm_t::NONE, StoreSettingsInSlots));
+    const auto slotsStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, slotsStorage.loadSettingsFromPersistentStorage());
+    const auto slotsLoadTime = std::chrono::steady_clock::now() - start;
+    double     value         = 0;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, slotsStorage.getSettingAsReal(key, value));
+    EXPECT_EQ(1.5, value);
+
+    reportMeasurement("FullFileBytes", fullFileSize);
+    reportMeasurement("SlottedFileBytes", slotsFileSize);
+    reportMeasurement("FullRewriteWrittenBytes", static_cast<int64_t>(fullFileMock.writtenBytes));
+    reportMeasurement("SlottedUpdateWrittenBytes", static_cast<int64_t>(slotsFileMock.writtenBytes));
+    reportMeasurement("FullRewriteTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(fullStoreTime).count());
+    reportMeasurement("SlottedUpdateTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(slotsStoreTime).count());
+    reportMeasurement("SlottedLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(slotsLoadTime).count());
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsInMappedTree)
+{
+    constexpr uint32_t settingsCount = 30000;
+    const std::string  textFilePath =
+        (std::filesystem::temp_directory_path() / "SettingsStorageBenchmark_Text.dat").string();
+    const std::string treeFilePath =
+        (std::filesystem::temp_directory_path() / "SettingsStorageBenchmark_MappedTree.dat").string();
+    LinuxMappedSettingsFile textFile(textFilePath.c_str());
+    LinuxMappedSettingsFile treeFile(treeFilePath.c_str());
+    std::filesystem::remove(treeFilePath);
+    {
+        SettingsStorage textStorage(linuxOSInterface, &textFile);
+        SettingsStorage treeStorage(linuxOSInterface, &treeFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.setExtendedSettingsFile(&textFile));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.setExtendedSettingsFile(&treeFile));
+        registerBenchmarkSettings(textStorage, settingsCount);
+        registerBenchmarkSettings(treeStorage, settingsCount);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.storeSettingsInPersistentStorage());
+        ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.storeSettingsInPersistentStorage(
+                                                 1, SettingsCompressionAlgorithm_t::NONE, StoreSettingsInMappedTree));
+    }
+
+    // Time until the first setting can be read after boot, and until the whole file is loaded.
+    char key[MAX_SETTING_KEY_SIZE];
+    snprintf(key, sizeof(key), "component%03u/setting%06u", 7U, 7U);
+    double value = 0;
+    auto   start = std::chrono::steady_clock::now();
+    {
+        SettingsStorage textStorage(linuxOSInterface, &textFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.setExtendedSettingsFile(&textFile));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.loadSettingsFromPersistentStorage());
+        ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.getSettingAsReal(key, value));
+    }
+    const auto textLoadTime = std::chrono::steady_clock::now() - start;
+
+    std::chrono::steady_clock::duration treeFirstLookupTime {};
+    start = std::chrono::steady_clock::now();
+    {
+        SettingsStorage treeStorage(linuxOSInterface, &treeFile);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.setExtendedSettingsFile(&treeFile));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.loadSettingsFromPersistentStorageLazily());
+        ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.getSettingAsReal(key, value));
+        treeFirstLookupTime = std::chrono::steady_clock::now() - start;
+        ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.loadSettingsFromPersistentStorage());
+    }
+    const auto treeLoadTime = std::chrono::steady_clock::now() - start;
+
+    // Time to store one changed setting.
+    SettingsStorage textStorage(linuxOSInterface, &textFile);
+    SettingsStorage treeStorage(linuxOSInterface, &treeFile);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.setExtendedSettingsFile(&textFile));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.setExtendedSettingsFile(&treeFile));
+    registerBenchmarkSettings(textStorage, settingsCount);
+    registerBenchmarkSettings(treeStorage, settingsCount);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.loadSettingsFromPersistentStorage());
+    ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.loadSettingsFromPersistentStorage());
+    ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.putSettingValueAsReal(key, 1.5));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.putSettingValueAsReal(key, 1.5));
+    start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, textStorage.storeSettingsInPersistentStorage());
+    const auto textStoreTime = std::chrono::steady_clock::now() - start;
+    start                    = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, treeStorage.storeSettingsInPersistentStorage(
+                                             1, SettingsCompressionAlgorithm_t::NONE, StoreSettingsInMappedTree));
+    const auto treeStoreTime = std::chrono::steady_clock::now() - start;
+
+    std::filesystem::remove(textFilePath);
+    std::filesystem::remove(treeFilePath);
+
+    reportMeasurement("TextLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(textLoadTime).count());
+    reportMeasurement("MappedTreeFirstLookupTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(treeFirstLookupTime).count());
+    reportMeasurement("MappedTreeLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(treeLoadTime).count());
+    reportMeasurement("TextStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(textStoreTime).count());
+    reportMeasurement("MappedTreeStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(treeStoreTime).count());
+}
+
+// A settings file that goes through the buffered streams of the C library, the baseline of the Linux settings files.
+class StdioSettingsFile : public ExtendedSettingsFile
+{
+public:
+    explicit StdioSettingsFile(const char* filePath) : filePath(filePath) {}
+
+    ~StdioSettingsFile() override
+    {
+        forceClose();
+    }
+
+    SettingsFileResult read(char* byte) override
+    {
+        const int c = file != nullptr ? fgetc(file) : EOF;
+        *byte       = static_cast<char>(c);
+        return c != EOF ? Success : EndOfFile;
+    }
+
+    SettingsFileResult readLine(std::string& buffer) override
+    {
+        char   chunk[256];
+        size_t read = 0;
+        while (file != nullptr && fgets(chunk, sizeof(chunk), file) != nullptr)
+        {
+            const size_t length = strlen(chunk);
+            buffer.append(chunk, length);
+            read += length;
+            if (chunk[length - 1] == '\n')
+            {
+                break;
+            }
+        }
+        return read > 0 ? Success : EndOfFile;
+    }
+
+    SettingsFileResult write(char byte) override
+    {
+        return fputc(byte, file) != EOF ? Success : IOError;
+    }
+
+    SettingsFileResult write(const std::string& data) override
+    {
+        return fwrite(data.data(), 1, data.size(), file) == data.size() ? Success : IOError;
+    }
+
+    SettingsFileResult openForRead() override
+    {
+        file   = fopen(filePath.c_str(), "rb");
+        status = file != nullptr ? FileOpenedForRead : FileClosed;
+        return file != nullptr ? Success : InvalidState;
+    }
+
+    SettingsFileResult openForWrite() override
+    {
+        file   = fopen(filePath.c_str(), "wb");
+        status = file != nullptr ? FileOpenedForWrite : FileClosed;
+        return file != nullptr ? Success : InvalidState;
+    }
+
+    SettingsFileResult close() override
+    {
+        const int result = file != nullptr ? fclose(file) : EOF;
+        file             = nullptr;
+        status           = FileClosed;
+        return result == 0 ? Success : IOError;
+    }
+
+    void forceClose() override
+    {
+        if (file != nullptr)
+        {
+            close();
+        }
+    }
+
+    FileStatus getOpenStatus() override
+    {
+        return status;
+    }
+
+private:
+    std::string filePath;
+    FILE*       file   = nullptr;
+    FileStatus  status = FileClosed;
+};
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreAndLoadSettingsAsync)
+{
+    constexpr uint32_t settingsCount = 200000;
+    const uint32_t     threads       = std::max(2U, std::thread::hardware_concurrency());
+
+    // The same files on a memory filesystem and on the disk of the temporary directory.
+    std::vector<std::pair<std::string, std::filesystem::path>> directories = {
+        {"Disk", std::filesystem::temp_directory_path()}};
+    if (std::filesystem::is_directory("/dev/shm"))
+    {
+        directories.emplace_back("Tmpfs", "/dev/shm");
+    }
+    for (const auto& [directoryName, directory] : directories)
+    {
+        const std::string      filePath = (directory / "SettingsStorageBenchmark_Async.dat").string();
+        StdioSettingsFile      stdioFile(filePath.c_str());
+        LinuxAsyncSettingsFile ringFile(filePath.c_str());
+        LinuxAsyncSettingsFile preadFile(filePath.c_str(), LinuxAsyncSettingsFile::DEFAULT_BUFFER_SIZE,
+                                         LinuxAsyncSettingsFile::DEFAULT_QUEUE_DEPTH, false);
+        const std::pair<const char*, ExtendedSettingsFile*> files[] = {
+            {"Stdio", &stdioFile}, {ringFile.isUsingRing() ? "Uring" : "UringUnavailable", &ringFile},
+            {"Pread", &preadFile}};
+        for (const auto& [fileName, settingsFile] : files)
+        {
+            for (const uint32_t storeThreads : {1U, threads})
+            {
+                SettingsStorage settingsStorage(linuxOSInterface, settingsFile);
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(settingsFile));
+                registerBenchmarkSettings(settingsStorage, settingsCount);
+                auto start = std::chrono::steady_clock::now();
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage(storeThreads));
+                const auto storeTime = std::chrono::steady_clock::now() - start;
+                start                = std::chrono::steady_clock::now();
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+                const auto loadTime = std::chrono::steady_clock::now() - start;
+
+                const std::string prefix = directoryName + fileName + (storeThreads > 1 ? "Parallel" : "Serial");
+                reportMeasurement((prefix + "StoreTimeUs").c_str(),
+                                  std::chrono::duration_cast<std::chrono::microseconds>(storeTime).count());
+                reportMeasurement((prefix + "LoadTimeUs").c_str(),
+                                  std::chrono::duration_cast<std::chrono::microseconds>(loadTime).count());
+            }
+        }
+        std::filesystem::remove(filePath);
+    }
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsWithDurability)
+{
+    constexpr uint32_t interlocksCount = 10;
+    constexpr int      stores          = 20;
+    const auto         directory       = std::filesystem::temp_directory_path();
+    const std::string  filePath        = (directory / "SettingsStorageBenchmark_Durability.dat").string();
+    const std::string  shardPath       = (directory / "SettingsStorageBenchmark_Interlocks.dat").string();
+    char               key[MAX_SETTING_KEY_SIZE];
+
+    // Stores a change of an interlock each time, with the interlocks in the settings file or in their own shard.
+    const auto measureStores = [&](const bool sharded, const SettingsDurability_t durability)
+    {
+        LinuxMappedSettingsFile settingsFile(filePath.c_str());
+        LinuxMappedSettingsFile shardFile(shardPath.c_str());
+        SettingsStorage         settingsStorage(linuxOSInterface, &settingsFile);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+        if (sharded)
+        {
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.addSettingsShard("interlock/", &shardFile));
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&shardFile));
+        }
+        registerBenchmarkSettings(settingsStorage, BENCHMARK_SETTINGS_COUNT);
+        for (uint32_t i = 0; i < interlocksCount; i++)
+        {
+            snprintf(key, sizeof(key), "interlock/setting%02u", i);
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.registerSettingAsInt(key, SettingPermissions_t::SYSTEM,
+                                                                                      0, durability));
+        }
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < stores; i++)
+        {
+            snprintf(key, sizeof(key), "interlock/setting%02u", i % interlocksCount);
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt(key, i));
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+        }
+        return (std::chrono::steady_clock::now() - start) / stores;
+    };
+
+    const auto unsyncedTime    = measureStores(false, SettingsDurability_t::NONE);
+    const auto allSyncedTime   = measureStores(false, SettingsDurability_t::FSYNCED);
+    const auto shardSyncedTime = measureStores(true, SettingsDurability_t::FSYNCED);
+    std::filesystem::remove(filePath);
+    std::filesystem::remove(shardPath);
+
+    reportMeasurement("UnsyncedStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(unsyncedTime).count());
+    reportMeasurement("AllFsyncedStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(allSyncedTime).count());
+    reportMeasurement("ShardFsyncedStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(shardSyncedTime).count());
+    reportMeasurement("ShardFsyncedSpeedupPercent", 100 * allSyncedTime / shardSyncedTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_LoadSettingsInBlocks)
+{
+    constexpr uint32_t settingsCount = 200000;
+    const uint32_t     threads       = std::max(2U, std::thread::hardware_concurrency());
+    const std::string  filePath =
+        (std::filesystem::temp_directory_path() / "SettingsStorageBenchmark_Blocks.dat").string();
+    LinuxMappedSettingsFile settingsFile(filePath.c_str());
+
+    // Loads the settings file stored as a whole or in blocks, whose checksums are validated by several threads.
+    const auto measureLoad = [&](const SettingsStoreMode_t mode, const uint32_t loadThreads)
+    {
+        {
+            SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+            registerBenchmarkSettings(settingsStorage, settingsCount);
+            EXPECT_EQ(SettingsStorage::NO_ERROR,
+                      settingsStorage.storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE, mode));
+        }
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFile);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.setExtendedSettingsFile(&settingsFile));
+        registerBenchmarkSettings(settingsStorage, settingsCount);
+        const auto start = std::chrono::steady_clock::now();
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorage(loadThreads));
+        return std::chrono::steady_clock::now() - start;
+    };
+
+    const auto wholeTime          = measureLoad(StoreAllSettings, 1);
+    const auto serialBlocksTime   = measureLoad(StoreSettingsInBlocks, 1);
+    const auto parallelBlocksTime = measureLoad(StoreSettingsInBlocks, threads);
+    std::filesystem::remove(filePath);
+
+    reportMeasurement("LoadThreads", threads);
+    reportMeasurement("WholeFileLoadTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(wholeTime).count());
+    reportMeasurement("SerialBlocksLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(serialBlocksTime).count());
+    reportMeasurement("ParallelBlocksLoadTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(parallelBlocksTime).count());
+    reportMeasurement("ParallelBlocksSpeedupPercent", 100 * serialBlocksTime / parallelBlocksTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsInPersistentStorageLowChurn)
+{
+    constexpr uint32_t settingsCount = 50000;
+    constexpr int      stores        = 20;
+    SettingsFileMock   settingsFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsStorage    settingsStorage(linuxOSInterface, &settingsFileMock);
+    registerBenchmarkSettings(settingsStorage, settingsCount);
+
+    // The first store formats every number, the next ones only those of the two settings that change each time.
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    const auto firstStoreTime = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < stores; i++)
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("component000/setting000000", i));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsReal("component001/setting000001", i));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    }
+    const auto lowChurnStoreTime = (std::chrono::steady_clock::now() - start) / stores;
+
+    reportMeasurement("FirstStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(firstStoreTime).count());
+    reportMeasurement("LowChurnStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(lowChurnStoreTime).count());
+    reportMeasurement("LowChurnStoreSpeedupPercent", 100 * firstStoreTime / lowChurnStoreTime);
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_StoreSettingsUnchanged)
+{
+    constexpr uint32_t settingsCount = 50000;
+    constexpr int      stores        = 20;
+    SettingsFileMock   settingsFileMock("", settingsCount * BENCHMARK_SETTINGS_RECORD_SIZE);
+    SettingsStorage    settingsStorage(linuxOSInterface, &settingsFileMock);
+    registerBenchmarkSettings(settingsStorage, settingsCount);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+
+    // Each setting changes and changes back before the store, so the stores only compare the hash of the file.
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < stores; i++)
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("component000/setting000000", i + 1));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("component000/setting000000", 0));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    }
+    const auto unchangedStoreTime = (std::chrono::steady_clock::now() - start) / stores;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < stores; i++)
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("component000/setting000000", i + 1));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    }
+    const auto changedStoreTime = (std::chrono::steady_clock::now() - start) / stores;
+
+    // The hashes of the prefixes let two storages compare their settings without listing them.
+    uint64_t rootHash = 0;
+    start             = std::chrono::steady_clock::now();
+    for (int i = 0; i < stores; i++)
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getRootHash(rootHash));
+    }
+    const auto rootHashTime = (std::chrono::steady_clock::now() - start) / stores;
+
+    reportMeasurement("UnchangedStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(unchangedStoreTime).count());
+    reportMeasurement("ChangedStoreTimeUs",
+                      std::chrono::duration_cast<std::chrono::microseconds>(changedStoreTime).count());
+    reportMeasurement("RootHashTimeNs", std::chrono::duration_cast<std::chrono::nanoseconds>(rootHashTime).count());
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_RegisterSettingsReserved)
+{
+    constexpr uint32_t settingsCount = 200000;
+    auto*              settingsStorage = new SettingsStorage(linuxOSInterface, nullptr);
+
+    // The values and their strings are taken from the slabs reserved, and released with them.
+    AllocationCounter allocationCounter;
+    auto              start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->reserveSettings(settingsCount));
+    registerBenchmarkSettings(*settingsStorage, settingsCount);
+    const auto registerTime = std::chrono::steady_clock::now() - start;
+    allocationCounter.stop();
+
+    start = std::chrono::steady_clock::now();
+    delete settingsStorage;
+    const auto destroyTime = std::chrono::steady_clock::now() - start;
+
+    reportMeasurement("RegisterTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(registerTime).count());
+    reportMeasurement("RegisterAllocations", static_cast<int64_t>(allocationCounter.getAllocations()));
+    reportMeasurement("DestroyTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(destroyTime).count());
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_PutSettingsAsString)
+{
+    constexpr uint32_t       settingsCount = 100000;
+    SettingsStorage          settingsStorage(linuxOSInterface, nullptr);
+    std::vector<std::string> keys;
+    char                     key[MAX_SETTING_KEY_SIZE];
+    for (uint32_t i = 0; i < settingsCount; i++)
+    {
+        snprintf(key, sizeof(key), "component%03u/setting%06u", i % 50, i);
+        keys.emplace_back(key);
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage.registerSettingAsString(key, SettingPermissions_t::USER, "auto"));
+    }
+
+    // The short values are stored in the settings, and the long ones reuse their buffer once it is allocated.
+    const char* const values[] = {"manual", "192.168.100.200", "auto",
+                                  "-----BEGIN CERTIFICATE-----MIIBszCCAVmgAwIBAgIU", "-----BEGIN CERTIFICATE-----"};
+    AllocationCounter allocationCounter;
+    const auto        start = std::chrono::steady_clock::now();
+    for (const char* value : values)
+    {
+        for (const std::string& settingKey : keys)
+        {
+            ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsString(settingKey.c_str(), value));
+        }
+    }
+    const auto putTime = std::chrono::steady_clock::now() - start;
+    allocationCounter.stop();
+
+    char outputValueBuffer[64];
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.getSettingAsString(keys.back().c_str(), outputValueBuffer, sizeof(outputValueBuffer)));
+    EXPECT_STREQ(values[std::size(values) - 1], outputValueBuffer);
+
+    reportMeasurement("PutTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(putTime).count());
+    reportMeasurement("PutAllocations", static_cast<int64_t>(allocationCounter.getAllocations()));
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_RegisterLargeDefaults)
+{
+    constexpr uint32_t settingsCount = 10000;
+    SettingsStorage    settingsStorage(linuxOSInterface, nullptr);
+    const std::string  certificate(2048, 'c');
+    char               key[MAX_SETTING_KEY_SIZE];
+
+    // The values share their default value, so the registration and the restore only allocate the defaults.
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < settingsCount; i++)
+    {
+        snprintf(key, sizeof(key), "component%03u/certificate%06u", i % 50, i);
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage.registerSettingAsString(key, SettingPermissions_t::SYSTEM, certificate.c_str()));
+    }
+    const auto registerTime = std::chrono::steady_clock::now() - start;
+    size_t     registerBytes, restoreBytes;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getStringsMemoryUsage(registerBytes));
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.restoreDefaultSettings(""));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getStringsMemoryUsage(restoreBytes));
+
+    reportMeasurement("RegisterTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(registerTime).count());
+    reportMeasurement("RegisterStringsBytes", static_cast<int64_t>(registerBytes));
+    reportMeasurement("RestoreStringsBytes", static_cast<int64_t>(restoreBytes));
+}
+
+TEST(SettingsStorageBenchmark, DISABLED_RegisterSettingsFromTable)
+{
+    constexpr uint32_t    settingsCount = 40000;
+    static constexpr char certificate[] = "-----BEGIN CERTIFICATE-----MIIBszCCAVmgAwIBAgIUJx3VAs4f1Yb2ZqKqF0pyRk4Z";
+    std::vector<std::string>                          keys;
+    std::vector<SettingsStorage::SettingDescriptor_t> descriptors;
+    char                                              key[MAX_SETTING_KEY_SIZE];
+    keys.reserve(settingsCount);
+    for (uint32_t i = 0; i < settingsCount; i++)
+    {
+        snprintf(key, sizeof(key), "component%03u/setting%06u", i % 50, i);
+        descriptors.push_back({.key          = keys.emplace_back(key).c_str(),
+                               .valueType    = SettingsStorage::STRING,
+                               .permissions  = SettingPermissions_t::USER,
+                               .defaultValue = {.string = i % 2 == 0 ? "auto" : certificate}});
+    }
+
+    // The table is registered while locking the settings once, and its default strings are not copied.
+    size_t          tableBytes, singleBytes;
+    SettingsStorage tableStorage(linuxOSInterface, nullptr);
+    auto            start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SettingsStorage::NO_ERROR, tableStorage.registerSettings(descriptors));
+    const auto tableTime = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, tableStorage.getStringsMemoryUsage(tableBytes));
+
+    SettingsStorage singleStorage(linuxOSInterface, nullptr);
+    start = std::chrono::steady_clock::now();
+    for (const SettingsStorage::SettingDescriptor_t& descriptor : descriptors)
+    {
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  singleStorage.registerSettingAsString(descriptor.key, descriptor.permissions,
+                                                        descriptor.defaultValue.string));
+    }
+    const auto singleTime = std::chrono::steady_clock::now() - start;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, singleStorage.getStringsMemoryUsage(singleBytes));
+
+    reportMeasurement("TableTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(tableTime).count());
+    reportMeasurement("TableStringsBytes", static_cast<int64_t>(tableBytes));
+    reportMeasurement("SingleTimeUs", std::chrono::duration_cast<std::chrono::microseconds>(singleTime).count());
+    reportMeasurement("SingleStringsBytes", static_cast<int64_t>(singleBytes));
+}
@@ -1,4 +1,7 @@
 #include "SettingsStorage.h"
+#include <bit>
+#include <random>
+#include <thread>
 #include "LinuxOSInterface.h"
 #include "SettingsFileMock.h"
 #include "gtest/gtest.h"
@@ -863,6 +866,37 @@ TEST(SettingsStorage, PutSettingValueAsStringValid)
     TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
 }
 
+TEST(SettingsStorage, PutSettingValueAsStringLengths)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    const char* key = "menu2/setting3";
+
+    // The values move between the buffers of the size classes of the pool, and the shorter ones reuse the longer ones.
+    const size_t      smallestSize = SettingsValuePool::STRING_SIZE_CLASSES[0];
+    const std::string values[]     = {"auto",
+                                      "",
+                                      std::string(smallestSize - 1, 'a'),
+                                      std::string(smallestSize, 'b'),
+                                      "192.168.100.200",
+                                      std::string(smallestSize + 1, 'c'),
+                                      std::string(1000, 'd'),
+                                      "manual"};
+    for (const std::string& value : values)
+    {
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString(key, value.c_str()));
+
+        // The buffer only needs room for the value and its NUL character.
+        std::vector<char> outputValueBuffer(value.size() + 1, 'x');
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->getSettingAsString(key, outputValueBuffer.data(), outputValueBuffer.size()));
+        EXPECT_STREQ(value.c_str(), outputValueBuffer.data());
+        EXPECT_EQ(SettingsStorage::INSUFFICIENT_BUFFER_SIZE_ERROR,
+                  settingsStorage->getSettingAsString(key, outputValueBuffer.data(), value.size()));
+    }
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
 TEST(SettingsStorage, PutSettingValueAsStringInvalidKey)
 {
     NEW_POPULATED_SETTINGS_STORAGE;
@@ -1299,6 +1333,181 @@ TEST(SettingsStorage, RegisterSettingAsStringInvalidPermissions)
     TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
 }
 
+constexpr SettingsStorage::SettingDescriptor_t TEST_SETTING_DESCRIPTORS[] = {
+    {.key          = "network/mode",
+     .valueType    = SettingsStorage::STRING,
+     .permissions  = SettingPermissions_t::USER,
+     .defaultValue = {.string = "auto"}},
+    {.key          = "network/address",
+     .valueType    = SettingsStorage::STRING,
+     .permissions  = SettingPermissions_t::ADMIN,
+     .defaultValue = {.string = "192.168.100.200/255.255.255.0"}},
+    {.key          = "network/mtu",
+     .valueType    = SettingsStorage::INTEGER,
+     .permissions  = SettingPermissions_t::ADMIN,
+     .defaultValue = {.integer = 1500},
+     .durability   = SettingsDurability_t::FSYNCED},
+    {.key          = "sensor/gain",
+     .valueType    = SettingsStorage::REAL,
+     .permissions  = SettingPermissions_t::SYSTEM,
+     .defaultValue = {.real = 0.75}}};
+
+TEST(SettingsStorage, registerSettingsValid)
+{
+    SettingsStorage settingsStorage(linuxOSInterface, nullptr);
+    size_t          initialBytes, bytes;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getStringsMemoryUsage(initialBytes));
+
+    // The default strings of the table are not copied.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.registerSettings(TEST_SETTING_DESCRIPTORS));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getStringsMemoryUsage(bytes));
+    EXPECT_EQ(initialBytes, bytes);
+
+    char                 stringValue[32];
+    int64_t              intValue;
+    double               realValue;
+    SettingPermissions_t permissions;
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.getSettingAsString("network/address", stringValue, sizeof(stringValue), &permissions));
+    EXPECT_STREQ("192.168.100.200/255.255.255.0", stringValue);
+    EXPECT_EQ(SettingPermissions_t::ADMIN, permissions);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt("network/mtu", intValue));
+    EXPECT_EQ(1500, intValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsReal("sensor/gain", realValue, &permissions));
+    EXPECT_EQ(0.75, realValue);
+    EXPECT_EQ(SettingPermissions_t::SYSTEM, permissions);
+
+    // The values are modified and restored without modifying the table.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsString("network/mode", "manual"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.putSettingValueAsString("network/address", "10.0.0.2/255.255.255.0"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsString("network/mode", stringValue, 7));
+    EXPECT_STREQ("manual", stringValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.restoreDefaultSettings("network/"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.getSettingAsString("network/address", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("192.168.100.200/255.255.255.0", stringValue);
+    EXPECT_STREQ("auto", TEST_SETTING_DESCRIPTORS[0].defaultValue.string);
+
+    // The imported default values replace the ones of the table.
+    std::vector<std::byte> buffer;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsString("network/mode", "manual"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.exportToBuffer(buffer));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.importFromBuffer(buffer));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsString("network/mode", stringValue, 7));
+    EXPECT_STREQ("manual", stringValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.getDefaultSettingAsString("network/address", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("192.168.100.200/255.255.255.0", stringValue);
+}
+
+TEST(SettingsStorage, registerSettingsKeyExists)
+{
+    SettingsStorage settingsStorage(linuxOSInterface, nullptr);
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsString("network/mode", SettingPermissions_t::USER, "manual"));
+
+    // The settings already registered are left as they are, and the others are registered.
+    EXPECT_EQ(SettingsStorage::KEY_EXISTS_ERROR, settingsStorage.registerSettings(TEST_SETTING_DESCRIPTORS));
+    char    stringValue[32];
+    int64_t intValue;
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.getDefaultSettingAsString("network/mode", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("manual", stringValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt("network/mtu", intValue));
+    EXPECT_EQ(1500, intValue);
+}
+
+TEST(SettingsStorage, registerSettingsInvalidInput)
+{
+    SettingsStorage settingsStorage(linuxOSInterface, nullptr);
+
+    // A single invalid descriptor rejects the whole table.
+    const SettingsStorage::SettingDescriptor_t invalidDescriptors[][2] = {
+        {TEST_SETTING_DESCRIPTORS[2],
+         {.key = "", .valueType = SettingsStorage::INTEGER, .permissions = SettingPermissions_t::USER}},
+        {TEST_SETTING_DESCRIPTORS[2],
+         {.key = "a", .valueType = SettingsStorage::STRING, .permissions = SettingPermissions_t::USER}},
+        {TEST_SETTING_DESCRIPTORS[2],
+         {.key = "a", .valueType = SettingsStorage::MAX_SETTING_VALUE_TYPE_ENUM, .permissions = ALL_PERMISSIONS}},
+        {TEST_SETTING_DESCRIPTORS[2],
+         {.key         = "a",
+          .valueType   = SettingsStorage::INTEGER,
+          .permissions = SettingPermissions_t::USER,
+          .durability  = SettingsDurability_t::MAX_SETTINGS_DURABILITY}}};
+    for (const auto& descriptors : invalidDescriptors)
+    {
+        EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage.registerSettings(descriptors));
+    }
+    int64_t intValue;
+    EXPECT_EQ(SettingsStorage::KEY_NOT_FOUND_ERROR, settingsStorage.getSettingAsInt("network/mtu", intValue));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.registerSettings({}));
+}
+
+TEST(SettingsStorage, reserveSettings)
+{
+    SettingsStorage settingsStorage(linuxOSInterface, nullptr);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.reserveSettings(1000));
+
+    // The memory of the settings and strings is reused when they change, whatever the size of the strings.
+    char        key[MAX_SETTING_KEY_SIZE];
+    std::string bigValue(1000, 'x');
+    for (uint32_t i = 0; i < 2000; i++)
+    {
+        snprintf(key, sizeof(key), "menu%u/setting%u", i % 10, i);
+        const std::string value = i % 7 == 0 ? bigValue : std::to_string(i);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.registerSettingAsString(key, ALL_PERMISSIONS, "auto"));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsString(key, value.c_str()));
+    }
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.restoreDefaultSettings("menu1/"));
+    EXPECT_EQ(SettingsStorage::KEY_EXISTS_ERROR,
+              settingsStorage.registerSettingAsString("menu0/setting0", ALL_PERMISSIONS, "manual"));
+
+    char value[1024];
+    for (uint32_t i = 0; i < 2000; i += 3)
+    {
+        snprintf(key, sizeof(key), "menu%u/setting%u", i % 10, i);
+        const std::string expectedValue = i % 10 == 1 ? "auto" : i % 7 == 0 ? bigValue : std::to_string(i);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsString(key, value, sizeof(value) - 1));
+        EXPECT_EQ(expectedValue, value);
+    }
+}
+
+TEST(SettingsStorage, getStringsMemoryUsage)
+{
+    SettingsStorage   settingsStorage(linuxOSInterface, nullptr);
+    const std::string certificate(1000, 'c');
+    const std::string otherCertificate(1000, 'o');
+    size_t            initialBytes, bytes;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getStringsMemoryUsage(initialBytes));
+
+    // The value shares the default value until it is modified.
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsString("tls/certificate", ALL_PERMISSIONS, certificate.c_str()));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getStringsMemoryUsage(bytes));
+    EXPECT_EQ(certificate.size() + 1, bytes - initialBytes);
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.putSettingValueAsString("tls/certificate", otherCertificate.c_str()));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getStringsMemoryUsage(bytes));
+    EXPECT_EQ(2 * (certificate.size() + 1), bytes - initialBytes);
+
+    // The default value is shared again once it is restored.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.restoreDefaultSettings("tls/"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getStringsMemoryUsage(bytes));
+    EXPECT_EQ(certificate.size() + 1, bytes - initialBytes);
+
+    char value[1024];
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsString("tls/certificate", value, sizeof(value)));
+    EXPECT_EQ(certificate, value);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsString("tls/certificate", "none"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.getDefaultSettingAsString("tls/certificate", value, sizeof(value)));
+    EXPECT_EQ(certificate, value);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsString("tls/certificate", value, sizeof(value)));
+    EXPECT_STREQ("none", value);
+}
+
 TEST(SettingsStorage, listSettingsKeysVoidKeyPrefix)
 {
     NEW_POPULATED_SETTINGS_STORAGE;
@@ -1761,6 +1970,296 @@ TEST(SettingsStorage, listSettingsKeysEmptyPrefix)
     TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
 }
 
+/// Keeps the mutexes it creates, so a test can hold the locks of a SettingsStorage.
+class MutexRecordingOSInterface : public LinuxOSInterface
+{
+public:
+    OSInterface_Mutex* osCreateMutex() override
+    {
+        mutexes.push_back(LinuxOSInterface::osCreateMutex());
+        return mutexes.back();
+    }
+
+    std::vector<OSInterface_Mutex*> mutexes;
+};
+
+TEST(SettingsStorage, getSubtreeHashOrderIndependent)
+{
+    SettingsStorage firstStorage(linuxOSInterface, nullptr);
+    SettingsStorage secondStorage(linuxOSInterface, nullptr);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, firstStorage.registerSettingAsInt("menu1/setting1", ALL_PERMISSIONS, 1));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, firstStorage.registerSettingAsReal("menu1/setting2", ALL_PERMISSIONS, 2.5));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, firstStorage.registerSettingAsString("menu2/setting3", ALL_PERMISSIONS, "a"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, secondStorage.registerSettingAsString("menu2/setting3", ALL_PERMISSIONS, "b"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, secondStorage.registerSettingAsReal("menu1/setting2", ALL_PERMISSIONS, 2.5));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, secondStorage.registerSettingAsInt("menu1/setting1", ALL_PERMISSIONS, 1));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              secondStorage.registerSettingAsInt("menu1/volatile", SettingPermissions_t::VOLATILE, 3));
+
+    // The hashes only depend on the settings, and the volatile settings are not part of them.
+    uint64_t firstHash  = 0;
+    uint64_t secondHash = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.getSubtreeHash("menu1/", firstHash));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, secondStorage.getSubtreeHash("menu1/", secondHash));
+    EXPECT_NE(0U, firstHash);
+    EXPECT_EQ(firstHash, secondHash);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.getRootHash(firstHash));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, secondStorage.getRootHash(secondHash));
+    EXPECT_NE(firstHash, secondHash);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, secondStorage.putSettingValueAsString("menu2/setting3", "a"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, secondStorage.getRootHash(secondHash));
+    EXPECT_EQ(firstHash, secondHash);
+
+    // A setting that changes back to its previous value gets its hash back, and the other prefixes keep theirs.
+    uint64_t menu2Hash   = 0;
+    uint64_t changedHash = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.getSubtreeHash("menu2/", menu2Hash));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.putSettingValueAsInt("menu1/setting1", 2));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.getRootHash(changedHash));
+    EXPECT_NE(firstHash, changedHash);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.getSubtreeHash("menu2/", changedHash));
+    EXPECT_EQ(menu2Hash, changedHash);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.restoreDefaultSettings("menu1/"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.getRootHash(changedHash));
+    EXPECT_EQ(firstHash, changedHash);
+
+    // The hash of a prefix that does not end with '/' is the sum of its settings.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.getSubtreeHash("menu", changedHash));
+    EXPECT_EQ(firstHash, changedHash);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, firstStorage.getSubtreeHash("menu3/", changedHash));
+    EXPECT_EQ(0U, changedHash);
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, firstStorage.getSubtreeHash(nullptr, changedHash));
+}
+
+TEST(SettingsStorage, listSubtreeHashes)
+{
+    SettingsStorage settingsStorage(linuxOSInterface, nullptr);
+    for (const char* key : {"menu1/group/setting1", "menu1/setting2", "menu1/setting3", "menu2/setting4", "setting5"})
+    {
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.registerSettingAsInt(key, ALL_PERMISSIONS, 1));
+    }
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsInt("menu1/volatile/setting6", SettingPermissions_t::VOLATILE, 1));
+
+    // The children of a prefix are listed in lexical order, with the hashes of getSubtreeHash().
+    std::vector<std::pair<std::string, uint64_t>> hashes = {{"previous", 0}};
+    std::vector<std::string>                      keys;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.listSubtreeHashes("", hashes));
+    std::transform(hashes.begin(), hashes.end(), std::back_inserter(keys), [](const auto& hash) { return hash.first; });
+    EXPECT_EQ(std::vector<std::string>({"menu1/", "menu2/", "setting5"}), keys);
+    uint64_t hash = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSubtreeHash("menu1/", hash));
+    EXPECT_EQ(hash, hashes[0].second);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSubtreeHash("setting5", hash));
+    EXPECT_EQ(hash, hashes[2].second);
+
+    keys.clear();
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.listSubtreeHashes("menu1/", hashes));
+    std::transform(hashes.begin(), hashes.end(), std::back_inserter(keys), [](const auto& hash) { return hash.first; });
+    EXPECT_EQ(std::vector<std::string>({"menu1/group/", "menu1/setting2", "menu1/setting3"}), keys);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.listSubtreeHashes("menu3/", hashes));
+    EXPECT_TRUE(hashes.empty());
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage.listSubtreeHashes("menu1", hashes));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage.listSubtreeHashes(nullptr, hashes));
+}
+
+TEST(SettingsStorage, getSubtreeHashLocked)
+{
+    MutexRecordingOSInterface osInterface;
+    SettingsStorage           settingsStorage(osInterface, nullptr);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.registerSettingAsInt("menu1/setting1", ALL_PERMISSIONS, 1));
+
+    // The readers mutex of the tree is created right after the mutex of the module configuration.
+    OSInterface_Mutex* readersMutex = osInterface.mutexes[1];
+    std::atomic<bool>  held         = false;
+    std::atomic<bool>  release      = false;
+    std::thread        holder(
+        [&]()
+        {
+            while (!readersMutex->wait(1000))
+            {
+            }
+            held = true;
+            while (!release)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            readersMutex->signal();
+        });
+    while (!held)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The hashes that are calculated from the settings can not be read while the settings can not be locked.
+    uint64_t                                      hash   = 0;
+    std::vector<std::pair<std::string, uint64_t>> hashes = {{"previous", 0}};
+    EXPECT_EQ(SettingsStorage::TIMEOUT_ERROR, settingsStorage.getSubtreeHash("menu1/setting", hash));
+    EXPECT_EQ(SettingsStorage::TIMEOUT_ERROR, settingsStorage.listSubtreeHashes("menu1/", hashes));
+    EXPECT_TRUE(hashes.empty());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSubtreeHash("menu1/", hash));
+    EXPECT_NE(0U, hash);
+    release = true;
+    holder.join();
+
+    uint64_t settingHash = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSubtreeHash("menu1/setting", settingHash));
+    EXPECT_EQ(hash, settingHash);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.listSubtreeHashes("menu1/", hashes));
+    EXPECT_EQ(1U, hashes.size());
+}
+
+TEST(SettingsStorage, getSubtreeHashStripesLocked)
+{
+    MutexRecordingOSInterface osInterface;
+    SettingsStorage           settingsStorage(osInterface, nullptr);
+    SettingsStorage           expectedStorage(linuxOSInterface, nullptr);
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsInt("menu1/group/setting1", ALL_PERMISSIONS, 1));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              expectedStorage.registerSettingAsInt("menu1/group/setting1", ALL_PERMISSIONS, 2));
+
+    // The mutexes of the hashes of the prefixes are created after the mutex of the module configuration and the
+    // readers mutex of the tree.
+    const std::vector<OSInterface_Mutex*> stripeMutexes(osInterface.mutexes.begin() + 2,
+                                                        osInterface.mutexes.begin() + 10);
+    std::atomic<bool>                     held    = false;
+    std::atomic<bool>                     release = false;
+    std::thread                           holder(
+        [&]()
+        {
+            for (OSInterface_Mutex* mutex : stripeMutexes)
+            {
+                while (!mutex->wait(1000))
+                {
+                }
+            }
+            held = true;
+            while (!release)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            for (OSInterface_Mutex* mutex : stripeMutexes)
+            {
+                mutex->signal();
+            }
+        });
+    while (!held)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // A change that can not lock the hashes of its prefixes is still made, and added to them once they are unlocked.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt("menu1/group/setting1", 2));
+    uint64_t                                      hash         = 0;
+    uint64_t                                      expectedHash = 0;
+    std::vector<std::pair<std::string, uint64_t>> hashes       = {{"previous", 0}};
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getRootHash(hash));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, expectedStorage.getRootHash(expectedHash));
+    EXPECT_EQ(expectedHash, hash);
+    EXPECT_EQ(SettingsStorage::TIMEOUT_ERROR, settingsStorage.getSubtreeHash("menu1/", hash));
+    EXPECT_EQ(SettingsStorage::TIMEOUT_ERROR, settingsStorage.listSubtreeHashes("", hashes));
+    EXPECT_TRUE(hashes.empty());
+    release = true;
+    holder.join();
+
+    for (const char* prefix : {"menu1/", "menu1/group/"})
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSubtreeHash(prefix, hash));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, expectedStorage.getSubtreeHash(prefix, expectedHash));
+        EXPECT_EQ(expectedHash, hash);
+    }
+}
+
+TEST(SettingsStorage, getSubtreeHashParallelPuts)
+{
+    constexpr int64_t threads = 4;
+    constexpr int64_t puts    = 1000;
+    SettingsStorage   settingsStorage(linuxOSInterface, nullptr);
+    for (int64_t thread = 0; thread < threads; thread++)
+    {
+        const std::string key = "menu" + std::to_string(thread) + "/setting";
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.registerSettingAsInt(key.c_str(), ALL_PERMISSIONS, 0));
+    }
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.registerSettingAsInt("shared/setting", ALL_PERMISSIONS, 0));
+
+    // The settings of different prefixes, and the same setting, are changed concurrently.
+    std::vector<std::thread> writers;
+    for (int64_t thread = 0; thread < threads; thread++)
+    {
+        writers.emplace_back(
+            [&settingsStorage, thread]()
+            {
+                const std::string key = "menu" + std::to_string(thread) + "/setting";
+                for (int64_t value = 1; value <= puts; value++)
+                {
+                    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.putSettingValueAsInt(key.c_str(), value));
+                    EXPECT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage.putSettingValueAsInt("shared/setting", thread * puts + value));
+                }
+            });
+    }
+    for (std::thread& writer : writers)
+    {
+        writer.join();
+    }
+
+    // The hashes are the same as the hashes of the last values.
+    int64_t sharedValue = 0;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getSettingAsInt("shared/setting", sharedValue));
+    SettingsStorage expectedStorage(linuxOSInterface, nullptr);
+    for (int64_t thread = 0; thread < threads; thread++)
+    {
+        const std::string key = "menu" + std::to_string(thread) + "/setting";
+        ASSERT_EQ(SettingsStorage::NO_ERROR, expectedStorage.registerSettingAsInt(key.c_str(), ALL_PERMISSIONS, puts));
+    }
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              expectedStorage.registerSettingAsInt("shared/setting", ALL_PERMISSIONS, sharedValue));
+    std::vector<std::pair<std::string, uint64_t>> hashes;
+    std::vector<std::pair<std::string, uint64_t>> expectedHashes;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.listSubtreeHashes("", hashes));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, expectedStorage.listSubtreeHashes("", expectedHashes));
+    EXPECT_EQ(expectedHashes, hashes);
+    uint64_t hash         = 0;
+    uint64_t expectedHash = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage.getRootHash(hash));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, expectedStorage.getRootHash(expectedHash));
+    EXPECT_EQ(expectedHash, hash);
+}
+
+TEST(SettingsStorage, getRootHashAfterLoad)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "new"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    uint64_t storedHash = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getRootHash(storedHash));
+
+    // The loaded settings and the imported settings update the hashes like the puts.
+    {
+        SettingsStorage loadedStorage(linuxOSInterface, settingsFileMock);
+        settings.iterateOverAll(populateSettingsCallback, &loadedStorage);
+        uint64_t loadedHash = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, loadedStorage.getRootHash(loadedHash));
+        EXPECT_NE(storedHash, loadedHash);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, loadedStorage.loadSettingsFromPersistentStorage());
+        EXPECT_EQ(SettingsStorage::NO_ERROR, loadedStorage.getRootHash(loadedHash));
+        EXPECT_EQ(storedHash, loadedHash);
+
+        SettingsStorage importedStorage(linuxOSInterface, nullptr);
+        settings.iterateOverAll(populateSettingsCallback, &importedStorage);
+        std::vector<std::byte> exported;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->exportToBuffer(exported));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.importFromBuffer(exported));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.getRootHash(loadedHash));
+        EXPECT_EQ(storedHash, loadedHash);
+    }
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
 TEST(SettingsStorage, restoreDefaultSettingsValidAllFilterByKey)
 {
     NEW_POPULATED_SETTINGS_STORAGE;
@@ -2782,73 +3281,2735 @@ TEST(SettingsStorage, loadSettingsFromPersistentStorageInvalidKeyString)
     TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
 }
 
-TEST(SettingsStorage, storeSettingsFromPersistentStorageValidVolatile)
+TEST(SettingsStorage, loadSettingsFromPersistentStorageValidHeaderCRC32C)
 {
     NEW_POPULATED_SETTINGS_T(settings);
 
-    SettingsFileMock* settingsFileMock =
-        new SettingsFileMock("menu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\nmenu3/"
-                             "setting4\t2\tstring4\n\r802044068\n",
-                             -1);
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(
+        "\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n");
+
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    int64_t value = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", value));
+    EXPECT_EQ(45, value);
+
+    delete settingsStorage;
+    delete settingsFileMock;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageValidHeaderCRC32)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(
+        "\rv1\t0\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r1874197929\n");
+
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    delete settingsStorage;
+    delete settingsFileMock;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageHeaderAlgorithmMismatch)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(
+        "\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r1874197929\n");
+
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    ASSERT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    delete settingsStorage;
+    delete settingsFileMock;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageHeaderInvalidVersion)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(
+        "\rv9\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n");
+
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    ASSERT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    delete settingsStorage;
+    delete settingsFileMock;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageHeaderInvalidAlgorithm)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(
+        "\rv1\t7\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n");
+
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    ASSERT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    delete settingsStorage;
+    delete settingsFileMock;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageMisplacedHeader)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(
+        "menu1/setting1\t0\t1.23\n\rv1\t1\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n");
+
     SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
 
+    ASSERT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    delete settingsStorage;
+    delete settingsFileMock;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageParallelMatchesSerial)
+{
+    constexpr uint32_t settingsCount = CONFIG_SETTINGS_STORAGE_PARALLEL_LOAD_MIN_CHUNK_SIZE / 8;
+    SettingsFileMock   settingsFileMock("", settingsCount * 64);
     {
-        settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+        SettingsStorage settingsStorage(linuxOSInterface, &settingsFileMock);
+        char            key[MAX_SETTING_KEY_SIZE];
+        for (uint32_t i = 0; i < settingsCount; i++)
+        {
+            snprintf(key, sizeof(key), "menu%u/setting%u", i % 7, i);
+            ASSERT_EQ(SettingsStorage::NO_ERROR,
+                      i % 2 == 0 ? settingsStorage.registerSettingAsReal(key, SettingPermissions_t::USER, i / 3.0)
+                                 : settingsStorage.registerSettingAsString(key, SettingPermissions_t::USER, key));
+        }
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.storeSettingsInPersistentStorage());
     }
 
-    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+    // Half of the settings are registered, so the load updates some settings and inserts the others as volatile.
+    SettingsFileMock serialFileMock(settingsFileMock._getInternalBuffer(), settingsCount * 64);
+    SettingsFileMock parallelFileMock(settingsFileMock._getInternalBuffer(), settingsCount * 64);
+    SettingsStorage  serialStorage(linuxOSInterface, &serialFileMock);
+    SettingsStorage  parallelStorage(linuxOSInterface, &parallelFileMock);
+    char             key[MAX_SETTING_KEY_SIZE];
+    for (uint32_t i = 0; i < settingsCount; i += 4)
+    {
+        snprintf(key, sizeof(key), "menu%u/setting%u", i % 7, i);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, serialStorage.registerSettingAsReal(key, SettingPermissions_t::USER, 0));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, parallelStorage.registerSettingAsReal(key, SettingPermissions_t::USER, 0));
+        snprintf(key, sizeof(key), "menu%u/setting%u", (i + 1) % 7, i + 1);
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  serialStorage.registerSettingAsString(key, SettingPermissions_t::USER, "default"));
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  parallelStorage.registerSettingAsString(key, SettingPermissions_t::USER, "default"));
+    }
 
-    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
-    EXPECT_STREQ("menu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r1874197929\n",
-                 settingsFileMock->_getInternalBuffer());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, serialStorage.loadSettingsFromPersistentStorage(1));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, parallelStorage.loadSettingsFromPersistentStorage(4));
 
-    SettingsStorage::SettingsKeysList_t outputKeys;
+    SettingsStorage::SettingsKeysList_t serialKeys;
+    SettingsStorage::SettingsKeysList_t parallelKeys;
     EXPECT_EQ(SettingsStorage::NO_ERROR,
-              settingsStorage->listSettingsKeys("", SettingPermissions_t::VOLATILE,
-                                                MatchSettingsWithAnyPermissionsListed, outputKeys));
+              serialStorage.listSettingsKeys("", SettingPermissions_t::VOLATILE, MatchSettingsWithAnyPermissionsListed,
+                                             serialKeys));
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              parallelStorage.listSettingsKeys("", SettingPermissions_t::VOLATILE,
+                                               MatchSettingsWithAnyPermissionsListed, parallelKeys));
+    EXPECT_EQ(settingsCount / 2, parallelKeys.size());
+    EXPECT_EQ(serialKeys, parallelKeys);
 
-    auto it = outputKeys.begin();
+    EXPECT_EQ(SettingsStorage::NO_ERROR, serialStorage.storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, parallelStorage.storeSettingsInPersistentStorage());
+    EXPECT_STREQ(serialFileMock._getInternalBuffer(), parallelFileMock._getInternalBuffer());
+}
 
-    ASSERT_NE(outputKeys.end(), it);
-    EXPECT_STREQ("menu3/setting4", it->c_str());
-    ++it;
+TEST(SettingsStorage, loadSettingsFromPersistentStorageParallelSmallFile)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(
+        "\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n");
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
 
-    ASSERT_EQ(outputKeys.end(), it);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage(4));
+
+    char stringValue[16];
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("string3", stringValue);
 
     delete settingsStorage;
     delete settingsFileMock;
     TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
 }
 
-TEST(SettingsStorage, storeSettingsFromPersistentStorageValidNoVolatile)
+TEST(SettingsStorage, loadSettingsFromPersistentStorageParallelInvalidCRC)
 {
     NEW_POPULATED_SETTINGS_STORAGE;
+    settingsFileMock->openForWrite();
+    settingsFileMock->write(std::string("menu1/setting1\t0\t9.5\nmenu1/setting2\t1\t7\n\r1874197929\n"));
+    settingsFileMock->close();
 
-    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorage(4));
 
-    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
-    EXPECT_STREQ("menu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r1874197929\n",
-                 settingsFileMock->_getInternalBuffer());
+    // The settings are not modified when the file is corrupted.
+    double realValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+    EXPECT_EQ(1.23, realValue);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageParallelTypeMismatch)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    settingsFileMock->openForWrite();
+    settingsFileMock->write(std::string("menu1/setting1\t1\t9\n\r3939210001\n"));
+    settingsFileMock->close();
+
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorage(4));
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorage(1));
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageTypeMismatchInBatch)
+{
+    for (const uint32_t threads : {1U, 4U})
+    {
+        NEW_POPULATED_SETTINGS_STORAGE;
+        settingsFileMock->openForWrite();
+        settingsFileMock->write(
+            std::string("menu1/setting1\t0\t9.5\nmenu1/setting2\t0\t7.5\nmenu2/setting3\t2\tnew\n\r570613524\n"));
+        settingsFileMock->close();
+
+        // The settings before and after the mismatched one are not merged either.
+        EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR,
+                  settingsStorage->loadSettingsFromPersistentStorage(threads));
+        double realValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+        EXPECT_EQ(1.23, realValue);
+        int64_t intValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(45, intValue);
+        char stringValue[16];
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+        EXPECT_STREQ("string3", stringValue);
+
+        TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+    }
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyRegister)
+{
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    SettingsStorage*  settingsStorage  = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
+
+    // The setting takes the persisted value, but keeps the permissions and default value of its registration.
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsReal("menu1/setting1", SettingPermissions_t::USER, 5.5));
+    double               realValue = 0;
+    SettingPermissions_t permissions;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue, &permissions));
+    EXPECT_EQ(1.23, realValue);
+    EXPECT_EQ(SettingPermissions_t::USER, permissions);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getDefaultSettingAsReal("menu1/setting1", realValue));
+    EXPECT_EQ(5.5, realValue);
+
+    // Settings that are read before being registered are loaded as volatile.
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue, &permissions));
+    EXPECT_EQ(45, intValue);
+    EXPECT_EQ(SettingPermissions_t::VOLATILE, permissions);
+    EXPECT_EQ(SettingsStorage::KEY_EXISTS_ERROR,
+              settingsStorage->registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 0));
+    EXPECT_EQ(SettingsStorage::KEY_NOT_FOUND_ERROR, settingsStorage->getSettingAsInt("menu1/setting4", intValue));
+
+    delete settingsStorage;
+    delete settingsFileMock;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyRegistered)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    settingsFileMock->openForWrite();
+    settingsFileMock->write(std::string("menu1/setting1\t0\t9.5\nmenu1/setting2\t1\t7\nmenu2/setting3\t2\tnew\n"
+                                        "\r3037108589\n"));
+    settingsFileMock->close();
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
+
+    double  realValue = 0;
+    int64_t intValue  = 0;
+    char    stringValue[16];
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 8));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(8, intValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+    EXPECT_EQ(9.5, realValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("new", stringValue);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyPutPending)
+{
+    MutexRecordingOSInterface osInterface;
+    SettingsFileMock*         settingsFileMock = new SettingsFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    SettingsStorage*          settingsStorage  = new SettingsStorage(osInterface, settingsFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 3));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
+
+    // The mutex of the lazy image is created right before the mutex of the asynchronous stores.
+    OSInterface_Mutex* lazyImageMutex = osInterface.mutexes[osInterface.mutexes.size() - 2];
+    std::atomic<bool>  held           = false;
+    std::atomic<bool>  release        = false;
+    std::thread        holder(
+        [&]()
+        {
+            while (!lazyImageMutex->wait(1000))
+            {
+            }
+            held = true;
+            while (!release)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            lazyImageMutex->signal();
+        });
+    while (!held)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // While the pending settings can not be loaded, a read uses the value in the tree and a write fails, otherwise the
+    // pending record would replace the value written once it is loaded.
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsStorage::TIMEOUT_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 8));
+    EXPECT_EQ(SettingsStorage::TIMEOUT_ERROR, settingsStorage->putSettingValueAsReal("menu1/setting1", 8.5));
+    EXPECT_EQ(SettingsStorage::TIMEOUT_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "new"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(3, intValue);
+    release = true;
+    holder.join();
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(45, intValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 8));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForSettings("", 1000));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(8, intValue);
+
+    delete settingsStorage;
+    delete settingsFileMock;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyList)
+{
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    SettingsStorage*  settingsStorage  = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
 
     SettingsStorage::SettingsKeysList_t outputKeys;
     EXPECT_EQ(SettingsStorage::NO_ERROR,
-              settingsStorage->listSettingsKeys("", SettingPermissions_t::VOLATILE,
-                                                ExcludeSettingsWithAnyPermissionsListed, outputKeys));
+              settingsStorage->listSettingsKeys("menu1", ALL_PERMISSIONS_VOLATILE,
+                                                MatchSettingsWithAnyPermissionsListed, outputKeys));
+    ASSERT_EQ(2U, outputKeys.size());
+    EXPECT_STREQ("menu1/setting1", outputKeys.front().c_str());
+    EXPECT_STREQ("menu1/setting2", outputKeys.back().c_str());
 
-    auto it = outputKeys.begin();
-    ASSERT_NE(outputKeys.end(), it);
-    EXPECT_STREQ("menu1/setting1", it->c_str());
-    ++it;
+    // Only the settings of the prefix are in the tree, so the other ones can still be registered.
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsString("menu2/setting3", SettingPermissions_t::USER, "default"));
 
-    ASSERT_NE(outputKeys.end(), it);
-    EXPECT_STREQ("menu1/setting2", it->c_str());
-    ++it;
+    outputKeys.clear();
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->listSettingsKeys("", ALL_PERMISSIONS_VOLATILE,
+                                                                           MatchSettingsWithAnyPermissionsListed,
+                                                                           outputKeys));
+    EXPECT_EQ(3U, outputKeys.size());
 
-    ASSERT_NE(outputKeys.end(), it);
-    EXPECT_STREQ("menu2/setting3", it->c_str());
-    ++it;
+    delete settingsStorage;
+    delete settingsFileMock;
+}
 
-    ASSERT_EQ(outputKeys.end(), it);
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyStore)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    settingsFileMock->openForWrite();
+    settingsFileMock->write(std::string("menu1/setting1\t0\t9.5\nmenu1/setting2\t1\t7\nmenu2/setting3\t2\tnew\n"
+                                        "\r3037108589\n"));
+    settingsFileMock->close();
+
+    // The pending settings are placed in the tree before the file is replaced.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+
+    std::string fileContent;
+    settingsFileMock->openForRead();
+    while (settingsFileMock->readLine(fileContent) == SettingsFile::Success)
+    {
+    }
+    settingsFileMock->close();
+    EXPECT_EQ("\rv1\t1\nmenu1/setting1\t0\t9.5\nmenu1/setting2\t1\t7\nmenu2/setting3\t2\tnew\n\r3045868583\n",
+              fileContent);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyInvalidCRC)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    settingsFileMock->openForWrite();
+    settingsFileMock->write(std::string("menu1/setting1\t0\t9.5\nmenu1/setting2\t1\t7\n\r1874197929\n"));
+    settingsFileMock->close();
+
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
+
+    double realValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+    EXPECT_EQ(1.23, realValue);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyTypeMismatch)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    settingsFileMock->openForWrite();
+    settingsFileMock->write(std::string("menu1/setting1\t1\t9\n\r3939210001\n"));
+    settingsFileMock->close();
+
+    // The file is valid, the record is discarded when it reaches the tree.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
+
+    double realValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+    EXPECT_EQ(1.23, realValue);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyUnsorted)
+{
+    SettingsFileMock* settingsFileMock =
+        new SettingsFileMock("menu2/setting3\t2\tstring3\nmenu1/setting1\t0\t1.23\n\r2111011167\n");
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    // Unsorted files are loaded eagerly, so the settings are already in the tree.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
+    EXPECT_EQ(SettingsStorage::KEY_EXISTS_ERROR,
+              settingsStorage->registerSettingAsReal("menu1/setting1", SettingPermissions_t::USER, 0));
+
+    char stringValue[16];
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("string3", stringValue);
+
+    delete settingsStorage;
+    delete settingsFileMock;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageStagedPermissions)
+{
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    SettingsStorage*  settingsStorage  = new SettingsStorage(linuxOSInterface, settingsFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsReal("menu1/setting1", SettingPermissions_t::SYSTEM, 0));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsString("menu2/setting3", SettingPermissions_t::USER, "default"));
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->loadSettingsFromPersistentStorageStaged(nullptr, SettingPermissions_t::SYSTEM));
+
+    // The SYSTEM settings are loaded before returning.
+    double realValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+    EXPECT_EQ(1.23, realValue);
+
+    // The rest are loaded in the background.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForSettings("", 1000));
+    char                 stringValue[16];
+    int64_t              intValue = 0;
+    SettingPermissions_t permissions;
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("string3", stringValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue, &permissions));
+    EXPECT_EQ(45, intValue);
+    EXPECT_EQ(SettingPermissions_t::VOLATILE, permissions);
+
+    delete settingsStorage;
+    delete settingsFileMock;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageStagedPrefix)
+{
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    SettingsStorage*  settingsStorage  = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageStaged("menu2"));
+
+    char stringValue[16];
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("string3", stringValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForSettings("menu1", 1000));
+
+    double realValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+    EXPECT_EQ(1.23, realValue);
+
+    delete settingsStorage;
+    delete settingsFileMock;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageStagedStore)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    settingsFileMock->openForWrite();
+    settingsFileMock->write(std::string("menu1/setting1\t0\t9.5\nmenu1/setting2\t1\t7\nmenu2/setting3\t2\tnew\n"
+                                        "\r3037108589\n"));
+    settingsFileMock->close();
+
+    // Storing while the background thread is loading the settings stores all of them.
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageStaged(nullptr));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+
+    std::string fileContent;
+    settingsFileMock->openForRead();
+    while (settingsFileMock->readLine(fileContent) == SettingsFile::Success)
+    {
+    }
+    settingsFileMock->close();
+    EXPECT_EQ("\rv1\t1\nmenu1/setting1\t0\t9.5\nmenu1/setting2\t1\t7\nmenu2/setting3\t2\tnew\n\r3045868583\n",
+              fileContent);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageStagedInvalidInput)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->loadSettingsFromPersistentStorageStaged(nullptr, static_cast<SettingPermissions_t>(16)));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->loadSettingsFromPersistentStorageStaged(
+                  nullptr, SettingPermissions_t::USER, static_cast<SettingPermissionsFilterMode_t>(9)));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage->waitForSettings(nullptr, 0));
+
+    // Without a pending load, every setting is ready.
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, exportToBufferImportFromBufferValid)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsReal("menu1/setting1", 9.5));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "new"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsInt("menu3/setting4", SettingPermissions_t::VOLATILE, -7));
+
+    std::vector<std::byte> buffer;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->exportToBuffer(buffer));
+
+    // The image keeps the values, the default values and the permissions, including the volatile settings.
+    SettingsStorage importedStorage(linuxOSInterface);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, importedStorage.importFromBuffer(buffer));
+
+    double               realValue;
+    int64_t              intValue;
+    char                 stringValue[32];
+    SettingPermissions_t permissions;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.getSettingAsReal("menu1/setting1", realValue, &permissions));
+    EXPECT_EQ(9.5, realValue);
+    EXPECT_EQ(SettingPermissions_t::USER, permissions);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.getDefaultSettingAsReal("menu1/setting1", realValue));
+    EXPECT_EQ(1.23, realValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(45, intValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              importedStorage.getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("new", stringValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              importedStorage.getDefaultSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("string3", stringValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.getSettingAsInt("menu3/setting4", intValue, &permissions));
+    EXPECT_EQ(-7, intValue);
+    EXPECT_EQ(SettingPermissions_t::VOLATILE, permissions);
+
+    std::vector<std::byte> importedBuffer;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, importedStorage.exportToBuffer(importedBuffer));
+    EXPECT_EQ(buffer, importedBuffer);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, importFromBufferReplacesSettings)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    std::vector<std::byte> buffer;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->exportToBuffer(buffer));
+
+    // The settings of the image replace the registered ones, even with another type, and the rest are kept.
+    SettingsStorage importedStorage(linuxOSInterface);
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              importedStorage.registerSettingAsString("menu1/setting1", SettingPermissions_t::SYSTEM, "other"));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              importedStorage.registerSettingAsInt("menu4/setting5", SettingPermissions_t::ADMIN, 5));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, importedStorage.importFromBuffer(buffer));
+
+    double               realValue;
+    int64_t              intValue;
+    SettingPermissions_t permissions;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.getSettingAsReal("menu1/setting1", realValue, &permissions));
+    EXPECT_EQ(1.23, realValue);
+    EXPECT_EQ(SettingPermissions_t::USER, permissions);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.getSettingAsInt("menu4/setting5", intValue));
+    EXPECT_EQ(5, intValue);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, importFromBufferInvalid)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    std::vector<std::byte> buffer;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->exportToBuffer(buffer));
+
+    SettingsStorage importedStorage(linuxOSInterface);
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, importedStorage.importFromBuffer({}));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              importedStorage.importFromBuffer(std::span(buffer).first(buffer.size() - 1)));
+
+    std::vector<std::byte> corruptedBuffer = buffer;
+    corruptedBuffer.back() ^= std::byte{1};
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, importedStorage.importFromBuffer(corruptedBuffer));
+
+    corruptedBuffer    = buffer;
+    corruptedBuffer[4] = std::byte{2}; // Format version.
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, importedStorage.importFromBuffer(corruptedBuffer));
+
+    SettingsStorage::SettingsKeysList_t outputKeys;
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              importedStorage.listSettingsKeys("", ALL_PERMISSIONS_VOLATILE, MatchSettingsWithAnyPermissionsListed,
+                                               outputKeys));
+    EXPECT_TRUE(outputKeys.empty());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, exportToBufferLazily)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SettingsFileMock settingsFileMock("\rv1\t1\nmenu1/setting1\t0\t9.5\nmenu1/setting2\t1\t7\nmenu2/setting3\t2\tnew\n"
+                                      "\r3045868583\n");
+    SettingsStorage  settingsStorage(linuxOSInterface, &settingsFileMock);
+    settings.iterateOverAll(populateSettingsCallback, &settingsStorage);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.loadSettingsFromPersistentStorageLazily());
+
+    // The pending settings are part of the image.
+    std::vector<std::byte> buffer;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage.exportToBuffer(buffer));
+    SettingsStorage importedStorage(linuxOSInterface);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, importedStorage.importFromBuffer(buffer));
+
+    int64_t intValue;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(7, intValue);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageValidVolatile)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+
+    SettingsFileMock* settingsFileMock =
+        new SettingsFileMock("menu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\nmenu3/"
+                             "setting4\t2\tstring4\n\r802044068\n",
+                             -1);
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    {
+        settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    }
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n",
+                 settingsFileMock->_getInternalBuffer());
+
+    SettingsStorage::SettingsKeysList_t outputKeys;
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->listSettingsKeys("", SettingPermissions_t::VOLATILE,
+                                                MatchSettingsWithAnyPermissionsListed, outputKeys));
+
+    auto it = outputKeys.begin();
+
+    ASSERT_NE(outputKeys.end(), it);
+    EXPECT_STREQ("menu3/setting4", it->c_str());
+    ++it;
+
+    ASSERT_EQ(outputKeys.end(), it);
+
+    delete settingsStorage;
+    delete settingsFileMock;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageValidNoVolatile)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n",
+                 settingsFileMock->_getInternalBuffer());
+
+    SettingsStorage::SettingsKeysList_t outputKeys;
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->listSettingsKeys("", SettingPermissions_t::VOLATILE,
+                                                ExcludeSettingsWithAnyPermissionsListed, outputKeys));
+
+    auto it = outputKeys.begin();
+    ASSERT_NE(outputKeys.end(), it);
+    EXPECT_STREQ("menu1/setting1", it->c_str());
+    ++it;
+
+    ASSERT_NE(outputKeys.end(), it);
+    EXPECT_STREQ("menu1/setting2", it->c_str());
+    ++it;
+
+    ASSERT_NE(outputKeys.end(), it);
+    EXPECT_STREQ("menu2/setting3", it->c_str());
+    ++it;
+
+    ASSERT_EQ(outputKeys.end(), it);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageParallelMatchesSerial)
+{
+    constexpr uint32_t settingsCount = 3 * CONFIG_SETTINGS_STORAGE_PARALLEL_STORE_MIN_SETTINGS_PER_THREAD + 17;
+    SettingsFileMock   serialFileMock("", settingsCount * 64);
+    SettingsFileMock   parallelFileMock("", settingsCount * 64);
+    SettingsStorage    serialStorage(linuxOSInterface, &serialFileMock);
+    SettingsStorage    parallelStorage(linuxOSInterface, &parallelFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, serialStorage.setExtendedSettingsFile(&serialFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, parallelStorage.setExtendedSettingsFile(&parallelFileMock));
+
+    char key[MAX_SETTING_KEY_SIZE];
+    for (uint32_t i = 0; i < settingsCount; i++)
+    {
+        snprintf(key, sizeof(key), "menu%u/setting%u", i % 7, i);
+        for (const SettingsStorage* settingsStorage : {&serialStorage, &parallelStorage})
+        {
+            switch (i % 4)
+            {
+                case 0:
+                    ASSERT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage->registerSettingAsInt(key, SettingPermissions_t::USER,
+                                                                    -static_cast<int64_t>(i)));
+                    break;
+                case 1:
+                    ASSERT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage->registerSettingAsReal(key, SettingPermissions_t::USER, i / 3.0));
+                    break;
+                case 2:
+                    ASSERT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage->registerSettingAsString(key, SettingPermissions_t::USER, key));
+                    break;
+                default:
+                    ASSERT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage->registerSettingAsInt(key, ALL_PERMISSIONS_VOLATILE, i));
+                    break;
+            }
+        }
+    }
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, serialStorage.storeSettingsInPersistentStorage(1));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, parallelStorage.storeSettingsInPersistentStorage(4));
+    EXPECT_STREQ(serialFileMock._getInternalBuffer(), parallelFileMock._getInternalBuffer());
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, parallelStorage.loadSettingsFromPersistentStorage());
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageParallelSmallTree)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(settingsFileMock));
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage(8));
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n",
+                 settingsFileMock->_getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageChangedNumbers)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    // The numbers formatted by a store are reused by the next ones until their value changes.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", -46));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsReal("menu1/setting1", 2.5));
+    for (const uint32_t threads : {1U, 8U})
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage(threads));
+        const std::string storedFile = settingsFileMock->_getInternalBuffer();
+        EXPECT_NE(std::string::npos, storedFile.find("\nmenu1/setting1\t0\t2.5\nmenu1/setting2\t1\t-46\n"));
+    }
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->restoreDefaultSettings("menu1/"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n",
+                 settingsFileMock->_getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageInsertedNumber)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    // The records of the numbers are kept in the order they were stored, so a number stored before them moves them, and
+    // the bits of the real 1.23 now belong to an integer.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    const int64_t integer = std::bit_cast<int64_t>(1.23);
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsInt("menu1/setting0", SettingPermissions_t::USER, integer));
+    for (const uint32_t threads : {1U, 8U})
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage(threads));
+        const std::string storedFile = settingsFileMock->_getInternalBuffer();
+        EXPECT_NE(std::string::npos, storedFile.find("\nmenu1/setting0\t1\t" + std::to_string(integer) +
+                                                     "\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\n"));
+    }
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageCompressed)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ));
+
+    // The checksum protects the uncompressed records, so it does not depend on the compression.
+    const std::string fileData = settingsFileMock->_getInternalBuffer();
+    EXPECT_TRUE(fileData.starts_with("\rv2\t1\t1\n"));
+    EXPECT_TRUE(fileData.ends_with("\n\r2314151071\n"));
+    EXPECT_EQ(std::string::npos, fileData.find("menu2/setting3"));
+
+    {
+        SettingsStorage loadStorage(linuxOSInterface, settingsFileMock);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, loadStorage.loadSettingsFromPersistentStorage());
+        int64_t intValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, loadStorage.getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(45, intValue);
+        char stringValue[16];
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  loadStorage.getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue) - 1));
+        EXPECT_STREQ("string3", stringValue);
+    }
+
+    // Storing again without compression goes back to the version 1 format.
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE));
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n",
+                 settingsFileMock->_getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageCompressedParallelMatchesSerial)
+{
+    constexpr uint32_t settingsCount = 3 * CONFIG_SETTINGS_STORAGE_PARALLEL_STORE_MIN_SETTINGS_PER_THREAD + 17;
+    SettingsFileMock   serialFileMock("", settingsCount * 64);
+    SettingsFileMock   parallelFileMock("", settingsCount * 64);
+    SettingsStorage    serialStorage(linuxOSInterface, &serialFileMock);
+    SettingsStorage    parallelStorage(linuxOSInterface, &parallelFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, serialStorage.setExtendedSettingsFile(&serialFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, parallelStorage.setExtendedSettingsFile(&parallelFileMock));
+
+    char key[MAX_SETTING_KEY_SIZE];
+    for (uint32_t i = 0; i < settingsCount; i++)
+    {
+        snprintf(key, sizeof(key), "menu%u/setting%u", i % 7, i);
+        for (const SettingsStorage* settingsStorage : {&serialStorage, &parallelStorage})
+        {
+            ASSERT_EQ(SettingsStorage::NO_ERROR,
+                      settingsStorage->registerSettingAsString(key, SettingPermissions_t::USER, key + i % 5));
+        }
+    }
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              serialStorage.storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ));
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              parallelStorage.storeSettingsInPersistentStorage(4, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ));
+    EXPECT_STREQ(serialFileMock._getInternalBuffer(), parallelFileMock._getInternalBuffer());
+
+    // Every load mode decompresses the file.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, parallelStorage.loadSettingsFromPersistentStorage(1));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, parallelStorage.loadSettingsFromPersistentStorage(4));
+    SettingsStorage lazyStorage(linuxOSInterface, &parallelFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, lazyStorage.setExtendedSettingsFile(&parallelFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, lazyStorage.loadSettingsFromPersistentStorageLazily());
+    char stringValue[MAX_SETTING_KEY_SIZE];
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              lazyStorage.getSettingAsString("menu2/setting1003", stringValue, sizeof(stringValue) - 1));
+    EXPECT_STREQ("u2/setting1003", stringValue);
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageInvalidCompression)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(
+                  1, SettingsCompressionAlgorithm_t::MAX_SETTINGS_COMPRESSION_ALGORITHM));
+    EXPECT_STREQ(defaultSettingsFile, settingsFileMock->_getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageHeaderInvalidCompression)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+
+    // Uncompressed files must use the version 1 header.
+    SettingsFileMock* settingsFileMock = new SettingsFileMock(
+        "\rv2\t1\t0\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\nmenu2/setting3\t2\tstring3\n\r2314151071\n");
+
+    SettingsStorage* settingsStorage = new SettingsStorage(linuxOSInterface, settingsFileMock);
+
+    ASSERT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+
+    delete settingsStorage;
+    delete settingsFileMock;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageSparse)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(settingsFileMock));
+    constexpr auto compression = SettingsCompressionAlgorithm_t::NONE;
+
+    // The settings that keep their default value are not stored.
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, compression, StoreModifiedSettings));
+    EXPECT_STREQ("\rv1\t1\n\r0\n", settingsFileMock->_getInternalBuffer());
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "new"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, compression, StoreModifiedSettings));
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting2\t1\t7\nmenu2/setting3\t2\tnew\n\r2691217407\n",
+                 settingsFileMock->_getInternalBuffer());
+
+    // A setting that is reset to its default value is stored once as a tombstone, to reset the value of the last file.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 45));
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, compression, StoreModifiedSettings));
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting2\t~1\nmenu2/setting3\t2\tnew\n\r264904306\n",
+                 settingsFileMock->_getInternalBuffer());
+    // A file whose settings did not change is not written again, so the tombstone stays until the next write.
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, compression, StoreModifiedSettings));
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting2\t~1\nmenu2/setting3\t2\tnew\n\r264904306\n",
+                 settingsFileMock->_getInternalBuffer());
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, compression, StoreModifiedSettings,
+                                                                SettingsDurability_t::FSYNCED));
+    EXPECT_STREQ("\rv1\t1\nmenu2/setting3\t2\tnew\n\r1803926598\n", settingsFileMock->_getInternalBuffer());
+
+    // The sparse file only changes the stored settings.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "string3"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(45, intValue);
+    char stringValue[16];
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue) - 1));
+    EXPECT_STREQ("new", stringValue);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageSparseParallelMatchesSerial)
+{
+    constexpr uint32_t settingsCount = 3 * CONFIG_SETTINGS_STORAGE_PARALLEL_STORE_MIN_SETTINGS_PER_THREAD + 17;
+    SettingsFileMock   serialFileMock("", settingsCount * 64);
+    SettingsFileMock   parallelFileMock("", settingsCount * 64);
+    SettingsStorage    serialStorage(linuxOSInterface, &serialFileMock);
+    SettingsStorage    parallelStorage(linuxOSInterface, &parallelFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, serialStorage.setExtendedSettingsFile(&serialFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, parallelStorage.setExtendedSettingsFile(&parallelFileMock));
+
+    char key[MAX_SETTING_KEY_SIZE];
+    for (uint32_t i = 0; i < settingsCount; i++)
+    {
+        snprintf(key, sizeof(key), "menu%u/setting%u", i % 7, i);
+        for (const SettingsStorage* settingsStorage : {&serialStorage, &parallelStorage})
+        {
+            ASSERT_EQ(SettingsStorage::NO_ERROR,
+                      settingsStorage->registerSettingAsInt(key, SettingPermissions_t::USER, i));
+            if (i % 5 == 0)
+            {
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt(key, i + 1));
+            }
+        }
+    }
+
+    for (const SettingsStoreMode_t mode : {StoreModifiedSettings, StoreAllSettings, StoreModifiedSettings})
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  serialStorage.storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE, mode));
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  parallelStorage.storeSettingsInPersistentStorage(4, SettingsCompressionAlgorithm_t::NONE, mode));
+        EXPECT_STREQ(serialFileMock._getInternalBuffer(), parallelFileMock._getInternalBuffer());
+        EXPECT_EQ(SettingsStorage::NO_ERROR, parallelStorage.loadSettingsFromPersistentStorage(4));
+    }
+
+    // After a full store, the settings that keep their default value are stored as tombstones once.
+    const std::string fileData = serialFileMock._getInternalBuffer();
+    EXPECT_NE(std::string::npos, fileData.find("\nmenu1/setting1\t~1\n"));
+    EXPECT_NE(std::string::npos, fileData.find("\nmenu0/setting0\t1\t1\n"));
+}
+
+TEST(SettingsStorage, storeSettingsFromPersistentStorageInvalidMode)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE,
+                                                                static_cast<SettingsStoreMode_t>(5)));
+    EXPECT_STREQ(defaultSettingsFile, settingsFileMock->_getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageTombstones)
+{
+    constexpr char tombstonesFile[] = "\rv1\t1\nmenu1/setting1\t~2\nmenu1/setting2\t~1\nmenu2/setting3\t~2\nmenu9/"
+                                      "setting9\t~0\n\r3566467902\n";
+
+    // Tombstones reset the settings to their default value, unless the type does not match, and are not inserted.
+    for (const bool lazily : {false, true})
+    {
+        NEW_POPULATED_SETTINGS_STORAGE;
+        delete settingsStorage;
+        delete settingsFileMock;
+        settingsFileMock = new SettingsFileMock(tombstonesFile);
+        settingsStorage  = new SettingsStorage(linuxOSInterface, settingsFileMock);
+        settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsReal("menu1/setting1", 9.5));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "new"));
+        result = lazily ? settingsStorage->loadSettingsFromPersistentStorageLazily()
+                        : settingsStorage->loadSettingsFromPersistentStorage();
+        EXPECT_EQ(SettingsStorage::NO_ERROR, result);
+
+        double realValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+        EXPECT_EQ(9.5, realValue);
+        int64_t intValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(45, intValue);
+        char stringValue[16];
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue) - 1));
+        EXPECT_STREQ("string3", stringValue);
+        EXPECT_EQ(SettingsStorage::KEY_NOT_FOUND_ERROR, settingsStorage->getSettingAsInt("menu9/setting9", intValue));
+
+        TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+    }
+}
+
+TEST(SettingsStorage, storeSettingsInPersistentStorageShards)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(settingsFileMock));
+    SettingsFileMock shardFileMock("", defaultSettingsFileSize);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu2/", &shardFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&shardFileMock));
+
+    // Each file has its own header and checksum, and the settings of the shard are not stored in the settings file.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\n\r279854800\n",
+                 settingsFileMock->_getInternalBuffer());
+    EXPECT_STREQ("\rv1\t1\nmenu2/setting3\t2\tstring3\n\r2773349900\n", shardFileMock._getInternalBuffer());
+
+    // A shard whose settings did not change is not opened again.
+    shardFileMock._setForceMockMode(true);
+    shardFileMock._setOpenForWriteResult(SettingsFile::IOError);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t7\n\r4233329493\n",
+                 settingsFileMock->_getInternalBuffer());
+
+    // A shard that fails to be stored is stored again by the next store, and the unchanged settings file is not.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "new"));
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    shardFileMock._setForceMockMode(false);
+    settingsFileMock->_setForceMockMode(true);
+    settingsFileMock->_setOpenForWriteResult(SettingsFile::IOError);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage(4));
+    settingsFileMock->_setForceMockMode(false);
+    EXPECT_STREQ("\rv1\t1\nmenu2/setting3\t2\tnew\n\r1803926598\n", shardFileMock._getInternalBuffer());
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t7\n\r4233329493\n",
+                 settingsFileMock->_getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsInPersistentStorageNestedShards)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    SettingsFileMock menuFileMock("", defaultSettingsFileSize);
+    SettingsFileMock settingFileMock("", defaultSettingsFileSize);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu", &menuFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu1/setting2", &settingFileMock));
+
+    // A setting belongs to the shard with the longest prefix of its key.
+    for (const uint32_t threads : {1U, 4U})
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->restoreDefaultSettings(""));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage(threads));
+        EXPECT_STREQ("\rv1\t1\n\r0\n", settingsFileMock->_getInternalBuffer());
+        EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu2/setting3\t2\tstring3\n\r1448930642\n",
+                     menuFileMock._getInternalBuffer());
+        EXPECT_STREQ("\rv1\t1\nmenu1/setting2\t1\t45\n\r3430557004\n", settingFileMock._getInternalBuffer());
+    }
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsInPersistentStorageUnchanged)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+
+    // A file whose settings hash the same as when it was last written the same way is not opened again.
+    settingsFileMock->_setForceMockMode(true);
+    settingsFileMock->_setOpenForWriteResult(SettingsFile::IOError);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 45));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ));
+
+    // A file that failed to be written, or that was loaded, is written again.
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    settingsFileMock->_setForceMockMode(false);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+    settingsFileMock->_setForceMockMode(true);
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    settingsFileMock->_setForceMockMode(false);
+
+    // Only the hashes are compared, so a file modified by another writer since it was stored is not rewritten.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    char* record = strstr(settingsFileMock->_getInternalBuffer(), "\nmenu1/setting2\t1\t45\n");
+    ASSERT_NE(nullptr, record);
+    record[19] = '6';
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 45));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_NE(nullptr, strstr(settingsFileMock->_getInternalBuffer(), "\nmenu1/setting2\t1\t46\n"));
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageShards)
+{
+    for (const uint32_t threads : {1U, 4U})
+    {
+        NEW_POPULATED_SETTINGS_STORAGE;
+        SettingsFileMock shardFileMock("\rv1\t1\nmenu2/setting3\t2\tnew\n\r1803926598\n");
+        SettingsFileMock emptyShardFileMock("\rv1\t1\n\r0\n");
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu2/", &shardFileMock));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu3/", &emptyShardFileMock));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage(threads));
+        int64_t intValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(45, intValue);
+        char stringValue[16];
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue) - 1));
+        EXPECT_STREQ("new", stringValue);
+
+        TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+    }
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageLazilyShards)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    SettingsFileMock shardFileMock("\rv1\t1\nmenu2/setting3\t2\tnew\n\r1803926598\n");
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu2/", &shardFileMock));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+
+    // The pending record of the shard setting in the settings file is stale, so it does not replace the shard value.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorageLazily());
+    char stringValue[16];
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue) - 1));
+    EXPECT_STREQ("new", stringValue);
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(45, intValue);
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageCorruptedShard)
+{
+    for (const bool lazily : {false, true})
+    {
+        NEW_POPULATED_SETTINGS_STORAGE;
+        SettingsFileMock corruptedShardFileMock("\rv1\t1\nmenu2/setting3\t2\tnew\n\r1\n");
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu2/", &corruptedShardFileMock));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+
+        // The corrupted shard is not loaded, but the settings file is.
+        result = lazily ? settingsStorage->loadSettingsFromPersistentStorageLazily()
+                        : settingsStorage->loadSettingsFromPersistentStorage();
+        EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, result);
+        int64_t intValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(45, intValue);
+        char stringValue[16];
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue) - 1));
+        EXPECT_STREQ("string3", stringValue);
+
+        TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+    }
+}
+
+TEST(SettingsStorage, addSettingsShardInvalid)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    SettingsFileMock shardFileMock("");
+    std::string      longPrefix(MAX_SETTING_KEY_SIZE, 'a');
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage->addSettingsShard(nullptr, &shardFileMock));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage->addSettingsShard("", &shardFileMock));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->addSettingsShard(longPrefix.c_str(), &shardFileMock));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage->addSettingsShard("menu2/", nullptr));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu2/", &shardFileMock));
+    EXPECT_EQ(SettingsStorage::KEY_EXISTS_ERROR, settingsStorage->addSettingsShard("menu2/", &shardFileMock));
+
+    SettingsStorage nonPersistentStorage(linuxOSInterface);
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, nonPersistentStorage.addSettingsShard("menu2/", &shardFileMock));
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, setExtendedSettingsFile)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    SettingsFileMock shardFileMock("");
+    SettingsFileMock otherFileMock("");
+
+    // Only the settings files of the storage can provide their extended capabilities.
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage->setExtendedSettingsFile(nullptr));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage->setExtendedSettingsFile(&shardFileMock));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, settingsStorage->setExtendedSettingsFile(&otherFileMock));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(settingsFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu2/", &shardFileMock));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&shardFileMock));
+
+    SettingsStorage nonPersistentStorage(linuxOSInterface, nullptr);
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR, nonPersistentStorage.setExtendedSettingsFile(&otherFileMock));
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+static void countStoreResultCallback(void* data, const SettingsStorage::SettingError_t result)
+{
+    static_cast<std::vector<SettingsStorage::SettingError_t>*>(data)->push_back(result);
+}
+
+// A settings file whose openForWrite() blocks until it is released, so the background stores can be held in flight.
+class BlockingSettingsFileMock : public SettingsFileMock
+{
+public:
+    using SettingsFileMock::SettingsFileMock;
+
+    SettingsFileResult openForWrite() override
+    {
+        opens++;
+        while (blocked)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return SettingsFileMock::openForWrite();
+    }
+
+    std::atomic<uint32_t> opens   = 0;
+    std::atomic<bool>     blocked = true;
+};
+
+TEST(SettingsStorage, storeSettingsAsyncMatchesSync)
+{
+    for (const auto compression :
+         {SettingsCompressionAlgorithm_t::NONE, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ})
+    {
+        for (const auto mode : {StoreAllSettings, StoreModifiedSettings})
+        {
+            NEW_POPULATED_SETTINGS_STORAGE;
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "new"));
+
+            std::vector<SettingsStorage::SettingError_t> results;
+            EXPECT_EQ(SettingsStorage::NO_ERROR,
+                      settingsStorage->storeSettingsAsync(countStoreResultCallback, &results, compression, mode));
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+            EXPECT_EQ(std::vector<SettingsStorage::SettingError_t>{SettingsStorage::NO_ERROR}, results);
+            const std::string asyncFile = settingsFileMock->_getInternalBuffer();
+
+            EXPECT_EQ(SettingsStorage::NO_ERROR,
+                      settingsStorage->storeSettingsInPersistentStorage(1, compression, mode));
+            EXPECT_EQ(std::string(settingsFileMock->_getInternalBuffer()), asyncFile);
+
+            TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+        }
+    }
+}
+
+class RecordingSettingsTaskFactory : public SettingsTaskFactory
+{
+public:
+    SettingsTask* createTask(void (*function)(void* arg), void* arg, const SettingsTaskConfig_t& config) override
+    {
+        configs.push_back(config);
+        return failing ? nullptr : SettingsTaskFactory::createTask(function, arg, config);
+    }
+
+    std::vector<SettingsTaskConfig_t> configs;
+    bool                              failing = false;
+};
+
+TEST(SettingsStorage, setTaskFactory)
+{
+    for (const bool failing : {false, true})
+    {
+        NEW_POPULATED_SETTINGS_STORAGE;
+        RecordingSettingsTaskFactory taskFactory;
+        taskFactory.failing = failing;
+        settingsStorage->setTaskFactory(&taskFactory);
+        SettingsFileMock shardFileMock("\rv1\t1\nmenu2/setting3\t2\tnew\n\r1803926598\n");
+        SettingsFileMock emptyShardFileMock("\rv1\t1\n\r0\n");
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu2/", &shardFileMock));
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu3/", &emptyShardFileMock));
+
+        // The tasks are created by the factory, and their work is done by the calling task if it can not create them.
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage(2));
+        char stringValue[16];
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue) - 1));
+        EXPECT_STREQ("new", stringValue);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+        std::vector<SettingsStorage::SettingError_t> results;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(countStoreResultCallback, &results));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+        EXPECT_EQ(std::vector<SettingsStorage::SettingError_t>{SettingsStorage::NO_ERROR}, results);
+        EXPECT_NE(nullptr, strstr(settingsFileMock->_getInternalBuffer(), "\nmenu1/setting2\t1\t7\n"));
+
+        ASSERT_EQ(2U, taskFactory.configs.size());
+        EXPECT_STREQ("SettingsLoad", taskFactory.configs[0].name);
+        EXPECT_STREQ("SettingsStore", taskFactory.configs[1].name);
+        for (const SettingsTaskConfig_t& config : taskFactory.configs)
+        {
+            EXPECT_EQ(static_cast<uint32_t>(CONFIG_SETTINGS_STORAGE_TASK_STACK_SIZE), config.stackSize);
+            EXPECT_EQ(static_cast<uint32_t>(CONFIG_SETTINGS_STORAGE_TASK_PRIORITY), config.priority);
+            EXPECT_EQ(CONFIG_SETTINGS_STORAGE_TASK_CORE, config.core);
+        }
+
+        TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+    }
+}
+
+// Blocks the write of the records for up to 2 seconds, until it is unblocked. The header is written right away.
+class RecordsBlockingSettingsFileMock : public SettingsFileMock
+{
+public:
+    using SettingsFileMock::SettingsFileMock;
+
+    SettingsFileResult write(const std::string& data) override
+    {
+        if (data.find("menu1/") != std::string::npos)
+        {
+            recordWrites++;
+            for (int i = 0; i < 2000 && blocked; i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            released = true;
+        }
+        return SettingsFileMock::write(data);
+    }
+
+    std::atomic<uint32_t> recordWrites = 0;
+    std::atomic<bool>     blocked      = true;
+    std::atomic<bool>     released     = false;
+};
+
+TEST(SettingsStorage, storeSettingsInParallelUnlocksTree)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    RecordsBlockingSettingsFileMock fileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                           settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+
+    // The records are written once the tree is unlocked, so the settings can be registered while the file is written.
+    std::thread store([settingsStorage]
+                      { EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage(2)); });
+    while (fileMock.recordWrites == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsInt("menu2/setting4", SettingPermissions_t::USER, 7));
+    EXPECT_FALSE(fileMock.released);
+    fileMock.blocked = false;
+    store.join();
+    int64_t outputValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu2/setting4", outputValue));
+    EXPECT_EQ(7, outputValue);
+    EXPECT_NE(nullptr, strstr(fileMock._getInternalBuffer(), "\nmenu1/setting2\t1\t45\n"));
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+// Stores the modified settings with the given threads, or with storeSettingsAsync() if threads is 0.
+static SettingsStorage::SettingError_t storeModifiedSettings(const SettingsStorage* settingsStorage,
+                                                             const uint32_t         threads)
+{
+    constexpr auto compression = SettingsCompressionAlgorithm_t::NONE;
+    if (threads != 0)
+    {
+        return settingsStorage->storeSettingsInPersistentStorage(threads, compression, StoreModifiedSettings);
+    }
+    std::vector<SettingsStorage::SettingError_t> results;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(countStoreResultCallback, &results,
+                                                                             compression, StoreModifiedSettings));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    return results.size() == 1 ? results[0] : SettingsStorage::FATAL_ERROR;
+}
+
+TEST(SettingsStorage, storeSettingsModifiedAfterFailedStore)
+{
+    // The tombstone of a setting reset to its default value is written again if the file that had it selected could
+    // not be written.
+    for (const uint32_t threads : {1U, 4U, 0U})
+    {
+        NEW_POPULATED_SETTINGS_STORAGE;
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(settingsFileMock));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, storeModifiedSettings(settingsStorage, threads));
+        EXPECT_NE(nullptr, strstr(settingsFileMock->_getInternalBuffer(), "\nmenu1/setting2\t1\t7\n"));
+
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 45));
+        settingsFileMock->_setForceMockMode(true);
+        settingsFileMock->_setCloseResult(SettingsFile::IOError);
+        EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, storeModifiedSettings(settingsStorage, threads));
+        settingsFileMock->_setForceMockMode(false);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, storeModifiedSettings(settingsStorage, threads));
+        EXPECT_NE(nullptr, strstr(settingsFileMock->_getInternalBuffer(), "\nmenu1/setting2\t~1\n"));
+
+        TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+    }
+}
+
+TEST(SettingsStorage, storeSettingsAsyncShards)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    SettingsFileMock shardFileMock("", defaultSettingsFileSize);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu2/", &shardFileMock));
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    EXPECT_STREQ("\rv1\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\n\r279854800\n",
+                 settingsFileMock->_getInternalBuffer());
+    EXPECT_STREQ("\rv1\t1\nmenu2/setting3\t2\tstring3\n\r2773349900\n", shardFileMock._getInternalBuffer());
+
+    // A shard that fails to be written is written again by the next store.
+    std::vector<SettingsStorage::SettingError_t> results;
+    shardFileMock._setForceMockMode(true);
+    shardFileMock._setOpenForWriteResult(SettingsFile::IOError);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "new"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(countStoreResultCallback, &results));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    EXPECT_EQ(std::vector<SettingsStorage::SettingError_t>{SettingsStorage::SETTINGS_FILESYSTEM_ERROR}, results);
+    shardFileMock._setForceMockMode(false);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(countStoreResultCallback, &results));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, results.back());
+    EXPECT_STREQ("\rv1\t1\nmenu2/setting3\t2\tnew\n\r1803926598\n", shardFileMock._getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsAsyncCoalesced)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    BlockingSettingsFileMock blockingFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                    settingsStorage = new SettingsStorage(linuxOSInterface, &blockingFileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+
+    std::vector<SettingsStorage::SettingError_t> results;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(countStoreResultCallback, &results));
+    while (blockingFileMock.opens == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(SettingsStorage::TIMEOUT_ERROR, settingsStorage->waitForStore(0));
+
+    // The requests made while the first store is written are written together, with the last values.
+    for (int64_t i = 1; i <= 4; i++)
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", i));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(countStoreResultCallback, &results));
+    }
+    blockingFileMock.blocked = false;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    EXPECT_EQ(2U, blockingFileMock.opens);
+    EXPECT_EQ(std::vector<SettingsStorage::SettingError_t>(5, SettingsStorage::NO_ERROR), results);
+    EXPECT_NE(nullptr, strstr(blockingFileMock._getInternalBuffer(), "menu1/setting2\t1\t4\n"));
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+typedef std::tuple<const SettingsStorage*, std::vector<SettingsStorage::SettingError_t>> WaitForStoreCallbackData_t;
+
+static void waitForStoreCallback(void* data, [[maybe_unused]] const SettingsStorage::SettingError_t result)
+{
+    auto& [settingsStorage, results] = *static_cast<WaitForStoreCallbackData_t*>(data);
+    results.push_back(settingsStorage->waitForStore(1000));
+}
+
+TEST(SettingsStorage, storeSettingsAsyncWaitFromCallback)
+{
+    // A completion callback does not wait for its own store, only for the ones requested since.
+    NEW_POPULATED_SETTINGS_T(settings);
+    BlockingSettingsFileMock blockingFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                    settingsStorage = new SettingsStorage(linuxOSInterface, &blockingFileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+
+    WaitForStoreCallbackData_t callbackData(settingsStorage, {});
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(waitForStoreCallback, &callbackData));
+    while (blockingFileMock.opens == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(waitForStoreCallback, &callbackData));
+    blockingFileMock.blocked = false;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    EXPECT_EQ((std::vector<SettingsStorage::SettingError_t>{SettingsStorage::TIMEOUT_ERROR, SettingsStorage::NO_ERROR}),
+              std::get<1>(callbackData));
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsAsyncInvalid)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsAsync(nullptr, nullptr,
+                                                  SettingsCompressionAlgorithm_t::MAX_SETTINGS_COMPRESSION_ALGORITHM));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsAsync(nullptr, nullptr, SettingsCompressionAlgorithm_t::NONE,
+                                                  static_cast<SettingsStoreMode_t>(2)));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(0));
+
+    SettingsStorage nonPersistentStorage(linuxOSInterface);
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, nonPersistentStorage.storeSettingsAsync());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, nonPersistentStorage.waitForStore(0));
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsInPersistentStorageDurability)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(settingsFileMock));
+    SettingsFileMock shardFileMock("", defaultSettingsFileSize);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("interlock/", &shardFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&shardFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsInt("interlock/door", SettingPermissions_t::SYSTEM, 0,
+                                                    SettingsDurability_t::FSYNCED));
+
+    // Only the file of the setting that requires it is synced.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(0U, settingsFileMock->_getSyncCount());
+    EXPECT_EQ(1U, shardFileMock._getSyncCount());
+    EXPECT_EQ(SettingsDurability_t::FSYNCED, shardFileMock._getLastSyncDurability());
+
+    // The durability is required again each time the setting changes, and not by the other settings.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(0U, settingsFileMock->_getSyncCount());
+    EXPECT_EQ(1U, shardFileMock._getSyncCount());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("interlock/door", 1));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(0U, settingsFileMock->_getSyncCount());
+    EXPECT_EQ(2U, shardFileMock._getSyncCount());
+
+    // A setting that changes back to the value of its file does not write nor sync the file again.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("interlock/door", 0));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("interlock/door", 1));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(2U, shardFileMock._getSyncCount());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->restoreDefaultSettings("interlock/"));
+
+    // The durability of the store applies to every file written, and the highest one is used.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 8));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("interlock/door", 2));
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(4, SettingsCompressionAlgorithm_t::NONE,
+                                                                StoreAllSettings, SettingsDurability_t::FLUSHED));
+    EXPECT_EQ(1U, settingsFileMock->_getSyncCount());
+    EXPECT_EQ(SettingsDurability_t::FLUSHED, settingsFileMock->_getLastSyncDurability());
+    EXPECT_EQ(3U, shardFileMock._getSyncCount());
+    EXPECT_EQ(SettingsDurability_t::FSYNCED, shardFileMock._getLastSyncDurability());
+
+    // A file that fails to be synced is closed, and written and synced again by the next store.
+    shardFileMock._setSyncResult(SettingsFile::IOError);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("interlock/door", 3));
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsFile::FileClosed, shardFileMock.getOpenStatus());
+    shardFileMock._setSyncResult(SettingsFile::Success);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(5U, shardFileMock._getSyncCount());
+    EXPECT_STREQ("\rv1\t1\ninterlock/door\t1\t3\n\r4077394804\n", shardFileMock._getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsInPersistentStorageDurabilityNotSupported)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SettingsFileMock settingsFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    SettingsStorage  settingsStorage(linuxOSInterface, &settingsFileMock);
+    settings.iterateOverAll(populateSettingsCallback, &settingsStorage);
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage.registerSettingAsReal("menu1/limit", SettingPermissions_t::SYSTEM, 2.5,
+                                                    SettingsDurability_t::BUFFERED));
+
+    // A plain settings file can not tell how far its data gets, so the settings stay dirty until they are stored
+    // without durability.
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFileMock.getOpenStatus());
+    EXPECT_EQ(0U, settingsFileMock._getSyncCount());
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR,
+              settingsStorage.storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE,
+                                                               StoreAllSettings, SettingsDurability_t::FSYNCED));
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsAsyncDurability)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(settingsFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsString("menu3/interlock", SettingPermissions_t::SYSTEM, "closed",
+                                                       SettingsDurability_t::FLUSHED));
+
+    std::vector<SettingsStorage::SettingError_t> results;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(countStoreResultCallback, &results));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    EXPECT_EQ(std::vector<SettingsStorage::SettingError_t>{SettingsStorage::NO_ERROR}, results);
+    EXPECT_EQ(1U, settingsFileMock->_getSyncCount());
+    EXPECT_EQ(SettingsDurability_t::FLUSHED, settingsFileMock->_getLastSyncDurability());
+
+    // Without shards the file is always written, but it is only synced as far as the store requires.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsAsync(countStoreResultCallback, &results));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    EXPECT_EQ(1U, settingsFileMock->_getSyncCount());
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->storeSettingsAsync(countStoreResultCallback, &results,
+                                                  SettingsCompressionAlgorithm_t::NONE, StoreAllSettings,
+                                                  SettingsDurability_t::FSYNCED));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForStore(1000));
+    EXPECT_EQ(2U, settingsFileMock->_getSyncCount());
+    EXPECT_EQ(SettingsDurability_t::FSYNCED, settingsFileMock->_getLastSyncDurability());
+    EXPECT_EQ(std::vector<SettingsStorage::SettingError_t>(3, SettingsStorage::NO_ERROR), results);
+
+    // The durability of the settings is part of their image.
+    std::vector<std::byte> buffer;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->exportToBuffer(buffer));
+    SettingsFileMock importedFileMock("", defaultSettingsFileSize);
+    SettingsStorage  importedStorage(linuxOSInterface, &importedFileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, importedStorage.setExtendedSettingsFile(&importedFileMock));
+    ASSERT_EQ(SettingsStorage::NO_ERROR, importedStorage.importFromBuffer(buffer));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, importedStorage.storeSettingsInPersistentStorage());
+    EXPECT_EQ(1U, importedFileMock._getSyncCount());
+    EXPECT_EQ(SettingsDurability_t::FLUSHED, importedFileMock._getLastSyncDurability());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, storeSettingsDurabilityInvalid)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->registerSettingAsInt("menu3/int", SettingPermissions_t::USER, 0,
+                                                    SettingsDurability_t::MAX_SETTINGS_DURABILITY));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->registerSettingAsReal("menu3/real", SettingPermissions_t::USER, 0,
+                                                     SettingsDurability_t::MAX_SETTINGS_DURABILITY));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->registerSettingAsString("menu3/string", SettingPermissions_t::USER, "",
+                                                       SettingsDurability_t::MAX_SETTINGS_DURABILITY));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE,
+                                                                StoreAllSettings,
+                                                                SettingsDurability_t::MAX_SETTINGS_DURABILITY));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsAsync(nullptr, nullptr, SettingsCompressionAlgorithm_t::NONE,
+                                                  StoreAllSettings, SettingsDurability_t::MAX_SETTINGS_DURABILITY));
+    SettingsStorage::SettingsKeysList_t outputKeys;
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->listSettingsKeys("menu3/", ALL_PERMISSIONS_VOLATILE,
+                                                MatchSettingsWithAnyPermissionsListed, outputKeys));
+    EXPECT_TRUE(outputKeys.empty());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, settingsTreeUsableAfterWriteTimeout)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SettingsStorage::SettingValue_t newValue = _valueSetting1;
+
+    // A writer that times out while a reader keeps the tree must not keep it locked for the next readers and writers.
+    EXPECT_EQ(0, settings.iterateOverAll(
+                     [](void* data, const unsigned char*, uint32_t, void*) {
+                         auto* tree = static_cast<SettingsStorage::Settings_t*>(data);
+                         std::thread writer([tree]() { tree->insert("menu3/setting4", 14, nullptr); });
+                         writer.join();
+                         return 0;
+                     },
+                     &settings));
+    EXPECT_EQ(nullptr, settings.insert("menu3/setting4", 14, &newValue));
+    EXPECT_EQ(&newValue, settings.search("menu3/setting4", 14));
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInPersistentStorageJoinsStoreInFlight)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    BlockingSettingsFileMock blockingFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                    settingsStorage = new SettingsStorage(linuxOSInterface, &blockingFileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+
+    std::vector<SettingsStorage::SettingError_t> results(4, SettingsStorage::TIMEOUT_ERROR);
+    std::vector<std::thread>                     stores;
+    stores.emplace_back([&]() { results[0] = settingsStorage->storeSettingsInPersistentStorage(); });
+    while (blockingFileMock.opens == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The stores called while the first one is written share a single store, which starts after all of them.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+    for (size_t i = 1; i < results.size(); i++)
+    {
+        stores.emplace_back([&, i]() { results[i] = settingsStorage->storeSettingsInPersistentStorage(); });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    blockingFileMock.blocked = false;
+    for (auto& store : stores)
+    {
+        store.join();
+    }
+    EXPECT_EQ(std::vector<SettingsStorage::SettingError_t>(4, SettingsStorage::NO_ERROR), results);
+    EXPECT_EQ(2U, blockingFileMock.opens);
+    EXPECT_NE(nullptr, strstr(blockingFileMock._getInternalBuffer(), "menu1/setting2\t1\t7\n"));
+
+    // A store that was not requested during another one, or that writes the files in another way, is not joined.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 8));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage());
+    EXPECT_EQ(3U, blockingFileMock.opens);
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageWaitsForStore)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    BlockingSettingsFileMock blockingFileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                    settingsStorage = new SettingsStorage(linuxOSInterface, &blockingFileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 7));
+
+    SettingsStorage::SettingError_t storeResult = SettingsStorage::TIMEOUT_ERROR;
+    std::thread store([&]() { storeResult = settingsStorage->storeSettingsInPersistentStorage(); });
+    while (blockingFileMock.opens == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // The load does not read the file while it is being written.
+    std::atomic<bool>               loaded     = false;
+    SettingsStorage::SettingError_t loadResult = SettingsStorage::TIMEOUT_ERROR;
+    std::thread                     load([&]() {
+        loadResult = settingsStorage->loadSettingsFromPersistentStorage();
+        loaded     = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(loaded);
+    blockingFileMock.blocked = false;
+    store.join();
+    load.join();
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeResult);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, loadResult);
+    int64_t value = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", value));
+    EXPECT_EQ(7, value);
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeAndLoadWithoutSettingsFile)
+{
+    SettingsStorage settingsStorage(linuxOSInterface);
+
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage.storeSettingsInPersistentStorage());
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage.loadSettingsFromPersistentStorage());
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, settingsStorage.loadSettingsFromPersistentStorageLazily());
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR,
+              settingsStorage.loadSettingsFromPersistentStorageStaged(nullptr));
+}
+
+class SlotsSettingsFileMock : public SettingsFileMock
+{
+public:
+    using SettingsFileMock::SettingsFileMock;
+
+    SettingsFileResult openForWrite() override
+    {
+        rewrites++;
+        return SettingsFileMock::openForWrite();
+    }
+
+    SettingsFileResult writeAt(size_t offset, std::string_view data) override
+    {
+        slotWrites++;
+        return failSlotWrites ? IOError : SettingsFileMock::writeAt(offset, data);
+    }
+
+    uint32_t rewrites       = 0;
+    uint32_t slotWrites     = 0;
+    bool     failSlotWrites = false;
+};
+
+static SettingsStorage::SettingError_t storeSettingsInSlots(const SettingsStorage* settingsStorage)
+{
+    return settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE,
+                                                             StoreSettingsInSlots);
+}
+
+TEST(SettingsStorage, storeSettingsInSlotsFormat)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SlotsSettingsFileMock fileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                 settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    const std::string storedFile = fileMock._getInternalBuffer();
+    EXPECT_TRUE(storedFile.starts_with("\rv3\t1\nmenu1/setting1\t0\t4:1.23" + std::string(21, ' ') + '\t'));
+    EXPECT_NE(std::string::npos, storedFile.find("\nmenu1/setting2\t1\t2:45" + std::string(23, ' ') + '\t'));
+    EXPECT_NE(std::string::npos, storedFile.find("\nmenu2/setting3\t2\t7:string3" + std::string(10, ' ') + '\t'));
+    EXPECT_TRUE(storedFile.ends_with("\n\r3\n"));
+
+    // The slotted file is loaded by every load.
+    for (const uint32_t threads : {1U, 2U, 0U})
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 0));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "x"));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, threads == 0
+                                                 ? settingsStorage->loadSettingsFromPersistentStorageLazily()
+                                                 : settingsStorage->loadSettingsFromPersistentStorage(threads));
+        int64_t intValue = 0;
+        char    stringValue[16];
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(45, intValue);
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+        EXPECT_STREQ("string3", stringValue);
+    }
+    EXPECT_EQ(storedFile, fileMock._getInternalBuffer());
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInSlotsUpdatesInPlace)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SlotsSettingsFileMock fileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                 settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    const std::string storedFile = fileMock._getInternalBuffer();
+    EXPECT_EQ(1U, fileMock.rewrites);
+
+    // Only the slot of the setting that changed is written, and the rest of the file is kept.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", -123456789));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(1U, fileMock.rewrites);
+    EXPECT_EQ(1U, fileMock.slotWrites);
+    const std::string updatedFile = fileMock._getInternalBuffer();
+    const size_t      slotStart   = storedFile.find("menu1/setting2");
+    const size_t      slotEnd     = storedFile.find('\n', slotStart) + 1;
+    ASSERT_EQ(storedFile.size(), updatedFile.size());
+    EXPECT_EQ(storedFile.substr(0, slotStart), updatedFile.substr(0, slotStart));
+    EXPECT_EQ(storedFile.substr(slotEnd), updatedFile.substr(slotEnd));
+    EXPECT_EQ(slotStart, updatedFile.find("menu1/setting2\t1\t10:-123456789" + std::string(14, ' ') + '\t'));
+
+    // The settings that keep their value are not written again.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", -123456789));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(1U, fileMock.slotWrites);
+
+    // A string is updated in place while it fits in its slot, and the file is rewritten when it outgrows it.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "longer str"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(1U, fileMock.rewrites);
+    EXPECT_EQ(2U, fileMock.slotWrites);
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->putSettingValueAsString("menu2/setting3", "a string longer than its slot"));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(2U, fileMock.rewrites);
+    EXPECT_EQ(2U, fileMock.slotWrites);
+
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 0));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+    int64_t intValue = 0;
+    char    stringValue[32];
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(-123456789, intValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+    EXPECT_STREQ("a string longer than its slot", stringValue);
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInSlotsRewritesFile)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SlotsSettingsFileMock fileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                 settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+
+    // A new setting needs a new slot.
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsInt("menu1/setting4", SettingPermissions_t::USER, 4));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(2U, fileMock.rewrites);
+    EXPECT_NE(nullptr, strstr(fileMock._getInternalBuffer(), "\nmenu1/setting4\t1\t1:4 "));
+
+    // A file stored in another mode has no slots.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting4", 5));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->storeSettingsInPersistentStorage(1));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting4", 6));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(4U, fileMock.rewrites);
+    EXPECT_EQ(0U, fileMock.slotWrites);
+
+    // A slot that can not be written is not trusted anymore, so the next store rewrites the file.
+    fileMock.failSlotWrites = true;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting4", 7));
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(1U, fileMock.slotWrites);
+    EXPECT_EQ(SettingsFile::FileClosed, fileMock.getOpenStatus());
+    fileMock.failSlotWrites = false;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(5U, fileMock.rewrites);
+    EXPECT_NE(nullptr, strstr(fileMock._getInternalBuffer(), "\nmenu1/setting4\t1\t1:7 "));
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInSlotsAfterLoad)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SlotsSettingsFileMock fileMock(defaultSettingsFile, defaultSettingsFileSize);
+    auto*                 settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    delete settingsStorage;
+
+    // The slots of a loaded file are updated in place, whichever load read it.
+    for (const uint32_t threads : {1U, 2U, 0U})
+    {
+        settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+        settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, threads == 0
+                                                 ? settingsStorage->loadSettingsFromPersistentStorageLazily()
+                                                 : settingsStorage->loadSettingsFromPersistentStorage(threads));
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->putSettingValueAsInt("menu1/setting2", static_cast<int64_t>(threads)));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+        EXPECT_EQ(1U, fileMock.rewrites);
+        delete settingsStorage;
+    }
+    EXPECT_EQ(3U, fileMock.slotWrites);
+
+    // Without positioned writes, the file is always rewritten.
+    settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 9));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    EXPECT_EQ(2U, fileMock.rewrites);
+    EXPECT_EQ(3U, fileMock.slotWrites);
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInSlotsInvalid)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ,
+                                                                StoreSettingsInSlots));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsAsync(nullptr, nullptr, SettingsCompressionAlgorithm_t::NONE,
+                                                  StoreSettingsInSlots));
+    EXPECT_STREQ(defaultSettingsFile, settingsFileMock->_getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageCorruptedSlots)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    const std::string storedFile   = settingsFileMock->_getInternalBuffer();
+    const size_t      secondRecord = storedFile.find("menu1/setting2");
+    const size_t      countLine    = storedFile.rfind('\r');
+
+    // A missing record, or a wrong number of records. The slots that do not match their checksum are only skipped.
+    std::string missingRecord = storedFile;
+    missingRecord.erase(secondRecord, storedFile.find('\n', secondRecord) + 1 - secondRecord);
+    std::string wrongCount = storedFile;
+    wrongCount.replace(countLine, std::string::npos, "\r4\n");
+
+    for (const std::string& corruptedFile : {missingRecord, wrongCount})
+    {
+        for (const uint32_t threads : {1U, 2U, 0U})
+        {
+            SettingsFileMock corruptedFileMock(corruptedFile.c_str());
+            SettingsStorage  corruptedStorage(linuxOSInterface, &corruptedFileMock);
+            EXPECT_EQ(SettingsStorage::NO_ERROR,
+                      corruptedStorage.registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 0));
+            EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR,
+                      threads == 0 ? corruptedStorage.loadSettingsFromPersistentStorageLazily()
+                                   : corruptedStorage.loadSettingsFromPersistentStorage(threads));
+            int64_t intValue = 1;
+            EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getSettingAsInt("menu1/setting2", intValue));
+            EXPECT_EQ(0, intValue);
+        }
+    }
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageTornSlots)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(settingsStorage));
+    const std::string storedFile = settingsFileMock->_getInternalBuffer();
+
+    // A slot torn by an interrupted update does not match its checksum, so it is skipped and the others are loaded.
+    const std::vector<std::tuple<std::string, std::string, std::string, std::string, std::string>> tornSlots = {
+        {"menu1/setting1\t", "4:1.23", "4:#.23", "", "menu1/setting2"},
+        {"menu1/setting2\t", "2:45", "2:46", "menu1/setting1", "menu2/setting3"},
+        {"menu1/setting2\t", "2:45", "9:45", "menu1/setting1", "menu2/setting3"},
+        {"menu2/setting3\t", "7:string3", "7:str#ng3", "menu1/setting2", ""},
+    };
+    for (const auto& [tornKey, value, tornValue, afterKey, beforeKey] : tornSlots)
+    {
+        std::string tornFile = storedFile;
+        tornFile.replace(tornFile.find(value, tornFile.find(tornKey)), value.size(), tornValue);
+
+        for (const uint32_t threads : {1U, 2U, 0U})
+        {
+            SlotsSettingsFileMock tornFileMock(tornFile.c_str());
+            SettingsStorage       tornStorage(linuxOSInterface, &tornFileMock);
+            EXPECT_EQ(SettingsStorage::NO_ERROR,
+                      tornStorage.registerSettingAsReal("menu1/setting1", SettingPermissions_t::USER, 0));
+            EXPECT_EQ(SettingsStorage::NO_ERROR,
+                      tornStorage.registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 0));
+            EXPECT_EQ(SettingsStorage::NO_ERROR,
+                      tornStorage.registerSettingAsString("menu2/setting3", SettingPermissions_t::USER, "default"));
+            EXPECT_EQ(SettingsStorage::DAMAGED_SETTINGS_ERROR,
+                      threads == 0 ? tornStorage.loadSettingsFromPersistentStorageLazily()
+                                   : tornStorage.loadSettingsFromPersistentStorage(threads));
+
+            std::vector<SettingsStorage::SettingsKeyRange_t> ranges;
+            EXPECT_EQ(SettingsStorage::NO_ERROR, tornStorage.getDamagedKeyRanges(ranges));
+            ASSERT_EQ(1U, ranges.size());
+            EXPECT_EQ("", ranges[0].keyPrefix);
+            EXPECT_EQ(afterKey, ranges[0].afterKey);
+            EXPECT_EQ(beforeKey, ranges[0].beforeKey);
+
+            // The torn setting keeps its value, the others take the value of their slot.
+            double  realValue = 0;
+            int64_t intValue  = 0;
+            char    stringValue[16];
+            EXPECT_EQ(SettingsStorage::NO_ERROR, tornStorage.getSettingAsReal("menu1/setting1", realValue));
+            EXPECT_EQ(tornKey == "menu1/setting1\t" ? 0 : 1.23, realValue);
+            EXPECT_EQ(SettingsStorage::NO_ERROR, tornStorage.getSettingAsInt("menu1/setting2", intValue));
+            EXPECT_EQ(tornKey == "menu1/setting2\t" ? 0 : 45, intValue);
+            EXPECT_EQ(SettingsStorage::NO_ERROR,
+                      tornStorage.getSettingAsString("menu2/setting3", stringValue, sizeof(stringValue)));
+            EXPECT_STREQ(tornKey == "menu2/setting3\t" ? "default" : "string3", stringValue);
+
+            // The torn slot is not in the index, so the next store rewrites the file instead of updating it in place.
+            EXPECT_EQ(SettingsStorage::NO_ERROR, tornStorage.putSettingValueAsInt("menu1/setting2", 7));
+            EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInSlots(&tornStorage));
+            EXPECT_EQ(1U, tornFileMock.rewrites);
+            EXPECT_EQ(0U, tornFileMock.slotWrites);
+            EXPECT_EQ(SettingsStorage::NO_ERROR, tornStorage.loadSettingsFromPersistentStorage());
+        }
+    }
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+// A settings file that can be mapped for update. The changes to the mapping only reach the disk when they are synced,
+// or when the file crashes, which keeps a random subset of the sectors that were not synced.
+class MappedSettingsFileMock : public ExtendedSettingsFile
+{
+public:
+    SettingsFileResult read(char* byte) override
+    {
+        if (status != FileOpenedForRead || readIndex >= pageCache.size())
+        {
+            return status != FileOpenedForRead ? InvalidState : EndOfFile;
+        }
+        *byte = pageCache[readIndex++];
+        return Success;
+    }
+
+    SettingsFileResult readLine(std::string& buffer) override
+    {
+        if (status != FileOpenedForRead || readIndex >= pageCache.size())
+        {
+            return status != FileOpenedForRead ? InvalidState : EndOfFile;
+        }
+        const size_t lineEnd = std::min(pageCache.find('\n', readIndex), pageCache.size() - 1) + 1;
+        buffer.append(pageCache, readIndex, lineEnd - readIndex);
+        readIndex = lineEnd;
+        return Success;
+    }
+
+    SettingsFileResult write(const char byte) override
+    {
+        return write(std::string(1, byte));
+    }
+
+    SettingsFileResult write(const std::string& data) override
+    {
+        if (status != FileOpenedForWrite || mapped)
+        {
+            return InvalidState;
+        }
+        pageCache.append(data);
+        return Success;
+    }
+
+    SettingsFileResult openForRead() override
+    {
+        if (status != FileClosed)
+        {
+            return InvalidState;
+        }
+        status    = FileOpenedForRead;
+        readIndex = 0;
+        return Success;
+    }
+
+    SettingsFileResult openForWrite() override
+    {
+        if (status != FileClosed)
+        {
+            return InvalidState;
+        }
+        status = FileOpenedForWrite;
+        pageCache.clear();
+        return Success;
+    }
+
+    SettingsFileResult close() override
+    {
+        if (status == FileClosed)
+        {
+            return InvalidState;
+        }
+        // The files written sequentially are synced when they are closed, like the mapped ones when they are synced.
+        if (status == FileOpenedForWrite && !mapped)
+        {
+            disk = pageCache;
+        }
+        status = FileClosed;
+        mapped = false;
+        return Success;
+    }
+
+    void forceClose() override
+    {
+        if (status != FileClosed)
+        {
+            close();
+        }
+    }
+
+    FileStatus getOpenStatus() override
+    {
+        return status;
+    }
+
+    SettingsFileResult mapForRead(std::string_view& data) override
+    {
+        data = status == FileOpenedForRead ? std::string_view(pageCache) : std::string_view();
+        return status == FileOpenedForRead ? Success : InvalidState;
+    }
+
+    SettingsFileResult mapForUpdate(const size_t size, char*& data, size_t& mappedSize) override
+    {
+        data       = nullptr;
+        mappedSize = 0;
+        if (status != FileClosed && !mapped)
+        {
+            return InvalidState;
+        }
+        status = FileOpenedForWrite;
+        mapped = true;
+        if (size > pageCache.size())
+        {
+            pageCache.resize(size, '\0');
+            disk.resize(size, '\0');
+        }
+        data       = pageCache.data();
+        mappedSize = pageCache.size();
+        return Success;
+    }
+
+    SettingsFileResult syncMapped(const size_t offset, const size_t length) override
+    {
+        if (status != FileOpenedForWrite || !mapped || offset + length > pageCache.size())
+        {
+            return InvalidState;
+        }
+        if (++syncs == crashAtSync)
+        {
+            return IOError;
+        }
+        syncedBytes += length;
+        disk.replace(offset, length, pageCache, offset, length);
+        return Success;
+    }
+
+    // Keeps a random subset of the sectors that were not synced, and drops the rest.
+    void crash(std::mt19937& random)
+    {
+        constexpr size_t SECTOR_SIZE = 512;
+        for (size_t sector = 0; sector < pageCache.size(); sector += SECTOR_SIZE)
+        {
+            if (random() % 2 == 0)
+            {
+                const size_t length = std::min(SECTOR_SIZE, pageCache.size() - sector);
+                disk.replace(sector, length, pageCache, sector, length);
+            }
+        }
+        pageCache = disk;
+        status    = FileClosed;
+        mapped    = false;
+    }
+
+    std::string pageCache; // What the reads see.
+    std::string disk;      // What survives a crash.
+    uint32_t    syncs       = 0;
+    uint32_t    crashAtSync = 0;
+    size_t      syncedBytes = 0;
+
+private:
+    FileStatus status    = FileClosed;
+    bool       mapped    = false;
+    size_t     readIndex = 0;
+};
+
+static SettingsStorage::SettingError_t storeSettingsInMappedTree(const SettingsStorage* settingsStorage)
+{
+    return settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE,
+                                                             StoreSettingsInMappedTree);
+}
+
+TEST(SettingsStorage, storeSettingsInMappedTree)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    MappedSettingsFileMock fileMock;
+    auto*                  settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInMappedTree(settingsStorage));
+    EXPECT_TRUE(fileMock.disk.starts_with("\rv4\n"));
+    EXPECT_EQ(fileMock.pageCache, fileMock.disk);
+    EXPECT_EQ(SettingsFile::FileClosed, fileMock.getOpenStatus());
+    EXPECT_EQ(2U, fileMock.syncs);
+
+    // The tree is loaded by every load.
+    for (const uint32_t threads : {1U, 2U, 0U})
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 0));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsString("menu2/setting3", "x"));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, threads == 0
+                                                 ? settingsStorage->loadSettingsFromPersistentStorageLazily()
+                                                 : settingsStorage->loadSettingsFromPersistentStorage(threads));
+        int64_t     intValue  = 0;
+        double      realValue = 0;
+        std::string stringValue(16, '\0');
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(45, intValue);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+        EXPECT_EQ(1.23, realValue);
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->getSettingAsString("menu2/setting3", stringValue.data(), stringValue.size()));
+        EXPECT_STREQ("string3", stringValue.c_str());
+    }
+
+    // The settings that keep their value are not written again.
+    const std::string storedFile = fileMock.disk;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 45));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInMappedTree(settingsStorage));
+    EXPECT_EQ(storedFile, fileMock.disk);
+    EXPECT_EQ(2U, fileMock.syncs);
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInMappedTreeUpdatesInPlace)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    MappedSettingsFileMock fileMock;
+    auto*                  settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    char name[32];
+    for (int i = 0; i < 1000; i++)
+    {
+        snprintf(name, sizeof(name), "menu3/setting%04d", i);
+        ASSERT_EQ(SettingsStorage::NO_ERROR,
+                  settingsStorage->registerSettingAsInt(name, SettingPermissions_t::USER, i));
+    }
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInMappedTree(settingsStorage));
+    const std::string storedFile = fileMock.disk;
+
+    // Only the nodes of the path of the setting that changed are written, after the nodes of the tree.
+    fileMock.syncedBytes = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu3/setting0500", -1));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInMappedTree(settingsStorage));
+    EXPECT_LT(fileMock.syncedBytes, storedFile.size() / 4);
+    EXPECT_GT(fileMock.disk.size(), storedFile.size());
+    constexpr size_t headerSize = SettingsMappedTree::HEADER_SIZE;
+    EXPECT_EQ(storedFile.substr(headerSize), fileMock.disk.substr(headerSize, storedFile.size() - headerSize));
+
+    // A new setting is inserted in the tree.
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->registerSettingAsInt("menu3/setting1000", SettingPermissions_t::USER, 1000));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInMappedTree(settingsStorage));
+
+    // A staged load searches the priority settings in the tree, and loads the rest in the background.
+    delete settingsStorage;
+    settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    EXPECT_EQ(SettingsStorage::NO_ERROR,
+              settingsStorage->loadSettingsFromPersistentStorageStaged("menu3/setting05", SettingPermissions_t::USER));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->waitForSettings("menu3/", 10000));
+    SettingsStorage::SettingsKeysList_t keys;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->listSettingsKeys("menu3/", SettingPermissions_t::VOLATILE,
+                                                                           MatchSettingsWithAnyPermissionsListed,
+                                                                           keys));
+    EXPECT_EQ(1001U, keys.size());
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu3/setting0500", intValue));
+    EXPECT_EQ(-1, intValue);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu3/setting1000", intValue));
+    EXPECT_EQ(1000, intValue);
+
+    // The loaded settings that are not registered are volatile, so the tree is built again without them.
+    EXPECT_EQ(SettingsStorage::NO_ERROR, storeSettingsInMappedTree(settingsStorage));
+    delete settingsStorage;
+    settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 0));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+    keys.clear();
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->listSettingsKeys("menu3/", SettingPermissions_t::VOLATILE,
+                                                                           MatchSettingsWithAnyPermissionsListed,
+                                                                           keys));
+    EXPECT_TRUE(keys.empty());
+    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(45, intValue);
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInMappedTreeSurvivesCrashes)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    std::mt19937 random(42);
+
+    // A crash at any sync of a store leaves either the old or the new settings, whatever part of the file was written.
+    for (const int changedSettings : {1, 3})
+    {
+        for (uint32_t crashAtSync = 1; crashAtSync <= 3; crashAtSync++)
+        {
+            for (int attempt = 0; attempt < 20; attempt++)
+            {
+                MappedSettingsFileMock fileMock;
+                auto*                  settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+                settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+                ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInMappedTree(settingsStorage));
+
+                EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 46));
+                if (changedSettings > 1)
+                {
+                    EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsReal("menu1/setting1", 2));
+                    EXPECT_EQ(SettingsStorage::NO_ERROR,
+                              settingsStorage->putSettingValueAsString("menu2/setting3", "a longer new value"));
+                }
+                fileMock.syncs       = 0;
+                fileMock.crashAtSync = crashAtSync;
+                EXPECT_EQ(crashAtSync <= 2 ? SettingsStorage::SETTINGS_FILESYSTEM_ERROR : SettingsStorage::NO_ERROR,
+                          storeSettingsInMappedTree(settingsStorage));
+                delete settingsStorage;
+                fileMock.crash(random);
+
+                settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+                settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+                EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 0));
+                ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->loadSettingsFromPersistentStorage());
+                int64_t     intValue  = 0;
+                double      realValue = 0;
+                std::string stringValue(32, '\0');
+                EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+                EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsReal("menu1/setting1", realValue));
+                EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsString(
+                                                         "menu2/setting3", stringValue.data(), stringValue.size()));
+                // Until the nodes are synced, the header is not written. Once they are, it may reach the disk.
+                if (crashAtSync == 3 || (crashAtSync == 2 && intValue == 46))
+                {
+                    EXPECT_EQ(46, intValue);
+                    EXPECT_EQ(changedSettings > 1 ? 2 : 1.23, realValue);
+                    EXPECT_STREQ(changedSettings > 1 ? "a longer new value" : "string3", stringValue.c_str());
+                }
+                else
+                {
+                    EXPECT_EQ(45, intValue);
+                    EXPECT_EQ(1.23, realValue);
+                    EXPECT_STREQ("string3", stringValue.c_str());
+                }
+                delete settingsStorage;
+            }
+        }
+    }
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInMappedTreeInvalid)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(settingsFileMock));
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ,
+                                                                StoreSettingsInMappedTree));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsAsync(nullptr, nullptr, SettingsCompressionAlgorithm_t::NONE,
+                                                  StoreSettingsInMappedTree));
+
+    // The file of the mock can not be mapped, so it is not modified.
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, storeSettingsInMappedTree(settingsStorage));
+    EXPECT_STREQ(defaultSettingsFile, settingsFileMock->_getInternalBuffer());
+    EXPECT_EQ(SettingsFile::FileClosed, settingsFileMock->getOpenStatus());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageCorruptedMappedTree)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    MappedSettingsFileMock fileMock;
+    auto*                  settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->setExtendedSettingsFile(&fileMock));
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInMappedTree(settingsStorage));
+    delete settingsStorage;
+    const std::string storedFile = fileMock.disk;
+
+    // A corrupted node fails the whole eager load, and only drops its own records in a lazy load.
+    fileMock.pageCache[storedFile.find("\t1\t45") + 4] = '6';
+    for (const uint32_t threads : {1U, 2U, 0U})
+    {
+        SettingsStorage corruptedStorage(linuxOSInterface, &fileMock);
+        ASSERT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.setExtendedSettingsFile(&fileMock));
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  corruptedStorage.registerSettingAsInt("menu1/setting2", SettingPermissions_t::USER, 0));
+        EXPECT_EQ(SettingsStorage::NO_ERROR,
+                  corruptedStorage.registerSettingAsString("menu2/setting3", SettingPermissions_t::USER, ""));
+        EXPECT_EQ(threads == 0 ? SettingsStorage::NO_ERROR : SettingsStorage::SETTINGS_FILESYSTEM_ERROR,
+                  threads == 0 ? corruptedStorage.loadSettingsFromPersistentStorageLazily()
+                               : corruptedStorage.loadSettingsFromPersistentStorage(threads));
+        int64_t intValue = 1;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(0, intValue);
+    }
+
+    // A file whose superblock is corrupted has no tree. The first store commits the tree in the superblock at 512.
+    fileMock.pageCache = storedFile;
+    fileMock.pageCache[512 + 8] ^= 1;
+    SettingsStorage corruptedStorage(linuxOSInterface, &fileMock);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.setExtendedSettingsFile(&fileMock));
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, corruptedStorage.loadSettingsFromPersistentStorage());
+    EXPECT_EQ(SettingsStorage::SETTINGS_FILESYSTEM_ERROR, corruptedStorage.loadSettingsFromPersistentStorageLazily());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+static SettingsStorage::SettingError_t storeSettingsInBlocks(const SettingsStorage* settingsStorage)
+{
+    return settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::NONE,
+                                                             StoreSettingsInBlocks);
+}
+
+// Registers the settings menu3/setting000 to menu3/setting199 with the default value i and the value i + 1000. Stored
+// after the populated settings, the blocks of 64 records end at menu3/setting060, 124, 188 and 199.
+static void registerBlockSettings(const SettingsStorage* settingsStorage, const bool modified)
+{
+    char key[MAX_SETTING_KEY_SIZE];
+    for (int64_t i = 0; i < 200; i++)
+    {
+        snprintf(key, sizeof(key), "menu3/setting%03d", static_cast<int>(i));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->registerSettingAsInt(key, SettingPermissions_t::USER, i));
+        if (modified)
+        {
+            EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt(key, i + 1000));
+        }
+    }
+}
+
+TEST(SettingsStorage, storeSettingsInBlocksFormat)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SettingsFileMock fileMock("", 16384);
+    auto*            settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    registerBlockSettings(settingsStorage, true);
+
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInBlocks(settingsStorage));
+    const std::string storedFile = fileMock._getInternalBuffer();
+    EXPECT_TRUE(storedFile.starts_with("\rv5\t1\nmenu1/setting1\t0\t1.23\nmenu1/setting2\t1\t45\n"));
+    EXPECT_NE(std::string::npos, storedFile.find("\nmenu3/setting060\t1\t1060\n\rb"));
+    EXPECT_NE(std::string::npos, storedFile.find("\nmenu3/setting124\t1\t1124\n\rb"));
+    EXPECT_NE(std::string::npos, storedFile.find("\nmenu3/setting188\t1\t1188\n\rb"));
+    EXPECT_NE(std::string::npos, storedFile.find("\nmenu3/setting199\t1\t1199\n\rb"));
+    EXPECT_TRUE(storedFile.ends_with("\n\r4\n"));
+
+    // The blocked file is loaded by every load.
+    for (const uint32_t threads : {1U, 2U, 0U})
+    {
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu1/setting2", 0));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->putSettingValueAsInt("menu3/setting150", 0));
+        EXPECT_EQ(SettingsStorage::NO_ERROR, threads == 0
+                                                 ? settingsStorage->loadSettingsFromPersistentStorageLazily()
+                                                 : settingsStorage->loadSettingsFromPersistentStorage(threads));
+        int64_t intValue = 0;
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu1/setting2", intValue));
+        EXPECT_EQ(45, intValue);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getSettingAsInt("menu3/setting150", intValue));
+        EXPECT_EQ(1150, intValue);
+        std::vector<SettingsStorage::SettingsKeyRange_t> damagedRanges(1);
+        EXPECT_EQ(SettingsStorage::NO_ERROR, settingsStorage->getDamagedKeyRanges(damagedRanges));
+        EXPECT_TRUE(damagedRanges.empty());
+    }
+    EXPECT_EQ(storedFile, fileMock._getInternalBuffer());
+
+    delete settingsStorage;
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, storeSettingsInBlocksInvalid)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsInPersistentStorage(1, SettingsCompressionAlgorithm_t::FRONT_CODING_LZ,
+                                                                StoreSettingsInBlocks));
+    EXPECT_EQ(SettingsStorage::INVALID_INPUT_ERROR,
+              settingsStorage->storeSettingsAsync(nullptr, nullptr, SettingsCompressionAlgorithm_t::NONE,
+                                                  StoreSettingsInBlocks));
+    EXPECT_STREQ(defaultSettingsFile, settingsFileMock->_getInternalBuffer());
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageCorruptedBlocks)
+{
+    NEW_POPULATED_SETTINGS_T(settings);
+    SettingsFileMock fileMock("", 16384);
+    auto*            settingsStorage = new SettingsStorage(linuxOSInterface, &fileMock);
+    settings.iterateOverAll(populateSettingsCallback, settingsStorage);
+    registerBlockSettings(settingsStorage, true);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInBlocks(settingsStorage));
+    const std::string storedFile = fileMock._getInternalBuffer();
+    delete settingsStorage;
+
+    // A value that does not match the checksum of its block, a checksum line that no longer starts a line, which joins
+    // its block with the next one, and a file truncated in its last block. Each one skips a range of keys.
+    std::string changedValue = storedFile;
+    changedValue.replace(storedFile.find("\t1\t1100\n"), 8, "\t1\t1101\n");
+    std::string brokenChecksumLine = storedFile;
+    brokenChecksumLine[storedFile.find("\rb", storedFile.find("menu3/setting124"))] = 'x';
+    const std::string truncatedFile = storedFile.substr(0, storedFile.find("menu3/setting195"));
+    const std::vector<std::tuple<std::string, const char*, const char*, const char*>> corruptedFiles = {
+        {changedValue, "menu3/setting060", "menu3/setting125", "menu3/setting100"},
+        {brokenChecksumLine, "menu3/setting060", "menu3/setting189", "menu3/setting150"},
+        {truncatedFile, "menu3/setting188", "", "menu3/setting190"},
+    };
+
+    for (const auto& [corruptedFile, afterKey, beforeKey, skippedKey] : corruptedFiles)
+    {
+        for (const uint32_t threads : {1U, 2U, 0U})
+        {
+            SettingsFileMock corruptedFileMock(corruptedFile.c_str());
+            SettingsStorage  corruptedStorage(linuxOSInterface, &corruptedFileMock);
+            registerBlockSettings(&corruptedStorage, false);
+            EXPECT_EQ(SettingsStorage::DAMAGED_SETTINGS_ERROR,
+                      threads == 0 ? corruptedStorage.loadSettingsFromPersistentStorageLazily()
+                                   : corruptedStorage.loadSettingsFromPersistentStorage(threads));
+
+            // The settings of the skipped blocks keep their value, and the others are loaded.
+            int64_t intValue = 0;
+            EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getSettingAsInt(skippedKey, intValue));
+            EXPECT_EQ(std::stoi(skippedKey + 13), intValue);
+            EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getSettingAsInt("menu1/setting2", intValue));
+            EXPECT_EQ(45, intValue);
+            EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getSettingAsInt(afterKey, intValue));
+            EXPECT_EQ(1000 + std::stoi(afterKey + 13), intValue);
+
+            std::vector<SettingsStorage::SettingsKeyRange_t> damagedRanges;
+            EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getDamagedKeyRanges(damagedRanges));
+            ASSERT_EQ(1U, damagedRanges.size());
+            EXPECT_EQ("", damagedRanges[0].keyPrefix);
+            EXPECT_EQ(afterKey, damagedRanges[0].afterKey);
+            EXPECT_EQ(beforeKey, damagedRanges[0].beforeKey);
+        }
+    }
+
+    TEAR_DOWN_NEW_POPULATED_SETTINGS_T;
+}
+
+TEST(SettingsStorage, loadSettingsFromPersistentStorageCorruptedBlocksInShard)
+{
+    NEW_POPULATED_SETTINGS_STORAGE;
+    SettingsFileMock shardFileMock("", 16384);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, settingsStorage->addSettingsShard("menu3/", &shardFileMock));
+    registerBlockSettings(settingsStorage, true);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, storeSettingsInBlocks(settingsStorage));
+    std::string shardFile = shardFileMock._getInternalBuffer();
+    shardFile.replace(shardFile.find("\t1\t1010\n"), 8, "\t1\t1011\n");
+
+    // The first block of the shard is skipped, and the rest of the shard and the settings file are loaded.
+    SettingsFileMock corruptedShardMock(shardFile.c_str());
+    SettingsFileMock settingsFileCopy(settingsFileMock->_getInternalBuffer());
+    SettingsStorage  corruptedStorage(linuxOSInterface, &settingsFileCopy);
+    ASSERT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.addSettingsShard("menu3/", &corruptedShardMock));
+    EXPECT_EQ(SettingsStorage::DAMAGED_SETTINGS_ERROR, corruptedStorage.loadSettingsFromPersistentStorage());
+    int64_t intValue = 0;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getSettingAsInt("menu1/setting2", intValue));
+    EXPECT_EQ(45, intValue);
+    EXPECT_EQ(SettingsStorage::KEY_NOT_FOUND_ERROR, corruptedStorage.getSettingAsInt("menu3/setting010", intValue));
+    EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getSettingAsInt("menu3/setting064", intValue));
+    EXPECT_EQ(1064, intValue);
+
+    std::vector<SettingsStorage::SettingsKeyRange_t> damagedRanges;
+    EXPECT_EQ(SettingsStorage::NO_ERROR, corruptedStorage.getDamagedKeyRanges(damagedRanges));
+    ASSERT_EQ(1U, damagedRanges.size());
+    EXPECT_EQ("menu3/", damagedRanges[0].keyPrefix);
+    EXPECT_EQ("", damagedRanges[0].afterKey);
+    EXPECT_EQ("menu3/setting064", damagedRanges[0].beforeKey);
 
     TEAR_DOWN_NEW_POPULATED_SETTINGS_STORAGE;
 }
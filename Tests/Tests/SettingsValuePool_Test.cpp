@@ -0,0 +1,80 @@
+#include "SettingsValuePool.h"
+#include <cstring>
+#include <set>
+#include <vector>
+#include "gtest/gtest.h"
+
+TEST(SettingsValuePool, AllocateObjects)
+{
+    SettingsValuePool pool(24, 4);
+    EXPECT_EQ(0U, pool.getSlabCount());
+
+    // The objects are aligned for any type, and a slab is only added once the last one is full.
+    std::vector<void*> objects;
+    for (int i = 0; i < 9; i++)
+    {
+        objects.push_back(pool.allocateObject());
+        EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(objects.back()) % alignof(std::max_align_t));
+        memset(objects.back(), i, 24);
+    }
+    EXPECT_EQ(3U, pool.getSlabCount());
+    EXPECT_EQ(9U, std::set<void*>(objects.begin(), objects.end()).size());
+
+    // A freed object is reused before any new slab.
+    pool.freeObject(objects[4]);
+    EXPECT_EQ(objects[4], pool.allocateObject());
+    EXPECT_EQ(3U, pool.getSlabCount());
+}
+
+TEST(SettingsValuePool, AllocateStrings)
+{
+    SettingsValuePool pool(24, 4, 256);
+
+    // The strings of the same class share slabs, and a freed string is reused by the next string of its class.
+    char* shortString = pool.allocateString(5);
+    char* otherString = pool.allocateString(16);
+    EXPECT_EQ(1U, pool.getSlabCount());
+    char* longerString = pool.allocateString(17);
+    EXPECT_EQ(2U, pool.getSlabCount());
+    strcpy(shortString, "auto");
+    strcpy(longerString, "192.168.100.200");
+    pool.freeString(shortString, 5);
+    EXPECT_EQ(shortString, pool.allocateString(12));
+    EXPECT_STREQ("192.168.100.200", longerString);
+    EXPECT_NE(otherString, longerString);
+
+    // The big strings are allocated on their own, and released with the pool if they are not freed.
+    char* bigString = pool.allocateString(1000);
+    memset(bigString, 'x', 1000);
+    pool.freeString(bigString, 1000);
+    memset(pool.allocateString(300), 'y', 300);
+    memset(pool.allocateString(5000), 'z', 5000);
+    EXPECT_EQ(2U, pool.getSlabCount());
+
+    EXPECT_EQ(16U, SettingsValuePool::getStringCapacity(1));
+    EXPECT_EQ(64U, SettingsValuePool::getStringCapacity(33));
+    EXPECT_EQ(300U, SettingsValuePool::getStringCapacity(300));
+}
+
+TEST(SettingsValuePool, Reserve)
+{
+    SettingsValuePool pool(40, 8);
+    void*             firstObject = pool.allocateObject();
+
+    // The objects reserved take a single slab, and the blocks already available are counted.
+    pool.reserve(100);
+    EXPECT_EQ(2U, pool.getSlabCount());
+    for (int i = 1; i < 100; i++)
+    {
+        memset(pool.allocateObject(), i, 40);
+    }
+    EXPECT_EQ(2U, pool.getSlabCount());
+    pool.reserve(50);
+    EXPECT_EQ(2U, pool.getSlabCount());
+    pool.freeObject(firstObject);
+    pool.reserve(100);
+    EXPECT_EQ(2U, pool.getSlabCount());
+    pool.allocateObject();
+    pool.allocateObject();
+    EXPECT_EQ(3U, pool.getSlabCount());
+}